@@ -33,7 +33,7 @@ int save_BMP(img_t *Img, const char *Filename)
 {
 	file_header_t	FileHeader;
 	bmp_headerV1_t	BMPHeaderV1;
-	uint8_t			ByteZero = 0;
+	uint8_t			ByteZero[3] = {0, 0, 0};
 	int32_t 		SizeWidthByte;
 	int32_t			TotalWidthMod4;
 
@@ -155,7 +155,7 @@ int save_BMP(img_t *Img, const char *Filename)
 			{
 				if(TotalWidthMod4 == 1)
 				{
-					if(fwrite(&ByteZero, sizeof(uint8_t), 3, ImageFile) != 1)
+					if(fwrite(ByteZero, sizeof(uint8_t), 3, ImageFile) != 3)
 					{
 						printf("Error: [save_BMP()] --> Could not write padding to file.\n\n");
 						return -1;
@@ -163,7 +163,7 @@ int save_BMP(img_t *Img, const char *Filename)
 					
 				}else if(TotalWidthMod4 == 2)
 				{
-					if(fwrite(&ByteZero, sizeof(uint8_t), 2, ImageFile) != 1)
+					if(fwrite(ByteZero, sizeof(uint8_t), 2, ImageFile) != 2)
 					{
 						printf("Error: [save_BMP()] --> Could not write padding to file.\n\n");
 						return -1;
@@ -171,7 +171,7 @@ int save_BMP(img_t *Img, const char *Filename)
 					
 				}else if(TotalWidthMod4 == 3)
 				{
-					if(fwrite(&ByteZero, sizeof(uint8_t), 1, ImageFile) != 1)
+					if(fwrite(ByteZero, sizeof(uint8_t), 1, ImageFile) != 1)
 					{
 						printf("Error: [save_BMP()] --> Could not write padding to file.\n\n");
 						return -1;
@@ -187,9 +187,9 @@ int save_BMP(img_t *Img, const char *Filename)
 }
 
 /******************************************************************************/
-/* Read BMP image to a pixel matrix
-   Return NULL if fail */
-img_t *read_BMP(const char *Filename)
+/* Open BMP image and read its headers. File is left at the start of the pixel matrix
+   (rows of 24 bits pixels padded to 4 bytes). Return NULL if fail */
+FILE *open_BMP(const char *Filename, int32_t *Width, int32_t *Height)
 {
 	file_header_t	FileHeader;
 	bmp_headerV1_t	BMPHeaderV1;
@@ -198,104 +198,128 @@ img_t *read_BMP(const char *Filename)
 	bmp_headerV4_t	BMPHeaderV4;
 	bmp_headerV5_t	BMPHeaderV5;
 
-	uint8_t 		Trash;
-
-	img_t			*Img;
 	FILE 			*ImageFile;
 
 	/* Open image */
 	ImageFile = fopen(Filename, "rb");
 	if(ImageFile == NULL)
 	{
-		printf("Error: [read_BMP()] --> Could not open file for pixel matrix extraction.\n\n");
+		printf("Error: [open_BMP()] --> Could not open file for pixel matrix extraction.\n\n");
 		return NULL;
 	}
 	
 	/* Acquire file header and verify if valid */
 	if(fread(&FileHeader, sizeof(file_header_t), 1, ImageFile) != 1)
 	{
-		printf("Error: [read_BMP()] --> Could not read \"File Header\".\n\n");
+		printf("Error: [open_BMP()] --> Could not read \"File Header\".\n\n");
+		fclose(ImageFile);
 		return NULL;
 	}
 	
 	if((FileHeader.CharID_1 != 0x42) || (FileHeader.CharID_2 != 0x4D))
 	{
-		printf("Error: [read_BMP()] --> Input file was not recognized as a BMP image.\n\n");
+		printf("Error: [open_BMP()] --> Input file was not recognized as a BMP image.\n\n");
+		fclose(ImageFile);
 		return NULL;
 	}
 	
-	/* Allocate space for image struct */
-	Img = malloc(sizeof(img_t));
-
-	/*============================== Temporary adjustment =======================*/
-	/*                CRAP IMPLEMENTATION !! FIX AS SOON AS POSSIBLE !!!         */
-	/* Improvising as 8-bit image acquisition has not yet been implemented */
-	Img->Pixel8 = NULL;
-	/*============================================================================*/
-	
 	/* Finding out BMP header version and reading it */
 	switch(FileHeader.OffsetPixelMatrix - sizeof(file_header_t))
 	{
 		case BITMAP_V1_INFOHEADER :
 			if(fread(&BMPHeaderV1, sizeof(bmp_headerV1_t), 1, ImageFile) != 1)
 			{
-				printf("Error: [read_BMP()] --> Could not read \"Header V1\".\n\n");
+				printf("Error: [open_BMP()] --> Could not read \"Header V1\".\n\n");
+				fclose(ImageFile);
 				return NULL;
 			}
-			Img->Width = BMPHeaderV1.Width;
-			Img->Height = BMPHeaderV1.Height;
+			*Width = BMPHeaderV1.Width;
+			*Height = BMPHeaderV1.Height;
 			break;
 			
 		case BITMAP_V2_INFOHEADER :
 			if(fread(&BMPHeaderV2, sizeof(bmp_headerV2_t), 1, ImageFile) != 1)
 			{
-				printf("Error: [read_BMP()] --> Could not read \"Header V2\". \n\n");
+				printf("Error: [open_BMP()] --> Could not read \"Header V2\". \n\n");
+				fclose(ImageFile);
 				return NULL;
 			}
-			Img->Width = BMPHeaderV2.Width;
-			Img->Height = BMPHeaderV2.Height;
+			*Width = BMPHeaderV2.Width;
+			*Height = BMPHeaderV2.Height;
 			break;
 		
 		case BITMAP_V3_INFOHEADER :
 			if(fread(&BMPHeaderV3, sizeof(bmp_headerV3_t), 1, ImageFile) != 1)
 			{
-				printf("Error: [read_BMP()] --> Could not read \"Header V3\".\n\n");
+				printf("Error: [open_BMP()] --> Could not read \"Header V3\".\n\n");
+				fclose(ImageFile);
 				return NULL;
 			}
-			Img->Width = BMPHeaderV3.Width;
-			Img->Height = BMPHeaderV3.Height;
+			*Width = BMPHeaderV3.Width;
+			*Height = BMPHeaderV3.Height;
 			break;
 		
 		case BITMAP_V4_INFOHEADER :
 			if(fread(&BMPHeaderV4, sizeof(bmp_headerV4_t), 1, ImageFile) != 1)
 			{
-				printf("Error: [read_BMP()] --> Could not read \"Header V4\".\n\n");
+				printf("Error: [open_BMP()] --> Could not read \"Header V4\".\n\n");
+				fclose(ImageFile);
 				return NULL;
 			}
-			Img->Width = BMPHeaderV4.Width;
-			Img->Height = BMPHeaderV4.Height;
+			*Width = BMPHeaderV4.Width;
+			*Height = BMPHeaderV4.Height;
 			break;
 			
 		case BITMAP_V5_INFOHEADER :
 			if(fread(&BMPHeaderV5, sizeof(bmp_headerV5_t), 1, ImageFile) != 1)
 			{
-				printf("Error: [read_BMP()] --> Could not read \"Header V5\".\n\n");
+				printf("Error: [open_BMP()] --> Could not read \"Header V5\".\n\n");
+				fclose(ImageFile);
 				return NULL;
 			}
-			Img->Width = BMPHeaderV5.Width;
-			Img->Height = BMPHeaderV5.Height;
+			*Width = BMPHeaderV5.Width;
+			*Height = BMPHeaderV5.Height;
 			break;
 			
 		default :
-			printf("Error: [read_BMP()] --> Bitmap header is not supported. Suported bitmap headers:\n");
+			printf("Error: [open_BMP()] --> Bitmap header is not supported. Suported bitmap headers:\n");
 			printf("       - BITMAPIFOHEADER     (V1)\n");
 			printf("       - BITMAPV2INFOHEADER  (V2)\n");
 			printf("       - BITMAPV3INFOHEADER  (V3)\n");
 			printf("       - BITMAPV4HEADER      (V4)\n");
 			printf("       - BITMAPV5HEADER      (V5)\n");
+			fclose(ImageFile);
 			return NULL;
 	}
-		
+
+	return ImageFile;
+}
+/******************************************************************************/
+/* Read BMP image to a pixel matrix
+   Return NULL if fail */
+img_t *read_BMP(const char *Filename)
+{
+	uint8_t 		Trash[3];
+
+	img_t			*Img;
+	FILE 			*ImageFile;
+	int32_t			Width, Height;
+
+	ImageFile = open_BMP(Filename, &Width, &Height);
+	if(ImageFile == NULL)
+		return NULL;
+	
+	/* Allocate space for image struct */
+	Img = malloc(sizeof(img_t));
+	Img->Width = Width;
+	Img->Height = Height;
+
+	/*============================== Temporary adjustment =======================*/
+	/*                CRAP IMPLEMENTATION !! FIX AS SOON AS POSSIBLE !!!         */
+	/* Improvising as 8-bit image acquisition has not yet been implemented */
+	Img->Pixel8 = NULL;
+	/*============================================================================*/
+	
 	/* Allocate space for pixel matrix */
 	Img->Pixel24 = malloc(Img->Height * sizeof(pixel24_t*));
 	
@@ -319,7 +343,7 @@ img_t *read_BMP(const char *Filename)
 			{
 				if(((Img->Width * 3) % 4) == 1)
 				{
-					if(fread(&Trash, sizeof(uint8_t), 3, ImageFile) != 3)
+					if(fread(Trash, sizeof(uint8_t), 3, ImageFile) != 3)
 					{
 						printf("Error: [read_BMP()] --> Could not read 3 padding bytes.\n\n");
 						return NULL;
@@ -327,7 +351,7 @@ img_t *read_BMP(const char *Filename)
 					
 				}else if(((Img->Width * 3) % 4) == 2)
 				{
-					if(fread(&Trash, sizeof(uint8_t), 2, ImageFile) != 2)
+					if(fread(Trash, sizeof(uint8_t), 2, ImageFile) != 2)
 					{
 						printf("Error: [read_BMP()] --> Could not read 2 padding bytes.\n\n");
 						return NULL;
@@ -335,7 +359,7 @@ img_t *read_BMP(const char *Filename)
 					
 				}else if(((Img->Width * 3) % 4) == 3)
 				{
-					if(fread(&Trash, sizeof(uint8_t), 1, ImageFile) != 1)
+					if(fread(Trash, sizeof(uint8_t), 1, ImageFile) != 1)
 					{
 						printf("Error: [read_BMP()] --> Could not read 1 padding byte.\n\n");
 						return NULL;
@@ -528,6 +552,82 @@ void free_img(img_t *Img)
 	free(Img);
 }
 /******************************************************************************/
+/* Create a view of a rectangular region of given image without copying pixels.
+   The view shares pixel memory with the original image and must be released with
+   "free_ROI_view" (never with "free_img") before the original image is freed.
+   Gray views only share "Pixel8" (rows "save_BMP" attaches to them are their own).
+   Return NULL if fail */
+img_t *new_ROI_view(img_t *Img, int32_t Row, int32_t Column, int32_t Height, int32_t Width)
+{
+	img_t	*View;
+
+	if((Img == NULL) || ((Img->Pixel24 == NULL) && (Img->Pixel8 == NULL)))
+		return NULL;
+
+	if((Row < 0) || (Column < 0) || (Height < 1) || (Width < 1) ||
+	   (Row + Height > Img->Height) || (Column + Width > Img->Width))
+	{
+		printf("Error: [new_ROI_view()] --> Region is out of image bounds.\n\n");
+		return NULL;
+	}
+
+	View = (img_t *)malloc(sizeof(img_t));
+	if(View == NULL)
+		return NULL;
+
+	View->Width = Width;
+	View->Height = Height;
+	View->Pixel24 = NULL;
+	View->Pixel8 = NULL;
+
+	if((Img->Pixel24 != NULL) && (Img->Pixel8 == NULL))
+	{
+		View->Pixel24 = (pixel24_t **)malloc(Height * sizeof(pixel24_t *));
+		if(View->Pixel24 == NULL)
+		{
+			free(View);
+			return NULL;
+		}
+
+		for(int32_t i = 0; i < Height; i++)
+			View->Pixel24[i] = Img->Pixel24[Row + i] + Column;
+	}
+
+	if(Img->Pixel8 != NULL)
+	{
+		View->Pixel8 = (uint8_t **)malloc(Height * sizeof(uint8_t *));
+		if(View->Pixel8 == NULL)
+		{
+			free(View->Pixel24);
+			free(View);
+			return NULL;
+		}
+
+		for(int32_t i = 0; i < Height; i++)
+			View->Pixel8[i] = Img->Pixel8[Row + i] + Column;
+	}
+
+	return View;
+}
+/******************************************************************************/
+/* Frees a view created by "new_ROI_view" (shared pixels are not released) */
+void free_ROI_view(img_t *View)
+{
+	if(View == NULL)
+		return;
+
+	/* RGB rows of gray views were attached by "save_BMP" */
+	if((View->Pixel8 != NULL) && (View->Pixel24 != NULL))
+	{
+		for(int32_t Row = 0; Row < View->Height; Row++)
+			free(View->Pixel24[Row]);
+	}
+
+	free(View->Pixel24);
+	free(View->Pixel8);
+	free(View);
+}
+/******************************************************************************/
 /* Display image information present on header*/
 void display_header(const char *Filename)
 {		
@@ -9,6 +9,7 @@
 #ifndef __BITMAP_H__
 #define __BITMAP_H__
 
+#include <stdio.h>
 #include <stdint.h>
 
 //Sizes of bitmap headers in bytes
@@ -236,6 +237,12 @@ typedef struct img					img_t;
 int save_BMP(img_t *Img, const char *Filename);
 
 
+/* Open BMP image and read its headers. File is left at the start of	[OK]
+   the pixel matrix (rows of 24 bits pixels padded to 4 bytes).
+   Return NULL if fail */
+FILE *open_BMP(const char *Filename, int32_t *Width, int32_t *Height);
+
+
 /* Read BMP image to a pixel matrix. 									[OK]
    Return NULL if fail */
 img_t *read_BMP(const char *Filename);
@@ -265,6 +272,18 @@ img_t *copy_BMP(img_t *OriginalImage);
 void free_img(img_t *Img);
 
 
+/* Create a view of a rectangular region of given image without copying	[OK]
+   pixels. The view shares pixel memory with the original image (only
+   "Pixel8" on gray images). Release it with "free_ROI_view" (not
+   "free_img"). Return NULL if fail */
+img_t *new_ROI_view(img_t *Img, int32_t Row, int32_t Column, int32_t Height, int32_t Width);
+
+
+/* Frees a view created by "new_ROI_view". Shared pixels are not released	[OK]
+   (RGB rows "save_BMP" attaches to gray views are). Does not return anything */
+void free_ROI_view(img_t *View);
+
+
 /* Display header information. 											[OK]
    Does not return anything */
 void display_header(const char *Filename);
@@ -7,6 +7,10 @@
  
 #include "cv.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>	/* SSE2 is part of every x86-64 target */
+#endif
+
 /*=============================================================================*/
 /*##########                    HELPER FUNCTIONS                     ##########*/
 /*=============================================================================*/
@@ -91,292 +95,174 @@ static void *cross_correlation(void *ThreadArg)
 			Acc = 0.0;
 		}
 	}
-}
 
-/*=============================================================================*/
-/*##########                     MAIN FUNCTIONS                      ##########*/
-/*=============================================================================*/
+	return NULL;
+}
 /*******************************************************************************/
-/* Convert RGB to grayscale. Return NULL on failure.
-	(method: channels average) ==> GRAY_AVERAGE
-	Pixel = (Red + Green + Blue)/3
-	(method: channel-dependent luminance perception) ==> GRAY_LUMI_PERCEP
-	Pixel = (0.2126Red + 0.7152Green + 0.0722Blue)/1
-	(method: linear aproximation of gamma and luminance perception) ==> GRAY_APROX_GAM_LUMI_PERCEP
-	Pixel = (0.299Red + 0.587Green + 0.114Blue)/1 */
-img_t *RGB_to_grayscale(img_t *InputImage, int Method)
+/* Receive "correlation_work_t" type and makes cross correlation on given row interval
+   visiting only the non-zero taps of "Args->SparseKernel". Each tap is applied to a whole
+   row at once so the inner loop runs over contiguous memory */
+static void *sparse_cross_correlation(void *ThreadArg)
 {
-	if(InputImage == NULL)
-		return NULL;
+	correlation_work_t *Args = (correlation_work_t *)ThreadArg;
 
-	int32_t RedWeight, GreenWeight, BlueWeight;
-	img_t	*OutImg;
-	
-	switch(Method)
+	int32_t StartRow	= Args->StartRow;
+	int32_t EndRow		= Args->EndRow;
+	int32_t ImgHeight	= Args->InputImage->Height;
+	int32_t ImgWidth	= Args->InputImage->Width;
+
+	sparse_kernel_t	*Kernel = Args->SparseKernel;
+
+	float	*AccRow;
+	float	BorderValue;
+	float	KerWeight;
+	int32_t	SrcRow, ColOffset;
+	int32_t	FirstCol, LastCol;	/* Columns that do not touch the border: [FirstCol:LastCol[ */
+	uint8_t	*SrcPixel;
+
+	switch(Args->BorderHandling)
 	{
-		case GRAY_AVERAGE :
-			RedWeight = 3333;
-			GreenWeight = 3334;
-			BlueWeight = 3333;
-			break;
-			
-		case GRAY_LUMI_PERCEP :
-			RedWeight = 2126;
-			GreenWeight = 7152;
-			BlueWeight = 722;
+		case BORDER_BLACK:
+			BorderValue = 0.0;
 			break;
-			
-		case GRAY_APROX_GAM_LUMI_PERCEP :
-			RedWeight = 2990;
-			GreenWeight = 5870;
-			BlueWeight = 1140;
+
+		case BORDER_WHITE:
+			BorderValue = 255.0;
 			break;
-			
-		default :
-			printf("Error: invalid \"Method\" input on RGB_to_grayscale function. Should be:\n");
-			printf("       GRAY_AVERAGE, GRAY_LUMI_PERCEP or GRAY_APROX_GAM_LUMI_PERCEP\n\n");
-			return NULL;
+
+		default:
+			printf("Error: selected border handling not suported.\n");
+			exit(EXIT_FAILURE);
 	}
 
-	OutImg = new_BMP_as_size(InputImage, GRAY_8BITS);
-	
-	for(int32_t Row = 0; Row < InputImage->Height; Row++)
+	AccRow = (float *)malloc(sizeof(float) * ImgWidth);
+	if(AccRow == NULL)
 	{
-		for(int32_t Column = 0; Column < InputImage->Width; Column++)
-		{
-			OutImg->Pixel8[Row][Column] = ((InputImage->Pixel24[Row][Column].Red * RedWeight) 
-			                             + (InputImage->Pixel24[Row][Column].Green * GreenWeight)
-			                             + (InputImage->Pixel24[Row][Column].Blue * BlueWeight))/10000;
-		}
+		printf("Error: [sparse_cross_correlation()] --> Could not allocate row buffer.\n");
+		exit(EXIT_FAILURE);
 	}
 
-	return OutImg;
-}
-
-/*******************************************************************************/
-/* Channel pass filter. Return -1 if fail or 0 on success.
-	ChannelSelect --> PASS_RED_CHANNEL
-	                  PASS_GREEN_CHANNEL
-	                  PASS_BLUE_CHANNEL */
-img_t *channel_pass_filter(img_t *InputImage, int ChannelSelect)
-{
-	if(InputImage == NULL)
-		return NULL;
-
-	img_t	*OutImg;
+	for(int32_t ImgRow = StartRow; ImgRow < EndRow; ImgRow++)
+	{
+		for(int32_t ImgColumn = 0; ImgColumn < ImgWidth; ImgColumn++)
+			AccRow[ImgColumn] = 0.0;
 
-	OutImg = new_BMP_as_size(InputImage, RGB_24BITS);
+		/* Taps are stored in row-major order, so every pixel accumulates in the same
+		   order as the dense path and results are identical */
+		for(int32_t i = 0; i < Kernel->NumTaps; i++)
+		{
+			SrcRow = ImgRow + Kernel->Tap[i].RowOffset;
+			ColOffset = Kernel->Tap[i].ColumnOffset;
+			KerWeight = Kernel->Tap[i].Weight;
 
-	switch(ChannelSelect)
-	{
-		case PASS_RED_CHANNEL :
-			for(int32_t Row = 0; Row < InputImage->Height; Row++)
+			if((SrcRow < 0) || (SrcRow >= ImgHeight))
 			{
-				for(int32_t Column = 0; Column < InputImage->Width; Column++)
-				{
-					OutImg->Pixel24[Row][Column].Red = InputImage->Pixel24[Row][Column].Red;
-					OutImg->Pixel24[Row][Column].Green = 0;
-					OutImg->Pixel24[Row][Column].Blue = 0;
-				}
+				FirstCol = ImgWidth;
+				LastCol = ImgWidth;
 			}
-			break;
-			
-		case PASS_GREEN_CHANNEL :
-			for(int32_t Row = 0; Row < InputImage->Height; Row++)
+			else
 			{
-				for(int32_t Column = 0; Column < InputImage->Width; Column++)
-				{
-					OutImg->Pixel24[Row][Column].Red = 0;
-					OutImg->Pixel24[Row][Column].Green = InputImage->Pixel24[Row][Column].Green;
-					OutImg->Pixel24[Row][Column].Blue = 0;
-				}
+				FirstCol = (ColOffset < 0) ? -ColOffset : 0;
+				LastCol = (ColOffset > 0) ? ImgWidth - ColOffset : ImgWidth;
+
+				if(FirstCol > ImgWidth)
+					FirstCol = ImgWidth;
+				if(LastCol < FirstCol)
+					LastCol = FirstCol;
 			}
-			break;
-			
-		case PASS_BLUE_CHANNEL :
-			for(int32_t Row = 0; Row < InputImage->Height; Row++)
+
+			/* Out of bound part of the row (left side, then right side) */
+			if(BorderValue != 0.0)
 			{
-				for(int Column = 0; Column < InputImage->Width; Column++)
-				{
-					OutImg->Pixel24[Row][Column].Red = 0;
-					OutImg->Pixel24[Row][Column].Green = 0;
-					OutImg->Pixel24[Row][Column].Blue = InputImage->Pixel24[Row][Column].Blue;
-				}
-			}
-			break;
-			
-		default :
-			printf("Error: invalid \"ChannelSelect\" input on channel_pass_filter function. Should be:\n");
-			printf("       PASS_RED_CHANNEL, PASS_GREEN_CHANNEL or PASS_BLUE_CHANNEL\n\n");
-			free_img(OutImg);
-			return NULL;
-	}
+				for(int32_t ImgColumn = 0; ImgColumn < FirstCol; ImgColumn++)
+					AccRow[ImgColumn] += KerWeight * BorderValue;
 
-	return OutImg;
-}
-/*******************************************************************************/
-/* Frees memory allocated by the kernel template */
-void free_kernel(kernel_t *Kernel)
-{
-	for (int32_t Row = 0; Row < Kernel->Height; Row++)
-	{
-		free(Kernel->Weight[Row]);
-	}
-	free(Kernel->Weight);
-	free(Kernel);
-}
-/*******************************************************************************/
-/* Create a low pass filter kernel with given odd dimension. Return NULL if fail
-   Type --> NEIGHBOR_AVERAGE */
-kernel_t *create_kernel_low_pass_filter(int32_t Height, int32_t Width, int Type)
-{
-	kernel_t	*Kernel;
+				for(int32_t ImgColumn = LastCol; ImgColumn < ImgWidth; ImgColumn++)
+					AccRow[ImgColumn] += KerWeight * BorderValue;
+			}
 
-	/* Check if dimensions are odd */
-	if(((Height % 2) == 0) || ((Width % 2) == 0))
-	{
-		printf("Error: kernel dimensions need to be odd.\n");
-		return NULL;
-	}
+			if(FirstCol == LastCol)
+				continue;
 
-	/* Allocating kernel */
-	Kernel = (kernel_t *)malloc(sizeof(kernel_t));
-	Kernel->Weight = (float **)malloc(sizeof(float *) * Height);
-	for(int32_t Row = 0; Row < Height; Row++)
-	{
-		Kernel->Weight[Row] = (float *)malloc(sizeof(float) * Width);
-	}
+			SrcPixel = Args->InputImage->Pixel8[SrcRow] + ColOffset;
 
-	/* Assingning values */
-	Kernel->Height = Height;
-	Kernel->Width = Width;
+			for(int32_t ImgColumn = FirstCol; ImgColumn < LastCol; ImgColumn++)
+				AccRow[ImgColumn] += KerWeight * SrcPixel[ImgColumn];
+		}
 
-	switch(Type)
-	{
-		case NEIGHBOR_AVERAGE:
-			for(int32_t Row = 0; Row < Height; Row++)
-			{
-				for(int32_t Column = 0; Column < Width; Column++)
-				{
-					Kernel->Weight[Row][Column] = 1.0/(Height * Width);
-				}
-			}
-			break;
+		for(int32_t ImgColumn = 0; ImgColumn < ImgWidth; ImgColumn++)
+		{
+			if(AccRow[ImgColumn] > 255)
+				AccRow[ImgColumn] = 255.0;
+			else if(AccRow[ImgColumn] < 0)
+				AccRow[ImgColumn] = 0;
 
-		default:
-			free_kernel(Kernel);
-			printf("Error: Type not supported on low pass kernel creation.\n");
-			return NULL;
+			Args->OutputImage->Pixel8[ImgRow][ImgColumn] = (uint8_t)AccRow[ImgColumn];
+		}
 	}
 
-	return Kernel;
+	free(AccRow);
+
+	return NULL;
 }
 /*******************************************************************************/
-/* Create a high pass filter kernel with given odd dimension. Return NULL if fail
-   Type --> LAPLACIAN_OPERATOR */
-kernel_t *create_kernel_high_pass_filter(int32_t Height, int32_t Width, int Type)
+/* Get pixel intensity used outside the image for given border handling.
+   Return -1 if border handling is not supported or 0 on success */
+static int get_border_value(int Border, float *Value)
 {
-	kernel_t	*Kernel;
-
-	/* Check if dimensions are odd */
-	if(((Height % 2) == 0) || ((Width % 2) == 0))
-	{
-		printf("Error: kernel dimensions need to be odd.\n");
-		return NULL;
-	}	
-
-	/* Allocating kernel */
-	Kernel = (kernel_t *)malloc(sizeof(kernel_t));
-	Kernel->Weight = (float **)malloc(sizeof(float *) * Height);
-	for(int32_t Row = 0; Row < Height; Row++)
-	{
-		Kernel->Weight[Row] = (float *)malloc(sizeof(float) * Width);
-	}
-
-	/* Assingning values */
-	Kernel->Height = Height;
-	Kernel->Width = Width;
-
-	switch(Type)
+	switch(Border)
 	{
-		case LAPLACIAN_OPERATOR_NORM:
-			for(int32_t Row = 0; Row < Height; Row++)
-			{
-				for(int32_t Column = 0; Column < Width; Column++)
-				{
-					if((Row == Height/2) && (Column == Width/2))
-					{
-						Kernel->Weight[Row][Column] = ((Height * Width) - 1)/(Height * Width);
-					}
-					else
-					{
-						Kernel->Weight[Row][Column] = -1.0/(Height * Width);
-					}
-				}
-			}
-			break;
+		case BORDER_BLACK:
+			*Value = 0.0;
+			return 0;
 
-		case LAPLACIAN_OPERATOR:
-			for(int32_t Row = 0; Row < Height; Row++)
-			{
-				for(int32_t Column = 0; Column < Width; Column++)
-				{
-					if((Row == Height/2) && (Column == Width/2))
-					{
-						Kernel->Weight[Row][Column] = ((Height * Width) - 1);
-					}
-					else
-					{
-						Kernel->Weight[Row][Column] = -1.0;
-					}
-				}
-			}
-			break;
+		case BORDER_WHITE:
+			*Value = 255.0;
+			return 0;
 
 		default:
-			free_kernel(Kernel);
-			printf("Error: Type not supported on high pass kernel creation.\n");
-			return NULL;
+			return -1;
 	}
-
-	return Kernel;
 }
 /*******************************************************************************/
-/* Makes cross correlation betwen the kernel and image using multiple threads.
-   Return NULL if fail
-	Img     --> Pointer to source image. This image will also be the output.
-	Kernel  --> Pointer to the the kernel to be used.
-	Threads --> Number of threads to be used in parallel on computacion
-	Border  --> BORDER_BLACK
-	            BORDER_WHITE */
-img_t *parallel_cross_correlation(img_t *Img, kernel_t *Kernel, int32_t ThreadsNum, int Border)
+/* Split the image rows between threads and run the correlation worker on each one.
+   When "SparseKernel" is not NULL the sparse path is used. Return NULL if fail */
+static img_t *run_cross_correlation(img_t *Img, kernel_t *Kernel, sparse_kernel_t *SparseKernel,
+                                    int32_t ThreadsNum, int Border)
 {
-	if((Img == NULL) || (Kernel == NULL) || (ThreadsNum < 1) || (Img->Pixel8 == NULL))
-		return NULL;
-
 	correlation_work_t	ThreadArg[ThreadsNum];
 	img_t				*OutputImg;
 	pthread_t			ThreadId[ThreadsNum];
+	float				BorderValue;
+
+	if(get_border_value(Border, &BorderValue) == -1)
+	{
+		printf("Error: [run_cross_correlation()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
 
 	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	if(OutputImg == NULL)
+		return NULL;
 
 	/* Creating threads arguments and starting threads */
 	for(int32_t i = 0; i < ThreadsNum; i++)
 	{
+		/* Both limits use the same formula so no row is left between intervals */
 		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
-		
-		if(i == ThreadsNum - 1)
-			ThreadArg[i].EndRow = Img->Height;
-		else
-			ThreadArg[i].EndRow = ThreadArg[i].StartRow + Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
 
 		
 		ThreadArg[i].BorderHandling = Border;
 		ThreadArg[i].Kernel = Kernel;
+		ThreadArg[i].SparseKernel = SparseKernel;
 		ThreadArg[i].InputImage = Img;
 		ThreadArg[i].OutputImage = OutputImg;
 
-		pthread_create(&ThreadId[i], NULL, cross_correlation, (void *)&ThreadArg[i]);
+		if(SparseKernel != NULL)
+			pthread_create(&ThreadId[i], NULL, sparse_cross_correlation, (void *)&ThreadArg[i]);
+		else
+			pthread_create(&ThreadId[i], NULL, cross_correlation, (void *)&ThreadArg[i]);
 	}
 
 	for(int32_t i = 0; i < ThreadsNum; i++)
@@ -387,137 +273,10126 @@ img_t *parallel_cross_correlation(img_t *Img, kernel_t *Kernel, int32_t ThreadsN
 	return OutputImg;
 }
 /*******************************************************************************/
-/* Makes convolution betwen the kernel and image using multiple threads.
-   Return NULL if fail
-	Img     --> Pointer to source image. This image will also be the output.
-	Kernel  --> Pointer to the the kernel to be used.
-	Threads --> Number of threads to be used in parallel on computacion
-	Border  --> BORDER_BLACK
-	            BORDER_WHITE */
+/* Run cross correlation choosing between dense and sparse path based on the
+   density of non-zero taps of the kernel. Return NULL if fail */
+static img_t *auto_cross_correlation(img_t *Img, kernel_t *Kernel, int32_t ThreadsNum, int Border)
+{
+	sparse_kernel_t	*SparseKernel;
+	img_t			*OutputImg;
+	int32_t			NonZero = 0;
+
+	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Kernel->Width; Column++)
+		{
+			if(Kernel->Weight[Row][Column] != 0.0)
+				NonZero++;
+		}
+	}
+
+	if(NonZero >= SPARSE_KERNEL_DENSITY * Kernel->Height * Kernel->Width)
+		return run_cross_correlation(Img, Kernel, NULL, ThreadsNum, Border);
+
+	SparseKernel = create_sparse_kernel(Kernel);
+	if(SparseKernel == NULL)
+		return run_cross_correlation(Img, Kernel, NULL, ThreadsNum, Border);
+
+	OutputImg = run_cross_correlation(Img, Kernel, SparseKernel, ThreadsNum, Border);
+
+	free_sparse_kernel(SparseKernel);
+
+	return OutputImg;
+}
+
+/*******************************************************************************/
+/* Fill "Coef" with 2*Radius+1 normalized gaussian weights centered on "Coef[Radius]" */
+static void gaussian_coefficients(float *Coef, int32_t Radius, float Sigma)
+{
+	float	Sum = 0.0;
+
+	for(int32_t i = -Radius; i <= Radius; i++)
+	{
+		Coef[i + Radius] = expf(-(float)(i * i) / (2.0 * Sigma * Sigma));
+		Sum += Coef[i + Radius];
+	}
+
+	for(int32_t i = 0; i <= 2 * Radius; i++)
+		Coef[i] /= Sum;
+}
+/*******************************************************************************/
+/* Fill "Coef" with the Young - van Vliet recursive gaussian coefficients:
+	Coef[0] = B, Coef[1] = b1/b0, Coef[2] = b2/b0, Coef[3] = b3/b0 */
+static void young_van_vliet_coefficients(float *Coef, float Sigma)
+{
+	double	q, q2, q3;
+	double	b0, b1, b2, b3;
+
+	if(Sigma >= 2.5)
+		q = 0.98711 * Sigma - 0.96330;
+	else
+		q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * Sigma);
+
+	q2 = q * q;
+	q3 = q2 * q;
+
+	b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+	b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+	b2 = -(1.4281 * q2 + 1.26661 * q3);
+	b3 = 0.422205 * q3;
+
+	Coef[0] = 1.0 - (b1 + b2 + b3) / b0;
+	Coef[1] = b1 / b0;
+	Coef[2] = b2 / b0;
+	Coef[3] = b3 / b0;
+}
+/*******************************************************************************/
+/* Horizontal FIR gaussian pass over rows [Start:End[. Writes to "Args->Buffer" */
+static void *gaussian_fir_rows(void *ThreadArg)
+{
+	gaussian_work_t *Args = (gaussian_work_t *)ThreadArg;
+
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	Radius		= Args->Radius;
+	int32_t	FirstCol, LastCol;
+	float	*AccRow;
+	float	Weight;
+	uint8_t	*SrcPixel;
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		AccRow = Args->Buffer + (size_t)Row * ImgWidth;
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			AccRow[Column] = 0.0;
+
+		/* Apply one tap to the whole row at a time (contiguous inner loop) */
+		for(int32_t k = -Radius; k <= Radius; k++)
+		{
+			Weight = Args->Coef[k + Radius];
+
+			FirstCol = (k < 0) ? -k : 0;
+			LastCol = (k > 0) ? ImgWidth - k : ImgWidth;
+			if(FirstCol > ImgWidth)
+				FirstCol = ImgWidth;
+			if(LastCol < FirstCol)
+				LastCol = FirstCol;
+
+			for(int32_t Column = 0; Column < FirstCol; Column++)
+				AccRow[Column] += Weight * Args->BorderValue;
+
+			for(int32_t Column = LastCol; Column < ImgWidth; Column++)
+				AccRow[Column] += Weight * Args->BorderValue;
+
+			SrcPixel = Args->InputImage->Pixel8[Row] + k;
+
+			for(int32_t Column = FirstCol; Column < LastCol; Column++)
+				AccRow[Column] += Weight * SrcPixel[Column];
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Vertical FIR gaussian pass over rows [Start:End[. Reads "Args->Buffer" and
+   writes the output image */
+static void *gaussian_fir_columns(void *ThreadArg)
+{
+	gaussian_work_t *Args = (gaussian_work_t *)ThreadArg;
+
+	int32_t	ImgHeight	= Args->InputImage->Height;
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	Radius		= Args->Radius;
+	int32_t	SrcRow;
+	float	*AccRow;
+	float	*SrcLine;
+	float	Weight;
+
+	AccRow = (float *)malloc(sizeof(float) * ImgWidth);
+	if(AccRow == NULL)
+	{
+		printf("Error: [gaussian_fir_columns()] --> Could not allocate row buffer.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			AccRow[Column] = 0.0;
+
+		for(int32_t k = -Radius; k <= Radius; k++)
+		{
+			Weight = Args->Coef[k + Radius];
+			SrcRow = Row + k;
+
+			/* A row outside the image filtered horizontally is still the border value */
+			if((SrcRow < 0) || (SrcRow >= ImgHeight))
+			{
+				for(int32_t Column = 0; Column < ImgWidth; Column++)
+					AccRow[Column] += Weight * Args->BorderValue;
+			}
+			else
+			{
+				SrcLine = Args->Buffer + (size_t)SrcRow * ImgWidth;
+
+				for(int32_t Column = 0; Column < ImgWidth; Column++)
+					AccRow[Column] += Weight * SrcLine[Column];
+			}
+		}
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+		{
+			if(AccRow[Column] > 255)
+				AccRow[Column] = 255.0;
+			else if(AccRow[Column] < 0)
+				AccRow[Column] = 0;
+
+			Args->OutputImage->Pixel8[Row][Column] = (uint8_t)(AccRow[Column] + 0.5);
+		}
+	}
+
+	free(AccRow);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Horizontal recursive gaussian pass over rows [Start:End[. Writes to "Args->Buffer".
+   Line layout: [3 steady samples][image row][Radius border samples][3 steady samples].
+   The recursion state before the row is the steady state of a constant border, so only
+   the right side needs padding for the backward pass to start close to its true state */
+static void *gaussian_iir_rows(void *ThreadArg)
+{
+	gaussian_work_t *Args = (gaussian_work_t *)ThreadArg;
+
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	LineLength	= ImgWidth + Args->Radius + 6;
+	float	B	= Args->Coef[0];
+	float	a1	= Args->Coef[1];
+	float	a2	= Args->Coef[2];
+	float	a3	= Args->Coef[3];
+	float	*Line;
+
+	Line = (float *)malloc(sizeof(float) * LineLength);
+	if(Line == NULL)
+	{
+		printf("Error: [gaussian_iir_rows()] --> Could not allocate line buffer.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		for(int32_t i = 0; i < LineLength; i++)
+			Line[i] = Args->BorderValue;
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			Line[Column + 3] = Args->InputImage->Pixel8[Row][Column];
+
+		/* Forward (causal) pass */
+		for(int32_t i = 3; i < LineLength - 3; i++)
+			Line[i] = B * Line[i] + a1 * Line[i - 1] + a2 * Line[i - 2] + a3 * Line[i - 3];
+
+		/* Backward (anti-causal) pass */
+		for(int32_t i = LineLength - 4; i >= 3; i--)
+			Line[i] = B * Line[i] + a1 * Line[i + 1] + a2 * Line[i + 2] + a3 * Line[i + 3];
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			Args->Buffer[(size_t)Row * ImgWidth + Column] = Line[Column + 3];
+	}
+
+	free(Line);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Vertical recursive gaussian pass over columns [Start:End[. Reads "Args->Buffer" and
+   writes the output image. Columns are processed in blocks of GAUSSIAN_COLUMN_BLOCK so
+   the recursion runs along rows of a small buffer with a contiguous inner loop */
+#define GAUSSIAN_COLUMN_BLOCK	64
+static void *gaussian_iir_columns(void *ThreadArg)
+{
+	gaussian_work_t *Args = (gaussian_work_t *)ThreadArg;
+
+	int32_t	ImgHeight	= Args->InputImage->Height;
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	LineLength	= ImgHeight + Args->Radius + 6;
+	int32_t	BlockWidth;
+	float	B	= Args->Coef[0];
+	float	a1	= Args->Coef[1];
+	float	a2	= Args->Coef[2];
+	float	a3	= Args->Coef[3];
+	float	*Block;
+	float	*Cur, *Prev1, *Prev2, *Prev3;
+	float	Value;
+
+	Block = (float *)malloc(sizeof(float) * LineLength * GAUSSIAN_COLUMN_BLOCK);
+	if(Block == NULL)
+	{
+		printf("Error: [gaussian_iir_columns()] --> Could not allocate block buffer.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int32_t StartCol = Args->Start; StartCol < Args->End; StartCol += GAUSSIAN_COLUMN_BLOCK)
+	{
+		BlockWidth = Args->End - StartCol;
+		if(BlockWidth > GAUSSIAN_COLUMN_BLOCK)
+			BlockWidth = GAUSSIAN_COLUMN_BLOCK;
+
+		for(int32_t i = 0; i < LineLength * GAUSSIAN_COLUMN_BLOCK; i++)
+			Block[i] = Args->BorderValue;
+
+		for(int32_t Row = 0; Row < ImgHeight; Row++)
+		{
+			for(int32_t c = 0; c < BlockWidth; c++)
+				Block[(Row + 3) * GAUSSIAN_COLUMN_BLOCK + c] = Args->Buffer[(size_t)Row * ImgWidth + StartCol + c];
+		}
+
+		/* Forward (causal) pass */
+		for(int32_t i = 3; i < LineLength - 3; i++)
+		{
+			Cur = Block + i * GAUSSIAN_COLUMN_BLOCK;
+			Prev1 = Cur - GAUSSIAN_COLUMN_BLOCK;
+			Prev2 = Prev1 - GAUSSIAN_COLUMN_BLOCK;
+			Prev3 = Prev2 - GAUSSIAN_COLUMN_BLOCK;
+
+			for(int32_t c = 0; c < GAUSSIAN_COLUMN_BLOCK; c++)
+				Cur[c] = B * Cur[c] + a1 * Prev1[c] + a2 * Prev2[c] + a3 * Prev3[c];
+		}
+
+		/* Backward (anti-causal) pass */
+		for(int32_t i = LineLength - 4; i >= 3; i--)
+		{
+			Cur = Block + i * GAUSSIAN_COLUMN_BLOCK;
+			Prev1 = Cur + GAUSSIAN_COLUMN_BLOCK;
+			Prev2 = Prev1 + GAUSSIAN_COLUMN_BLOCK;
+			Prev3 = Prev2 + GAUSSIAN_COLUMN_BLOCK;
+
+			for(int32_t c = 0; c < GAUSSIAN_COLUMN_BLOCK; c++)
+				Cur[c] = B * Cur[c] + a1 * Prev1[c] + a2 * Prev2[c] + a3 * Prev3[c];
+		}
+
+		for(int32_t Row = 0; Row < ImgHeight; Row++)
+		{
+			for(int32_t c = 0; c < BlockWidth; c++)
+			{
+				Value = Block[(Row + 3) * GAUSSIAN_COLUMN_BLOCK + c];
+
+				if(Value > 255)
+					Value = 255.0;
+				else if(Value < 0)
+					Value = 0;
+
+				Args->OutputImage->Pixel8[Row][StartCol + c] = (uint8_t)(Value + 0.5);
+			}
+		}
+	}
+
+	free(Block);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Split interval [0:Total[ between threads and run one gaussian pass */
+static void run_gaussian_pass(void *(*Worker)(void *), gaussian_work_t *ThreadArg,
+                              int32_t ThreadsNum, int32_t Total)
+{
+	pthread_t	ThreadId[ThreadsNum];
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Total/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Total/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, Worker, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+}
+
+/*******************************************************************************/
+/* Copy image row to "Line" leaving one border pixel on each side (Line[-1] and
+   Line[Width] must be valid). If "Row" is out of bound the whole line is border */
+static void fill_padded_line(uint8_t *Line, img_t *Img, int32_t Row, uint8_t BorderValue)
+{
+	if((Row < 0) || (Row >= Img->Height))
+	{
+		for(int32_t Column = -1; Column <= Img->Width; Column++)
+			Line[Column] = BorderValue;
+		return;
+	}
+
+	Line[-1] = BorderValue;
+	Line[Img->Width] = BorderValue;
+
+	for(int32_t Column = 0; Column < Img->Width; Column++)
+		Line[Column] = Img->Pixel8[Row][Column];
+}
+/*******************************************************************************/
+/* Compute horizontal and vertical 3x3 derivatives of one row from the padded lines
+   above, at and below it. Derivatives are positive towards increasing column (Gx)
+   and increasing row (Gy) */
+static void gradient_row(const uint8_t *Up, const uint8_t *Mid, const uint8_t *Down,
+                         int32_t Width, int Operator, int16_t *Gx, int16_t *Gy)
+{
+	int16_t	Side, Center;
+
+	if(Operator == GRADIENT_SCHARR)
+	{
+		Side = 3;
+		Center = 10;
+	}
+	else
+	{
+		Side = 1;
+		Center = 2;
+	}
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		Gx[Column] = Side * (Up[Column + 1] - Up[Column - 1])
+		           + Center * (Mid[Column + 1] - Mid[Column - 1])
+		           + Side * (Down[Column + 1] - Down[Column - 1]);
+
+		Gy[Column] = Side * (Down[Column - 1] - Up[Column - 1])
+		           + Center * (Down[Column] - Up[Column])
+		           + Side * (Down[Column + 1] - Up[Column + 1]);
+	}
+}
+/*******************************************************************************/
+/* Quantize gradient direction (modulo 180 degrees) to "Bins" bins centered on k*180/Bins.
+   Four bins are resolved with tangent comparisons, any other number uses atan2 */
+static uint8_t quantize_orientation(int32_t Gx, int32_t Gy, int32_t Bins)
+{
+	float	Angle;
+	int32_t	Bin;
+
+	if(Bins == 4)
+	{
+		/* tan(22.5) ~= 0.41421 ~= 106/256 and tan(67.5) ~= 2.41421 ~= 618/256 */
+		int32_t AbsX = abs(Gx);
+		int32_t AbsY = abs(Gy);
+
+		if(AbsY * 256 <= AbsX * 106)
+			return 0;
+		if(AbsY * 256 >= AbsX * 618)
+			return 2;
+
+		return ((Gx > 0) == (Gy > 0)) ? 1 : 3;
+	}
+
+	Angle = atan2f((float)Gy, (float)Gx) * (180.0 / M_PI);
+	if(Angle < 0)
+		Angle += 180.0;
+
+	Bin = (int32_t)(Angle * Bins / 180.0 + 0.5);
+
+	return (uint8_t)(Bin % Bins);
+}
+/*******************************************************************************/
+/* Receive "gradient_work_t" type and computes gradient on given row interval.
+   Each row is read once through three rotating padded line buffers */
+static void *gradient(void *ThreadArg)
+{
+	gradient_work_t *Args = (gradient_work_t *)ThreadArg;
+
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	uint8_t	*Storage;
+	uint8_t	*Up, *Mid, *Down, *Tmp;
+	int16_t	*Gx, *Gy;
+	int32_t	Magnitude;
+
+	Storage = (uint8_t *)malloc(3 * (ImgWidth + 2));
+	Gx = (int16_t *)malloc(sizeof(int16_t) * ImgWidth);
+	Gy = (int16_t *)malloc(sizeof(int16_t) * ImgWidth);
+	if((Storage == NULL) || (Gx == NULL) || (Gy == NULL))
+	{
+		printf("Error: [gradient()] --> Could not allocate line buffers.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Up = Storage + 1;
+	Mid = Up + ImgWidth + 2;
+	Down = Mid + ImgWidth + 2;
+
+	if(Args->StartRow < Args->EndRow)
+	{
+		fill_padded_line(Up, Args->InputImage, Args->StartRow - 1, Args->BorderValue);
+		fill_padded_line(Mid, Args->InputImage, Args->StartRow, Args->BorderValue);
+	}
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		fill_padded_line(Down, Args->InputImage, Row + 1, Args->BorderValue);
+
+		gradient_row(Up, Mid, Down, ImgWidth, Args->Operator, Gx, Gy);
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+		{
+			if(Args->Norm == GRADIENT_L2)
+				Magnitude = (int32_t)sqrtf((float)(Gx[Column] * Gx[Column] + Gy[Column] * Gy[Column]));
+			else
+				Magnitude = abs(Gx[Column]) + abs(Gy[Column]);
+
+			Args->MagnitudeImage->Pixel8[Row][Column] = (Magnitude > 255) ? 255 : (uint8_t)Magnitude;
+		}
+
+		if(Args->OrientationImage != NULL)
+		{
+			for(int32_t Column = 0; Column < ImgWidth; Column++)
+			{
+				Args->OrientationImage->Pixel8[Row][Column] =
+					quantize_orientation(Gx[Column], Gy[Column], Args->OrientationBins);
+			}
+		}
+
+		/* Rotate line buffers: only the new bottom line is read on next row */
+		Tmp = Up;
+		Up = Mid;
+		Mid = Down;
+		Down = Tmp;
+	}
+
+	free(Storage);
+	free(Gx);
+	free(Gy);
+
+	return NULL;
+}
+
+/*******************************************************************************/
+/* Return row as a byte array for both image types. On RGB_24BITS channels are
+   interleaved (Blue, Green, Red) with stride 3 */
+static uint8_t *byte_row(img_t *Img, int32_t Row)
+{
+	if(Img->Pixel8 != NULL)
+		return Img->Pixel8[Row];
+	else
+		return (uint8_t *)Img->Pixel24[Row];
+}
+/*******************************************************************************/
+/* Compare-exchange pairs of median sorting networks. Median ends on the center element */
+static const uint8_t Median9Network[19][2] =
+{
+	{1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8}, {0, 3},
+	{5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4}, {4, 2}
+};
+
+static const uint8_t Median25Network[99][2] =
+{
+	{0, 1}, {3, 4}, {2, 4}, {2, 3}, {6, 7}, {5, 7}, {5, 6}, {9, 10}, {8, 10}, {8, 9},
+	{12, 13}, {11, 13}, {11, 12}, {15, 16}, {14, 16}, {14, 15}, {18, 19}, {17, 19}, {17, 18}, {21, 22},
+	{20, 22}, {20, 21}, {23, 24}, {2, 5}, {3, 6}, {0, 6}, {0, 3}, {4, 7}, {1, 7}, {1, 4},
+	{11, 14}, {8, 14}, {8, 11}, {12, 15}, {9, 15}, {9, 12}, {13, 16}, {10, 16}, {10, 13}, {20, 23},
+	{17, 23}, {17, 20}, {21, 24}, {18, 24}, {18, 21}, {19, 22}, {8, 17}, {9, 18}, {0, 18}, {0, 9},
+	{10, 19}, {1, 19}, {1, 10}, {11, 20}, {2, 20}, {2, 11}, {12, 21}, {3, 21}, {3, 12}, {13, 22},
+	{4, 22}, {4, 13}, {14, 23}, {5, 23}, {5, 14}, {15, 24}, {6, 24}, {6, 15}, {7, 16}, {7, 19},
+	{13, 21}, {15, 23}, {7, 13}, {7, 15}, {1, 9}, {3, 11}, {5, 17}, {11, 17}, {9, 17}, {4, 10},
+	{6, 12}, {7, 14}, {4, 6}, {4, 7}, {12, 14}, {10, 14}, {6, 7}, {10, 12}, {6, 10}, {6, 17},
+	{12, 17}, {7, 17}, {7, 10}, {12, 18}, {7, 12}, {10, 18}, {12, 20}, {10, 20}, {10, 12}
+};
+/*******************************************************************************/
+/* Sort pair of lanes element by element: A receives the minimum and B the maximum */
+static void median_compare_exchange(uint8_t *restrict A, uint8_t *restrict B)
+{
+	uint8_t	Min, Max;
+
+	for(int32_t c = 0; c < MEDIAN_STRIP_WIDTH; c++)
+	{
+		Min = (A[c] < B[c]) ? A[c] : B[c];
+		Max = (A[c] < B[c]) ? B[c] : A[c];
+		A[c] = Min;
+		B[c] = Max;
+	}
+}
+/*******************************************************************************/
+/* Median of one channel on columns [StartCol:EndCol[ (at most MEDIAN_STRIP_WIDTH wide)
+   with a sorting network. Every window position is a lane array and each compare-exchange
+   runs over the whole strip, so the inner loops are plain byte min/max */
+static void median_network_strip(median_work_t *Args, int32_t Channel, int32_t Stride,
+                                 int32_t StartCol, int32_t EndCol)
+{
+	int32_t	ImgHeight	= Args->InputImage->Height;
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	Radius		= Args->Radius;
+	int32_t	Side		= 2 * Radius + 1;
+	int32_t	StripWidth	= EndCol - StartCol;
+	int32_t	NumPairs	= (Radius == 1) ? 19 : 99;
+	const uint8_t (*Network)[2] = (Radius == 1) ? Median9Network : Median25Network;
+
+	uint8_t	Lane[25][MEDIAN_STRIP_WIDTH];
+	uint8_t	*SrcPixel, *DstPixel;
+	int32_t	SrcRow, FirstCol, LastCol, k;
+
+	for(int32_t Row = 0; Row < ImgHeight; Row++)
+	{
+		/* Gather window samples */
+		k = 0;
+		for(int32_t dy = -Radius; dy <= Radius; dy++)
+		{
+			SrcRow = Row + dy;
+
+			for(int32_t dx = -Radius; dx <= Radius; dx++, k++)
+			{
+				if((SrcRow < 0) || (SrcRow >= ImgHeight))
+				{
+					for(int32_t c = 0; c < StripWidth; c++)
+						Lane[k][c] = Args->BorderValue;
+					continue;
+				}
+
+				/* Strip positions reading inside the image: [FirstCol:LastCol[ */
+				FirstCol = -(StartCol + dx);
+				if(FirstCol < 0)
+					FirstCol = 0;
+				LastCol = ImgWidth - (StartCol + dx);
+				if(LastCol > StripWidth)
+					LastCol = StripWidth;
+
+				for(int32_t c = 0; c < FirstCol; c++)
+					Lane[k][c] = Args->BorderValue;
+
+				for(int32_t c = (LastCol > FirstCol) ? LastCol : FirstCol; c < StripWidth; c++)
+					Lane[k][c] = Args->BorderValue;
+
+				SrcPixel = byte_row(Args->InputImage, SrcRow) + (StartCol + dx) * Stride + Channel;
+
+				if(Stride == 1)
+				{
+					for(int32_t c = FirstCol; c < LastCol; c++)
+						Lane[k][c] = SrcPixel[c];
+				}
+				else
+				{
+					for(int32_t c = FirstCol; c < LastCol; c++)
+						Lane[k][c] = SrcPixel[c * Stride];
+				}
+			}
+		}
+
+		/* Apply network. Loops run over the whole lane (fixed length) so they vectorize */
+		for(int32_t p = 0; p < NumPairs; p++)
+		{
+			median_compare_exchange(Lane[Network[p][0]], Lane[Network[p][1]]);
+		}
+
+		DstPixel = byte_row(Args->OutputImage, Row) + Channel;
+
+		for(int32_t c = 0; c < StripWidth; c++)
+			DstPixel[(StartCol + c) * Stride] = Lane[(Side * Side)/2][c];
+	}
+}
+/*******************************************************************************/
+/* Median of one channel on columns [StartCol:EndCol[ with the constant time algorithm
+   (Perreault - Hebert). One histogram is kept per column (coarse 16 bins + fine 256 bins)
+   and the window histogram is built by adding the entering column and removing the
+   leaving one. Fine bins of the window are only updated for the coarse bin that holds
+   the median (lazy update) */
+static void median_histogram_strip(median_work_t *Args, int32_t Channel, int32_t Stride,
+                                   int32_t StartCol, int32_t EndCol)
+{
+	int32_t	ImgHeight	= Args->InputImage->Height;
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	Radius		= Args->Radius;
+	int32_t	Side		= 2 * Radius + 1;
+	int32_t	NumCols		= EndCol - StartCol + 2 * Radius;	/* Histogram columns */
+	int32_t	Rank		= (Side * Side)/2;
+
+	uint16_t	*ColCoarse;		/* NumCols * 16 */
+	uint16_t	*ColFine;		/* NumCols * 256 */
+	uint16_t	Coarse[16];
+	uint16_t	Fine[256];
+	int32_t		LastUpdate[16];
+
+	uint8_t		*DstPixel;
+	uint16_t	*HistFine, *HistAdd, *HistSub;
+	uint8_t		Value;
+	int32_t		Column, Sum, Bin, Bucket;
+
+	ColCoarse = (uint16_t *)calloc(NumCols * 16, sizeof(uint16_t));
+	ColFine = (uint16_t *)calloc(NumCols * 256, sizeof(uint16_t));
+	if((ColCoarse == NULL) || (ColFine == NULL))
+	{
+		printf("Error: [median_histogram_strip()] --> Could not allocate histograms.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Column histograms for first row (rows -Radius to Radius) */
+	for(int32_t i = 0; i < NumCols; i++)
+	{
+		Column = StartCol - Radius + i;
+
+		for(int32_t Row = -Radius; Row <= Radius; Row++)
+		{
+			if((Column < 0) || (Column >= ImgWidth) || (Row < 0) || (Row >= ImgHeight))
+				Value = Args->BorderValue;
+			else
+				Value = byte_row(Args->InputImage, Row)[Column * Stride + Channel];
+
+			ColFine[i * 256 + Value]++;
+			ColCoarse[i * 16 + (Value >> 4)]++;
+		}
+	}
+
+	for(int32_t Row = 0; Row < ImgHeight; Row++)
+	{
+		/* Slide column histograms one row down (columns outside image stay constant) */
+		if(Row > 0)
+		{
+			int32_t	OldRow = Row - 1 - Radius;
+			int32_t	NewRow = Row + Radius;
+			uint8_t	*OldPixel = ((OldRow >= 0) && (OldRow < ImgHeight)) ?
+			                    byte_row(Args->InputImage, OldRow) + Channel : NULL;
+			uint8_t	*NewPixel = ((NewRow >= 0) && (NewRow < ImgHeight)) ?
+			                    byte_row(Args->InputImage, NewRow) + Channel : NULL;
+
+			for(int32_t i = 0; i < NumCols; i++)
+			{
+				Column = StartCol - Radius + i;
+				if((Column < 0) || (Column >= ImgWidth))
+					continue;
+
+				Value = (OldPixel != NULL) ? OldPixel[Column * Stride] : Args->BorderValue;
+				ColFine[i * 256 + Value]--;
+				ColCoarse[i * 16 + (Value >> 4)]--;
+
+				Value = (NewPixel != NULL) ? NewPixel[Column * Stride] : Args->BorderValue;
+				ColFine[i * 256 + Value]++;
+				ColCoarse[i * 16 + (Value >> 4)]++;
+			}
+		}
+
+		/* Window coarse histogram for first output column */
+		for(int32_t b = 0; b < 16; b++)
+		{
+			Coarse[b] = 0;
+			LastUpdate[b] = -Side;	/* Forces full fine recompute on first use */
+		}
+
+		for(int32_t i = 0; i < Side; i++)
+		{
+			for(int32_t b = 0; b < 16; b++)
+				Coarse[b] += ColCoarse[i * 16 + b];
+		}
+
+		DstPixel = byte_row(Args->OutputImage, Row) + Channel;
+
+		for(int32_t j = 0; j < EndCol - StartCol; j++)
+		{
+			/* Window covers histogram columns [j:j+Side[ */
+			if(j > 0)
+			{
+				HistAdd = ColCoarse + (j + Side - 1) * 16;
+				HistSub = ColCoarse + (j - 1) * 16;
+
+				for(int32_t b = 0; b < 16; b++)
+					Coarse[b] += HistAdd[b] - HistSub[b];
+			}
+
+			/* Find coarse bucket holding the median */
+			Sum = 0;
+			for(Bucket = 0; Bucket < 15; Bucket++)
+			{
+				if(Sum + Coarse[Bucket] > Rank)
+					break;
+				Sum += Coarse[Bucket];
+			}
+
+			/* Bring fine bins of that bucket up to date */
+			HistFine = Fine + Bucket * 16;
+
+			if(j - LastUpdate[Bucket] >= Side)
+			{
+				for(int32_t b = 0; b < 16; b++)
+					HistFine[b] = 0;
+
+				for(int32_t i = j; i < j + Side; i++)
+				{
+					HistAdd = ColFine + i * 256 + Bucket * 16;
+
+					for(int32_t b = 0; b < 16; b++)
+						HistFine[b] += HistAdd[b];
+				}
+			}
+			else
+			{
+				for(int32_t k = LastUpdate[Bucket] + 1; k <= j; k++)
+				{
+					HistAdd = ColFine + (k + Side - 1) * 256 + Bucket * 16;
+					HistSub = ColFine + (k - 1) * 256 + Bucket * 16;
+
+					for(int32_t b = 0; b < 16; b++)
+						HistFine[b] += HistAdd[b] - HistSub[b];
+				}
+			}
+			LastUpdate[Bucket] = j;
+
+			for(Bin = 0; Bin < 15; Bin++)
+			{
+				if(Sum + HistFine[Bin] > Rank)
+					break;
+				Sum += HistFine[Bin];
+			}
+
+			DstPixel[(StartCol + j) * Stride] = (uint8_t)(Bucket * 16 + Bin);
+		}
+	}
+
+	free(ColCoarse);
+	free(ColFine);
+}
+/*******************************************************************************/
+/* Receive "median_work_t" type and filters the column interval strip by strip */
+static void *median(void *ThreadArg)
+{
+	median_work_t *Args = (median_work_t *)ThreadArg;
+
+	int32_t	Stride = (Args->InputImage->Pixel8 != NULL) ? 1 : 3;
+	int32_t	StripEnd;
+
+	for(int32_t Channel = 0; Channel < Stride; Channel++)
+	{
+		for(int32_t StripStart = Args->StartColumn; StripStart < Args->EndColumn; StripStart = StripEnd)
+		{
+			StripEnd = StripStart + MEDIAN_STRIP_WIDTH;
+			if(StripEnd > Args->EndColumn)
+				StripEnd = Args->EndColumn;
+
+			if(Args->Radius == 0)
+			{
+				for(int32_t Row = 0; Row < Args->InputImage->Height; Row++)
+				{
+					for(int32_t Column = StripStart; Column < StripEnd; Column++)
+					{
+						byte_row(Args->OutputImage, Row)[Column * Stride + Channel] =
+							byte_row(Args->InputImage, Row)[Column * Stride + Channel];
+					}
+				}
+			}
+			else if(Args->Radius <= 2)
+				median_network_strip(Args, Channel, Stride, StripStart, StripEnd);
+			else
+				median_histogram_strip(Args, Channel, Stride, StripStart, StripEnd);
+		}
+	}
+
+	return NULL;
+}
+
+/*******************************************************************************/
+/* van Herk - Gil-Werman on one padded line "Line" of "Length" samples (multiple of
+   "Size"). On return Line[x] holds min/max of the original Line[x:x+Size[.
+   "Suffix" is a scratch buffer with the same length */
+static void vhgw_line(uint8_t *Line, uint8_t *Suffix, int32_t Length, int32_t Size, int32_t IsMax)
+{
+	int32_t	Last;
+
+	for(int32_t Start = 0; Start < Length; Start += Size)
+	{
+		Last = Start + Size - 1;
+
+		/* Suffix min/max from segment end, then prefix min/max in place */
+		Suffix[Last] = Line[Last];
+		if(IsMax)
+		{
+			for(int32_t i = Last - 1; i >= Start; i--)
+				Suffix[i] = (Line[i] > Suffix[i + 1]) ? Line[i] : Suffix[i + 1];
+			for(int32_t i = Start + 1; i <= Last; i++)
+				Line[i] = (Line[i] > Line[i - 1]) ? Line[i] : Line[i - 1];
+		}
+		else
+		{
+			for(int32_t i = Last - 1; i >= Start; i--)
+				Suffix[i] = (Line[i] < Suffix[i + 1]) ? Line[i] : Suffix[i + 1];
+			for(int32_t i = Start + 1; i <= Last; i++)
+				Line[i] = (Line[i] < Line[i - 1]) ? Line[i] : Line[i - 1];
+		}
+	}
+
+	/* Window [x:x+Size[ = suffix of x's segment + prefix of next segment */
+	for(int32_t x = 0; x + Size - 1 < Length; x++)
+	{
+		if(IsMax)
+			Line[x] = (Suffix[x] > Line[x + Size - 1]) ? Suffix[x] : Line[x + Size - 1];
+		else
+			Line[x] = (Suffix[x] < Line[x + Size - 1]) ? Suffix[x] : Line[x + Size - 1];
+	}
+}
+/*******************************************************************************/
+/* Element-wise min/max of two lanes of MORPH_COLUMN_BLOCK pixels stored on "Dst" */
+#define MORPH_COLUMN_BLOCK	64
+static void morph_lanes(uint8_t *restrict Dst, const uint8_t *restrict Src, int32_t IsMax)
+{
+	if(IsMax)
+	{
+		for(int32_t c = 0; c < MORPH_COLUMN_BLOCK; c++)
+			Dst[c] = (Dst[c] > Src[c]) ? Dst[c] : Src[c];
+	}
+	else
+	{
+		for(int32_t c = 0; c < MORPH_COLUMN_BLOCK; c++)
+			Dst[c] = (Dst[c] < Src[c]) ? Dst[c] : Src[c];
+	}
+}
+/*******************************************************************************/
+/* Horizontal morphology pass on rows [Start:End[ */
+static void *morphology_rows(void *ThreadArg)
+{
+	morphology_work_t *Args = (morphology_work_t *)ThreadArg;
+
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	Size		= Args->Size;
+	int32_t	Anchor		= Size/2;
+	int32_t	Length		= ((ImgWidth + Size - 1 + Size - 1)/Size) * Size;
+	uint8_t	*Line, *Suffix;
+
+	Line = (uint8_t *)malloc(Length);
+	Suffix = (uint8_t *)malloc(Length);
+	if((Line == NULL) || (Suffix == NULL))
+	{
+		printf("Error: [morphology_rows()] --> Could not allocate line buffers.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		for(int32_t i = 0; i < Length; i++)
+			Line[i] = Args->BorderValue;
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			Line[Column + Anchor] = Args->InputImage->Pixel8[Row][Column];
+
+		vhgw_line(Line, Suffix, Length, Size, Args->IsMax);
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			Args->OutputImage->Pixel8[Row][Column] = Line[Column];
+	}
+
+	free(Line);
+	free(Suffix);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Vertical morphology pass on columns [Start:End[. Blocks of MORPH_COLUMN_BLOCK columns
+   are processed together so every step is an element-wise min/max over a whole lane */
+static void *morphology_columns(void *ThreadArg)
+{
+	morphology_work_t *Args = (morphology_work_t *)ThreadArg;
+
+	int32_t	ImgHeight	= Args->InputImage->Height;
+	int32_t	Size		= Args->Size;
+	int32_t	Anchor		= Size/2;
+	int32_t	Length		= ((ImgHeight + Size - 1 + Size - 1)/Size) * Size;
+	int32_t	BlockWidth, Last;
+	uint8_t	*Block, *Suffix;
+	uint8_t	*Lane;
+
+	Block = (uint8_t *)malloc((size_t)Length * MORPH_COLUMN_BLOCK);
+	Suffix = (uint8_t *)malloc((size_t)Length * MORPH_COLUMN_BLOCK);
+	if((Block == NULL) || (Suffix == NULL))
+	{
+		printf("Error: [morphology_columns()] --> Could not allocate block buffers.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int32_t StartCol = Args->Start; StartCol < Args->End; StartCol += MORPH_COLUMN_BLOCK)
+	{
+		BlockWidth = Args->End - StartCol;
+		if(BlockWidth > MORPH_COLUMN_BLOCK)
+			BlockWidth = MORPH_COLUMN_BLOCK;
+
+		for(int32_t i = 0; i < Length * MORPH_COLUMN_BLOCK; i++)
+			Block[i] = Args->BorderValue;
+
+		for(int32_t Row = 0; Row < ImgHeight; Row++)
+		{
+			Lane = Block + (size_t)(Row + Anchor) * MORPH_COLUMN_BLOCK;
+
+			for(int32_t c = 0; c < BlockWidth; c++)
+				Lane[c] = Args->InputImage->Pixel8[Row][StartCol + c];
+		}
+
+		for(int32_t Start = 0; Start < Length; Start += Size)
+		{
+			Last = Start + Size - 1;
+
+			/* Suffix min/max from segment end, then prefix min/max in place */
+			for(int32_t i = Last; i >= Start; i--)
+			{
+				for(int32_t c = 0; c < MORPH_COLUMN_BLOCK; c++)
+					Suffix[(size_t)i * MORPH_COLUMN_BLOCK + c] = Block[(size_t)i * MORPH_COLUMN_BLOCK + c];
+
+				if(i != Last)
+					morph_lanes(Suffix + (size_t)i * MORPH_COLUMN_BLOCK,
+					            Suffix + (size_t)(i + 1) * MORPH_COLUMN_BLOCK, Args->IsMax);
+			}
+
+			for(int32_t i = Start + 1; i <= Last; i++)
+				morph_lanes(Block + (size_t)i * MORPH_COLUMN_BLOCK,
+				            Block + (size_t)(i - 1) * MORPH_COLUMN_BLOCK, Args->IsMax);
+		}
+
+		/* Window [Row:Row+Size[ = suffix of Row's segment + prefix of next segment */
+		for(int32_t Row = 0; Row < ImgHeight; Row++)
+		{
+			morph_lanes(Suffix + (size_t)Row * MORPH_COLUMN_BLOCK,
+			            Block + (size_t)(Row + Size - 1) * MORPH_COLUMN_BLOCK, Args->IsMax);
+
+			for(int32_t c = 0; c < BlockWidth; c++)
+				Args->OutputImage->Pixel8[Row][StartCol + c] = Suffix[(size_t)Row * MORPH_COLUMN_BLOCK + c];
+		}
+	}
+
+	free(Block);
+	free(Suffix);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Split interval [0:Total[ between threads and run one morphology pass */
+static void run_morphology_pass(void *(*Worker)(void *), morphology_work_t *ThreadArg,
+                                int32_t ThreadsNum, int32_t Total)
+{
+	pthread_t	ThreadId[ThreadsNum];
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Total/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Total/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, Worker, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+}
+/*******************************************************************************/
+/* Erosion (IsMax = 0) or dilation (IsMax = 1) with rectangular element as two
+   separable passes. Return NULL if fail */
+static img_t *erode_dilate(img_t *Img, int32_t IsMax, int32_t Height, int32_t Width,
+                           int32_t ThreadsNum, uint8_t BorderValue)
+{
+	morphology_work_t	ThreadArg[ThreadsNum];
+	img_t				*TmpImg;
+	img_t				*OutputImg;
+
+	TmpImg = new_BMP_as_size(Img, GRAY_8BITS);
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	if((TmpImg == NULL) || (OutputImg == NULL))
+	{
+		free_img(TmpImg);
+		free_img(OutputImg);
+		return NULL;
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].IsMax = IsMax;
+		ThreadArg[i].BorderValue = BorderValue;
+		ThreadArg[i].Size = Width;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = TmpImg;
+	}
+	run_morphology_pass(morphology_rows, ThreadArg, ThreadsNum, Img->Height);
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Size = Height;
+		ThreadArg[i].InputImage = TmpImg;
+		ThreadArg[i].OutputImage = OutputImg;
+	}
+	run_morphology_pass(morphology_columns, ThreadArg, ThreadsNum, Img->Width);
+
+	free_img(TmpImg);
+
+	return OutputImg;
+}
+
+/*******************************************************************************/
+/* Receive "histogram_work_t" type and counts pixels on given row interval.
+   Consecutive pixels go to different banks and banks are summed at the end */
+static void *histogram_count(void *ThreadArg)
+{
+	histogram_work_t *Args = (histogram_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int32_t		Channels = (Args->InputImage->Pixel8 != NULL) ? 1 : 3;
+	uint32_t	*Bank;
+	uint8_t		*Pixel;
+	int32_t		Column;
+
+	/* Bank[(b * Channels + Channel) * 256 + Value] */
+	Bank = (uint32_t *)calloc(HISTOGRAM_BANKS * Channels * 256, sizeof(uint32_t));
+	if(Bank == NULL)
+	{
+		printf("Error: [histogram_count()] --> Could not allocate histogram banks.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		if(Channels == 1)
+		{
+			Pixel = Args->InputImage->Pixel8[Row];
+
+			for(Column = 0; Column + HISTOGRAM_BANKS <= ImgWidth; Column += HISTOGRAM_BANKS)
+			{
+				for(int32_t b = 0; b < HISTOGRAM_BANKS; b++)
+					Bank[b * 256 + Pixel[Column + b]]++;
+			}
+
+			for(; Column < ImgWidth; Column++)
+				Bank[Pixel[Column]]++;
+		}
+		else
+		{
+			/* Red, green and blue go to separate tables, so interleave banks by pixel */
+			for(Column = 0; Column < ImgWidth; Column++)
+			{
+				uint32_t *Table = Bank + (Column % HISTOGRAM_BANKS) * 3 * 256;
+
+				Table[PASS_RED_CHANNEL * 256 + Args->InputImage->Pixel24[Row][Column].Red]++;
+				Table[PASS_GREEN_CHANNEL * 256 + Args->InputImage->Pixel24[Row][Column].Green]++;
+				Table[PASS_BLUE_CHANNEL * 256 + Args->InputImage->Pixel24[Row][Column].Blue]++;
+			}
+		}
+	}
+
+	for(int32_t i = 0; i < Channels * 256; i++)
+	{
+		Args->Hist[i] = 0;
+
+		for(int32_t b = 0; b < HISTOGRAM_BANKS; b++)
+			Args->Hist[i] += Bank[b * Channels * 256 + i];
+	}
+
+	free(Bank);
+
+	return NULL;
+}
+
+/*******************************************************************************/
+/* Receive "lut_work_t" type and maps pixels through the lookup table on given rows.
+   RGB_24BITS images use one table per channel (red, green and blue) */
+static void *lut_apply(void *ThreadArg)
+{
+	lut_work_t *Args = (lut_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	uint8_t		*SrcPixel, *DstPixel;
+	uint8_t		*Red = Args->Lut + 256 * PASS_RED_CHANNEL;
+	uint8_t		*Green = Args->Lut + 256 * PASS_GREEN_CHANNEL;
+	uint8_t		*Blue = Args->Lut + 256 * PASS_BLUE_CHANNEL;
+	pixel24_t	*SrcColor, *DstColor;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		if(Args->InputImage->Pixel8 == NULL)
+		{
+			SrcColor = Args->InputImage->Pixel24[Row];
+			DstColor = Args->OutputImage->Pixel24[Row];
+
+			for(int32_t Column = 0; Column < ImgWidth; Column++)
+			{
+				DstColor[Column].Red = Red[SrcColor[Column].Red];
+				DstColor[Column].Green = Green[SrcColor[Column].Green];
+				DstColor[Column].Blue = Blue[SrcColor[Column].Blue];
+			}
+			continue;
+		}
+
+		SrcPixel = Args->InputImage->Pixel8[Row];
+		DstPixel = Args->OutputImage->Pixel8[Row];
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+			DstPixel[Column] = Args->Lut[SrcPixel[Column]];
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "lut_work_t" type and packs non-zero table results as bits on given rows */
+static void *lut_apply_mask(void *ThreadArg)
+{
+	lut_work_t *Args = (lut_work_t *)ThreadArg;
+
+	int32_t	ImgWidth = Args->InputImage->Width;
+	uint8_t	*SrcPixel, *Bits;
+	uint8_t	Byte;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		SrcPixel = Args->InputImage->Pixel8[Row];
+		Bits = Args->Mask->Bits + (size_t)Row * Args->Mask->Stride;
+
+		for(int32_t Column = 0; Column < ImgWidth; Column += 8)
+		{
+			Byte = 0;
+
+			for(int32_t b = 0; (b < 8) && (Column + b < ImgWidth); b++)
+			{
+				if(Args->Lut[SrcPixel[Column + b]] != 0)
+					Byte |= (uint8_t)(1 << b);
+			}
+
+			Bits[Column / 8] = Byte;
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Build equalization table of a histogram with "NumPixel" samples */
+static void equalization_lut(const uint32_t *Hist, uint32_t NumPixel, uint8_t *Lut)
+{
+	uint32_t	Cdf = 0;
+	uint32_t	CdfMin = 0;
+
+	for(int32_t i = 0; i < 256; i++)
+	{
+		if(Hist[i] != 0)
+		{
+			CdfMin = Hist[i];
+			break;
+		}
+	}
+
+	for(int32_t i = 0; i < 256; i++)
+	{
+		Cdf += Hist[i];
+
+		if(NumPixel == CdfMin)
+			Lut[i] = (uint8_t)i;	/* Constant image */
+		else if(Cdf <= CdfMin)
+			Lut[i] = 0;
+		else
+			Lut[i] = (uint8_t)(((uint64_t)(Cdf - CdfMin) * 255 + (NumPixel - CdfMin)/2) / (NumPixel - CdfMin));
+	}
+}
+/*******************************************************************************/
+/* Receive "clahe_work_t" type and builds clipped equalization tables for tiles [Start:End[.
+   Clipped excess is redistributed evenly over all bins */
+static void *clahe_tiles(void *ThreadArg)
+{
+	clahe_work_t *Args = (clahe_work_t *)ThreadArg;
+
+	int32_t		ImgHeight	= Args->InputImage->Height;
+	int32_t		ImgWidth	= Args->InputImage->Width;
+	int32_t		RowStart, RowEnd, ColStart, ColEnd;
+	uint32_t	Hist[256];
+	uint32_t	Area, Limit, Excess, Step;
+	uint8_t		*Pixel;
+	uint32_t	Cdf;
+
+	for(int32_t Tile = Args->Start; Tile < Args->End; Tile++)
+	{
+		RowStart = (Tile / Args->TilesX) * ImgHeight/Args->TilesY;
+		RowEnd = (Tile / Args->TilesX + 1) * ImgHeight/Args->TilesY;
+		ColStart = (Tile % Args->TilesX) * ImgWidth/Args->TilesX;
+		ColEnd = (Tile % Args->TilesX + 1) * ImgWidth/Args->TilesX;
+		Area = (RowEnd - RowStart) * (ColEnd - ColStart);
+
+		for(int32_t i = 0; i < 256; i++)
+			Hist[i] = 0;
+
+		for(int32_t Row = RowStart; Row < RowEnd; Row++)
+		{
+			Pixel = Args->InputImage->Pixel8[Row];
+
+			for(int32_t Column = ColStart; Column < ColEnd; Column++)
+				Hist[Pixel[Column]]++;
+		}
+
+		/* Clip and redistribute */
+		if(Args->ClipLimit > 0.0)
+		{
+			Limit = (uint32_t)(Args->ClipLimit * Area / 256.0);
+			if(Limit < 1)
+				Limit = 1;
+
+			Excess = 0;
+			for(int32_t i = 0; i < 256; i++)
+			{
+				if(Hist[i] > Limit)
+				{
+					Excess += Hist[i] - Limit;
+					Hist[i] = Limit;
+				}
+			}
+
+			for(int32_t i = 0; i < 256; i++)
+				Hist[i] += Excess / 256;
+
+			/* Residual spread with uniform step over the bins */
+			Excess %= 256;
+			if(Excess > 0)
+			{
+				Step = 256 / Excess;
+				for(int32_t i = 0; (i < 256) && (Excess > 0); i += Step, Excess--)
+					Hist[i]++;
+			}
+		}
+
+		/* Tile table maps through the normalized cumulative distribution */
+		Cdf = 0;
+		for(int32_t i = 0; i < 256; i++)
+		{
+			Cdf += Hist[i];
+			Args->Lut[Tile * 256 + i] = (uint8_t)(((uint64_t)Cdf * 255 + Area/2) / Area);
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "clahe_work_t" type and maps rows [Start:End[ interpolating the tables of the
+   four nearest tile centers. Tile and weight of each column are precomputed, so a pixel
+   costs four table reads and a fixed point blend */
+static void *clahe_interpolate(void *ThreadArg)
+{
+	clahe_work_t *Args = (clahe_work_t *)ThreadArg;
+
+	int32_t	ImgHeight	= Args->InputImage->Height;
+	int32_t	ImgWidth	= Args->InputImage->Width;
+	int32_t	TileY0, TileY1, WeightY, Left, Right, WeightX;
+	float	PosY;
+	uint8_t	*Top, *Bottom;
+	uint8_t	*SrcPixel, *DstPixel;
+	uint8_t	Value;
+	int32_t	TopValue, BottomValue;
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		/* Position in tile units relative to tile centers */
+		PosY = (Row + 0.5) * Args->TilesY / ImgHeight - 0.5;
+		if(PosY < 0)
+			PosY = 0;
+
+		TileY0 = (int32_t)PosY;
+		if(TileY0 >= Args->TilesY - 1)
+		{
+			TileY0 = Args->TilesY - 1;
+			TileY1 = TileY0;
+			WeightY = 0;
+		}
+		else
+		{
+			TileY1 = TileY0 + 1;
+			WeightY = (int32_t)((PosY - TileY0) * 256.0 + 0.5);
+		}
+
+		Top = Args->Lut + TileY0 * Args->TilesX * 256;
+		Bottom = Args->Lut + TileY1 * Args->TilesX * 256;
+
+		SrcPixel = Args->InputImage->Pixel8[Row];
+		DstPixel = Args->OutputImage->Pixel8[Row];
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+		{
+			Value = SrcPixel[Column];
+			Left = Args->ColumnTile[Column] * 256 + Value;
+			Right = (Args->ColumnTile[Column] + ((Args->ColumnTile[Column] < Args->TilesX - 1) ? 1 : 0)) * 256 + Value;
+			WeightX = Args->ColumnWeight[Column];
+
+			TopValue = Top[Left] * (256 - WeightX) + Top[Right] * WeightX;
+			BottomValue = Bottom[Left] * (256 - WeightX) + Bottom[Right] * WeightX;
+
+			DstPixel[Column] = (uint8_t)((TopValue * (256 - WeightY) + BottomValue * WeightY + (1 << 15)) >> 16);
+		}
+	}
+
+	return NULL;
+}
+
+/*******************************************************************************/
+/* Allocate bit mask with all bits cleared. Return NULL if fail */
+static bit_mask_t *new_bit_mask(int32_t Width, int32_t Height)
+{
+	bit_mask_t	*Mask;
+
+	Mask = (bit_mask_t *)malloc(sizeof(bit_mask_t));
+	if(Mask == NULL)
+		return NULL;
+
+	Mask->Width = Width;
+	Mask->Height = Height;
+	Mask->Stride = (Width + 7) / 8;
+	Mask->Bits = (uint8_t *)calloc((size_t)Mask->Stride * Height, 1);
+	if(Mask->Bits == NULL)
+	{
+		free(Mask);
+		return NULL;
+	}
+
+	return Mask;
+}
+/*******************************************************************************/
+/* Allocate summed-area table for given image size. Return NULL if fail */
+static integral_t *new_integral(int32_t ImgWidth, int32_t ImgHeight, int Type)
+{
+	integral_t	*Table;
+	size_t		Entries = ((size_t)ImgWidth + 1) * ((size_t)ImgHeight + 1);
+
+	Table = (integral_t *)malloc(sizeof(integral_t));
+	if(Table == NULL)
+		return NULL;
+
+	Table->Width = ImgWidth + 1;
+	Table->Height = ImgHeight + 1;
+	Table->Type = Type;
+	Table->Sum32 = NULL;
+	Table->Sum64 = NULL;
+	Table->SumDouble = NULL;
+
+	switch(Type)
+	{
+		case INTEGRAL_UINT32:
+			Table->Sum32 = (uint32_t *)malloc(sizeof(uint32_t) * Entries);
+			if(Table->Sum32 != NULL)
+				return Table;
+			break;
+
+		case INTEGRAL_UINT64:
+			Table->Sum64 = (uint64_t *)malloc(sizeof(uint64_t) * Entries);
+			if(Table->Sum64 != NULL)
+				return Table;
+			break;
+
+		case INTEGRAL_DOUBLE:
+			Table->SumDouble = (double *)malloc(sizeof(double) * Entries);
+			if(Table->SumDouble != NULL)
+				return Table;
+			break;
+
+		default:
+			printf("Error: [integral_image()] --> Invalid \"Type\" input.\n\n");
+			break;
+	}
+
+	free(Table);
+	return NULL;
+}
+/*******************************************************************************/
+/* Prefix sum of one image row (multiplied by "Factor" if not NULL) into a 32 bits table
+   row (Dst[0] receives 0). With SSE2 four pixels are summed per step with two shifted adds */
+static void prefix_row_u32(const uint8_t *Pixel, const uint8_t *Factor, uint32_t *Dst, int32_t ImgWidth)
+{
+	uint32_t	Acc = 0;
+	uint32_t	Value;
+	int32_t		Column = 0;
+
+	Dst[0] = 0;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Carry = _mm_setzero_si128();
+	__m128i	Vec;
+	uint32_t	Four;
+
+	for(; Column + 4 <= ImgWidth; Column += 4)
+	{
+		Four = (uint32_t)Pixel[Column] | ((uint32_t)Pixel[Column + 1] << 8) |
+		       ((uint32_t)Pixel[Column + 2] << 16) | ((uint32_t)Pixel[Column + 3] << 24);
+
+		Vec = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)Four), Zero), Zero);
+		if(Factor != NULL)
+		{
+			Four = (uint32_t)Factor[Column] | ((uint32_t)Factor[Column + 1] << 8) |
+			       ((uint32_t)Factor[Column + 2] << 16) | ((uint32_t)Factor[Column + 3] << 24);
+
+			/* High halves are zero: lane = x*y */
+			Vec = _mm_madd_epi16(Vec, _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)Four), Zero), Zero));
+		}
+
+		Vec = _mm_add_epi32(Vec, _mm_slli_si128(Vec, 4));
+		Vec = _mm_add_epi32(Vec, _mm_slli_si128(Vec, 8));
+		Vec = _mm_add_epi32(Vec, Carry);
+
+		_mm_storeu_si128((__m128i *)(Dst + Column + 1), Vec);
+		Carry = _mm_shuffle_epi32(Vec, 0xFF);
+	}
+
+	Acc = (Column > 0) ? Dst[Column] : 0;
+#endif
+
+	for(; Column < ImgWidth; Column++)
+	{
+		Value = Pixel[Column];
+		Acc += (Factor != NULL) ? Value * Factor[Column] : Value;
+		Dst[Column + 1] = Acc;
+	}
+}
+/*******************************************************************************/
+/* Row pass of summed-area table: prefix sums along each image row [Start:End[.
+   Table row "Row + 1" receives the running sum of image row "Row" */
+static void *integral_rows(void *ThreadArg)
+{
+	integral_work_t *Args = (integral_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	size_t		Stride = Args->Table->Width;
+	uint8_t		*Pixel, *Factor;
+	uint64_t	Acc;
+	double		AccDouble;
+	uint32_t	Value;
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		Pixel = Args->InputImage->Pixel8[Row];
+		Factor = (Args->FactorImage != NULL) ? Args->FactorImage->Pixel8[Row] : NULL;
+
+		switch(Args->Table->Type)
+		{
+			case INTEGRAL_UINT32:
+				prefix_row_u32(Pixel, Factor, Args->Table->Sum32 + (Row + 1) * Stride, ImgWidth);
+				break;
+
+			case INTEGRAL_UINT64:
+			{
+				uint64_t *Dst = Args->Table->Sum64 + (Row + 1) * Stride;
+
+				Dst[0] = 0;
+				Acc = 0;
+				for(int32_t Column = 0; Column < ImgWidth; Column++)
+				{
+					Value = Pixel[Column];
+					Acc += (Factor != NULL) ? Value * Factor[Column] : Value;
+					Dst[Column + 1] = Acc;
+				}
+				break;
+			}
+
+			case INTEGRAL_DOUBLE:
+			{
+				double *Dst = Args->Table->SumDouble + (Row + 1) * Stride;
+
+				Dst[0] = 0.0;
+				AccDouble = 0.0;
+				for(int32_t Column = 0; Column < ImgWidth; Column++)
+				{
+					Value = Pixel[Column];
+					AccDouble += (Factor != NULL) ? Value * Factor[Column] : Value;
+					Dst[Column + 1] = AccDouble;
+				}
+				break;
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Column pass of summed-area table over table columns [Start:End[. Every table row
+   adds the row above it, so the inner loop is contiguous along the row */
+static void *integral_columns(void *ThreadArg)
+{
+	integral_work_t *Args = (integral_work_t *)ThreadArg;
+
+	size_t	Stride = Args->Table->Width;
+
+	for(int32_t Row = 2; Row < Args->Table->Height; Row++)
+	{
+		int32_t Column = Args->Start;
+
+		switch(Args->Table->Type)
+		{
+			case INTEGRAL_UINT32:
+			{
+				uint32_t *Cur = Args->Table->Sum32 + Row * Stride;
+				uint32_t *Prev = Cur - Stride;
+#ifdef __SSE2__
+				for(; Column + 4 <= Args->End; Column += 4)
+				{
+					_mm_storeu_si128((__m128i *)(Cur + Column),
+					                 _mm_add_epi32(_mm_loadu_si128((__m128i *)(Cur + Column)),
+					                               _mm_loadu_si128((__m128i *)(Prev + Column))));
+				}
+#endif
+				for(; Column < Args->End; Column++)
+					Cur[Column] += Prev[Column];
+				break;
+			}
+
+			case INTEGRAL_UINT64:
+			{
+				uint64_t *Cur = Args->Table->Sum64 + Row * Stride;
+				uint64_t *Prev = Cur - Stride;
+#ifdef __SSE2__
+				for(; Column + 2 <= Args->End; Column += 2)
+				{
+					_mm_storeu_si128((__m128i *)(Cur + Column),
+					                 _mm_add_epi64(_mm_loadu_si128((__m128i *)(Cur + Column)),
+					                               _mm_loadu_si128((__m128i *)(Prev + Column))));
+				}
+#endif
+				for(; Column < Args->End; Column++)
+					Cur[Column] += Prev[Column];
+				break;
+			}
+
+			case INTEGRAL_DOUBLE:
+			{
+				double *Cur = Args->Table->SumDouble + Row * Stride;
+				double *Prev = Cur - Stride;
+
+				for(; Column < Args->End; Column++)
+					Cur[Column] += Prev[Column];
+				break;
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Build summed-area table of "Img" (multiplied by "Factor" if not NULL) using a row pass
+   followed by a column pass. Return NULL if fail */
+static integral_t *build_integral(img_t *Img, img_t *Factor, int Type, int32_t ThreadsNum)
+{
+	integral_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	integral_t		*Table;
+
+	Table = new_integral(Img->Width, Img->Height, Type);
+	if(Table == NULL)
+		return NULL;
+
+	/* First table row is zero */
+	for(int32_t Column = 0; Column < Table->Width; Column++)
+	{
+		if(Type == INTEGRAL_UINT32)
+			Table->Sum32[Column] = 0;
+		else if(Type == INTEGRAL_UINT64)
+			Table->Sum64[Column] = 0;
+		else
+			Table->SumDouble[Column] = 0.0;
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Img->Height/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Img->Height/ThreadsNum;
+		ThreadArg[i].FactorImage = Factor;
+		ThreadArg[i].Table = Table;
+		ThreadArg[i].InputImage = Img;
+
+		pthread_create(&ThreadId[i], NULL, integral_rows, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Table->Width/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Table->Width/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, integral_columns, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return Table;
+}
+/*******************************************************************************/
+/* Receive "adaptive_work_t" type and thresholds given rows with window statistics
+   read from the summed-area tables */
+static void *adaptive(void *ThreadArg)
+{
+	adaptive_work_t *Args = (adaptive_work_t *)ThreadArg;
+
+	int32_t		ImgHeight	= Args->InputImage->Height;
+	int32_t		ImgWidth	= Args->InputImage->Width;
+	size_t		Stride		= Args->Sum->Width;
+	int32_t		Top, Bottom, Left, Right;
+	uint32_t	*SumTop, *SumBottom;
+	uint64_t	*SqTop = NULL, *SqBottom = NULL;
+	uint32_t	Area, WindowSum;
+	uint64_t	WindowSq;
+	double		Mean, Variance, Threshold;
+	uint8_t		*Pixel, *Bits = NULL;
+	uint8_t		Result;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		/* Window rows [Top:Bottom[ clipped to image */
+		Top = (Row - Args->Radius < 0) ? 0 : Row - Args->Radius;
+		Bottom = (Row + Args->Radius + 1 > ImgHeight) ? ImgHeight : Row + Args->Radius + 1;
+
+		SumTop = Args->Sum->Sum32 + Top * Stride;
+		SumBottom = Args->Sum->Sum32 + Bottom * Stride;
+		if(Args->SqSum != NULL)
+		{
+			SqTop = Args->SqSum->Sum64 + Top * Stride;
+			SqBottom = Args->SqSum->Sum64 + Bottom * Stride;
+		}
+
+		Pixel = Args->InputImage->Pixel8[Row];
+		if(Args->Mask != NULL)
+		{
+			Bits = Args->Mask->Bits + (size_t)Row * Args->Mask->Stride;
+			for(int32_t i = 0; i < Args->Mask->Stride; i++)
+				Bits[i] = 0;
+		}
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+		{
+			Left = (Column - Args->Radius < 0) ? 0 : Column - Args->Radius;
+			Right = (Column + Args->Radius + 1 > ImgWidth) ? ImgWidth : Column + Args->Radius + 1;
+			Area = (Bottom - Top) * (Right - Left);
+
+			WindowSum = SumBottom[Right] - SumBottom[Left] - SumTop[Right] + SumTop[Left];
+			Mean = (double)WindowSum / Area;
+
+			if(Args->Method == ADAPTIVE_SAUVOLA)
+			{
+				WindowSq = SqBottom[Right] - SqBottom[Left] - SqTop[Right] + SqTop[Left];
+				Variance = (double)WindowSq / Area - Mean * Mean;
+				if(Variance < 0)
+					Variance = 0;
+
+				Threshold = Mean * (1.0 + Args->Param * (sqrt(Variance) / 128.0 - 1.0));
+			}
+			else
+			{
+				Threshold = Mean - Args->Param;
+			}
+
+			Result = (Pixel[Column] > Threshold) ? 255 : 0;
+
+			if(Args->Mask != NULL)
+			{
+				if(Result)
+					Bits[Column / 8] |= (uint8_t)(1 << (Column % 8));
+			}
+			else
+			{
+				Args->OutputImage->Pixel8[Row][Column] = Result;
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Run global threshold writing either GRAY_8BITS image or bit mask */
+static void run_threshold(img_t *Img, uint8_t Level, int32_t ThreadsNum, img_t *OutputImg, bit_mask_t *Mask)
+{
+	lut_work_t	ThreadArg[ThreadsNum];
+	pthread_t	ThreadId[ThreadsNum];
+	uint8_t		Lut[256];
+
+	for(int32_t i = 0; i < 256; i++)
+		Lut[i] = (i > Level) ? 255 : 0;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+		ThreadArg[i].Lut = Lut;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+		ThreadArg[i].Mask = Mask;
+
+		if(Mask != NULL)
+			pthread_create(&ThreadId[i], NULL, lut_apply_mask, (void *)&ThreadArg[i]);
+		else
+			pthread_create(&ThreadId[i], NULL, lut_apply, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+}
+/*******************************************************************************/
+/* Run adaptive threshold writing either GRAY_8BITS image or bit mask. Return -1 if fail */
+static int run_adaptive_threshold(img_t *Img, int Method, int32_t Radius, float Param,
+                                  int32_t ThreadsNum, img_t *OutputImg, bit_mask_t *Mask)
+{
+	adaptive_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	integral_t		*Sum;
+	integral_t		*SqSum = NULL;
+
+	if((Method != ADAPTIVE_MEAN) && (Method != ADAPTIVE_SAUVOLA))
+	{
+		printf("Error: [adaptive_threshold()] --> Invalid \"Method\" input.\n\n");
+		return -1;
+	}
+
+	if(Radius < 1)
+	{
+		printf("Error: [adaptive_threshold()] --> Radius should be positive.\n\n");
+		return -1;
+	}
+
+	/* Window sums of pixels always fit 32 bits, sums of squares may not */
+	Sum = build_integral(Img, NULL, INTEGRAL_UINT32, ThreadsNum);
+	if(Method == ADAPTIVE_SAUVOLA)
+		SqSum = build_integral(Img, Img, INTEGRAL_UINT64, ThreadsNum);
+
+	if((Sum == NULL) || ((Method == ADAPTIVE_SAUVOLA) && (SqSum == NULL)))
+	{
+		printf("Error: [adaptive_threshold()] --> Could not allocate memory.\n\n");
+		free_integral(Sum);
+		free_integral(SqSum);
+		return -1;
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+		ThreadArg[i].Method = Method;
+		ThreadArg[i].Radius = Radius;
+		ThreadArg[i].Param = Param;
+		ThreadArg[i].Sum = Sum;
+		ThreadArg[i].SqSum = SqSum;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+		ThreadArg[i].Mask = Mask;
+
+		pthread_create(&ThreadId[i], NULL, adaptive, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	free_integral(Sum);
+	free_integral(SqSum);
+
+	return 0;
+}
+
+/*******************************************************************************/
+/* Foreground pixels of each 2x2 block on given block row. Bit 0 is top left, bit 1
+   top right, bit 2 bottom left and bit 3 bottom right pixel */
+static void block_masks(img_t *Img, int32_t BlockRow, uint8_t *Mask)
+{
+	int32_t	Row = 2 * BlockRow;
+	int32_t	Pairs = Img->Width / 2;
+	uint8_t	*Top = Img->Pixel8[Row];
+	uint8_t	*Bottom = (Row + 1 < Img->Height) ? Img->Pixel8[Row + 1] : NULL;
+
+	for(int32_t Block = 0; Block < Pairs; Block++)
+	{
+		Mask[Block] = (uint8_t)((Top[2 * Block] != 0) | ((Top[2 * Block + 1] != 0) << 1));
+	}
+	if(Img->Width & 1)
+		Mask[Pairs] = (uint8_t)(Top[2 * Pairs] != 0);
+
+	if(Bottom == NULL)
+		return;
+
+	for(int32_t Block = 0; Block < Pairs; Block++)
+	{
+		Mask[Block] |= (uint8_t)(((Bottom[2 * Block] != 0) << 2) | ((Bottom[2 * Block + 1] != 0) << 3));
+	}
+	if(Img->Width & 1)
+		Mask[Pairs] |= (uint8_t)((Bottom[2 * Pairs] != 0) << 2);
+}
+/*******************************************************************************/
+/* Root of the label tree. Roots are always the smallest label of its tree */
+static uint32_t find_root(uint32_t *Parent, uint32_t Label)
+{
+	uint32_t	Root = Label;
+	uint32_t	Next;
+
+	while(Parent[Root] != Root)
+		Root = Parent[Root];
+
+	/* Path compression */
+	while(Parent[Label] != Root)
+	{
+		Next = Parent[Label];
+		Parent[Label] = Root;
+		Label = Next;
+	}
+
+	return Root;
+}
+/*******************************************************************************/
+/* Join label trees keeping the smallest root. Return the new root */
+static uint32_t merge_labels(uint32_t *Parent, uint32_t A, uint32_t B)
+{
+	A = find_root(Parent, A);
+	B = find_root(Parent, B);
+
+	if(A < B)
+	{
+		Parent[B] = A;
+		return A;
+	}
+
+	Parent[A] = B;
+	return B;
+}
+/*******************************************************************************/
+/* Join block "Column" with the 8-connected blocks of the row above (up left, up and
+   up right). "Label" is the current label of the block (0 if none yet). Return the
+   resulting label of the block */
+static uint32_t link_upper_blocks(uint32_t *Parent, uint8_t *UpMask, uint32_t *UpLabel,
+                                  int32_t Column, int32_t Blocks, uint8_t Mask, uint32_t Label)
+{
+	/* Up left: top left pixel touches its bottom right pixel */
+	if((Column > 0) && (Mask & 1) && (UpMask[Column - 1] & 8))
+		Label = Label ? merge_labels(Parent, Label, UpLabel[Column - 1]) : UpLabel[Column - 1];
+
+	/* Up: any top pixel touches any of its bottom pixels */
+	if((Mask & 3) && (UpMask[Column] & 12))
+		Label = Label ? merge_labels(Parent, Label, UpLabel[Column]) : UpLabel[Column];
+
+	/* Up right: top right pixel touches its bottom left pixel */
+	if((Column + 1 < Blocks) && (Mask & 2) && (UpMask[Column + 1] & 4))
+		Label = Label ? merge_labels(Parent, Label, UpLabel[Column + 1]) : UpLabel[Column + 1];
+
+	return Label;
+}
+/*******************************************************************************/
+/* Receive "components_work_t" type. First pass: provisional labels of 2x2 blocks on
+   block rows [StartRow:EndRow[. All pixels of a block are 8-connected, so each block
+   needs a single label and one test per neighbour block */
+static void *label_blocks(void *ThreadArg)
+{
+	components_work_t *Args = (components_work_t *)ThreadArg;
+
+	int32_t		Blocks = (Args->InputImage->Width + 1) / 2;
+	uint32_t	*Parent = Args->Parent;
+	uint32_t	Next = Args->Base;
+	uint32_t	*Label;
+	uint8_t		*Mask;
+	uint32_t	Current;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Mask = Args->BlockMask + (size_t)Row * Blocks;
+		Label = Args->BlockLabel + (size_t)Row * Blocks;
+
+		block_masks(Args->InputImage, Row, Mask);
+
+		for(int32_t Column = 0; Column < Blocks; Column++)
+		{
+			if(Mask[Column] == 0)
+			{
+				Label[Column] = 0;
+				continue;
+			}
+
+			Current = 0;
+
+			/* Left: left pixels touch its right pixels */
+			if((Column > 0) && (Mask[Column] & 5) && (Mask[Column - 1] & 10))
+				Current = Label[Column - 1];
+
+			/* Top block row of the strip is joined with the strip above afterwards */
+			if(Row > Args->StartRow)
+				Current = link_upper_blocks(Parent, Mask - Blocks, Label - Blocks,
+				                            Column, Blocks, Mask[Column], Current);
+
+			if(Current == 0)
+			{
+				Current = Next++;
+				Parent[Current] = Current;
+			}
+
+			Label[Column] = Current;
+		}
+	}
+
+	Args->Used = Next - Args->Base;
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "components_work_t" type. Second pass: write final labels of pixels on block
+   rows [StartRow:EndRow[ and accumulate blob statistics of this thread */
+static void *label_pixels(void *ThreadArg)
+{
+	components_work_t *Args = (components_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int32_t		ImgHeight = Args->InputImage->Height;
+	int32_t		Blocks = (ImgWidth + 1) / 2;
+	uint32_t	*Labels = Args->Output->Labels;
+	uint32_t	*BlockLabel;
+	uint8_t		*BlockMask;
+	uint32_t	Final;
+	blob_t		*Blob;
+	int32_t		Row, Column;
+
+	for(uint32_t i = 0; i < Args->Output->Count; i++)
+	{
+		Args->Blobs[i].Area = 0;
+		Args->Blobs[i].Left = INT32_MAX;
+		Args->Blobs[i].Top = INT32_MAX;
+		Args->Blobs[i].Right = -1;
+		Args->Blobs[i].Bottom = -1;
+		Args->Blobs[i].SumX = 0;
+		Args->Blobs[i].SumY = 0;
+	}
+
+	for(int32_t BlockRow = Args->StartRow; BlockRow < Args->EndRow; BlockRow++)
+	{
+		BlockLabel = Args->BlockLabel + (size_t)BlockRow * Blocks;
+		BlockMask = Args->BlockMask + (size_t)BlockRow * Blocks;
+
+		for(int32_t BlockColumn = 0; BlockColumn < Blocks; BlockColumn++)
+		{
+			Final = (BlockLabel[BlockColumn] != 0) ? Args->Parent[BlockLabel[BlockColumn]] : 0;
+			Blob = (Final != 0) ? &Args->Blobs[Final - 1] : NULL;
+
+			for(int32_t Bit = 0; Bit < 4; Bit++)
+			{
+				Row = 2 * BlockRow + (Bit >> 1);
+				Column = 2 * BlockColumn + (Bit & 1);
+				if((Row >= ImgHeight) || (Column >= ImgWidth))
+					continue;
+
+				if((BlockMask[BlockColumn] >> Bit) & 1)
+				{
+					Labels[(size_t)Row * ImgWidth + Column] = Final;
+
+					Blob->Area++;
+					Blob->SumX += Column;
+					Blob->SumY += Row;
+					if(Column < Blob->Left)
+						Blob->Left = Column;
+					if(Column > Blob->Right)
+						Blob->Right = Column;
+					if(Row < Blob->Top)
+						Blob->Top = Row;
+					if(Row > Blob->Bottom)
+						Blob->Bottom = Row;
+				}
+				else
+				{
+					Labels[(size_t)Row * ImgWidth + Column] = 0;
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Allocate float map. Return NULL if fail */
+static float_map_t *new_float_map(int32_t Width, int32_t Height)
+{
+	float_map_t	*Map;
+
+	Map = (float_map_t *)malloc(sizeof(float_map_t));
+	if(Map == NULL)
+		return NULL;
+
+	Map->Width = Width;
+	Map->Height = Height;
+	Map->Data = (float *)malloc(sizeof(float) * (size_t)Width * Height);
+	if(Map->Data == NULL)
+	{
+		free(Map);
+		return NULL;
+	}
+
+	return Map;
+}
+/*******************************************************************************/
+/* Prepare zero mean template, its norm and summed-area tables of the image used by
+   every normalized cross correlation path. Return -1 if fail */
+static int prepare_ncc(img_t *Img, img_t *Template, ncc_work_t *Args, int32_t ThreadsNum)
+{
+	size_t	Area = (size_t)Template->Width * Template->Height;
+	double	Mean = 0.0;
+	double	Energy = 0.0;
+	float	*Tap;
+
+	Args->TemplateWidth = Template->Width;
+	Args->TemplateHeight = Template->Height;
+	Args->FFTSize = 0;
+	Args->SpectrumRe = NULL;
+	Args->SpectrumIm = NULL;
+	Args->Cos = NULL;
+	Args->Sin = NULL;
+	Args->Scratch = NULL;
+	Args->InputImage = Img;
+	Args->Output = NULL;
+
+	Args->Template = (float *)malloc(sizeof(float) * Area);
+	Args->Sum = integral_image(Img, INTEGRAL_UINT32, ThreadsNum);
+	Args->SqSum = integral_image_sq(Img, INTEGRAL_UINT64, ThreadsNum);
+
+	if((Args->Template == NULL) || (Args->Sum == NULL) || (Args->SqSum == NULL))
+	{
+		free(Args->Template);
+		free_integral(Args->Sum);
+		free_integral(Args->SqSum);
+		return -1;
+	}
+
+	for(int32_t Row = 0; Row < Template->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Template->Width; Column++)
+			Mean += Template->Pixel8[Row][Column];
+	}
+	Mean /= (double)Area;
+
+	Tap = Args->Template;
+	for(int32_t Row = 0; Row < Template->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Template->Width; Column++, Tap++)
+		{
+			*Tap = (float)(Template->Pixel8[Row][Column] - Mean);
+			Energy += (double)*Tap * *Tap;
+		}
+	}
+
+	Args->TemplateNorm = sqrt(Energy);
+
+	return 0;
+}
+/*******************************************************************************/
+/* Frees memory allocated by "prepare_ncc" */
+static void release_ncc(ncc_work_t *Args)
+{
+	free(Args->Template);
+	free_integral(Args->Sum);
+	free_integral(Args->SqSum);
+}
+/*******************************************************************************/
+/* Normalize correlation of zero mean template with the image window at given position.
+   Window spread is computed exactly on integers so flat windows score 0 */
+static float ncc_score(ncc_work_t *Args, int32_t Row, int32_t Column, double Numerator)
+{
+	int32_t		Bottom = Row + Args->TemplateHeight;
+	int32_t		Right = Column + Args->TemplateWidth;
+	uint64_t	Area = (uint64_t)Args->TemplateWidth * Args->TemplateHeight;
+	uint64_t	Sum = (uint64_t)integral_sum(Args->Sum, Row, Column, Bottom, Right);
+	uint64_t	SqSum = (uint64_t)integral_sum(Args->SqSum, Row, Column, Bottom, Right);
+	uint64_t	Spread = Area * SqSum - Sum * Sum;		/* Area^2 x window variance */
+	double		Score;
+
+	if(Spread == 0)
+		return 0.0f;
+
+	Score = Numerator * sqrt((double)Area / (double)Spread) / Args->TemplateNorm;
+
+	if(Score > 1.0)
+		return 1.0f;
+	if(Score < -1.0)
+		return -1.0f;
+
+	return (float)Score;
+}
+/*******************************************************************************/
+/* Normalized cross correlation at a single position (used on pyramid refinement) */
+static float ncc_at(ncc_work_t *Args, int32_t Row, int32_t Column)
+{
+	double	Numerator = 0.0;
+	float	RowSum;
+	float	*Taps;
+	uint8_t	*Pixel;
+
+	for(int32_t i = 0; i < Args->TemplateHeight; i++)
+	{
+		Taps = Args->Template + (size_t)i * Args->TemplateWidth;
+		Pixel = Args->InputImage->Pixel8[Row + i] + Column;
+
+		RowSum = 0.0f;
+		for(int32_t j = 0; j < Args->TemplateWidth; j++)
+			RowSum += Taps[j] * Pixel[j];
+
+		Numerator += RowSum;
+	}
+
+	return ncc_score(Args, Row, Column, Numerator);
+}
+/*******************************************************************************/
+/* Lanes of output columns accumulated together on direct correlation (4 SSE registers)
+   and columns processed together by FFT butterflies (fixed length loops are vectorized) */
+#define NCC_LANES	16
+
+/* Correlate one line with one template row: Acc[x] += sum(Taps[j] * Line[x + j]).
+   Each group of lanes stays on registers while all taps are applied.
+   "Length" must be multiple of NCC_LANES */
+static void ncc_correlate_row(float *restrict Acc, const float *restrict Line,
+                              const float *restrict Taps, int32_t TapsNum, int32_t Length)
+{
+#ifdef __SSE2__
+	__m128	Lane0, Lane1, Lane2, Lane3, Tap;
+
+	for(int32_t Column = 0; Column < Length; Column += NCC_LANES)
+	{
+		Lane0 = _mm_loadu_ps(Acc + Column);
+		Lane1 = _mm_loadu_ps(Acc + Column + 4);
+		Lane2 = _mm_loadu_ps(Acc + Column + 8);
+		Lane3 = _mm_loadu_ps(Acc + Column + 12);
+
+		for(int32_t j = 0; j < TapsNum; j++)
+		{
+			const float *Src = Line + Column + j;
+
+			Tap = _mm_set1_ps(Taps[j]);
+			Lane0 = _mm_add_ps(Lane0, _mm_mul_ps(Tap, _mm_loadu_ps(Src)));
+			Lane1 = _mm_add_ps(Lane1, _mm_mul_ps(Tap, _mm_loadu_ps(Src + 4)));
+			Lane2 = _mm_add_ps(Lane2, _mm_mul_ps(Tap, _mm_loadu_ps(Src + 8)));
+			Lane3 = _mm_add_ps(Lane3, _mm_mul_ps(Tap, _mm_loadu_ps(Src + 12)));
+		}
+
+		_mm_storeu_ps(Acc + Column, Lane0);
+		_mm_storeu_ps(Acc + Column + 4, Lane1);
+		_mm_storeu_ps(Acc + Column + 8, Lane2);
+		_mm_storeu_ps(Acc + Column + 12, Lane3);
+	}
+#else
+	float	Lanes[NCC_LANES];
+
+	for(int32_t Column = 0; Column < Length; Column += NCC_LANES)
+	{
+		for(int32_t k = 0; k < NCC_LANES; k++)
+			Lanes[k] = Acc[Column + k];
+
+		for(int32_t j = 0; j < TapsNum; j++)
+		{
+			const float *Src = Line + Column + j;
+			float Tap = Taps[j];
+
+			for(int32_t k = 0; k < NCC_LANES; k++)
+				Lanes[k] += Tap * Src[k];
+		}
+
+		for(int32_t k = 0; k < NCC_LANES; k++)
+			Acc[Column + k] = Lanes[k];
+	}
+#endif
+}
+/*******************************************************************************/
+/* Receive "ncc_work_t" type. Direct path: score map rows [Start:End[ */
+static void *ncc_direct(void *ThreadArg)
+{
+	ncc_work_t *Args = (ncc_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int32_t		OutWidth = Args->Output->Width;
+	int32_t		Length = (OutWidth + NCC_LANES - 1) / NCC_LANES * NCC_LANES;
+	float		Line[Length + Args->TemplateWidth];
+	float		Acc[Length];
+	uint8_t		*Pixel;
+	float		*Out;
+
+	for(int32_t Column = ImgWidth; Column < Length + Args->TemplateWidth; Column++)
+		Line[Column] = 0.0f;
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		for(int32_t Column = 0; Column < Length; Column++)
+			Acc[Column] = 0.0f;
+
+		for(int32_t i = 0; i < Args->TemplateHeight; i++)
+		{
+			Pixel = Args->InputImage->Pixel8[Row + i];
+			for(int32_t Column = 0; Column < ImgWidth; Column++)
+				Line[Column] = Pixel[Column];
+
+			ncc_correlate_row(Acc, Line, Args->Template + (size_t)i * Args->TemplateWidth,
+			                  Args->TemplateWidth, Length);
+		}
+
+		Out = Args->Output->Data + (size_t)Row * OutWidth;
+		for(int32_t Column = 0; Column < OutWidth; Column++)
+			Out[Column] = ncc_score(Args, Row, Column, Acc[Column]);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Radix-2 butterfly between two rows of complex values (one column per lane).
+   "Length" must be multiple of NCC_LANES */
+static void fft_butterfly(float *restrict ReA, float *restrict ImA, float *restrict ReB,
+                          float *restrict ImB, float Wr, float Wi, int32_t Length)
+{
+	float	Tr, Ti;
+
+	for(int32_t Column = 0; Column < Length; Column += NCC_LANES)
+	{
+		for(int32_t k = 0; k < NCC_LANES; k++)
+		{
+			Tr = ReB[Column + k] * Wr - ImB[Column + k] * Wi;
+			Ti = ReB[Column + k] * Wi + ImB[Column + k] * Wr;
+			ReB[Column + k] = ReA[Column + k] - Tr;
+			ImB[Column + k] = ImA[Column + k] - Ti;
+			ReA[Column + k] += Tr;
+			ImA[Column + k] += Ti;
+		}
+	}
+}
+/*******************************************************************************/
+/* In-place FFT of every column of a square complex array. Butterflies combine whole
+   rows so memory access stays contiguous. Sin holds sin(-2*pi*k/Size) */
+static void fft_columns(float *Re, float *Im, int32_t Size, const float *Cos, const float *Sin,
+                        int32_t Inverse)
+{
+	float	Swap;
+	float	Wi;
+
+	/* Bit reversal permutation of rows */
+	for(int32_t i = 1, j = 0; i < Size; i++)
+	{
+		int32_t Bit = Size >> 1;
+
+		for(; j & Bit; Bit >>= 1)
+			j ^= Bit;
+		j ^= Bit;
+
+		if(i < j)
+		{
+			for(int32_t Column = 0; Column < Size; Column++)
+			{
+				Swap = Re[(size_t)i * Size + Column];
+				Re[(size_t)i * Size + Column] = Re[(size_t)j * Size + Column];
+				Re[(size_t)j * Size + Column] = Swap;
+
+				Swap = Im[(size_t)i * Size + Column];
+				Im[(size_t)i * Size + Column] = Im[(size_t)j * Size + Column];
+				Im[(size_t)j * Size + Column] = Swap;
+			}
+		}
+	}
+
+	for(int32_t Span = 2; Span <= Size; Span <<= 1)
+	{
+		int32_t Half = Span / 2;
+		int32_t TwiddleStep = Size / Span;
+
+		for(int32_t Start = 0; Start < Size; Start += Span)
+		{
+			for(int32_t k = 0; k < Half; k++)
+			{
+				size_t A = (size_t)(Start + k) * Size;
+				size_t B = A + (size_t)Half * Size;
+
+				Wi = Inverse ? -Sin[k * TwiddleStep] : Sin[k * TwiddleStep];
+				fft_butterfly(Re + A, Im + A, Re + B, Im + B, Cos[k * TwiddleStep], Wi, Size);
+			}
+		}
+	}
+}
+/*******************************************************************************/
+/* In-place transpose of a square array */
+static void transpose_square(float *Data, int32_t Size)
+{
+	float	Swap;
+
+	for(int32_t Row = 0; Row < Size; Row++)
+	{
+		for(int32_t Column = Row + 1; Column < Size; Column++)
+		{
+			Swap = Data[(size_t)Row * Size + Column];
+			Data[(size_t)Row * Size + Column] = Data[(size_t)Column * Size + Row];
+			Data[(size_t)Column * Size + Row] = Swap;
+		}
+	}
+}
+/*******************************************************************************/
+/* 2D FFT of a square complex array as two column passes around a transpose. Forward
+   transform leaves the spectrum transposed and inverse transform of a transposed
+   spectrum gives back the original orientation (without 1/Size^2 scale) */
+static void fft_2d(float *Re, float *Im, int32_t Size, const float *Cos, const float *Sin,
+                   int32_t Inverse)
+{
+	fft_columns(Re, Im, Size, Cos, Sin, Inverse);
+	transpose_square(Re, Size);
+	transpose_square(Im, Size);
+	fft_columns(Re, Im, Size, Cos, Sin, Inverse);
+}
+/*******************************************************************************/
+/* Receive "ncc_work_t" type. FFT path: tiles [Start:End[ of the score map. Each tile
+   correlates a FFTSize^2 image block with the template and keeps the outputs without
+   wrap around. Two real tiles are packed on one complex transform */
+static void *ncc_fft(void *ThreadArg)
+{
+	ncc_work_t *Args = (ncc_work_t *)ThreadArg;
+
+	int32_t		Size = Args->FFTSize;
+	size_t		Points = (size_t)Size * Size;
+	int32_t		StepY = Size - Args->TemplateHeight + 1;
+	int32_t		StepX = Size - Args->TemplateWidth + 1;
+	int32_t		OutWidth = Args->Output->Width;
+	int32_t		OutHeight = Args->Output->Height;
+	int32_t		TilesX = (OutWidth + StepX - 1) / StepX;
+	float		*Re = Args->Scratch;
+	float		*Im = Args->Scratch + Points;
+	float		Scale = 1.0f / (float)Points;
+	float		*Part, Real, Imag;
+	int32_t		Tile, Top, Left, Row;
+
+	for(int32_t First = Args->Start; First < Args->End; First += 2)
+	{
+		for(int32_t i = 0; i < 2; i++)
+		{
+			Part = i ? Im : Re;
+			Tile = First + i;
+
+			if(Tile >= Args->End)
+			{
+				for(size_t k = 0; k < Points; k++)
+					Part[k] = 0.0f;
+				continue;
+			}
+
+			Top = (Tile / TilesX) * StepY;
+			Left = (Tile % TilesX) * StepX;
+
+			for(int32_t y = 0; y < Size; y++)
+			{
+				Row = Top + y;
+				for(int32_t x = 0; x < Size; x++)
+				{
+					if((Row < Args->InputImage->Height) && (Left + x < Args->InputImage->Width))
+						Part[(size_t)y * Size + x] = Args->InputImage->Pixel8[Row][Left + x];
+					else
+						Part[(size_t)y * Size + x] = 0.0f;
+				}
+			}
+		}
+
+		fft_2d(Re, Im, Size, Args->Cos, Args->Sin, 0);
+
+		for(size_t k = 0; k < Points; k++)
+		{
+			Real = Re[k] * Args->SpectrumRe[k] - Im[k] * Args->SpectrumIm[k];
+			Imag = Re[k] * Args->SpectrumIm[k] + Im[k] * Args->SpectrumRe[k];
+			Re[k] = Real;
+			Im[k] = Imag;
+		}
+
+		fft_2d(Re, Im, Size, Args->Cos, Args->Sin, 1);
+
+		for(int32_t i = 0; (i < 2) && (First + i < Args->End); i++)
+		{
+			Part = i ? Im : Re;
+			Tile = First + i;
+			Top = (Tile / TilesX) * StepY;
+			Left = (Tile % TilesX) * StepX;
+
+			for(int32_t y = 0; (y < StepY) && (Top + y < OutHeight); y++)
+			{
+				float *Out = Args->Output->Data + (size_t)(Top + y) * OutWidth;
+
+				for(int32_t x = 0; (x < StepX) && (Left + x < OutWidth); x++)
+					Out[Left + x] = ncc_score(Args, Top + y, Left + x, Part[(size_t)y * Size + x] * Scale);
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Fill score map from prepared arguments choosing direct or FFT path.
+   Return -1 if fail */
+static int compute_ncc(ncc_work_t *Setup, float_map_t *Output, int32_t ThreadsNum)
+{
+	ncc_work_t	ThreadArg[ThreadsNum];
+	pthread_t	ThreadId[ThreadsNum];
+	void		*(*Worker)(void *) = ncc_direct;
+	int32_t		Tasks = Output->Height;
+	int32_t		Side, Size = 1, ImgSize = 1;
+	size_t		Points = 0;
+	float		*Spectrum = NULL;
+	float		*Twiddle = NULL;
+	float		*Scratch = NULL;
+
+	Setup->Output = Output;
+	Setup->FFTSize = 0;
+
+	if(Setup->TemplateWidth * Setup->TemplateHeight >= NCC_FFT_AREA)
+	{
+		/* Tiles 4 times the template keep most outputs valid, but no larger than the image */
+		Side = (Setup->TemplateWidth > Setup->TemplateHeight) ? Setup->TemplateWidth : Setup->TemplateHeight;
+		while(Size < Side)
+			Size <<= 1;
+		Size *= 4;
+
+		Side = (Setup->InputImage->Width > Setup->InputImage->Height) ? Setup->InputImage->Width : Setup->InputImage->Height;
+		while(ImgSize < Side)
+			ImgSize <<= 1;
+
+		if(Size > ImgSize)
+			Size = ImgSize;
+		if(Size < 4 * NCC_LANES)
+			Size = 4 * NCC_LANES;
+
+		Points = (size_t)Size * Size;
+		Spectrum = (float *)malloc(sizeof(float) * 2 * Points);
+		Twiddle = (float *)malloc(sizeof(float) * Size);
+		Scratch = (float *)malloc(sizeof(float) * 2 * Points * ThreadsNum);
+
+		if((Spectrum == NULL) || (Twiddle == NULL) || (Scratch == NULL))
+		{
+			free(Spectrum);
+			free(Twiddle);
+			free(Scratch);
+			return -1;
+		}
+
+		Setup->FFTSize = Size;
+		Setup->Cos = Twiddle;
+		Setup->Sin = Twiddle + Size / 2;
+		Setup->SpectrumRe = Spectrum;
+		Setup->SpectrumIm = Spectrum + Points;
+
+		for(int32_t k = 0; k < Size / 2; k++)
+		{
+			Setup->Cos[k] = (float)cos(2.0 * M_PI * k / Size);
+			Setup->Sin[k] = (float)-sin(2.0 * M_PI * k / Size);
+		}
+
+		/* Conjugated spectrum of zero mean template placed on top left corner */
+		for(size_t k = 0; k < 2 * Points; k++)
+			Spectrum[k] = 0.0f;
+
+		for(int32_t Row = 0; Row < Setup->TemplateHeight; Row++)
+		{
+			for(int32_t Column = 0; Column < Setup->TemplateWidth; Column++)
+				Setup->SpectrumRe[(size_t)Row * Size + Column] = Setup->Template[(size_t)Row * Setup->TemplateWidth + Column];
+		}
+
+		fft_2d(Setup->SpectrumRe, Setup->SpectrumIm, Size, Setup->Cos, Setup->Sin, 0);
+
+		for(size_t k = 0; k < Points; k++)
+			Setup->SpectrumIm[k] = -Setup->SpectrumIm[k];
+
+		Tasks = ((Output->Width + Size - Setup->TemplateWidth) / (Size - Setup->TemplateWidth + 1)) *
+		        ((Output->Height + Size - Setup->TemplateHeight) / (Size - Setup->TemplateHeight + 1));
+		Worker = ncc_fft;
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i] = *Setup;
+		ThreadArg[i].Start = i * Tasks/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Tasks/ThreadsNum;
+		ThreadArg[i].Scratch = (Scratch != NULL) ? Scratch + 2 * Points * i : NULL;
+
+		pthread_create(&ThreadId[i], NULL, Worker, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	free(Spectrum);
+	free(Twiddle);
+	free(Scratch);
+
+	Setup->FFTSize = 0;
+	Setup->SpectrumRe = NULL;
+	Setup->SpectrumIm = NULL;
+	Setup->Cos = NULL;
+	Setup->Sin = NULL;
+
+	return 0;
+}
+/*******************************************************************************/
+/* Best matches first (ties broken by position so order is deterministic) */
+static int compare_matches(const void *A, const void *B)
+{
+	const match_t *MatchA = (const match_t *)A;
+	const match_t *MatchB = (const match_t *)B;
+
+	if(MatchA->Score != MatchB->Score)
+		return (MatchA->Score < MatchB->Score) ? 1 : -1;
+	if(MatchA->Row != MatchB->Row)
+		return (MatchA->Row > MatchB->Row) ? 1 : -1;
+
+	return (MatchA->Column > MatchB->Column) - (MatchA->Column < MatchB->Column);
+}
+/*******************************************************************************/
+/* Local maxima (3x3) of the score map not below "MinScore". Return array allocated
+   with "Count" entries or NULL if fail */
+static match_t *score_peaks(float_map_t *Map, float MinScore, int32_t *Count)
+{
+	match_t		*Peaks = NULL;
+	float		Value;
+	int32_t		Found = 0;
+	int32_t		IsPeak;
+
+	for(int32_t Pass = 0; Pass < 2; Pass++)
+	{
+		if(Pass == 1)
+		{
+			Peaks = (match_t *)malloc(sizeof(match_t) * (Found + 1));
+			if(Peaks == NULL)
+				return NULL;
+			*Count = Found;
+			Found = 0;
+		}
+
+		for(int32_t Row = 0; Row < Map->Height; Row++)
+		{
+			for(int32_t Column = 0; Column < Map->Width; Column++)
+			{
+				Value = Map->Data[(size_t)Row * Map->Width + Column];
+				if(Value < MinScore)
+					continue;
+
+				IsPeak = 1;
+				for(int32_t y = Row - 1; (y <= Row + 1) && IsPeak; y++)
+				{
+					for(int32_t x = Column - 1; x <= Column + 1; x++)
+					{
+						if((y < 0) || (x < 0) || (y >= Map->Height) || (x >= Map->Width))
+							continue;
+						if(Map->Data[(size_t)y * Map->Width + x] > Value)
+						{
+							IsPeak = 0;
+							break;
+						}
+					}
+				}
+
+				if(IsPeak == 0)
+					continue;
+
+				if(Pass == 1)
+				{
+					Peaks[Found].Row = Row;
+					Peaks[Found].Column = Column;
+					Peaks[Found].Score = Value;
+				}
+				Found++;
+			}
+		}
+	}
+
+	return Peaks;
+}
+/*******************************************************************************/
+/* Sort candidates and keep the best ones whose templates do not overlap.
+   "Matches" may be the candidate array itself. Return number of matches kept */
+static int32_t select_matches(match_t *Candidates, int32_t Count, int32_t Width, int32_t Height,
+                              match_t *Matches, int32_t MaxMatches)
+{
+	int32_t	Selected = 0;
+	int32_t	Overlap;
+
+	qsort(Candidates, Count, sizeof(match_t), compare_matches);
+
+	for(int32_t i = 0; (i < Count) && (Selected < MaxMatches); i++)
+	{
+		Overlap = 0;
+		for(int32_t j = 0; j < Selected; j++)
+		{
+			if((abs(Candidates[i].Row - Matches[j].Row) < Height) &&
+			   (abs(Candidates[i].Column - Matches[j].Column) < Width))
+			{
+				Overlap = 1;
+				break;
+			}
+		}
+
+		if(Overlap == 0)
+			Matches[Selected++] = Candidates[i];
+	}
+
+	return Selected;
+}
+/*******************************************************************************/
+/* Half size image by 2x2 averaging (last row and column are dropped if odd).
+   Return NULL if fail */
+static img_t *half_size(img_t *Img)
+{
+	img_t	*Half;
+	uint8_t	*Top, *Bottom;
+
+	Half = new_BMP(Img->Width / 2, Img->Height / 2, GRAY_8BITS);
+	if(Half == NULL)
+		return NULL;
+
+	for(int32_t Row = 0; Row < Half->Height; Row++)
+	{
+		Top = Img->Pixel8[2 * Row];
+		Bottom = Img->Pixel8[2 * Row + 1];
+
+		for(int32_t Column = 0; Column < Half->Width; Column++)
+		{
+			Half->Pixel8[Row][Column] = (uint8_t)((Top[2 * Column] + Top[2 * Column + 1] +
+			                                       Bottom[2 * Column] + Bottom[2 * Column + 1] + 2) >> 2);
+		}
+	}
+
+	return Half;
+}
+/*******************************************************************************/
+/* Return 1 if all pixels have the same value */
+static int flat_image(img_t *Img)
+{
+	uint8_t	First = Img->Pixel8[0][0];
+
+	for(int32_t Row = 0; Row < Img->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Img->Width; Column++)
+		{
+			if(Img->Pixel8[Row][Column] != First)
+				return 0;
+		}
+	}
+
+	return 1;
+}
+/*******************************************************************************/
+/* Template search on pyramid levels [0:Top]: full search on level "Top" and candidate
+   refinement (+-2 pixels around twice their position) on each finer level.
+   Return number of matches or -1 if fail */
+static int32_t pyramid_search(img_t **ImgLevel, img_t **TplLevel, int32_t Top, float MinScore,
+                              match_t *Matches, int32_t MaxMatches, int32_t ThreadsNum)
+{
+	ncc_work_t	Setup;
+	float_map_t	*Map;
+	match_t		*Candidates;
+	match_t		Best;
+	int32_t		Count, Kept;
+	int32_t		LastRow, LastColumn, Row, Column;
+	float		Score;
+
+	if(prepare_ncc(ImgLevel[Top], TplLevel[Top], &Setup, ThreadsNum) == -1)
+		return -1;
+
+	Map = new_float_map(ImgLevel[Top]->Width - TplLevel[Top]->Width + 1,
+	                    ImgLevel[Top]->Height - TplLevel[Top]->Height + 1);
+	if((Map == NULL) || (compute_ncc(&Setup, Map, ThreadsNum) == -1))
+	{
+		free_float_map(Map);
+		release_ncc(&Setup);
+		return -1;
+	}
+	release_ncc(&Setup);
+
+	Candidates = score_peaks(Map, (Top > 0) ? MinScore - (float)NCC_PYRAMID_SLACK : MinScore, &Count);
+	free_float_map(Map);
+	if(Candidates == NULL)
+		return -1;
+
+	Count = select_matches(Candidates, Count, TplLevel[Top]->Width, TplLevel[Top]->Height, Candidates,
+	                       (Top > 0) ? MaxMatches * NCC_PYRAMID_CANDIDATES : MaxMatches);
+
+	for(int32_t Level = Top - 1; Level >= 0; Level--)
+	{
+		if(prepare_ncc(ImgLevel[Level], TplLevel[Level], &Setup, ThreadsNum) == -1)
+		{
+			free(Candidates);
+			return -1;
+		}
+
+		LastRow = ImgLevel[Level]->Height - TplLevel[Level]->Height;
+		LastColumn = ImgLevel[Level]->Width - TplLevel[Level]->Width;
+
+		for(int32_t i = 0; i < Count; i++)
+		{
+			Best.Score = -2.0f;
+			Best.Row = 0;
+			Best.Column = 0;
+
+			for(int32_t y = -2; y <= 2; y++)
+			{
+				Row = 2 * Candidates[i].Row + y;
+				if((Row < 0) || (Row > LastRow))
+					continue;
+
+				for(int32_t x = -2; x <= 2; x++)
+				{
+					Column = 2 * Candidates[i].Column + x;
+					if((Column < 0) || (Column > LastColumn))
+						continue;
+
+					Score = ncc_at(&Setup, Row, Column);
+					if(Score > Best.Score)
+					{
+						Best.Score = Score;
+						Best.Row = Row;
+						Best.Column = Column;
+					}
+				}
+			}
+
+			Candidates[i] = Best;
+		}
+
+		release_ncc(&Setup);
+	}
+
+	/* Refined candidates may converge, select again with full resolution scores */
+	Kept = 0;
+	for(int32_t i = 0; i < Count; i++)
+	{
+		if(Candidates[i].Score >= MinScore)
+			Candidates[Kept++] = Candidates[i];
+	}
+
+	Count = select_matches(Candidates, Kept, TplLevel[0]->Width, TplLevel[0]->Height, Matches, MaxMatches);
+	free(Candidates);
+
+	return Count;
+}
+/*******************************************************************************/
+/* Vertical distances at or above this value mean the column has no zero pixel.
+   Values never overflow because images are smaller than 2^30 rows */
+#define DISTANCE_INF	(1u << 30)
+
+/* Receive "distance_work_t" type. Column pass over columns [Start:End[: distance to
+   the nearest zero pixel on the same column by a down and an up scan. Rows are
+   walked in order so the inner loop is contiguous */
+static void *distance_columns(void *ThreadArg)
+{
+	distance_work_t *Args = (distance_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int32_t		ImgHeight = Args->InputImage->Height;
+	uint32_t	*Cur, *Prev;
+	uint8_t		*Pixel;
+
+	for(int32_t Row = 0; Row < ImgHeight; Row++)
+	{
+		Cur = Args->Squared + (size_t)Row * ImgWidth;
+		Pixel = Args->InputImage->Pixel8[Row];
+
+		if(Row == 0)
+		{
+			for(int32_t Column = Args->Start; Column < Args->End; Column++)
+				Cur[Column] = (Pixel[Column] != 0) ? DISTANCE_INF : 0;
+			continue;
+		}
+
+		Prev = Cur - ImgWidth;
+		for(int32_t Column = Args->Start; Column < Args->End; Column++)
+			Cur[Column] = (Pixel[Column] != 0) ? Prev[Column] + 1 : 0;
+	}
+
+	for(int32_t Row = ImgHeight - 2; Row >= 0; Row--)
+	{
+		Cur = Args->Squared + (size_t)Row * ImgWidth;
+		Prev = Cur + ImgWidth;
+
+		for(int32_t Column = Args->Start; Column < Args->End; Column++)
+		{
+			if(Prev[Column] + 1 < Cur[Column])
+				Cur[Column] = Prev[Column] + 1;
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Ceil of A/B for B > 0 */
+static int64_t ceil_div(int64_t A, int64_t B)
+{
+	return (A >= 0) ? (A + B - 1) / B : -((-A) / B);
+}
+/*******************************************************************************/
+/* Receive "distance_work_t" type. Row pass over rows [Start:End[: squared distance is
+   the lower envelope of parabolas (x - q)^2 + f(q) with f(q) the squared vertical
+   distance. Parabola intersections are computed on integers so the result is exact */
+static void *distance_rows(void *ThreadArg)
+{
+	distance_work_t *Args = (distance_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int64_t		Height[ImgWidth];		/* f(q) of each parabola */
+	int32_t		Vertex[ImgWidth];		/* Envelope parabolas */
+	int64_t		Start[ImgWidth];		/* First column where each one is the lowest */
+	uint32_t	*Squared;
+	float		*Output;
+	int64_t		Column2, Distance;
+	int32_t		Last, j;
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		Squared = Args->Squared + (size_t)Row * ImgWidth;
+		Output = (Args->Output != NULL) ? Args->Output + (size_t)Row * ImgWidth : NULL;
+
+		Last = -1;
+		for(int32_t q = 0; q < ImgWidth; q++)
+		{
+			if(Squared[q] >= DISTANCE_INF)
+				continue;
+
+			Height[q] = (int64_t)Squared[q] * Squared[q];
+			Column2 = (int64_t)q * q;
+
+			while(Last >= 0)
+			{
+				int32_t v = Vertex[Last];
+				int64_t Cross = ceil_div(Height[q] + Column2 - Height[v] - (int64_t)v * v, 2 * (int64_t)(q - v));
+
+				if(Cross > Start[Last])
+				{
+					Vertex[++Last] = q;
+					Start[Last] = Cross;
+					break;
+				}
+				Last--;
+			}
+
+			if(Last < 0)
+			{
+				Last = 0;
+				Vertex[0] = q;
+				Start[0] = INT64_MIN;
+			}
+		}
+
+		j = 0;
+		for(int32_t x = 0; x < ImgWidth; x++)
+		{
+			if(Last < 0)
+			{
+				if(Output != NULL)
+					Output[x] = INFINITY;
+				else
+					Squared[x] = UINT32_MAX;
+				continue;
+			}
+
+			while((j < Last) && (Start[j + 1] <= x))
+				j++;
+
+			Distance = (int64_t)(x - Vertex[j]) * (x - Vertex[j]) + Height[Vertex[j]];
+
+			if(Output != NULL)
+				Output[x] = sqrtf((float)Distance);
+			else
+				Squared[x] = (uint32_t)Distance;
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Run column and row passes of distance transform. "Output" may be NULL */
+static void run_distance_transform(img_t *Img, uint32_t *Squared, float *Output, int32_t ThreadsNum)
+{
+	distance_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Img->Width/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Img->Width/ThreadsNum;
+		ThreadArg[i].Squared = Squared;
+		ThreadArg[i].Output = Output;
+		ThreadArg[i].InputImage = Img;
+
+		pthread_create(&ThreadId[i], NULL, distance_columns, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Img->Height/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Img->Height/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, distance_rows, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+}
+/*******************************************************************************/
+/* Fixed point of Hough sin/cos tables. Products with coordinates below 32768 and the
+   rho offset stay below 2^31 */
+#define HOUGH_FRACTION_BITS	14
+
+/* Edge points gathered before voting so that full theta voting walks one accumulator
+   row at a time */
+#define HOUGH_CHUNK			4096
+
+/* Vote gathered edge points */
+static void hough_vote_points(hough_work_t *Args, const int32_t *X, const int32_t *Y,
+                              const uint8_t *Bin, int32_t Count)
+{
+	int32_t		Offset = (Args->RhoMax << HOUGH_FRACTION_BITS) + (1 << (HOUGH_FRACTION_BITS - 1));
+	uint32_t	*Cells;
+	int32_t		Center, Theta;
+
+	if(Args->Orientation == NULL)
+	{
+		for(Theta = 0; Theta < Args->ThetaBins; Theta++)
+		{
+			int32_t Cos = Args->Cos[Theta];
+			int32_t Sin = Args->Sin[Theta];
+
+			Cells = Args->Accumulator + (size_t)Theta * Args->RhoBins;
+			for(int32_t i = 0; i < Count; i++)
+				Cells[(X[i] * Cos + Y[i] * Sin + Offset) >> HOUGH_FRACTION_BITS]++;
+		}
+		return;
+	}
+
+	for(int32_t i = 0; i < Count; i++)
+	{
+		/* Gradient direction is the line normal, so it maps directly to theta */
+		Center = ((Bin[i] % Args->Bins) * Args->ThetaBins + Args->Bins / 2) / Args->Bins;
+
+		for(int32_t Step = -Args->Band; Step <= Args->Band; Step++)
+		{
+			Theta = Center + Step;
+			if(Theta < 0)
+				Theta += Args->ThetaBins;
+			else if(Theta >= Args->ThetaBins)
+				Theta -= Args->ThetaBins;
+
+			Cells = Args->Accumulator + (size_t)Theta * Args->RhoBins;
+			Cells[(X[i] * Args->Cos[Theta] + Y[i] * Args->Sin[Theta] + Offset) >> HOUGH_FRACTION_BITS]++;
+		}
+	}
+}
+/*******************************************************************************/
+/* Receive "hough_work_t" type. Voting pass of edge image rows [Start:End[ on the
+   private accumulator of this thread */
+static void *hough_vote(void *ThreadArg)
+{
+	hough_work_t *Args = (hough_work_t *)ThreadArg;
+
+	size_t		Cells = (size_t)Args->ThetaBins * Args->RhoBins;
+	int32_t		X[HOUGH_CHUNK];
+	int32_t		Y[HOUGH_CHUNK];
+	uint8_t		Bin[HOUGH_CHUNK];
+	int32_t		Count = 0;
+	uint8_t		*Pixel;
+
+	for(size_t i = 0; i < Cells; i++)
+		Args->Accumulator[i] = 0;
+
+	for(int32_t Row = Args->Start; Row < Args->End; Row++)
+	{
+		Pixel = Args->InputImage->Pixel8[Row];
+
+		for(int32_t Column = 0; Column < Args->InputImage->Width; Column++)
+		{
+			if(Pixel[Column] <= Args->Threshold)
+				continue;
+
+			X[Count] = Column;
+			Y[Count] = Row;
+			Bin[Count] = (Args->Orientation != NULL) ? Args->Orientation->Pixel8[Row][Column] : 0;
+
+			if(++Count == HOUGH_CHUNK)
+			{
+				hough_vote_points(Args, X, Y, Bin, Count);
+				Count = 0;
+			}
+		}
+	}
+
+	hough_vote_points(Args, X, Y, Bin, Count);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "hough_work_t" type. Merge pass: add private accumulators on cells [Start:End[
+   into the first one */
+static void *hough_merge(void *ThreadArg)
+{
+	hough_work_t *Args = (hough_work_t *)ThreadArg;
+
+	size_t		Cells = (size_t)Args->ThetaBins * Args->RhoBins;
+	uint32_t	*Dst = Args->Partials;
+	uint32_t	*Src;
+
+	for(int32_t i = 1; i < Args->PartialsNum; i++)
+	{
+		Src = Args->Partials + i * Cells;
+		for(int32_t Cell = Args->Start; Cell < Args->End; Cell++)
+			Dst[Cell] += Src[Cell];
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Accumulator cell with theta wrapping around (theta + pi is the same line with
+   opposite rho). Out of range rho gives 0 */
+static uint32_t hough_cell(uint32_t *Accumulator, int32_t ThetaBins, int32_t RhoBins,
+                           int32_t Theta, int32_t Rho)
+{
+	if(Theta < 0)
+	{
+		Theta += ThetaBins;
+		Rho = RhoBins - 1 - Rho;
+	}
+	else if(Theta >= ThetaBins)
+	{
+		Theta -= ThetaBins;
+		Rho = RhoBins - 1 - Rho;
+	}
+
+	if((Rho < 0) || (Rho >= RhoBins))
+		return 0;
+
+	return Accumulator[(size_t)Theta * RhoBins + Rho];
+}
+/*******************************************************************************/
+/* Most voted lines first (ties broken by position so order is deterministic) */
+static int compare_lines(const void *A, const void *B)
+{
+	const hough_line_t *LineA = (const hough_line_t *)A;
+	const hough_line_t *LineB = (const hough_line_t *)B;
+
+	if(LineA->Votes != LineB->Votes)
+		return (LineA->Votes < LineB->Votes) ? 1 : -1;
+	if(LineA->Theta != LineB->Theta)
+		return (LineA->Theta > LineB->Theta) ? 1 : -1;
+
+	return (LineA->Rho > LineB->Rho) - (LineA->Rho < LineB->Rho);
+}
+/*******************************************************************************/
+/* Peaks of the accumulator: 3x3 local maxima not below "MinVotes", then the strongest
+   ones are kept if no kept line is within HOUGH_NMS_RADIUS cells. While selecting,
+   Theta holds the theta bin. Return number of lines or -1 if fail */
+static int32_t hough_peaks(uint32_t *Accumulator, int32_t ThetaBins, int32_t RhoBins, int32_t RhoMax,
+                           uint32_t MinVotes, hough_line_t *Lines, int32_t MaxLines)
+{
+	hough_line_t	*Peaks = NULL;
+	uint32_t		Value, Neighbour;
+	int32_t			Found = 0, Selected = 0;
+	int32_t			IsPeak, Near, DeltaTheta;
+	float			DeltaRho;
+
+	for(int32_t Pass = 0; Pass < 2; Pass++)
+	{
+		if(Pass == 1)
+		{
+			Peaks = (hough_line_t *)malloc(sizeof(hough_line_t) * (Found + 1));
+			if(Peaks == NULL)
+				return -1;
+			Found = 0;
+		}
+
+		for(int32_t Theta = 0; Theta < ThetaBins; Theta++)
+		{
+			for(int32_t Rho = 0; Rho < RhoBins; Rho++)
+			{
+				Value = Accumulator[(size_t)Theta * RhoBins + Rho];
+				if((Value < MinVotes) || (Value == 0))
+					continue;
+
+				/* Strictly above previous neighbours and not below next ones so
+				   plateaus give a single peak */
+				IsPeak = 1;
+				for(int32_t i = -1; (i <= 1) && IsPeak; i++)
+				{
+					for(int32_t j = -1; j <= 1; j++)
+					{
+						if((i == 0) && (j == 0))
+							continue;
+
+						Neighbour = hough_cell(Accumulator, ThetaBins, RhoBins, Theta + i, Rho + j);
+						if((Neighbour > Value) || ((Neighbour == Value) && ((i < 0) || ((i == 0) && (j < 0)))))
+						{
+							IsPeak = 0;
+							break;
+						}
+					}
+				}
+
+				if(IsPeak == 0)
+					continue;
+
+				if(Pass == 1)
+				{
+					Peaks[Found].Rho = (float)(Rho - RhoMax);
+					Peaks[Found].Theta = (float)Theta;
+					Peaks[Found].Votes = Value;
+				}
+				Found++;
+			}
+		}
+	}
+
+	qsort(Peaks, Found, sizeof(hough_line_t), compare_lines);
+
+	for(int32_t i = 0; (i < Found) && (Selected < MaxLines); i++)
+	{
+		Near = 0;
+		for(int32_t j = 0; (j < Selected) && (Near == 0); j++)
+		{
+			DeltaTheta = abs((int32_t)Peaks[i].Theta - (int32_t)Lines[j].Theta);
+			DeltaRho = fabsf(Peaks[i].Rho - Lines[j].Rho);
+
+			/* Across theta wrap around rho changes sign */
+			if(DeltaTheta > ThetaBins / 2)
+			{
+				DeltaTheta = ThetaBins - DeltaTheta;
+				DeltaRho = fabsf(Peaks[i].Rho + Lines[j].Rho);
+			}
+
+			Near = (DeltaTheta <= HOUGH_NMS_RADIUS) && (DeltaRho <= HOUGH_NMS_RADIUS);
+		}
+
+		if(Near == 0)
+			Lines[Selected++] = Peaks[i];
+	}
+
+	for(int32_t i = 0; i < Selected; i++)
+		Lines[i].Theta = (float)(Lines[i].Theta * M_PI / ThetaBins);
+
+	free(Peaks);
+
+	return Selected;
+}
+/*******************************************************************************/
+/* Offsets (column, row) of the 16 pixels on the FAST circle of radius 3, clockwise
+   from the top. Pixels 0, 4, 8 and 12 are the compass pixels */
+static const int8_t FastCircle[16][2] =
+{
+	{0, -3}, {1, -3}, {2, -2}, {3, -1}, {3, 0}, {3, 1}, {2, 2}, {1, 3},
+	{0, 3}, {-1, 3}, {-2, 2}, {-3, 1}, {-3, 0}, {-3, -1}, {-2, -2}, {-1, -3}
+};
+
+/* FAST score of one pixel: smallest absolute difference to the center on the best arc
+   of "Arc" contiguous circle pixels all brighter or all darker than the center (the
+   point stays a corner for thresholds below it). Return 0 if not a corner.
+   "Rows" points to the image rows [Row-3:Row+3] */
+static float fast_score(uint8_t **Rows, int32_t Column, int32_t Arc, uint8_t Threshold)
+{
+	int32_t		Center = Rows[3][Column];
+	int32_t		Diff[32];
+	uint32_t	Bright = 0, Dark = 0;
+	uint32_t	BrightRun, DarkRun;
+	int32_t		Best = 0, Low, High;
+
+	for(int32_t i = 0; i < 16; i++)
+	{
+		Diff[i] = Rows[3 + FastCircle[i][1]][Column + FastCircle[i][0]] - Center;
+		Diff[i + 16] = Diff[i];
+
+		if(Diff[i] > Threshold)
+			Bright |= 1u << i;
+		else if(Diff[i] < -Threshold)
+			Dark |= 1u << i;
+	}
+
+	/* Runs are searched on the mask repeated twice so they may wrap around */
+	BrightRun = Bright | (Bright << 16);
+	DarkRun = Dark | (Dark << 16);
+	for(int32_t k = 1; k < Arc; k++)
+	{
+		BrightRun &= (Bright | (Bright << 16)) >> k;
+		DarkRun &= (Dark | (Dark << 16)) >> k;
+	}
+
+	if(((BrightRun | DarkRun) & 0xFFFF) == 0)
+		return 0.0f;
+
+	for(int32_t Start = 0; Start < 16; Start++)
+	{
+		Low = 255;
+		High = -255;
+		for(int32_t k = 0; k < Arc; k++)
+		{
+			if(Diff[Start + k] < Low)
+				Low = Diff[Start + k];
+			if(Diff[Start + k] > High)
+				High = Diff[Start + k];
+		}
+
+		if(Low > Best)
+			Best = Low;
+		if(-High > Best)
+			Best = -High;
+	}
+
+	return (float)Best;
+}
+/*******************************************************************************/
+/* FAST response of one image row (0 where there is no corner). Any "Arc" contiguous
+   pixels cover at least Arc/4 compass pixels, so pixels failing that on both polarities
+   are rejected without the full test (16 pixels per SIMD compare) */
+static void fast_row(corner_work_t *Args, int32_t Row, float *Out)
+{
+	img_t	*Img = Args->InputImage;
+	int32_t	Need = Args->Arc / 4;
+	int32_t	Column = 3;
+	int32_t	Bright, Dark;
+	uint8_t	*Rows[7];
+
+	for(int32_t x = 0; x < Img->Width; x++)
+		Out[x] = 0.0f;
+
+	if((Row < 3) || (Row >= Img->Height - 3))
+		return;
+
+	for(int32_t i = 0; i < 7; i++)
+		Rows[i] = Img->Pixel8[Row - 3 + i];
+
+#ifdef __SSE2__
+	__m128i	Ones = _mm_set1_epi8((char)0xFF);
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Limit = _mm_set1_epi8((char)(1 - Need));
+	__m128i	Thr = _mm_set1_epi8((char)Args->Threshold);
+	__m128i	Center, High, Low, Pixel, BrightSum, DarkSum;
+	int32_t	Mask;
+
+	for(; Column + 16 <= Img->Width - 3; Column += 16)
+	{
+		Center = _mm_loadu_si128((__m128i *)(Rows[3] + Column));
+		High = _mm_adds_epu8(Center, Thr);
+		Low = _mm_subs_epu8(Center, Thr);
+		BrightSum = Zero;
+		DarkSum = Zero;
+
+		for(int32_t i = 0; i < 16; i += 4)
+		{
+			Pixel = _mm_loadu_si128((__m128i *)(Rows[3 + FastCircle[i][1]] + Column + FastCircle[i][0]));
+
+			/* Each bright or dark compass pixel adds -1 */
+			BrightSum = _mm_add_epi8(BrightSum, _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(Pixel, High), Zero), Ones));
+			DarkSum = _mm_add_epi8(DarkSum, _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(Low, Pixel), Zero), Ones));
+		}
+
+		Mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(BrightSum, Limit), _mm_cmplt_epi8(DarkSum, Limit)));
+
+		while(Mask != 0)
+		{
+			int32_t Lane = __builtin_ctz(Mask);
+
+			Out[Column + Lane] = fast_score(Rows, Column + Lane, Args->Arc, Args->Threshold);
+			Mask &= Mask - 1;
+		}
+	}
+#endif
+
+	for(; Column < Img->Width - 3; Column++)
+	{
+		Bright = 0;
+		Dark = 0;
+		for(int32_t i = 0; i < 16; i += 4)
+		{
+			int32_t Pixel = Rows[3 + FastCircle[i][1]][Column + FastCircle[i][0]];
+
+			Bright += (Pixel > Rows[3][Column] + Args->Threshold);
+			Dark += (Pixel < Rows[3][Column] - Args->Threshold);
+		}
+
+		if((Bright >= Need) || (Dark >= Need))
+			Out[Column] = fast_score(Rows, Column, Args->Arc, Args->Threshold);
+	}
+}
+/*******************************************************************************/
+/* Harris products of one image row: Gx^2, Gy^2 and Gx*Gy of Sobel derivatives scaled
+   to gray levels per pixel. Rows out of the image give zero products */
+static void harris_products(corner_work_t *Args, int32_t Row, uint8_t *Lines, int16_t *Gx, int16_t *Gy,
+                            float *Xx, float *Yy, float *Xy)
+{
+	img_t	*Img = Args->InputImage;
+	int32_t	Stride = Img->Width + 2;
+	float	Dx, Dy;
+
+	if((Row < 0) || (Row >= Img->Height))
+	{
+		for(int32_t Column = 0; Column < Img->Width; Column++)
+		{
+			Xx[Column] = 0.0f;
+			Yy[Column] = 0.0f;
+			Xy[Column] = 0.0f;
+		}
+		return;
+	}
+
+	for(int32_t i = 0; i < 3; i++)
+		fill_padded_line(Lines + i * Stride + 1, Img, Row - 1 + i, 0);
+
+	gradient_row(Lines + 1, Lines + Stride + 1, Lines + 2 * Stride + 1, Img->Width, GRADIENT_SOBEL, Gx, Gy);
+
+	for(int32_t Column = 0; Column < Img->Width; Column++)
+	{
+		Dx = Gx[Column] * 0.125f;
+		Dy = Gy[Column] * 0.125f;
+		Xx[Column] = Dx * Dx;
+		Yy[Column] = Dy * Dy;
+		Xy[Column] = Dx * Dy;
+	}
+}
+/*******************************************************************************/
+/* Harris or Shi-Tomasi response of one image row. Rows must be requested in increasing
+   order: product rows [Row-Radius:Row+Radius] are kept on a ring and each new one is
+   computed once. "Next" is the next product row not computed yet */
+static void harris_row(corner_work_t *Args, int32_t Row, int32_t *Next, float *Out)
+{
+	img_t	*Img = Args->InputImage;
+	int32_t	Width = Img->Width;
+	int32_t	Radius = Args->Radius;
+	int32_t	Taps = 2 * Radius + 1;
+	float	*Ring = Args->Scratch + 3 * (size_t)Width;
+	float	*Sum = Ring + 3 * (size_t)Taps * Width;
+	int16_t	*Gx = (int16_t *)(Sum + 3 * (size_t)(Width + 2 * Radius));
+	int16_t	*Gy = Gx + Width;
+	uint8_t	*Lines = (uint8_t *)(Gy + Width);
+	float	*SumXx = Sum + Radius;
+	float	*SumYy = SumXx + Width + 2 * Radius;
+	float	*SumXy = SumYy + Width + 2 * Radius;
+	float	*Slot;
+	float	A, B, C, Weight;
+
+	if(*Next < Row - Radius)
+		*Next = Row - Radius;
+
+	for(; *Next <= Row + Radius; (*Next)++)
+	{
+		Slot = Ring + 3 * (size_t)Width * (((*Next % Taps) + Taps) % Taps);
+		harris_products(Args, *Next, Lines, Gx, Gy, Slot, Slot + Width, Slot + 2 * Width);
+	}
+
+	/* Vertical window (sums are zero padded by Radius on both sides) */
+	for(int32_t Column = -Radius; Column < Width + Radius; Column++)
+	{
+		SumXx[Column] = 0.0f;
+		SumYy[Column] = 0.0f;
+		SumXy[Column] = 0.0f;
+	}
+
+	for(int32_t k = 0; k < Taps; k++)
+	{
+		int32_t ProductRow = Row - Radius + k;
+
+		Slot = Ring + 3 * (size_t)Width * (((ProductRow % Taps) + Taps) % Taps);
+		Weight = Args->Weights[k];
+
+		for(int32_t Column = 0; Column < Width; Column++)
+		{
+			SumXx[Column] += Weight * Slot[Column];
+			SumYy[Column] += Weight * Slot[Width + Column];
+			SumXy[Column] += Weight * Slot[2 * Width + Column];
+		}
+	}
+
+	/* Horizontal window and response */
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		A = 0.0f;
+		B = 0.0f;
+		C = 0.0f;
+		for(int32_t k = 0; k < Taps; k++)
+		{
+			A += Args->Weights[k] * SumXx[Column - Radius + k];
+			C += Args->Weights[k] * SumYy[Column - Radius + k];
+			B += Args->Weights[k] * SumXy[Column - Radius + k];
+		}
+
+		if(Args->Detector == CORNER_HARRIS)
+			Out[Column] = A * C - B * B - Args->K * (A + C) * (A + C);
+		else
+			Out[Column] = 0.5f * (A + C) - sqrtf(0.25f * (A - C) * (A - C) + B * B);
+	}
+}
+/*******************************************************************************/
+/* Receive "corner_work_t" type. Response rows are produced once in order and three of
+   them are kept for 3x3 non maximum suppression. Local maxima update the grid cell */
+static void *corner_detect(void *ThreadArg)
+{
+	corner_work_t *Args = (corner_work_t *)ThreadArg;
+
+	img_t		*Img = Args->InputImage;
+	int32_t		Width = Img->Width;
+	int32_t		CellsX = (Width + Args->GridSize - 1) / Args->GridSize;
+	int32_t		FirstRow = Args->StartRow * Args->GridSize;
+	int32_t		LastRow = Args->EndRow * Args->GridSize;
+	float		*Prev = Args->Scratch;
+	float		*Cur = Prev + Width;
+	float		*Next = Cur + Width;
+	float		*Swap;
+	int32_t		NextProduct = INT32_MIN;
+	keypoint_t	*Cell;
+	float		Value;
+	int32_t		IsPeak;
+
+	if(LastRow > Img->Height)
+		LastRow = Img->Height;
+
+	if(FirstRow < Args->Margin)
+		FirstRow = Args->Margin;
+	if(LastRow > Img->Height - Args->Margin)
+		LastRow = Img->Height - Args->Margin;
+
+	if(FirstRow >= LastRow)
+		return NULL;
+
+	for(int32_t Row = FirstRow - 1; Row <= FirstRow; Row++)
+	{
+		if(Args->Detector == CORNER_FAST)
+			fast_row(Args, Row, (Row < FirstRow) ? Prev : Cur);
+		else
+			harris_row(Args, Row, &NextProduct, (Row < FirstRow) ? Prev : Cur);
+	}
+
+	for(int32_t Row = FirstRow; Row < LastRow; Row++)
+	{
+		if(Args->Detector == CORNER_FAST)
+			fast_row(Args, Row + 1, Next);
+		else
+			harris_row(Args, Row + 1, &NextProduct, Next);
+
+		for(int32_t Column = Args->Margin; Column < Width - Args->Margin; Column++)
+		{
+			Value = Cur[Column];
+			if((Value < Args->MinScore) || (Value <= 0.0f))
+				continue;
+
+			/* Strictly above previous neighbours and not below next ones */
+			IsPeak = (Value > Prev[Column - 1]) && (Value > Prev[Column]) && (Value > Prev[Column + 1]) &&
+			         (Value > Cur[Column - 1]) && (Value >= Cur[Column + 1]) &&
+			         (Value >= Next[Column - 1]) && (Value >= Next[Column]) && (Value >= Next[Column + 1]);
+
+			if(IsPeak == 0)
+				continue;
+
+			Cell = &Args->Cells[(size_t)(Row / Args->GridSize) * CellsX + Column / Args->GridSize];
+			if(Value > Cell->Score)
+			{
+				Cell->X = Column;
+				Cell->Y = Row;
+				Cell->Score = Value;
+			}
+		}
+
+		Swap = Prev;
+		Prev = Cur;
+		Cur = Next;
+		Next = Swap;
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Strongest keypoints first (ties broken by position so order is deterministic) */
+static int compare_keypoints(const void *A, const void *B)
+{
+	const keypoint_t *PointA = (const keypoint_t *)A;
+	const keypoint_t *PointB = (const keypoint_t *)B;
+
+	if(PointA->Score != PointB->Score)
+		return (PointA->Score < PointB->Score) ? 1 : -1;
+	if(PointA->Y != PointB->Y)
+		return (PointA->Y > PointB->Y) ? 1 : -1;
+
+	return (PointA->X > PointB->X) - (PointA->X < PointB->X);
+}
+/*******************************************************************************/
+/* Run corner detection on grid cell rows split among threads and keep the strongest
+   cell winners. "Setup" holds the detector parameters and "ScratchSize" the floats
+   needed by each thread. Return number of corners or -1 if fail */
+static int32_t run_corner_detect(corner_work_t *Setup, size_t ScratchSize, keypoint_t *Points,
+                                 int32_t MaxPoints, int32_t ThreadsNum)
+{
+	corner_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_t			*Img = Setup->InputImage;
+	int32_t			CellsX = (Img->Width + Setup->GridSize - 1) / Setup->GridSize;
+	int32_t			CellsY = (Img->Height + Setup->GridSize - 1) / Setup->GridSize;
+	size_t			CellsNum = (size_t)CellsX * CellsY;
+	keypoint_t		*Cells;
+	float			*Scratch;
+	int32_t			Found = 0;
+
+	Cells = (keypoint_t *)malloc(sizeof(keypoint_t) * CellsNum);
+	Scratch = (float *)malloc(sizeof(float) * ScratchSize * ThreadsNum);
+
+	if((Cells == NULL) || (Scratch == NULL))
+	{
+		free(Cells);
+		free(Scratch);
+		return -1;
+	}
+
+	for(size_t i = 0; i < CellsNum; i++)
+		Cells[i].Score = -FLT_MAX;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i] = *Setup;
+		ThreadArg[i].StartRow = i * CellsY/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * CellsY/ThreadsNum;
+		ThreadArg[i].Scratch = Scratch + ScratchSize * i;
+		ThreadArg[i].Cells = Cells;
+
+		pthread_create(&ThreadId[i], NULL, corner_detect, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	for(size_t i = 0; i < CellsNum; i++)
+	{
+		if(Cells[i].Score != -FLT_MAX)
+			Cells[Found++] = Cells[i];
+	}
+
+	qsort(Cells, Found, sizeof(keypoint_t), compare_keypoints);
+
+	if(Found > MaxPoints)
+		Found = MaxPoints;
+
+	for(int32_t i = 0; i < Found; i++)
+		Points[i] = Cells[i];
+
+	free(Cells);
+	free(Scratch);
+
+	return Found;
+}
+/*******************************************************************************/
+#define STATS_CHUNK_BLOCKS	16384	/* 48 bytes blocks before 32 bits lanes may overflow */
+
+#ifdef __SSE2__
+/* Accumulate one 16 bytes vector. Bytes [0:4[, [4:8[, [8:12[ and [12:16[ are added to
+   the sums "A", "B", "C" and "A" again so each sum lane always gets the same channel */
+static inline void stats_vector(__m128i Value, __m128i *Min, __m128i *Max, __m128i *SumA, __m128i *SumB,
+                                __m128i *SumC, __m128i *SqA, __m128i *SqB, __m128i *SqC)
+{
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Low = _mm_unpacklo_epi8(Value, Zero);
+	__m128i	High = _mm_unpackhi_epi8(Value, Zero);
+	__m128i	LowSq = _mm_mullo_epi16(Low, Low);
+	__m128i	HighSq = _mm_mullo_epi16(High, High);
+
+	*Min = _mm_min_epu8(*Min, Value);
+	*Max = _mm_max_epu8(*Max, Value);
+
+	*SumA = _mm_add_epi32(*SumA, _mm_add_epi32(_mm_unpacklo_epi16(Low, Zero), _mm_unpackhi_epi16(High, Zero)));
+	*SumB = _mm_add_epi32(*SumB, _mm_unpackhi_epi16(Low, Zero));
+	*SumC = _mm_add_epi32(*SumC, _mm_unpacklo_epi16(High, Zero));
+
+	*SqA = _mm_add_epi32(*SqA, _mm_add_epi32(_mm_unpacklo_epi16(LowSq, Zero), _mm_unpackhi_epi16(HighSq, Zero)));
+	*SqB = _mm_add_epi32(*SqB, _mm_unpackhi_epi16(LowSq, Zero));
+	*SqC = _mm_add_epi32(*SqC, _mm_unpacklo_epi16(HighSq, Zero));
+}
+#endif
+
+/* Minimum and maximum per channel of one row of "Bytes" bytes and add its sums to "Sum"
+   and "SumSq". Rows are read as 48 bytes blocks (16 RGB pixels) so channel of each
+   SIMD lane is fixed */
+static void stats_row(const uint8_t *Data, int32_t Bytes, int32_t Channels, uint8_t *Min, uint8_t *Max,
+                      uint64_t *Sum, uint64_t *SumSq)
+{
+	/* Channel of byte position modulo 3 (BGR order in memory) */
+	static const int32_t ByteChannel[2][3] =
+	{
+		{0, 0, 0},
+		{PASS_BLUE_CHANNEL, PASS_GREEN_CHANNEL, PASS_RED_CHANNEL}
+	};
+	const int32_t	*Channel = ByteChannel[Channels == 3];
+	int32_t			Position = 0;
+
+	for(int32_t c = 0; c < Channels; c++)
+	{
+		Min[c] = 255;
+		Max[c] = 0;
+	}
+
+#ifdef __SSE2__
+	uint8_t		MinLanes[48], MaxLanes[48];
+	uint32_t	SumLanes[12], SqLanes[12];
+	int32_t		Blocks;
+
+	while(Position + 48 <= Bytes)
+	{
+		__m128i	Min0 = _mm_set1_epi8((char)0xFF), Min1 = Min0, Min2 = Min0;
+		__m128i	Max0 = _mm_setzero_si128(), Max1 = Max0, Max2 = Max0;
+		__m128i	Sum0 = Max0, Sum1 = Max0, Sum2 = Max0;
+		__m128i	Sq0 = Max0, Sq1 = Max0, Sq2 = Max0;
+
+		Blocks = (Bytes - Position) / 48;
+		if(Blocks > STATS_CHUNK_BLOCKS)
+			Blocks = STATS_CHUNK_BLOCKS;
+
+		/* Sum "k" holds bytes whose position is k + lane modulo 3 */
+		for(int32_t b = 0; b < Blocks; b++, Position += 48)
+		{
+			stats_vector(_mm_loadu_si128((__m128i *)(Data + Position)), &Min0, &Max0,
+			             &Sum0, &Sum1, &Sum2, &Sq0, &Sq1, &Sq2);
+			stats_vector(_mm_loadu_si128((__m128i *)(Data + Position + 16)), &Min1, &Max1,
+			             &Sum1, &Sum2, &Sum0, &Sq1, &Sq2, &Sq0);
+			stats_vector(_mm_loadu_si128((__m128i *)(Data + Position + 32)), &Min2, &Max2,
+			             &Sum2, &Sum0, &Sum1, &Sq2, &Sq0, &Sq1);
+		}
+
+		_mm_storeu_si128((__m128i *)MinLanes, Min0);
+		_mm_storeu_si128((__m128i *)(MinLanes + 16), Min1);
+		_mm_storeu_si128((__m128i *)(MinLanes + 32), Min2);
+		_mm_storeu_si128((__m128i *)MaxLanes, Max0);
+		_mm_storeu_si128((__m128i *)(MaxLanes + 16), Max1);
+		_mm_storeu_si128((__m128i *)(MaxLanes + 32), Max2);
+		_mm_storeu_si128((__m128i *)SumLanes, Sum0);
+		_mm_storeu_si128((__m128i *)(SumLanes + 4), Sum1);
+		_mm_storeu_si128((__m128i *)(SumLanes + 8), Sum2);
+		_mm_storeu_si128((__m128i *)SqLanes, Sq0);
+		_mm_storeu_si128((__m128i *)(SqLanes + 4), Sq1);
+		_mm_storeu_si128((__m128i *)(SqLanes + 8), Sq2);
+
+		for(int32_t i = 0; i < 48; i++)
+		{
+			if(MinLanes[i] < Min[Channel[i % 3]])
+				Min[Channel[i % 3]] = MinLanes[i];
+			if(MaxLanes[i] > Max[Channel[i % 3]])
+				Max[Channel[i % 3]] = MaxLanes[i];
+		}
+
+		for(int32_t k = 0; k < 3; k++)
+		{
+			for(int32_t Lane = 0; Lane < 4; Lane++)
+			{
+				Sum[Channel[(k + Lane) % 3]] += SumLanes[4 * k + Lane];
+				SumSq[Channel[(k + Lane) % 3]] += SqLanes[4 * k + Lane];
+			}
+		}
+	}
+#endif
+
+	for(; Position < Bytes; Position++)
+	{
+		int32_t c = Channel[Position % 3];
+
+		if(Data[Position] < Min[c])
+			Min[c] = Data[Position];
+		if(Data[Position] > Max[c])
+			Max[c] = Data[Position];
+
+		Sum[c] += Data[Position];
+		SumSq[c] += (uint32_t)Data[Position] * Data[Position];
+	}
+}
+/*******************************************************************************/
+/* Return first column of row whose channel "c" has "Value" (or -1) */
+static int32_t stats_find(const uint8_t *Data, int32_t Width, int32_t Channels, int32_t c, uint8_t Value)
+{
+	/* Red is the last byte of a pixel in memory */
+	int32_t Offset = (Channels == 3) ? PASS_BLUE_CHANNEL - c : 0;
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		if(Data[Column * Channels + Offset] == Value)
+			return Column;
+	}
+
+	return -1;
+}
+/*******************************************************************************/
+/* Receive "stats_work_t" type. Positions are only searched on rows that improve the
+   minimum or maximum of this thread, so the row scan is repeated rarely */
+static void *stats_worker(void *ThreadArg)
+{
+	stats_work_t *Args = (stats_work_t *)ThreadArg;
+
+	img_t		*Img = Args->InputImage;
+	img_stats_t	*Partial = &Args->Partial;
+	int32_t		Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	uint8_t		RowMin[3], RowMax[3];
+	uint8_t		*Data;
+
+	for(int32_t c = 0; c < 3; c++)
+	{
+		Partial->Min[c] = 255;
+		Partial->Max[c] = 0;
+		Partial->Sum[c] = 0;
+		Partial->MinX[c] = -1;
+		Partial->MinY[c] = -1;
+		Partial->MaxX[c] = -1;
+		Partial->MaxY[c] = -1;
+		Args->SumSq[c] = 0;
+	}
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Data = (Channels == 1) ? Img->Pixel8[Row] : (uint8_t *)Img->Pixel24[Row];
+
+		stats_row(Data, Img->Width * Channels, Channels, RowMin, RowMax, Partial->Sum, Args->SumSq);
+
+		for(int32_t c = 0; c < Channels; c++)
+		{
+			if((RowMin[c] < Partial->Min[c]) || (Row == Args->StartRow))
+			{
+				Partial->Min[c] = RowMin[c];
+				if(Args->Locate != 0)
+				{
+					Partial->MinX[c] = stats_find(Data, Img->Width, Channels, c, RowMin[c]);
+					Partial->MinY[c] = Row;
+				}
+			}
+
+			if((RowMax[c] > Partial->Max[c]) || (Row == Args->StartRow))
+			{
+				Partial->Max[c] = RowMax[c];
+				if(Args->Locate != 0)
+				{
+					Partial->MaxX[c] = stats_find(Data, Img->Width, Channels, c, RowMax[c]);
+					Partial->MaxY[c] = Row;
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+#ifdef __SSE2__
+/* Turn 32 BGR pixels (96 bytes on V0 to V5) into planes: V0, V1 --> Blue, V2, V3 -->
+   Green and V4, V5 --> Red. Five rounds of byte interleaving between vectors k and
+   k+3 take every byte to its plane position */
+static inline void deinterleave_bgr(__m128i *V0, __m128i *V1, __m128i *V2, __m128i *V3, __m128i *V4, __m128i *V5)
+{
+	__m128i	T0, T1, T2, T3, T4, T5;
+
+	for(int32_t Round = 0; Round < 5; Round++)
+	{
+		T0 = _mm_unpacklo_epi8(*V0, *V3);
+		T1 = _mm_unpackhi_epi8(*V0, *V3);
+		T2 = _mm_unpacklo_epi8(*V1, *V4);
+		T3 = _mm_unpackhi_epi8(*V1, *V4);
+		T4 = _mm_unpacklo_epi8(*V2, *V5);
+		T5 = _mm_unpackhi_epi8(*V2, *V5);
+
+		*V0 = T0;
+		*V1 = T1;
+		*V2 = T2;
+		*V3 = T3;
+		*V4 = T4;
+		*V5 = T5;
+	}
+}
+
+/* Inverse of "deinterleave_bgr": planes back to 32 BGR pixels. Each round splits even
+   and odd bytes of vector pairs (mask or shift and saturated pack) */
+static inline void interleave_bgr(__m128i *V0, __m128i *V1, __m128i *V2, __m128i *V3, __m128i *V4, __m128i *V5)
+{
+	__m128i	Mask = _mm_set1_epi16(0x00FF);
+	__m128i	T0, T1, T2, T3, T4, T5;
+
+	for(int32_t Round = 0; Round < 5; Round++)
+	{
+		T0 = _mm_packus_epi16(_mm_and_si128(*V0, Mask), _mm_and_si128(*V1, Mask));
+		T3 = _mm_packus_epi16(_mm_srli_epi16(*V0, 8), _mm_srli_epi16(*V1, 8));
+		T1 = _mm_packus_epi16(_mm_and_si128(*V2, Mask), _mm_and_si128(*V3, Mask));
+		T4 = _mm_packus_epi16(_mm_srli_epi16(*V2, 8), _mm_srli_epi16(*V3, 8));
+		T2 = _mm_packus_epi16(_mm_and_si128(*V4, Mask), _mm_and_si128(*V5, Mask));
+		T5 = _mm_packus_epi16(_mm_srli_epi16(*V4, 8), _mm_srli_epi16(*V5, 8));
+
+		*V0 = T0;
+		*V1 = T1;
+		*V2 = T2;
+		*V3 = T3;
+		*V4 = T4;
+		*V5 = T5;
+	}
+}
+#endif
+/*******************************************************************************/
+/* Red, Green and Blue weights of a gray conversion method in 15 bits fixed point
+   (weights add to exactly 1). Return -1 if method is invalid */
+static int gray_weights(int Method, uint16_t *Weights)
+{
+	int32_t RedWeight, BlueWeight;
+
+	switch(Method)
+	{
+		case GRAY_AVERAGE :
+			RedWeight = 3333;
+			BlueWeight = 3333;
+			break;
+
+		case GRAY_LUMI_PERCEP :
+			RedWeight = 2126;
+			BlueWeight = 722;
+			break;
+
+		case GRAY_APROX_GAM_LUMI_PERCEP :
+			RedWeight = 2990;
+			BlueWeight = 1140;
+			break;
+
+		default :
+			return -1;
+	}
+
+	Weights[0] = (RedWeight * 32768 + 5000) / 10000;
+	Weights[2] = (BlueWeight * 32768 + 5000) / 10000;
+	Weights[1] = 32768 - Weights[0] - Weights[2];
+
+	return 0;
+}
+/*******************************************************************************/
+#ifdef __SSE2__
+/* Gray level of 8 pixels. Channels hold values shifted left by 8 bits on 16 bits lanes,
+   so a high multiply by 15 bits weights gives products with 7 fractional bits */
+static inline __m128i gray_lanes(__m128i Blue, __m128i Green, __m128i Red, __m128i BlueWeight,
+                                 __m128i GreenWeight, __m128i RedWeight)
+{
+	__m128i	Sum;
+
+	Sum = _mm_add_epi16(_mm_mulhi_epu16(Red, RedWeight), _mm_mulhi_epu16(Green, GreenWeight));
+	Sum = _mm_add_epi16(Sum, _mm_mulhi_epu16(Blue, BlueWeight));
+
+	return _mm_srli_epi16(_mm_add_epi16(Sum, _mm_set1_epi16(64)), 7);
+}
+#endif
+
+/* Convert one row of "Width" pixels to gray. SIMD and scalar paths do the same
+   integer arithmetic so results do not depend on the path */
+static void gray_row(const pixel24_t *Input, uint8_t *Output, int32_t Width, const uint16_t *Weights)
+{
+	const uint8_t	*Data = (const uint8_t *)Input;
+	int32_t			Column = 0;
+	uint32_t		Sum;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	RedWeight = _mm_set1_epi16((short)Weights[0]);
+	__m128i	GreenWeight = _mm_set1_epi16((short)Weights[1]);
+	__m128i	BlueWeight = _mm_set1_epi16((short)Weights[2]);
+	__m128i	V0, V1, V2, V3, V4, V5;
+	__m128i	Low, High;
+
+	for(; Column + 32 <= Width; Column += 32)
+	{
+		V0 = _mm_loadu_si128((__m128i *)(Data + 3 * Column));
+		V1 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 16));
+		V2 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 32));
+		V3 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 48));
+		V4 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 64));
+		V5 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 80));
+
+		deinterleave_bgr(&V0, &V1, &V2, &V3, &V4, &V5);
+
+		Low = gray_lanes(_mm_unpacklo_epi8(Zero, V0), _mm_unpacklo_epi8(Zero, V2), _mm_unpacklo_epi8(Zero, V4),
+		                 BlueWeight, GreenWeight, RedWeight);
+		High = gray_lanes(_mm_unpackhi_epi8(Zero, V0), _mm_unpackhi_epi8(Zero, V2), _mm_unpackhi_epi8(Zero, V4),
+		                  BlueWeight, GreenWeight, RedWeight);
+		_mm_storeu_si128((__m128i *)(Output + Column), _mm_packus_epi16(Low, High));
+
+		Low = gray_lanes(_mm_unpacklo_epi8(Zero, V1), _mm_unpacklo_epi8(Zero, V3), _mm_unpacklo_epi8(Zero, V5),
+		                 BlueWeight, GreenWeight, RedWeight);
+		High = gray_lanes(_mm_unpackhi_epi8(Zero, V1), _mm_unpackhi_epi8(Zero, V3), _mm_unpackhi_epi8(Zero, V5),
+		                  BlueWeight, GreenWeight, RedWeight);
+		_mm_storeu_si128((__m128i *)(Output + Column + 16), _mm_packus_epi16(Low, High));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		Sum = (((uint32_t)Input[Column].Red << 8) * Weights[0]) >> 16;
+		Sum += (((uint32_t)Input[Column].Green << 8) * Weights[1]) >> 16;
+		Sum += (((uint32_t)Input[Column].Blue << 8) * Weights[2]) >> 16;
+
+		Output[Column] = (uint8_t)((Sum + 64) >> 7);
+	}
+}
+/*******************************************************************************/
+/* Receive "gray_work_t" type */
+static void *gray_convert(void *ThreadArg)
+{
+	gray_work_t *Args = (gray_work_t *)ThreadArg;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		gray_row(Args->InputImage->Pixel24[Row], Args->OutputImage->Pixel8[Row],
+		         Args->InputImage->Width, Args->Weights);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Copy each channel of one row of "Width" color pixels to its plane (NULL --> skipped).
+   Pixels are deinterleaved 32 at a time with SIMD */
+static void split_row(const pixel24_t *Color, uint8_t *Red, uint8_t *Green, uint8_t *Blue, int32_t Width)
+{
+	int32_t	Column = 0;
+
+#ifdef __SSE2__
+	const uint8_t	*Data = (const uint8_t *)Color;
+	uint8_t			Unused[32];
+	__m128i			V0, V1, V2, V3, V4, V5;
+
+	for(; Column + 32 <= Width; Column += 32)
+	{
+		V0 = _mm_loadu_si128((__m128i *)(Data + 3 * Column));
+		V1 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 16));
+		V2 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 32));
+		V3 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 48));
+		V4 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 64));
+		V5 = _mm_loadu_si128((__m128i *)(Data + 3 * Column + 80));
+
+		deinterleave_bgr(&V0, &V1, &V2, &V3, &V4, &V5);
+
+		/* Skipped planes are written to a scratch buffer */
+		_mm_storeu_si128((__m128i *)((Blue != NULL) ? Blue + Column : Unused), V0);
+		_mm_storeu_si128((__m128i *)((Blue != NULL) ? Blue + Column + 16 : Unused + 16), V1);
+		_mm_storeu_si128((__m128i *)((Green != NULL) ? Green + Column : Unused), V2);
+		_mm_storeu_si128((__m128i *)((Green != NULL) ? Green + Column + 16 : Unused + 16), V3);
+		_mm_storeu_si128((__m128i *)((Red != NULL) ? Red + Column : Unused), V4);
+		_mm_storeu_si128((__m128i *)((Red != NULL) ? Red + Column + 16 : Unused + 16), V5);
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		if(Red != NULL)
+			Red[Column] = Color[Column].Red;
+		if(Green != NULL)
+			Green[Column] = Color[Column].Green;
+		if(Blue != NULL)
+			Blue[Column] = Color[Column].Blue;
+	}
+}
+/*******************************************************************************/
+/* Interleave one row of "Width" pixels of three planes on the color row. Pixels are
+   interleaved 32 at a time with SIMD */
+static void merge_row(const uint8_t *Red, const uint8_t *Green, const uint8_t *Blue, pixel24_t *Color, int32_t Width)
+{
+	int32_t	Column = 0;
+
+#ifdef __SSE2__
+	uint8_t	*Data = (uint8_t *)Color;
+	__m128i	V0, V1, V2, V3, V4, V5;
+
+	for(; Column + 32 <= Width; Column += 32)
+	{
+		V0 = _mm_loadu_si128((__m128i *)(Blue + Column));
+		V1 = _mm_loadu_si128((__m128i *)(Blue + Column + 16));
+		V2 = _mm_loadu_si128((__m128i *)(Green + Column));
+		V3 = _mm_loadu_si128((__m128i *)(Green + Column + 16));
+		V4 = _mm_loadu_si128((__m128i *)(Red + Column));
+		V5 = _mm_loadu_si128((__m128i *)(Red + Column + 16));
+
+		interleave_bgr(&V0, &V1, &V2, &V3, &V4, &V5);
+
+		_mm_storeu_si128((__m128i *)(Data + 3 * Column), V0);
+		_mm_storeu_si128((__m128i *)(Data + 3 * Column + 16), V1);
+		_mm_storeu_si128((__m128i *)(Data + 3 * Column + 32), V2);
+		_mm_storeu_si128((__m128i *)(Data + 3 * Column + 48), V3);
+		_mm_storeu_si128((__m128i *)(Data + 3 * Column + 64), V4);
+		_mm_storeu_si128((__m128i *)(Data + 3 * Column + 80), V5);
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		Color[Column].Red = Red[Column];
+		Color[Column].Green = Green[Column];
+		Color[Column].Blue = Blue[Column];
+	}
+}
+/*******************************************************************************/
+/* Receive "channels_work_t" type and copies each channel of the color image to its plane */
+static void *channels_split(void *ThreadArg)
+{
+	channels_work_t *Args = (channels_work_t *)ThreadArg;
+
+	uint8_t	*Plane[3];
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		for(int32_t c = 0; c < 3; c++)
+			Plane[c] = (Args->Planes[c] != NULL) ? Args->Planes[c]->Pixel8[Row] : NULL;
+
+		split_row(Args->ColorImage->Pixel24[Row], Plane[PASS_RED_CHANNEL], Plane[PASS_GREEN_CHANNEL],
+		          Plane[PASS_BLUE_CHANNEL], Args->ColorImage->Width);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "channels_work_t" type and interleaves the three planes on the color image */
+static void *channels_merge(void *ThreadArg)
+{
+	channels_work_t *Args = (channels_work_t *)ThreadArg;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		merge_row(Args->Planes[PASS_RED_CHANNEL]->Pixel8[Row], Args->Planes[PASS_GREEN_CHANNEL]->Pixel8[Row],
+		          Args->Planes[PASS_BLUE_CHANNEL]->Pixel8[Row], Args->ColorImage->Pixel24[Row],
+		          Args->ColorImage->Width);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Convert one row with a fixed point (14 bits) 3x3 matrix: Out[k] = Matrix[k] * In + Offset[k].
+   16 pixels are converted at a time with SIMD multiply-add of pixel pairs */
+static void color_linear_row(const uint8_t **In, uint8_t **Out, int32_t Width, const int16_t *Matrix,
+                             const int32_t *Offset)
+{
+	int32_t	Column = 0;
+	int32_t	Value;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	PairAB[3], PairC[3], Add[3];
+	__m128i	A, B, C, Low, High;
+	__m128i	AB0, AB1, AB2, AB3, C0, C1, C2, C3;
+	__m128i	R0, R1, R2, R3;
+
+	for(int32_t k = 0; k < 3; k++)
+	{
+		PairAB[k] = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)Matrix[3 * k + 1] << 16) | (uint16_t)Matrix[3 * k]));
+		PairC[k] = _mm_set1_epi32((uint16_t)Matrix[3 * k + 2]);
+		Add[k] = _mm_set1_epi32(Offset[k]);
+	}
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		A = _mm_loadu_si128((__m128i *)(In[0] + Column));
+		B = _mm_loadu_si128((__m128i *)(In[1] + Column));
+		C = _mm_loadu_si128((__m128i *)(In[2] + Column));
+
+		/* (A, B) pairs and (C, 0) pairs on 32 bits lanes */
+		Low = _mm_unpacklo_epi8(A, Zero);
+		High = _mm_unpacklo_epi8(B, Zero);
+		AB0 = _mm_unpacklo_epi16(Low, High);
+		AB1 = _mm_unpackhi_epi16(Low, High);
+		Low = _mm_unpackhi_epi8(A, Zero);
+		High = _mm_unpackhi_epi8(B, Zero);
+		AB2 = _mm_unpacklo_epi16(Low, High);
+		AB3 = _mm_unpackhi_epi16(Low, High);
+
+		Low = _mm_unpacklo_epi8(C, Zero);
+		High = _mm_unpackhi_epi8(C, Zero);
+		C0 = _mm_unpacklo_epi16(Low, Zero);
+		C1 = _mm_unpackhi_epi16(Low, Zero);
+		C2 = _mm_unpacklo_epi16(High, Zero);
+		C3 = _mm_unpackhi_epi16(High, Zero);
+
+		for(int32_t k = 0; k < 3; k++)
+		{
+			R0 = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(AB0, PairAB[k]), _mm_madd_epi16(C0, PairC[k])), Add[k]);
+			R1 = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(AB1, PairAB[k]), _mm_madd_epi16(C1, PairC[k])), Add[k]);
+			R2 = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(AB2, PairAB[k]), _mm_madd_epi16(C2, PairC[k])), Add[k]);
+			R3 = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(AB3, PairAB[k]), _mm_madd_epi16(C3, PairC[k])), Add[k]);
+
+			Low = _mm_packs_epi32(_mm_srai_epi32(R0, 14), _mm_srai_epi32(R1, 14));
+			High = _mm_packs_epi32(_mm_srai_epi32(R2, 14), _mm_srai_epi32(R3, 14));
+			_mm_storeu_si128((__m128i *)(Out[k] + Column), _mm_packus_epi16(Low, High));
+		}
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		for(int32_t k = 0; k < 3; k++)
+		{
+			Value = (In[0][Column] * Matrix[3 * k] + In[1][Column] * Matrix[3 * k + 1] +
+			         In[2][Column] * Matrix[3 * k + 2] + Offset[k]) >> 14;
+			Out[k][Column] = (uint8_t)((Value < 0) ? 0 : ((Value > 255) ? 255 : Value));
+		}
+	}
+}
+/*******************************************************************************/
+/* Fixed point matrix of RGB to YCbCr (or inverse) conversion from luma weights of red
+   and blue. Rows that must add to exactly 1 or 0 are adjusted on the middle weight */
+static void ycbcr_matrix(double Kr, double Kb, int Inverse, color_work_t *Setup)
+{
+	double	Kg = 1.0 - Kr - Kb;
+	double	Weights[9];
+	int16_t	*Matrix = Setup->Matrix;
+
+	if(Inverse == 0)
+	{
+		Weights[0] = Kr;
+		Weights[1] = Kg;
+		Weights[2] = Kb;
+		Weights[3] = -Kr / (2.0 * (1.0 - Kb));
+		Weights[4] = -Kg / (2.0 * (1.0 - Kb));
+		Weights[5] = 0.5;
+		Weights[6] = 0.5;
+		Weights[7] = -Kg / (2.0 * (1.0 - Kr));
+		Weights[8] = -Kb / (2.0 * (1.0 - Kr));
+	}
+	else
+	{
+		Weights[0] = 1.0;
+		Weights[1] = 0.0;
+		Weights[2] = 2.0 * (1.0 - Kr);
+		Weights[3] = 1.0;
+		Weights[4] = -2.0 * Kb * (1.0 - Kb) / Kg;
+		Weights[5] = -2.0 * Kr * (1.0 - Kr) / Kg;
+		Weights[6] = 1.0;
+		Weights[7] = 2.0 * (1.0 - Kb);
+		Weights[8] = 0.0;
+	}
+
+	for(int32_t i = 0; i < 9; i++)
+		Matrix[i] = (int16_t)lround(Weights[i] * 16384.0);
+
+	if(Inverse == 0)
+	{
+		/* Gray pixels give Y equal to the gray level and Cb = Cr = 128 */
+		Matrix[1] = 16384 - Matrix[0] - Matrix[2];
+		Matrix[4] = -Matrix[3] - Matrix[5];
+		Matrix[7] = -Matrix[6] - Matrix[8];
+
+		Setup->Offset[0] = 8192;
+		Setup->Offset[1] = 128 * 16384 + 8192;
+		Setup->Offset[2] = 128 * 16384 + 8192;
+	}
+	else
+	{
+		/* Chroma is centered at 128 */
+		for(int32_t k = 0; k < 3; k++)
+			Setup->Offset[k] = -128 * (Matrix[3 * k + 1] + Matrix[3 * k + 2]) + 8192;
+	}
+}
+/*******************************************************************************/
+#ifdef __SSE2__
+/* floor((Num * Scale + Half / 2) / Den) on 8 non-negative 16 bits lanes (Den > 0). Operands
+   stay below 2^24 and quotients of distinct integers differ by more than float rounding,
+   so the single precision division floors exactly */
+static inline __m128i hsv_quotient(__m128i Num, __m128i Half, __m128i Den, __m128 Scale)
+{
+	__m128i	Zero = _mm_setzero_si128();
+	__m128	Point5 = _mm_set1_ps(0.5f);
+	__m128	Low, High;
+
+	Low = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Num, Zero)), Scale),
+	                 _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Half, Zero)), Point5));
+	High = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Num, Zero)), Scale),
+	                  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Half, Zero)), Point5));
+	Low = _mm_div_ps(Low, _mm_cvtepi32_ps(_mm_unpacklo_epi16(Den, Zero)));
+	High = _mm_div_ps(High, _mm_cvtepi32_ps(_mm_unpackhi_epi16(Den, Zero)));
+
+	return _mm_packs_epi32(_mm_cvttps_epi32(Low), _mm_cvttps_epi32(High));
+}
+/*******************************************************************************/
+/* RGB to HSV of 8 pixels on 16 bits lanes, same results as the scalar code */
+static inline void hsv_pixels(__m128i Red, __m128i Green, __m128i Blue, __m128i *Out)
+{
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	One = _mm_set1_epi16(1);
+	__m128i	Max, Min, Delta, IsRed, IsGreen, Hue;
+
+	Max = _mm_max_epi16(_mm_max_epi16(Red, Green), Blue);
+	Min = _mm_min_epi16(_mm_min_epi16(Red, Green), Blue);
+	Delta = _mm_sub_epi16(Max, Min);
+
+	IsRed = _mm_cmpeq_epi16(Max, Red);
+	IsGreen = _mm_andnot_si128(IsRed, _mm_cmpeq_epi16(Max, Green));
+
+	Hue = _mm_or_si128(_mm_and_si128(IsRed, _mm_add_epi16(_mm_sub_epi16(Green, Blue), Delta)),
+	                   _mm_and_si128(IsGreen, _mm_add_epi16(_mm_sub_epi16(Blue, Red), _mm_mullo_epi16(Delta, _mm_set1_epi16(3)))));
+	Hue = _mm_or_si128(Hue, _mm_andnot_si128(_mm_or_si128(IsRed, IsGreen),
+	                                         _mm_add_epi16(_mm_sub_epi16(Red, Green), _mm_mullo_epi16(Delta, _mm_set1_epi16(5)))));
+
+	Hue = _mm_sub_epi16(hsv_quotient(Hue, Delta, _mm_max_epi16(Delta, One), _mm_set1_ps(30.0f)), _mm_set1_epi16(30));
+	Hue = _mm_add_epi16(Hue, _mm_and_si128(_mm_cmplt_epi16(Hue, Zero), _mm_set1_epi16(180)));
+
+	Out[0] = _mm_andnot_si128(_mm_cmpeq_epi16(Delta, Zero), Hue);
+	Out[1] = hsv_quotient(Delta, Max, _mm_max_epi16(Max, One), _mm_set1_ps(255.0f));
+	Out[2] = Max;
+}
+/*******************************************************************************/
+/* floor((Value * Fraction + 3824) / 7650) on 8 lanes: 32 bits products are divided by a
+   multiply with 2^35 / 7650 rounded up, exact for every product of HSV inverse */
+static inline __m128i hsv_divide_7650(__m128i Value, __m128i Fraction)
+{
+	__m128i	Magic = _mm_set1_epi32(4491470);
+	__m128i	Round = _mm_set1_epi32(3824);
+	__m128i	Low, High, ProductLow, ProductHigh;
+
+	Low = _mm_mullo_epi16(Value, Fraction);
+	High = _mm_mulhi_epu16(Value, Fraction);
+	ProductLow = _mm_add_epi32(_mm_unpacklo_epi16(Low, High), Round);
+	ProductHigh = _mm_add_epi32(_mm_unpackhi_epi16(Low, High), Round);
+
+	ProductLow = _mm_or_si128(_mm_srli_epi64(_mm_mul_epu32(ProductLow, Magic), 35),
+	                          _mm_slli_epi64(_mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(ProductLow, 32), Magic), 35), 32));
+	ProductHigh = _mm_or_si128(_mm_srli_epi64(_mm_mul_epu32(ProductHigh, Magic), 35),
+	                           _mm_slli_epi64(_mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(ProductHigh, 32), Magic), 35), 32));
+
+	return _mm_packs_epi32(ProductLow, ProductHigh);
+}
+/*******************************************************************************/
+/* HSV to RGB of 8 pixels on 16 bits lanes, same results as the scalar code. Divisions
+   by 30 and 255 are 16 bits fixed point multiplies */
+static inline void hsv_inverse_pixels(__m128i Hue, __m128i Saturation, __m128i Value, __m128i *Out)
+{
+	__m128i	Sector, Fraction, Product, P, Q, T;
+	__m128i	Mask[6];
+
+	Hue = _mm_sub_epi16(Hue, _mm_and_si128(_mm_cmpgt_epi16(Hue, _mm_set1_epi16(179)), _mm_set1_epi16(180)));
+	Sector = _mm_mulhi_epu16(Hue, _mm_set1_epi16(2185));
+	Fraction = _mm_sub_epi16(Hue, _mm_mullo_epi16(Sector, _mm_set1_epi16(30)));
+
+	P = _mm_mullo_epi16(Value, _mm_sub_epi16(_mm_set1_epi16(255), Saturation));
+	P = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(P, _mm_set1_epi16(127)), _mm_set1_epi16((int16_t)0x8081)), 7);
+
+	Product = _mm_mullo_epi16(Value, Saturation);
+	Q = _mm_sub_epi16(Value, hsv_divide_7650(Product, Fraction));
+	T = _mm_sub_epi16(Value, hsv_divide_7650(Product, _mm_sub_epi16(_mm_set1_epi16(30), Fraction)));
+
+	for(int32_t k = 0; k < 6; k++)
+		Mask[k] = _mm_cmpeq_epi16(Sector, _mm_set1_epi16(k));
+
+	/* Sectors 0 to 5: (V,T,P) (Q,V,P) (P,V,T) (P,Q,V) (T,P,V) (V,P,Q) */
+	Out[0] = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_or_si128(Mask[0], Mask[5]), Value),
+	                                   _mm_and_si128(Mask[1], Q)),
+	                      _mm_or_si128(_mm_and_si128(_mm_or_si128(Mask[2], Mask[3]), P),
+	                                   _mm_and_si128(Mask[4], T)));
+	Out[1] = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_or_si128(Mask[1], Mask[2]), Value),
+	                                   _mm_and_si128(Mask[3], Q)),
+	                      _mm_or_si128(_mm_and_si128(_mm_or_si128(Mask[4], Mask[5]), P),
+	                                   _mm_and_si128(Mask[0], T)));
+	Out[2] = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_or_si128(Mask[3], Mask[4]), Value),
+	                                   _mm_and_si128(Mask[5], Q)),
+	                      _mm_or_si128(_mm_and_si128(_mm_or_si128(Mask[0], Mask[1]), P),
+	                                   _mm_and_si128(Mask[2], T)));
+}
+#endif
+/*******************************************************************************/
+/* Convert one row from RGB to HSV with rounded divisions: H = 30 * h / Delta in sectors
+   of 60 degrees and S = 255 * Delta / Max. 16 pixels are converted at a time with SIMD */
+static void color_hsv_row(const uint8_t **In, uint8_t **Out, int32_t Width)
+{
+	int32_t	Column = 0;
+	int32_t	Red, Green, Blue;
+	int32_t	Max, Min, Delta, Hue;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Rgb[3], Low[3], High[3];
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		for(int32_t k = 0; k < 3; k++)
+			Rgb[k] = _mm_loadu_si128((__m128i *)(In[k] + Column));
+
+		hsv_pixels(_mm_unpacklo_epi8(Rgb[0], Zero), _mm_unpacklo_epi8(Rgb[1], Zero), _mm_unpacklo_epi8(Rgb[2], Zero), Low);
+		hsv_pixels(_mm_unpackhi_epi8(Rgb[0], Zero), _mm_unpackhi_epi8(Rgb[1], Zero), _mm_unpackhi_epi8(Rgb[2], Zero), High);
+
+		for(int32_t k = 0; k < 3; k++)
+			_mm_storeu_si128((__m128i *)(Out[k] + Column), _mm_packus_epi16(Low[k], High[k]));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		Red = In[0][Column];
+		Green = In[1][Column];
+		Blue = In[2][Column];
+
+		Max = (Red > Green) ? Red : Green;
+		Max = (Blue > Max) ? Blue : Max;
+		Min = (Red < Green) ? Red : Green;
+		Min = (Blue < Min) ? Blue : Min;
+		Delta = Max - Min;
+
+		/* Hue sectors of 60 degrees (30 units) around red, green and blue, shifted by one
+		   sector so rounding only sees positive values */
+		if(Max == Red)
+			Hue = Green - Blue + Delta;
+		else if(Max == Green)
+			Hue = Blue - Red + 3 * Delta;
+		else
+			Hue = Red - Green + 5 * Delta;
+
+		Hue = (Delta == 0) ? 0 : (60 * Hue + Delta) / (2 * Delta) - 30;
+		if(Hue < 0)
+			Hue += 180;
+
+		Out[0][Column] = (uint8_t)Hue;
+		Out[1][Column] = (uint8_t)((Max == 0) ? 0 : (510 * Delta + Max) / (2 * Max));
+		Out[2][Column] = (uint8_t)Max;
+	}
+}
+/*******************************************************************************/
+/* Convert one row from HSV to RGB with rounded integer arithmetic. 16 pixels are
+   converted at a time with SIMD */
+static void color_hsv_inverse_row(const uint8_t **In, uint8_t **Out, int32_t Width)
+{
+	int32_t	Column = 0;
+	int32_t	Hue, Saturation, Value, Fraction;
+	int32_t	P, Q, T;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Hsv[3], Low[3], High[3];
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		for(int32_t k = 0; k < 3; k++)
+			Hsv[k] = _mm_loadu_si128((__m128i *)(In[k] + Column));
+
+		hsv_inverse_pixels(_mm_unpacklo_epi8(Hsv[0], Zero), _mm_unpacklo_epi8(Hsv[1], Zero), _mm_unpacklo_epi8(Hsv[2], Zero), Low);
+		hsv_inverse_pixels(_mm_unpackhi_epi8(Hsv[0], Zero), _mm_unpackhi_epi8(Hsv[1], Zero), _mm_unpackhi_epi8(Hsv[2], Zero), High);
+
+		for(int32_t k = 0; k < 3; k++)
+			_mm_storeu_si128((__m128i *)(Out[k] + Column), _mm_packus_epi16(Low[k], High[k]));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		Hue = In[0][Column] % 180;
+		Saturation = In[1][Column];
+		Value = In[2][Column];
+		Fraction = Hue % 30;
+
+		P = (Value * (255 - Saturation) + 127) / 255;
+		Q = (Value * (7650 - Saturation * Fraction) + 3825) / 7650;
+		T = (Value * (7650 - Saturation * (30 - Fraction)) + 3825) / 7650;
+
+		switch(Hue / 30)
+		{
+			case 0 :
+				Out[0][Column] = Value; Out[1][Column] = T; Out[2][Column] = P;
+				break;
+			case 1 :
+				Out[0][Column] = Q; Out[1][Column] = Value; Out[2][Column] = P;
+				break;
+			case 2 :
+				Out[0][Column] = P; Out[1][Column] = Value; Out[2][Column] = T;
+				break;
+			case 3 :
+				Out[0][Column] = P; Out[1][Column] = Q; Out[2][Column] = Value;
+				break;
+			case 4 :
+				Out[0][Column] = T; Out[1][Column] = P; Out[2][Column] = Value;
+				break;
+			default :
+				Out[0][Column] = Value; Out[1][Column] = P; Out[2][Column] = Q;
+				break;
+		}
+	}
+}
+/*******************************************************************************/
+#define LAB_CBRT_SIZE	1024	/* Intervals of f(t) table on [0:1] */
+#define LAB_GAMMA_SIZE	16384	/* Intervals of linear to sRGB table on [0:1] */
+
+/* Lab f(t) from the table with linear interpolation (t clipped to [0:1]) */
+static inline float lab_cube_root(float Value, const float *CubeRoot)
+{
+	float	Position = Value * LAB_CBRT_SIZE;
+	int32_t	Index;
+
+	if(Position <= 0.0f)
+		return CubeRoot[0];
+	if(Position >= LAB_CBRT_SIZE)
+		return CubeRoot[LAB_CBRT_SIZE];
+
+	Index = (int32_t)Position;
+
+	return CubeRoot[Index] + (Position - Index) * (CubeRoot[Index + 1] - CubeRoot[Index]);
+}
+
+/* Inverse of Lab f(t) */
+static inline float lab_inverse_f(float Value)
+{
+	if(Value > 6.0f / 29.0f)
+		return Value * Value * Value;
+
+	return (Value - 16.0f / 116.0f) * 0.128418f;
+}
+
+/* Saturated rounding of a float to 8 bits */
+static inline uint8_t color_clip(float Value)
+{
+	Value += 0.5f;
+
+	return (uint8_t)((Value <= 0.0f) ? 0 : ((Value >= 255.0f) ? 255 : Value));
+}
+/*******************************************************************************/
+/* Convert one row from RGB to Lab. sRGB linearization and f(t) come from tables,
+   XYZ is normalized by the D65 white */
+static void color_lab_row(const uint8_t **In, uint8_t **Out, int32_t Width, const float *Linear,
+                          const float *CubeRoot)
+{
+	float	Red, Green, Blue;
+	float	FX, FY, FZ;
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		Red = Linear[In[0][Column]];
+		Green = Linear[In[1][Column]];
+		Blue = Linear[In[2][Column]];
+
+		FX = lab_cube_root((0.412453f * Red + 0.357580f * Green + 0.180423f * Blue) / 0.950456f, CubeRoot);
+		FY = lab_cube_root(0.212671f * Red + 0.715160f * Green + 0.072169f * Blue, CubeRoot);
+		FZ = lab_cube_root((0.019334f * Red + 0.119193f * Green + 0.950227f * Blue) / 1.088754f, CubeRoot);
+
+		Out[0][Column] = color_clip((116.0f * FY - 16.0f) * 2.55f);
+		Out[1][Column] = color_clip(500.0f * (FX - FY) + 128.0f);
+		Out[2][Column] = color_clip(200.0f * (FY - FZ) + 128.0f);
+	}
+}
+/*******************************************************************************/
+/* Convert one row from Lab to RGB. sRGB gamma comes from a table */
+static void color_lab_inverse_row(const uint8_t **In, uint8_t **Out, int32_t Width, const uint8_t *Gamma)
+{
+	float	FX, FY, FZ, X, Y, Z;
+	float	Linear[3];
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		FY = (In[0][Column] / 2.55f + 16.0f) / 116.0f;
+		FX = FY + (In[1][Column] - 128) / 500.0f;
+		FZ = FY - (In[2][Column] - 128) / 200.0f;
+
+		X = 0.950456f * lab_inverse_f(FX);
+		Y = lab_inverse_f(FY);
+		Z = 1.088754f * lab_inverse_f(FZ);
+
+		Linear[0] = 3.240479f * X - 1.537150f * Y - 0.498535f * Z;
+		Linear[1] = -0.969256f * X + 1.875992f * Y + 0.041556f * Z;
+		Linear[2] = 0.055648f * X - 0.204043f * Y + 1.057311f * Z;
+
+		for(int32_t k = 0; k < 3; k++)
+		{
+			if(Linear[k] <= 0.0f)
+				Out[k][Column] = Gamma[0];
+			else if(Linear[k] >= 1.0f)
+				Out[k][Column] = Gamma[LAB_GAMMA_SIZE];
+			else
+				Out[k][Column] = Gamma[(int32_t)(Linear[k] * LAB_GAMMA_SIZE + 0.5f)];
+		}
+	}
+}
+/*******************************************************************************/
+/* Fill conversion parameters and tables of "Setup". Return -1 if fail */
+static int prepare_color(int Conversion, color_work_t *Setup)
+{
+	double	Value;
+
+	Setup->Conversion = Conversion;
+	Setup->Linear = NULL;
+	Setup->CubeRoot = NULL;
+	Setup->Gamma = NULL;
+
+	switch(Conversion)
+	{
+		case COLOR_RGB_TO_HSV :
+		case COLOR_HSV_TO_RGB :
+			return 0;
+
+		case COLOR_RGB_TO_YCBCR_601 :
+		case COLOR_YCBCR_601_TO_RGB :
+			ycbcr_matrix(0.299, 0.114, Conversion == COLOR_YCBCR_601_TO_RGB, Setup);
+			return 0;
+
+		case COLOR_RGB_TO_YCBCR_709 :
+		case COLOR_YCBCR_709_TO_RGB :
+			ycbcr_matrix(0.2126, 0.0722, Conversion == COLOR_YCBCR_709_TO_RGB, Setup);
+			return 0;
+
+		case COLOR_RGB_TO_LAB :
+			Setup->Linear = (float *)malloc(sizeof(float) * 256);
+			Setup->CubeRoot = (float *)malloc(sizeof(float) * (LAB_CBRT_SIZE + 1));
+			if((Setup->Linear == NULL) || (Setup->CubeRoot == NULL))
+				return -1;
+
+			for(int32_t i = 0; i < 256; i++)
+			{
+				Value = i / 255.0;
+				Setup->Linear[i] = (float)((Value <= 0.04045) ? Value / 12.92 : pow((Value + 0.055) / 1.055, 2.4));
+			}
+
+			for(int32_t i = 0; i <= LAB_CBRT_SIZE; i++)
+			{
+				Value = (double)i / LAB_CBRT_SIZE;
+				Setup->CubeRoot[i] = (float)((Value > 0.008856) ? cbrt(Value) : 7.787 * Value + 16.0 / 116.0);
+			}
+			return 0;
+
+		case COLOR_LAB_TO_RGB :
+			Setup->Gamma = (uint8_t *)malloc(LAB_GAMMA_SIZE + 1);
+			if(Setup->Gamma == NULL)
+				return -1;
+
+			for(int32_t i = 0; i <= LAB_GAMMA_SIZE; i++)
+			{
+				Value = (double)i / LAB_GAMMA_SIZE;
+				Value = (Value <= 0.0031308) ? 12.92 * Value : 1.055 * pow(Value, 1.0 / 2.4) - 0.055;
+				Setup->Gamma[i] = (uint8_t)lround(255.0 * Value);
+			}
+			return 0;
+
+		default :
+			return -1;
+	}
+}
+/*******************************************************************************/
+/* Frees tables allocated by "prepare_color" */
+static void release_color(color_work_t *Setup)
+{
+	free(Setup->Linear);
+	free(Setup->CubeRoot);
+	free(Setup->Gamma);
+}
+/*******************************************************************************/
+/* Receive "color_work_t" type. Packed rows are split to planar scratch rows before the
+   conversion and merged back after it, so conversions only handle planes */
+static void *color_convert(void *ThreadArg)
+{
+	color_work_t *Args = (color_work_t *)ThreadArg;
+
+	int32_t		Width = (Args->Input != NULL) ? Args->Input->Width : Args->InputPlanes[0]->Width;
+	const uint8_t	*In[3];
+	uint8_t		*Out[3];
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		for(int32_t c = 0; c < 3; c++)
+		{
+			if(Args->Input != NULL)
+				In[c] = Args->Scratch + (size_t)c * Width;
+			else
+				In[c] = Args->InputPlanes[c]->Pixel8[Row];
+
+			if(Args->Output != NULL)
+				Out[c] = Args->Scratch + (size_t)(3 + c) * Width;
+			else
+				Out[c] = Args->OutputPlanes[c]->Pixel8[Row];
+		}
+
+		if(Args->Input != NULL)
+			split_row(Args->Input->Pixel24[Row], (uint8_t *)In[PASS_RED_CHANNEL], (uint8_t *)In[PASS_GREEN_CHANNEL],
+			          (uint8_t *)In[PASS_BLUE_CHANNEL], Width);
+
+		switch(Args->Conversion)
+		{
+			case COLOR_RGB_TO_HSV :
+				color_hsv_row(In, Out, Width);
+				break;
+
+			case COLOR_HSV_TO_RGB :
+				color_hsv_inverse_row(In, Out, Width);
+				break;
+
+			case COLOR_RGB_TO_LAB :
+				color_lab_row(In, Out, Width, Args->Linear, Args->CubeRoot);
+				break;
+
+			case COLOR_LAB_TO_RGB :
+				color_lab_inverse_row(In, Out, Width, Args->Gamma);
+				break;
+
+			default :
+				color_linear_row(In, Out, Width, Args->Matrix, Args->Offset);
+				break;
+		}
+
+		if(Args->Output != NULL)
+			merge_row(Out[PASS_RED_CHANNEL], Out[PASS_GREEN_CHANNEL], Out[PASS_BLUE_CHANNEL],
+			          Args->Output->Pixel24[Row], Width);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Convert color space between packed images or planes (the NULL packed image selects
+   planes on each side) using multiple threads. Return -1 if fail */
+static int run_color_convert(int Conversion, img_t *Input, img_t **InputPlanes, img_t *Output,
+                             img_t **OutputPlanes, int32_t ThreadsNum)
+{
+	color_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	color_work_t	Setup;
+	img_t			*Size = (Input != NULL) ? Input : InputPlanes[0];
+	uint8_t			*Scratch;
+
+	Scratch = (uint8_t *)malloc((size_t)6 * Size->Width * ThreadsNum);
+
+	if((prepare_color(Conversion, &Setup) == -1) || (Scratch == NULL))
+	{
+		release_color(&Setup);
+		free(Scratch);
+		return -1;
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i] = Setup;
+		ThreadArg[i].StartRow = i * Size->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Size->Height/ThreadsNum;
+		ThreadArg[i].Scratch = Scratch + (size_t)6 * Size->Width * i;
+		ThreadArg[i].Input = Input;
+		ThreadArg[i].Output = Output;
+
+		for(int32_t c = 0; c < 3; c++)
+		{
+			ThreadArg[i].InputPlanes[c] = (InputPlanes != NULL) ? InputPlanes[c] : NULL;
+			ThreadArg[i].OutputPlanes[c] = (OutputPlanes != NULL) ? OutputPlanes[c] : NULL;
+		}
+
+		pthread_create(&ThreadId[i], NULL, color_convert, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	release_color(&Setup);
+	free(Scratch);
+
+	return 0;
+}
+/*******************************************************************************/
+/* Source position (times "Step") of the nearest pixel of each destination pixel,
+   pixel centers aligned */
+static void resize_nearest_table(int32_t Source, int32_t Destination, int32_t Step, int32_t *Index)
+{
+	for(int32_t i = 0; i < Destination; i++)
+		Index[i] = (int32_t)(((2 * (int64_t)i + 1) * Source) / (2 * (int64_t)Destination)) * Step;
+}
+/*******************************************************************************/
+/* Source positions (times "Step") of the two neighbours of each destination pixel and
+   their weights in 14 bits fixed point (adding 16384), pixel centers aligned */
+static void resize_linear_table(int32_t Source, int32_t Destination, int32_t Step, int32_t *Index,
+                                int16_t *Weight)
+{
+	double	Scale = (double)Source / Destination;
+	double	Position, Fraction;
+	int32_t	First;
+
+	for(int32_t i = 0; i < Destination; i++)
+	{
+		Position = (i + 0.5) * Scale - 0.5;
+		First = (int32_t)floor(Position);
+		Fraction = Position - First;
+
+		/* Borders are replicated */
+		if(First < 0)
+		{
+			First = 0;
+			Fraction = 0.0;
+		}
+		if(First >= Source - 1)
+		{
+			First = Source - 1;
+			Fraction = 0.0;
+		}
+
+		Index[2 * i] = First * Step;
+		Index[2 * i + 1] = ((First < Source - 1) ? First + 1 : First) * Step;
+		Weight[2 * i + 1] = (int16_t)lround(Fraction * 16384.0);
+		Weight[2 * i] = 16384 - Weight[2 * i + 1];
+	}
+}
+/*******************************************************************************/
+/* Spans of source pixels covered by each destination pixel (first, count and position
+   of the weights on "Weight") with overlaps normalized to add 1. "Weight" must hold
+   Source + Destination values */
+static void resize_area_table(int32_t Source, int32_t Destination, int32_t *Span, float *Weight)
+{
+	double	Scale = (double)Source / Destination;
+	double	Start, End;
+	int32_t	First, Last;
+	int32_t	Count = 0;
+
+	for(int32_t i = 0; i < Destination; i++)
+	{
+		Start = i * Scale;
+		End = (i + 1) * Scale;
+		First = (int32_t)floor(Start);
+		Last = (int32_t)ceil(End) - 1;
+		if(Last > Source - 1)
+			Last = Source - 1;
+
+		Span[3 * i] = First;
+		Span[3 * i + 1] = Last - First + 1;
+		Span[3 * i + 2] = Count;
+
+		for(int32_t j = First; j <= Last; j++)
+			Weight[Count++] = (float)((fmin(j + 1.0, End) - fmax((double)j, Start)) / Scale);
+	}
+}
+/*******************************************************************************/
+/* Output rows picking the nearest source pixels */
+static void resize_nearest(resize_work_t *Args)
+{
+	int32_t			Width = Args->Output->Width;
+	const uint8_t	*Source, *Pixel;
+	uint8_t			*Destination;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Source = byte_row(Args->Input, Args->RowIndex[Row]);
+		Destination = byte_row(Args->Output, Row);
+
+		if(Args->Channels == 1)
+		{
+			for(int32_t Column = 0; Column < Width; Column++)
+				Destination[Column] = Source[Args->ColumnIndex[Column]];
+		}
+		else
+		{
+			for(int32_t Column = 0; Column < Width; Column++)
+			{
+				Pixel = Source + Args->ColumnIndex[Column];
+				Destination[3 * Column] = Pixel[0];
+				Destination[3 * Column + 1] = Pixel[1];
+				Destination[3 * Column + 2] = Pixel[2];
+			}
+		}
+	}
+}
+/*******************************************************************************/
+/* Horizontal bilinear pass of a source row. Results keep 7 fractional bits, so they
+   fit 16 bits lanes of the vertical pass */
+static void resize_linear_columns(const uint8_t *Source, int16_t *Destination, int32_t Width, int32_t Channels,
+                                  const int32_t *Index, const int16_t *Weight)
+{
+	const uint8_t	*Left, *Right;
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		Left = Source + Index[2 * Column];
+		Right = Source + Index[2 * Column + 1];
+
+		if(Channels == 1)
+		{
+			Destination[Column] = (int16_t)((Left[0] * Weight[2 * Column] + Right[0] * Weight[2 * Column + 1] + 64) >> 7);
+		}
+		else
+		{
+			for(int32_t c = 0; c < 3; c++)
+				Destination[3 * Column + c] = (int16_t)((Left[c] * Weight[2 * Column] + Right[c] * Weight[2 * Column + 1] + 64) >> 7);
+		}
+	}
+}
+/*******************************************************************************/
+/* Vertical bilinear pass of two horizontally interpolated rows. 16 values are blended
+   at a time with SIMD multiply-add of (Top, Bottom) pairs */
+static void resize_linear_rows(const int16_t *Top, const int16_t *Bottom, uint8_t *Destination, int32_t Length,
+                               int16_t TopWeight, int16_t BottomWeight)
+{
+	int32_t	Index = 0;
+
+#ifdef __SSE2__
+	__m128i	Weights = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)BottomWeight << 16) | (uint16_t)TopWeight));
+	__m128i	Round = _mm_set1_epi32(1 << 20);
+	__m128i	Top0, Top1, Bottom0, Bottom1;
+	__m128i	R0, R1, R2, R3;
+
+	for(; Index + 16 <= Length; Index += 16)
+	{
+		Top0 = _mm_loadu_si128((__m128i *)(Top + Index));
+		Top1 = _mm_loadu_si128((__m128i *)(Top + Index + 8));
+		Bottom0 = _mm_loadu_si128((__m128i *)(Bottom + Index));
+		Bottom1 = _mm_loadu_si128((__m128i *)(Bottom + Index + 8));
+
+		R0 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(Top0, Bottom0), Weights), Round), 21);
+		R1 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(Top0, Bottom0), Weights), Round), 21);
+		R2 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(Top1, Bottom1), Weights), Round), 21);
+		R3 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(Top1, Bottom1), Weights), Round), 21);
+
+		_mm_storeu_si128((__m128i *)(Destination + Index),
+		                 _mm_packus_epi16(_mm_packs_epi32(R0, R1), _mm_packs_epi32(R2, R3)));
+	}
+#endif
+
+	for(; Index < Length; Index++)
+		Destination[Index] = (uint8_t)((Top[Index] * TopWeight + Bottom[Index] * BottomWeight + (1 << 20)) >> 21);
+}
+/*******************************************************************************/
+/* Output rows by bilinear interpolation. Horizontal passes of the last two source rows
+   are kept (by row parity) and reused by following output rows */
+static void resize_linear(resize_work_t *Args)
+{
+	int32_t	Width = Args->Output->Width;
+	int32_t	Length = Width * Args->Channels;
+	int16_t	*Rows[2];
+	int32_t	Cached[2] = {-1, -1};
+	int32_t	Source;
+
+	Rows[0] = (int16_t *)Args->Buffer;
+	Rows[1] = Rows[0] + Length;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		for(int32_t k = 0; k < 2; k++)
+		{
+			Source = Args->RowIndex[2 * Row + k];
+			if(Cached[Source & 1] != Source)
+			{
+				resize_linear_columns(byte_row(Args->Input, Source), Rows[Source & 1], Width, Args->Channels,
+				                      Args->ColumnIndex, Args->ColumnWeight);
+				Cached[Source & 1] = Source;
+			}
+		}
+
+		resize_linear_rows(Rows[Args->RowIndex[2 * Row] & 1], Rows[Args->RowIndex[2 * Row + 1] & 1],
+		                   byte_row(Args->Output, Row), Length, Args->RowWeight[2 * Row], Args->RowWeight[2 * Row + 1]);
+	}
+}
+/*******************************************************************************/
+/* Add (or copy when "First" is not 0) a row of bytes to 16 bits sums */
+static void resize_accumulate(uint16_t *Sum, const uint8_t *Source, int32_t Length, int First)
+{
+	int32_t	Index = 0;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Pixels, Low, High;
+
+	for(; Index + 16 <= Length; Index += 16)
+	{
+		Pixels = _mm_loadu_si128((__m128i *)(Source + Index));
+		Low = _mm_unpacklo_epi8(Pixels, Zero);
+		High = _mm_unpackhi_epi8(Pixels, Zero);
+
+		if(First == 0)
+		{
+			Low = _mm_add_epi16(Low, _mm_loadu_si128((__m128i *)(Sum + Index)));
+			High = _mm_add_epi16(High, _mm_loadu_si128((__m128i *)(Sum + Index + 8)));
+		}
+
+		_mm_storeu_si128((__m128i *)(Sum + Index), Low);
+		_mm_storeu_si128((__m128i *)(Sum + Index + 8), High);
+	}
+#endif
+
+	for(; Index < Length; Index++)
+		Sum[Index] = (First != 0) ? Source[Index] : Sum[Index] + Source[Index];
+}
+/*******************************************************************************/
+/* Average of 2x2 blocks of a GRAY_8BITS row pair. Even and odd bytes are added on
+   16 bits lanes, 16 output pixels at a time */
+static void resize_half_gray(const uint8_t *Top, const uint8_t *Bottom, uint8_t *Destination, int32_t Width)
+{
+	int32_t	Column = 0;
+
+#ifdef __SSE2__
+	__m128i	Mask = _mm_set1_epi16(0x00FF);
+	__m128i	Two = _mm_set1_epi16(2);
+	__m128i	Upper, Lower, Low, High;
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		Upper = _mm_loadu_si128((__m128i *)(Top + 2 * Column));
+		Lower = _mm_loadu_si128((__m128i *)(Bottom + 2 * Column));
+		Low = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(Upper, Mask), _mm_srli_epi16(Upper, 8)),
+		                    _mm_add_epi16(_mm_and_si128(Lower, Mask), _mm_srli_epi16(Lower, 8)));
+
+		Upper = _mm_loadu_si128((__m128i *)(Top + 2 * Column + 16));
+		Lower = _mm_loadu_si128((__m128i *)(Bottom + 2 * Column + 16));
+		High = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(Upper, Mask), _mm_srli_epi16(Upper, 8)),
+		                     _mm_add_epi16(_mm_and_si128(Lower, Mask), _mm_srli_epi16(Lower, 8)));
+
+		Low = _mm_srli_epi16(_mm_add_epi16(Low, Two), 2);
+		High = _mm_srli_epi16(_mm_add_epi16(High, Two), 2);
+		_mm_storeu_si128((__m128i *)(Destination + Column), _mm_packus_epi16(Low, High));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+		Destination[Column] = (uint8_t)((Top[2 * Column] + Top[2 * Column + 1] +
+		                                 Bottom[2 * Column] + Bottom[2 * Column + 1] + 2) >> 2);
+}
+/*******************************************************************************/
+/* Average of 4x4 blocks of four GRAY_8BITS rows. Pair sums of the rows are added on
+   16 bits lanes and then adjacent pairs on 32 bits lanes, 16 output pixels at a time */
+static void resize_quarter_gray(const uint8_t **Rows, uint8_t *Destination, int32_t Width)
+{
+	int32_t	Column = 0;
+	int32_t	Sum;
+
+#ifdef __SSE2__
+	__m128i	Mask = _mm_set1_epi16(0x00FF);
+	__m128i	Ones = _mm_set1_epi16(1);
+	__m128i	Eight = _mm_set1_epi16(8);
+	__m128i	Quads[4];
+	__m128i	Pairs, Pixels, Low, High;
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		for(int32_t k = 0; k < 4; k++)
+		{
+			Pairs = _mm_setzero_si128();
+			for(int32_t r = 0; r < 4; r++)
+			{
+				Pixels = _mm_loadu_si128((__m128i *)(Rows[r] + 4 * Column + 16 * k));
+				Pairs = _mm_add_epi16(Pairs, _mm_add_epi16(_mm_and_si128(Pixels, Mask), _mm_srli_epi16(Pixels, 8)));
+			}
+			Quads[k] = _mm_madd_epi16(Pairs, Ones);
+		}
+
+		Low = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(Quads[0], Quads[1]), Eight), 4);
+		High = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(Quads[2], Quads[3]), Eight), 4);
+		_mm_storeu_si128((__m128i *)(Destination + Column), _mm_packus_epi16(Low, High));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		Sum = 8;
+		for(int32_t r = 0; r < 4; r++)
+			Sum += Rows[r][4 * Column] + Rows[r][4 * Column + 1] + Rows[r][4 * Column + 2] + Rows[r][4 * Column + 3];
+		Destination[Column] = (uint8_t)(Sum >> 4);
+	}
+}
+/*******************************************************************************/
+/* Output rows averaging blocks of FactorX x FactorY source pixels (integer factors).
+   Block rows are added on 16 bits sums, GRAY_8BITS 2x and 4x decimation have own paths */
+static void resize_area_blocks(resize_work_t *Args)
+{
+	int32_t		Width = Args->Output->Width;
+	int32_t		Channels = Args->Channels;
+	int32_t		FactorX = Args->FactorX;
+	int32_t		FactorY = Args->FactorY;
+	uint32_t	Count = (uint32_t)(FactorX * FactorY);
+	uint32_t	Total;
+	uint16_t	*Sum = (uint16_t *)Args->Buffer;
+	const uint8_t	*Rows[4];
+	uint8_t		*Destination;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Destination = byte_row(Args->Output, Row);
+
+		if((Channels == 1) && (FactorX == FactorY) && ((FactorX == 2) || (FactorX == 4)))
+		{
+			for(int32_t r = 0; r < FactorY; r++)
+				Rows[r] = byte_row(Args->Input, Row * FactorY + r);
+
+			if(FactorX == 2)
+				resize_half_gray(Rows[0], Rows[1], Destination, Width);
+			else
+				resize_quarter_gray(Rows, Destination, Width);
+			continue;
+		}
+
+		for(int32_t r = 0; r < FactorY; r++)
+			resize_accumulate(Sum, byte_row(Args->Input, Row * FactorY + r), Width * FactorX * Channels, r == 0);
+
+		for(int32_t Column = 0; Column < Width; Column++)
+		{
+			for(int32_t c = 0; c < Channels; c++)
+			{
+				Total = Count / 2;
+				for(int32_t i = 0; i < FactorX; i++)
+					Total += Sum[(Column * FactorX + i) * Channels + c];
+
+				Destination[Column * Channels + c] = (uint8_t)(Total / Count);
+			}
+		}
+	}
+}
+/*******************************************************************************/
+/* Output rows averaging source pixels weighted by their covered area (any factors) */
+static void resize_area(resize_work_t *Args)
+{
+	int32_t			Width = Args->Output->Width;
+	int32_t			Channels = Args->Channels;
+	int32_t			Length = Width * Channels;
+	float			*Accumulator = (float *)Args->Buffer;
+	const int32_t	*RowSpan, *Span;
+	const float		*Weight;
+	const uint8_t	*Source;
+	float			Scale, Value;
+	uint8_t			*Destination;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		RowSpan = Args->RowIndex + 3 * Row;
+
+		for(int32_t i = 0; i < Length; i++)
+			Accumulator[i] = 0.0f;
+
+		for(int32_t r = 0; r < RowSpan[1]; r++)
+		{
+			Source = byte_row(Args->Input, RowSpan[0] + r);
+			Scale = Args->RowArea[RowSpan[2] + r];
+
+			for(int32_t Column = 0; Column < Width; Column++)
+			{
+				Span = Args->ColumnIndex + 3 * Column;
+				Weight = Args->ColumnArea + Span[2];
+
+				for(int32_t c = 0; c < Channels; c++)
+				{
+					Value = 0.0f;
+					for(int32_t i = 0; i < Span[1]; i++)
+						Value += Source[(Span[0] + i) * Channels + c] * Weight[i];
+
+					Accumulator[Column * Channels + c] += Scale * Value;
+				}
+			}
+		}
+
+		Destination = byte_row(Args->Output, Row);
+		for(int32_t i = 0; i < Length; i++)
+			Destination[i] = color_clip(Accumulator[i]);
+	}
+}
+/*******************************************************************************/
+/* Receive "resize_work_t" type */
+static void *resize_rows(void *ThreadArg)
+{
+	resize_work_t *Args = (resize_work_t *)ThreadArg;
+
+	if(Args->Method == RESIZE_NEAREST)
+		resize_nearest(Args);
+	else if(Args->Method == RESIZE_BILINEAR)
+		resize_linear(Args);
+	else if(Args->FactorX != 0)
+		resize_area_blocks(Args);
+	else
+		resize_area(Args);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Number of pyramid levels kept from "Levels", so the coarsest one is the first of
+   1x1 pixels at most (each level has half the size rounded up) */
+static int32_t pyramid_levels(int32_t Width, int32_t Height, int32_t Levels)
+{
+	int32_t	Count = 1;
+
+	while((Count < Levels) && ((Width > 1) || (Height > 1)))
+	{
+		Width = (Width + 1) / 2;
+		Height = (Height + 1) / 2;
+		Count++;
+	}
+
+	return Count;
+}
+/*******************************************************************************/
+/* Allocate a pyramid for a source of "Width" x "Height" pixels. Header, levels, row
+   pointers, bands, pixels and "ScratchSize" bytes of scratch (16 bytes aligned, returned
+   on "Scratch" and unused after the build) share a single block. Return NULL if fail */
+static pyramid_t *new_pyramid(int32_t Width, int32_t Height, int32_t Levels, int Bands, size_t ScratchSize,
+                              uint8_t **Scratch)
+{
+	size_t		Rows = 0, Pixels = 0, BandPixels = 0;
+	size_t		Size;
+	int32_t		LevelWidth = Width, LevelHeight = Height;
+	pyramid_t	*Pyramid;
+	uint8_t		**RowPointer;
+	int16_t		*BandData;
+	uint8_t		*Data;
+
+	for(int32_t l = 0; l < Levels; l++)
+	{
+		Rows += LevelHeight;
+		Pixels += (size_t)LevelWidth * LevelHeight;
+		if((Bands != 0) && (l < Levels - 1))
+			BandPixels += (size_t)LevelWidth * LevelHeight;
+
+		LevelWidth = (LevelWidth + 1) / 2;
+		LevelHeight = (LevelHeight + 1) / 2;
+	}
+
+	Size = sizeof(pyramid_t) + sizeof(img_t) * Levels + sizeof(uint8_t *) * Rows +
+	       ((Bands != 0) ? sizeof(int16_t *) * Levels : 0) + sizeof(int16_t) * BandPixels + Pixels +
+	       ScratchSize + 15;
+
+	Pyramid = (pyramid_t *)malloc(Size);
+	if(Pyramid == NULL)
+		return NULL;
+
+	Pyramid->Levels = Levels;
+	Pyramid->Level = (img_t *)(Pyramid + 1);
+	RowPointer = (uint8_t **)(Pyramid->Level + Levels);
+	Pyramid->Band = (Bands != 0) ? (int16_t **)(RowPointer + Rows) : NULL;
+	BandData = (Bands != 0) ? (int16_t *)(Pyramid->Band + Levels) : (int16_t *)(RowPointer + Rows);
+	Data = (uint8_t *)(BandData + BandPixels);
+
+	LevelWidth = Width;
+	LevelHeight = Height;
+	for(int32_t l = 0; l < Levels; l++)
+	{
+		Pyramid->Level[l].Width = LevelWidth;
+		Pyramid->Level[l].Height = LevelHeight;
+		Pyramid->Level[l].Pixel24 = NULL;
+		Pyramid->Level[l].Pixel8 = RowPointer;
+
+		for(int32_t Row = 0; Row < LevelHeight; Row++)
+			RowPointer[Row] = Data + (size_t)Row * LevelWidth;
+
+		RowPointer += LevelHeight;
+		Data += (size_t)LevelWidth * LevelHeight;
+
+		if(Bands != 0)
+		{
+			Pyramid->Band[l] = (l < Levels - 1) ? BandData : NULL;
+			if(l < Levels - 1)
+				BandData += (size_t)LevelWidth * LevelHeight;
+		}
+
+		LevelWidth = (LevelWidth + 1) / 2;
+		LevelHeight = (LevelHeight + 1) / 2;
+	}
+
+	*Scratch = (uint8_t *)(((uintptr_t)Data + 15) & ~(uintptr_t)15);
+
+	return Pyramid;
+}
+/*******************************************************************************/
+/* Vertical binomial sums (1 4 6 4 1) of five rows, 16 columns at a time */
+static void pyramid_column_sums(const uint8_t **Rows, uint16_t *Sum, int32_t Width)
+{
+	int32_t	Column = 0;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Pixels[5];
+	__m128i	Outer, Inner, Center;
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		for(int32_t k = 0; k < 5; k++)
+			Pixels[k] = _mm_loadu_si128((__m128i *)(Rows[k] + Column));
+
+		Outer = _mm_add_epi16(_mm_unpacklo_epi8(Pixels[0], Zero), _mm_unpacklo_epi8(Pixels[4], Zero));
+		Inner = _mm_add_epi16(_mm_unpacklo_epi8(Pixels[1], Zero), _mm_unpacklo_epi8(Pixels[3], Zero));
+		Center = _mm_unpacklo_epi8(Pixels[2], Zero);
+		_mm_storeu_si128((__m128i *)(Sum + Column),
+		                 _mm_add_epi16(_mm_add_epi16(Outer, _mm_slli_epi16(Inner, 2)),
+		                               _mm_add_epi16(_mm_slli_epi16(Center, 2), _mm_slli_epi16(Center, 1))));
+
+		Outer = _mm_add_epi16(_mm_unpackhi_epi8(Pixels[0], Zero), _mm_unpackhi_epi8(Pixels[4], Zero));
+		Inner = _mm_add_epi16(_mm_unpackhi_epi8(Pixels[1], Zero), _mm_unpackhi_epi8(Pixels[3], Zero));
+		Center = _mm_unpackhi_epi8(Pixels[2], Zero);
+		_mm_storeu_si128((__m128i *)(Sum + Column + 8),
+		                 _mm_add_epi16(_mm_add_epi16(Outer, _mm_slli_epi16(Inner, 2)),
+		                               _mm_add_epi16(_mm_slli_epi16(Center, 2), _mm_slli_epi16(Center, 1))));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+		Sum[Column] = (uint16_t)(Rows[0][Column] + Rows[4][Column] + 4 * (Rows[1][Column] + Rows[3][Column]) +
+		                         6 * Rows[2][Column]);
+}
+/*******************************************************************************/
+/* Horizontal binomial (1 4 6 4 1) on even columns of padded sums (Sum[-2] to Sum[2 * Width]
+   are valid, 16 more may be read), rounding the 8 bits of both passes. Even and odd sums
+   are separated on 32 bits lanes, 8 output pixels at a time */
+static void pyramid_reduce_row(const uint16_t *Sum, uint8_t *Destination, int32_t Width)
+{
+	int32_t	Column = 0;
+	int32_t	Position;
+
+#ifdef __SSE2__
+	__m128i	Mask = _mm_set1_epi32(0xFFFF);
+	__m128i	Round = _mm_set1_epi16(128);
+	__m128i	Even[3], Odd[2];
+	__m128i	Low, High, Result;
+
+	for(; Column + 8 <= Width; Column += 8)
+	{
+		for(int32_t k = 0; k < 3; k++)
+		{
+			Low = _mm_loadu_si128((__m128i *)(Sum + 2 * Column - 2 + 2 * k));
+			High = _mm_loadu_si128((__m128i *)(Sum + 2 * Column + 6 + 2 * k));
+			Even[k] = _mm_packs_epi32(_mm_and_si128(Low, Mask), _mm_and_si128(High, Mask));
+			if(k < 2)
+				Odd[k] = _mm_packs_epi32(_mm_srli_epi32(Low, 16), _mm_srli_epi32(High, 16));
+		}
+
+		/* Sums of both passes reach 65280: unsigned 16 bits lanes */
+		Result = _mm_add_epi16(_mm_add_epi16(Even[0], Even[2]), _mm_slli_epi16(_mm_add_epi16(Odd[0], Odd[1]), 2));
+		Result = _mm_add_epi16(Result, _mm_add_epi16(_mm_slli_epi16(Even[1], 2), _mm_slli_epi16(Even[1], 1)));
+		Result = _mm_srli_epi16(_mm_add_epi16(Result, Round), 8);
+		_mm_storel_epi64((__m128i *)(Destination + Column), _mm_packus_epi16(Result, Result));
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		Position = 2 * Column;
+		Destination[Column] = (uint8_t)((Sum[Position - 2] + Sum[Position + 2] + 4 * (Sum[Position - 1] + Sum[Position + 1]) +
+		                                 6 * Sum[Position] + 128) >> 8);
+	}
+}
+/*******************************************************************************/
+/* Receive "pyramid_work_t" type. Coarse rows from five Fine rows blurred vertically on
+   every column and horizontally only on kept (even) columns. Borders are replicated */
+static void *pyramid_reduce(void *ThreadArg)
+{
+	pyramid_work_t *Args = (pyramid_work_t *)ThreadArg;
+
+	int32_t			Width = Args->Fine->Width;
+	int32_t			LastRow = Args->Fine->Height - 1;
+	uint16_t		*Sum = Args->Buffer + 2;
+	const uint8_t	*Rows[5];
+	int32_t			Source;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		for(int32_t k = 0; k < 5; k++)
+		{
+			Source = 2 * Row - 2 + k;
+			Source = (Source < 0) ? 0 : ((Source > LastRow) ? LastRow : Source);
+			Rows[k] = Args->Fine->Pixel8[Source];
+		}
+
+		pyramid_column_sums(Rows, Sum, Width);
+		Sum[-2] = Sum[-1] = Sum[0];
+		Sum[Width] = Sum[Width + 1] = Sum[Width - 1];
+
+		pyramid_reduce_row(Sum, Args->Coarse->Pixel8[Row], Args->Coarse->Width);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Vertical expansion sums of coarse rows for a fine row: (1 6 1) of Top, Middle and
+   Bottom on even rows and (4 4) of Middle and Bottom on odd rows, 16 columns at a time */
+static void pyramid_expand_sums(const uint8_t *Top, const uint8_t *Middle, const uint8_t *Bottom, int32_t Odd,
+                                uint16_t *Sum, int32_t Width)
+{
+	int32_t	Column = 0;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Upper, Center, Lower;
+	__m128i	A, B, C;
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		Upper = _mm_loadu_si128((__m128i *)(Top + Column));
+		Center = _mm_loadu_si128((__m128i *)(Middle + Column));
+		Lower = _mm_loadu_si128((__m128i *)(Bottom + Column));
+
+		for(int32_t k = 0; k < 2; k++)
+		{
+			A = (k == 0) ? _mm_unpacklo_epi8(Upper, Zero) : _mm_unpackhi_epi8(Upper, Zero);
+			B = (k == 0) ? _mm_unpacklo_epi8(Center, Zero) : _mm_unpackhi_epi8(Center, Zero);
+			C = (k == 0) ? _mm_unpacklo_epi8(Lower, Zero) : _mm_unpackhi_epi8(Lower, Zero);
+
+			if(Odd != 0)
+				A = _mm_slli_epi16(_mm_add_epi16(B, C), 2);
+			else
+				A = _mm_add_epi16(_mm_add_epi16(A, C), _mm_add_epi16(_mm_slli_epi16(B, 2), _mm_slli_epi16(B, 1)));
+
+			_mm_storeu_si128((__m128i *)(Sum + Column + 8 * k), A);
+		}
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		if(Odd != 0)
+			Sum[Column] = (uint16_t)(4 * (Middle[Column] + Bottom[Column]));
+		else
+			Sum[Column] = (uint16_t)(Top[Column] + 6 * Middle[Column] + Bottom[Column]);
+	}
+}
+/*******************************************************************************/
+/* Horizontal expansion of padded coarse sums (Sum[-1] and Sum[Coarse width] are valid)
+   to "Width" fine pixels: (1 6 1) on even and (4 4) on odd columns, rounding the 6 bits
+   of both passes. Even and odd results of 8 coarse columns are interleaved at a time */
+static void pyramid_expand_row(const uint16_t *Sum, uint8_t *Destination, int32_t Width)
+{
+	int32_t	Column = 0;
+
+#ifdef __SSE2__
+	__m128i	Round = _mm_set1_epi16(32);
+	__m128i	Left, Center, Right, Even, Odd;
+
+	for(; 2 * Column + 16 <= Width; Column += 8)
+	{
+		Left = _mm_loadu_si128((__m128i *)(Sum + Column - 1));
+		Center = _mm_loadu_si128((__m128i *)(Sum + Column));
+		Right = _mm_loadu_si128((__m128i *)(Sum + Column + 1));
+
+		Even = _mm_add_epi16(_mm_add_epi16(Left, Right), _mm_add_epi16(_mm_slli_epi16(Center, 2), _mm_slli_epi16(Center, 1)));
+		Odd = _mm_slli_epi16(_mm_add_epi16(Center, Right), 2);
+		Even = _mm_srli_epi16(_mm_add_epi16(Even, Round), 6);
+		Odd = _mm_srli_epi16(_mm_add_epi16(Odd, Round), 6);
+
+		_mm_storeu_si128((__m128i *)(Destination + 2 * Column),
+		                 _mm_packus_epi16(_mm_unpacklo_epi16(Even, Odd), _mm_unpackhi_epi16(Even, Odd)));
+	}
+#endif
+
+	for(int32_t Position = 2 * Column; Position < Width; Position++)
+	{
+		Column = Position >> 1;
+		if(Position & 1)
+			Destination[Position] = (uint8_t)((4 * (Sum[Column] + Sum[Column + 1]) + 32) >> 6);
+		else
+			Destination[Position] = (uint8_t)((Sum[Column - 1] + 6 * Sum[Column] + Sum[Column + 1] + 32) >> 6);
+	}
+}
+/*******************************************************************************/
+/* Band row (Fine minus Expanded) or, on "Collapse", rebuilt Fine row (Expanded plus
+   Band saturated), 16 pixels at a time */
+static void pyramid_band_row(uint8_t *Fine, const uint8_t *Expanded, int16_t *Band, int32_t Width, int32_t Collapse)
+{
+	int32_t	Column = 0;
+	int32_t	Value;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Pixels, Low, High;
+
+	for(; Column + 16 <= Width; Column += 16)
+	{
+		Pixels = _mm_loadu_si128((__m128i *)(Expanded + Column));
+		Low = _mm_unpacklo_epi8(Pixels, Zero);
+		High = _mm_unpackhi_epi8(Pixels, Zero);
+
+		if(Collapse != 0)
+		{
+			Low = _mm_add_epi16(Low, _mm_loadu_si128((__m128i *)(Band + Column)));
+			High = _mm_add_epi16(High, _mm_loadu_si128((__m128i *)(Band + Column + 8)));
+			_mm_storeu_si128((__m128i *)(Fine + Column), _mm_packus_epi16(Low, High));
+		}
+		else
+		{
+			Pixels = _mm_loadu_si128((__m128i *)(Fine + Column));
+			_mm_storeu_si128((__m128i *)(Band + Column), _mm_sub_epi16(_mm_unpacklo_epi8(Pixels, Zero), Low));
+			_mm_storeu_si128((__m128i *)(Band + Column + 8), _mm_sub_epi16(_mm_unpackhi_epi8(Pixels, Zero), High));
+		}
+	}
+#endif
+
+	for(; Column < Width; Column++)
+	{
+		if(Collapse != 0)
+		{
+			Value = Expanded[Column] + Band[Column];
+			Fine[Column] = (uint8_t)((Value < 0) ? 0 : ((Value > 255) ? 255 : Value));
+		}
+		else
+			Band[Column] = (int16_t)(Fine[Column] - Expanded[Column]);
+	}
+}
+/*******************************************************************************/
+/* Receive "pyramid_work_t" type. Fine rows expanded from Coarse are subtracted from Fine
+   (band) or added to Band (collapse). Borders are replicated */
+static void *pyramid_expand(void *ThreadArg)
+{
+	pyramid_work_t *Args = (pyramid_work_t *)ThreadArg;
+
+	int32_t		Width = Args->Coarse->Width;
+	int32_t		LastRow = Args->Coarse->Height - 1;
+	uint16_t	*Sum = Args->Buffer + 2;
+	int32_t		Middle;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Middle = Row >> 1;
+		pyramid_expand_sums(Args->Coarse->Pixel8[(Middle > 0) ? Middle - 1 : 0], Args->Coarse->Pixel8[Middle],
+		                    Args->Coarse->Pixel8[(Middle < LastRow) ? Middle + 1 : LastRow], Row & 1, Sum, Width);
+		Sum[-1] = Sum[0];
+		Sum[Width] = Sum[Width - 1];
+
+		pyramid_expand_row(Sum, Args->Expanded, Args->Fine->Width);
+		pyramid_band_row(Args->Fine->Pixel8[Row], Args->Expanded, Args->Band + (size_t)Row * Args->Fine->Width,
+		                 Args->Fine->Width, Args->Collapse);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Bytes of scratch needed by each thread on levels up to "Width" pixels wide. Rounded
+   up to 16 bytes so the "uint16_t" buffer of every thread stays aligned */
+static size_t pyramid_scratch(int32_t Width)
+{
+	return (sizeof(uint16_t) * (Width + 20) + (size_t)Width + 15) & ~(size_t)15;
+}
+/*******************************************************************************/
+/* Run "pyramid_reduce" (rows of Coarse) or "pyramid_expand" (rows of Fine) using
+   multiple threads. "Scratch" holds "pyramid_scratch" bytes of each thread */
+static void run_pyramid(void *(*Worker)(void *), img_t *Fine, img_t *Coarse, int16_t *Band, int32_t Collapse,
+                        uint8_t *Scratch, size_t ScratchSize, int32_t ThreadsNum)
+{
+	pyramid_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	int32_t			Height = (Worker == pyramid_reduce) ? Coarse->Height : Fine->Height;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Height/ThreadsNum;
+		ThreadArg[i].Collapse = Collapse;
+		ThreadArg[i].Buffer = (uint16_t *)(Scratch + ScratchSize * i);
+		ThreadArg[i].Expanded = Scratch + ScratchSize * i + sizeof(uint16_t) * (Fine->Width + 20);
+		ThreadArg[i].Band = Band;
+		ThreadArg[i].Fine = Fine;
+		ThreadArg[i].Coarse = Coarse;
+
+		pthread_create(&ThreadId[i], NULL, Worker, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+}
+/*******************************************************************************/
+/* Build Gaussian levels (and bands if the pyramid has them) of "Img". Return NULL if fail */
+static pyramid_t *build_pyramid(img_t *Img, int32_t Levels, int Bands, int32_t ThreadsNum)
+{
+	pyramid_t	*Pyramid;
+	uint8_t		*Scratch;
+	size_t		ScratchSize = pyramid_scratch(Img->Width);
+
+	Levels = pyramid_levels(Img->Width, Img->Height, Levels);
+	Pyramid = new_pyramid(Img->Width, Img->Height, Levels, Bands, ScratchSize * ThreadsNum, &Scratch);
+	if(Pyramid == NULL)
+		return NULL;
+
+	for(int32_t Row = 0; Row < Img->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Img->Width; Column++)
+			Pyramid->Level[0].Pixel8[Row][Column] = Img->Pixel8[Row][Column];
+	}
+
+	for(int32_t l = 1; l < Levels; l++)
+		run_pyramid(pyramid_reduce, &Pyramid->Level[l - 1], &Pyramid->Level[l], NULL, 0, Scratch, ScratchSize, ThreadsNum);
+
+	for(int32_t l = 0; (Bands != 0) && (l < Levels - 1); l++)
+		run_pyramid(pyramid_expand, &Pyramid->Level[l], &Pyramid->Level[l + 1], Pyramid->Band[l], 0,
+		            Scratch, ScratchSize, ThreadsNum);
+
+	return Pyramid;
+}
+/*******************************************************************************/
+#define WARP_ONE		4294967296.0	/* 1.0 on 32.32 fixed point */
+#define WARP_LIMIT		536870912.0		/* Coordinates are clipped to +-2^29 */
+
+/* Index inside [0:Size[ used for "Index" by BORDER_REPLICATE and BORDER_REFLECT.
+   Return -1 for constant borders (BORDER_BLACK and BORDER_WHITE) */
+static inline int32_t border_index(int32_t Index, int32_t Size, int32_t Border)
+{
+	if((Index >= 0) && (Index < Size))
+		return Index;
+
+	if(Border == BORDER_REPLICATE)
+		return (Index < 0) ? 0 : Size - 1;
+
+	if(Border == BORDER_REFLECT)
+	{
+		Index %= 2 * Size;
+		if(Index < 0)
+			Index += 2 * Size;
+
+		return (Index < Size) ? Index : 2 * Size - 1 - Index;
+	}
+
+	return -1;
+}
+/*******************************************************************************/
+/* Sample a pixel touching the border at fixed point source coordinates (X, Y) */
+static void warp_border_sample(warp_work_t *Args, int64_t X, int64_t Y, uint8_t *Destination)
+{
+	int32_t			Channels = Args->Channels;
+	int32_t			Columns[2], Rows[2];
+	int32_t			FractionX, FractionY;
+	int32_t			Weight[4], Sum;
+	const uint8_t	*Pixel;
+
+	if(Args->Interpolation == WARP_NEAREST)
+	{
+		Columns[0] = border_index((int32_t)(X >> 32), Args->Input->Width, Args->Border);
+		Rows[0] = border_index((int32_t)(Y >> 32), Args->Input->Height, Args->Border);
+
+		for(int32_t c = 0; c < Channels; c++)
+		{
+			if((Columns[0] < 0) || (Rows[0] < 0))
+				Destination[c] = Args->BorderValue;
+			else
+				Destination[c] = byte_row(Args->Input, Rows[0])[Columns[0] * Channels + c];
+		}
+		return;
+	}
+
+	for(int32_t k = 0; k < 2; k++)
+	{
+		Columns[k] = border_index((int32_t)(X >> 32) + k, Args->Input->Width, Args->Border);
+		Rows[k] = border_index((int32_t)(Y >> 32) + k, Args->Input->Height, Args->Border);
+	}
+
+	FractionX = (int32_t)((X >> 22) & 1023);
+	FractionY = (int32_t)((Y >> 22) & 1023);
+	Weight[0] = (1024 - FractionX) * (1024 - FractionY);
+	Weight[1] = FractionX * (1024 - FractionY);
+	Weight[2] = (1024 - FractionX) * FractionY;
+	Weight[3] = FractionX * FractionY;
+
+	for(int32_t c = 0; c < Channels; c++)
+	{
+		Sum = 1 << 19;
+		for(int32_t k = 0; k < 4; k++)
+		{
+			if((Columns[k & 1] < 0) || (Rows[k >> 1] < 0))
+				Sum += Weight[k] * Args->BorderValue;
+			else
+			{
+				Pixel = byte_row(Args->Input, Rows[k >> 1]) + Columns[k & 1] * Channels;
+				Sum += Weight[k] * Pixel[c];
+			}
+		}
+		Destination[c] = (uint8_t)(Sum >> 20);
+	}
+}
+/*******************************************************************************/
+/* Fixed point (32.32) source coordinate from a floating point one, clipped far outside */
+static inline int64_t warp_fixed(double Value)
+{
+	Value = (Value < -WARP_LIMIT) ? -WARP_LIMIT : ((Value > WARP_LIMIT) ? WARP_LIMIT : Value);
+
+	return (int64_t)((Value + WARP_LIMIT) * WARP_ONE) - (int64_t)(WARP_LIMIT * WARP_ONE);
+}
+/*******************************************************************************/
+/* Fixed point source coordinates of output pixels [StartColumn:EndColumn[ of a row.
+   Affine coordinates are stepped on fixed point, perspective ones are stepped on
+   homogeneous coordinates and divided. Coordinates are biased by half of the sampling
+   step (a pixel or 1/1024), so truncation rounds */
+static void warp_coordinates(warp_work_t *Args, int32_t Row, int32_t StartColumn, int32_t EndColumn,
+                             int64_t *X, int64_t *Y)
+{
+	const double	*M = Args->Matrix;
+	int64_t			Bias = (Args->Interpolation == WARP_NEAREST) ? (int64_t)1 << 31 : (int64_t)1 << 21;
+	int64_t			StepX, StepY, SourceX, SourceY;
+	double			Homogeneous[3];
+	int32_t			Count = EndColumn - StartColumn;
+
+	if(Args->Perspective == 0)
+	{
+		StepX = (int64_t)llround(M[0] * WARP_ONE);
+		StepY = (int64_t)llround(M[3] * WARP_ONE);
+		SourceX = (int64_t)llround((M[1] * Row + M[2]) * WARP_ONE) + StartColumn * StepX + Bias;
+		SourceY = (int64_t)llround((M[4] * Row + M[5]) * WARP_ONE) + StartColumn * StepY + Bias;
+
+		for(int32_t i = 0; i < Count; i++)
+		{
+			X[i] = SourceX;
+			Y[i] = SourceY;
+			SourceX += StepX;
+			SourceY += StepY;
+		}
+		return;
+	}
+
+	Homogeneous[0] = M[0] * StartColumn + M[1] * Row + M[2];
+	Homogeneous[1] = M[3] * StartColumn + M[4] * Row + M[5];
+	Homogeneous[2] = M[6] * StartColumn + M[7] * Row + M[8];
+
+	for(int32_t i = 0; i < Count; i++)
+	{
+		/* Points at infinity fall far outside */
+		if(Homogeneous[2] != 0.0)
+		{
+			X[i] = warp_fixed(Homogeneous[0] / Homogeneous[2]) + Bias;
+			Y[i] = warp_fixed(Homogeneous[1] / Homogeneous[2]) + Bias;
+		}
+		else
+		{
+			X[i] = warp_fixed(-WARP_LIMIT);
+			Y[i] = warp_fixed(-WARP_LIMIT);
+		}
+
+		Homogeneous[0] += M[0];
+		Homogeneous[1] += M[3];
+		Homogeneous[2] += M[6];
+	}
+}
+/*******************************************************************************/
+/* Output pixels [StartColumn:EndColumn[ of a row (at most WARP_TILE_SIZE). Pixels whose
+   samples are inside the image are read directly, the others through border handling */
+static void warp_row(warp_work_t *Args, int32_t Row, int32_t StartColumn, int32_t EndColumn)
+{
+	int64_t			X[WARP_TILE_SIZE], Y[WARP_TILE_SIZE];
+	int32_t			Channels = Args->Channels;
+	int32_t			Bilinear = (Args->Interpolation == WARP_BILINEAR);
+	uint64_t		Width = (uint64_t)(Args->Input->Width - Bilinear);
+	uint64_t		Height = (uint64_t)(Args->Input->Height - Bilinear);
+	uint8_t			*Destination = byte_row(Args->Output, Row) + StartColumn * Channels;
+	int32_t			Count = EndColumn - StartColumn;
+	int32_t			Column, FractionX, FractionY;
+	int32_t			Weight[4];
+	const uint8_t	*Top, *Bottom;
+
+	warp_coordinates(Args, Row, StartColumn, EndColumn, X, Y);
+
+	for(int32_t i = 0; i < Count; i++, Destination += Channels)
+	{
+		/* Unsigned compare also rejects negative coordinates */
+		if(((uint64_t)(X[i] >> 32) >= Width) || ((uint64_t)(Y[i] >> 32) >= Height))
+		{
+			warp_border_sample(Args, X[i], Y[i], Destination);
+			continue;
+		}
+
+		Column = (int32_t)(X[i] >> 32) * Channels;
+		Top = byte_row(Args->Input, (int32_t)(Y[i] >> 32)) + Column;
+
+		if(Bilinear == 0)
+		{
+			Destination[0] = Top[0];
+			if(Channels == 3)
+			{
+				Destination[1] = Top[1];
+				Destination[2] = Top[2];
+			}
+			continue;
+		}
+
+		FractionX = (int32_t)((X[i] >> 22) & 1023);
+		FractionY = (int32_t)((Y[i] >> 22) & 1023);
+		Weight[0] = (1024 - FractionX) * (1024 - FractionY);
+		Weight[1] = FractionX * (1024 - FractionY);
+		Weight[2] = (1024 - FractionX) * FractionY;
+		Weight[3] = FractionX * FractionY;
+
+		Bottom = byte_row(Args->Input, (int32_t)(Y[i] >> 32) + 1) + Column;
+		for(int32_t c = 0; c < Channels; c++)
+		{
+			Destination[c] = (uint8_t)((Top[c] * Weight[0] + Top[c + Channels] * Weight[1] +
+			                            Bottom[c] * Weight[2] + Bottom[c + Channels] * Weight[3] + (1 << 19)) >> 20);
+		}
+	}
+}
+/*******************************************************************************/
+/* Receive "warp_work_t" type. Rows are filled in tiles of WARP_TILE_SIZE pixels */
+static void *warp_tiles(void *ThreadArg)
+{
+	warp_work_t *Args = (warp_work_t *)ThreadArg;
+
+	int32_t	Width = Args->Output->Width;
+	int32_t	LastRow, LastColumn;
+
+	for(int32_t TileRow = Args->StartRow; TileRow < Args->EndRow; TileRow += WARP_TILE_SIZE)
+	{
+		LastRow = (TileRow + WARP_TILE_SIZE < Args->EndRow) ? TileRow + WARP_TILE_SIZE : Args->EndRow;
+
+		for(int32_t TileColumn = 0; TileColumn < Width; TileColumn += WARP_TILE_SIZE)
+		{
+			LastColumn = (TileColumn + WARP_TILE_SIZE < Width) ? TileColumn + WARP_TILE_SIZE : Width;
+
+			for(int32_t Row = TileRow; Row < LastRow; Row++)
+				warp_row(Args, Row, TileColumn, LastColumn);
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Warp "Img" with a destination to source 3x3 matrix using multiple threads. Affine
+   matrices whose coordinates fit fixed point are stepped on it. Return NULL if fail */
+static img_t *run_warp(img_t *Img, const double *Inverse, int32_t Width, int32_t Height, int Interpolation,
+                       int Border, int32_t ThreadsNum)
+{
+	warp_work_t	ThreadArg[ThreadsNum];
+	pthread_t	ThreadId[ThreadsNum];
+	warp_work_t	Setup;
+	img_t		*OutputImg;
+	double		Corner;
+
+	Setup.Interpolation = Interpolation;
+	Setup.Border = Border;
+	Setup.Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	Setup.BorderValue = (Border == BORDER_WHITE) ? 255 : 0;
+	Setup.Perspective = (Inverse[6] != 0.0) || (Inverse[7] != 0.0) || (Inverse[8] != 1.0);
+
+	for(int32_t i = 0; i < 9; i++)
+		Setup.Matrix[i] = Inverse[i];
+
+	/* Affine coordinates are linear: checking the corners bounds every pixel */
+	for(int32_t k = 0; (k < 4) && (Setup.Perspective == 0); k++)
+	{
+		for(int32_t j = 0; j < 2; j++)
+		{
+			Corner = Inverse[3 * j] * ((k & 1) ? Width : 0) + Inverse[3 * j + 1] * ((k & 2) ? Height : 0) + Inverse[3 * j + 2];
+			if(fabs(Corner) > WARP_LIMIT / 2)
+				Setup.Perspective = 1;
+		}
+	}
+
+	OutputImg = new_BMP(Width, Height, (Setup.Channels == 3) ? RGB_24BITS : GRAY_8BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i] = Setup;
+		ThreadArg[i].StartRow = i * Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Height/ThreadsNum;
+		ThreadArg[i].Input = Img;
+		ThreadArg[i].Output = OutputImg;
+
+		pthread_create(&ThreadId[i], NULL, warp_tiles, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Invert a 3x3 matrix (row-major). Return -1 if it is singular */
+static int invert_matrix3(const double *Matrix, double *Inverse)
+{
+	double	Determinant;
+
+	Inverse[0] = Matrix[4] * Matrix[8] - Matrix[5] * Matrix[7];
+	Inverse[1] = Matrix[2] * Matrix[7] - Matrix[1] * Matrix[8];
+	Inverse[2] = Matrix[1] * Matrix[5] - Matrix[2] * Matrix[4];
+	Inverse[3] = Matrix[5] * Matrix[6] - Matrix[3] * Matrix[8];
+	Inverse[4] = Matrix[0] * Matrix[8] - Matrix[2] * Matrix[6];
+	Inverse[5] = Matrix[2] * Matrix[3] - Matrix[0] * Matrix[5];
+	Inverse[6] = Matrix[3] * Matrix[7] - Matrix[4] * Matrix[6];
+	Inverse[7] = Matrix[1] * Matrix[6] - Matrix[0] * Matrix[7];
+	Inverse[8] = Matrix[0] * Matrix[4] - Matrix[1] * Matrix[3];
+
+	Determinant = Matrix[0] * Inverse[0] + Matrix[1] * Inverse[3] + Matrix[2] * Inverse[6];
+	if(fabs(Determinant) < DBL_EPSILON)
+		return -1;
+
+	for(int32_t i = 0; i < 9; i++)
+		Inverse[i] /= Determinant;
+
+	return 0;
+}
+/*******************************************************************************/
+/* Vertical pass of a symmetric kernel over "Length" bytes: Rows[k] is the source row
+   at distance k - Radius. Rows at the same distance are added before the multiply,
+   16 values at a time */
+static void sharpen_columns(const uint8_t **Rows, const float *Coef, int32_t Radius, float *Line, int32_t Length)
+{
+	int32_t	Index = 0;
+	float	Sum;
+
+#ifdef __SSE2__
+	__m128i	Zero = _mm_setzero_si128();
+	__m128i	Upper, Lower, Low, High;
+	__m128	Acc[4], Weight;
+
+	for(; Index + 16 <= Length; Index += 16)
+	{
+		Weight = _mm_set1_ps(Coef[Radius]);
+		Upper = _mm_loadu_si128((__m128i *)(Rows[Radius] + Index));
+		Low = _mm_unpacklo_epi8(Upper, Zero);
+		High = _mm_unpackhi_epi8(Upper, Zero);
+		Acc[0] = _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpacklo_epi16(Low, Zero)));
+		Acc[1] = _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpackhi_epi16(Low, Zero)));
+		Acc[2] = _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpacklo_epi16(High, Zero)));
+		Acc[3] = _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpackhi_epi16(High, Zero)));
+
+		for(int32_t k = 1; k <= Radius; k++)
+		{
+			Weight = _mm_set1_ps(Coef[Radius + k]);
+			Upper = _mm_loadu_si128((__m128i *)(Rows[Radius - k] + Index));
+			Lower = _mm_loadu_si128((__m128i *)(Rows[Radius + k] + Index));
+			Low = _mm_add_epi16(_mm_unpacklo_epi8(Upper, Zero), _mm_unpacklo_epi8(Lower, Zero));
+			High = _mm_add_epi16(_mm_unpackhi_epi8(Upper, Zero), _mm_unpackhi_epi8(Lower, Zero));
+
+			Acc[0] = _mm_add_ps(Acc[0], _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpacklo_epi16(Low, Zero))));
+			Acc[1] = _mm_add_ps(Acc[1], _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpackhi_epi16(Low, Zero))));
+			Acc[2] = _mm_add_ps(Acc[2], _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpacklo_epi16(High, Zero))));
+			Acc[3] = _mm_add_ps(Acc[3], _mm_mul_ps(Weight, _mm_cvtepi32_ps(_mm_unpackhi_epi16(High, Zero))));
+		}
+
+		for(int32_t j = 0; j < 4; j++)
+			_mm_storeu_ps(Line + Index + 4 * j, Acc[j]);
+	}
+#endif
+
+	for(; Index < Length; Index++)
+	{
+		Sum = Coef[Radius] * Rows[Radius][Index];
+		for(int32_t k = 1; k <= Radius; k++)
+			Sum += Coef[Radius + k] * (float)(Rows[Radius - k][Index] + Rows[Radius + k][Index]);
+
+		Line[Index] = Sum;
+	}
+}
+/*******************************************************************************/
+/* Horizontal pass of a symmetric kernel on a line buffer with taps "Channels" values
+   apart. Center[-Radius * Channels] to Center[Length + Radius * Channels - 1] must be
+   valid. 4 values at a time */
+static void sharpen_rows(const float *Center, const float *Coef, int32_t Radius, int32_t Channels,
+                         float *Blur, int32_t Length)
+{
+	int32_t	Index = 0;
+	float	Sum;
+
+#ifdef __SSE2__
+	__m128	Acc, Weight;
+
+	for(; Index + 4 <= Length; Index += 4)
+	{
+		Acc = _mm_mul_ps(_mm_set1_ps(Coef[Radius]), _mm_loadu_ps(Center + Index));
+
+		for(int32_t k = 1; k <= Radius; k++)
+		{
+			Weight = _mm_set1_ps(Coef[Radius + k]);
+			Acc = _mm_add_ps(Acc, _mm_mul_ps(Weight, _mm_add_ps(_mm_loadu_ps(Center + Index - k * Channels),
+			                                                    _mm_loadu_ps(Center + Index + k * Channels))));
+		}
+
+		_mm_storeu_ps(Blur + Index, Acc);
+	}
+#endif
+
+	for(; Index < Length; Index++)
+	{
+		Sum = Coef[Radius] * Center[Index];
+		for(int32_t k = 1; k <= Radius; k++)
+			Sum += Coef[Radius + k] * (Center[Index - k * Channels] + Center[Index + k * Channels]);
+
+		Blur[Index] = Sum;
+	}
+}
+/*******************************************************************************/
+/* Receive "sharpen_work_t" type. For each strip of SHARPEN_STRIP_WIDTH pixels and each
+   row, kernels are applied vertically to a line buffer (strip plus margins), then
+   horizontally, and the blurs are combined with the source before the next row */
+static void *sharpen_strips(void *ThreadArg)
+{
+	sharpen_work_t *Args = (sharpen_work_t *)ThreadArg;
+
+	int32_t			Width = Args->InputImage->Width;
+	int32_t			Height = Args->InputImage->Height;
+	int32_t			Channels = Args->Channels;
+	int32_t			Halo = Args->Radius[0];
+	int32_t			StripEnd, First, Last, Origin, Source;
+	int32_t			LineLength;
+	float			*Line[2], *Blur[2];
+	float			Detail;
+	const uint8_t	*Pixel;
+	uint8_t			*Destination;
+
+	if((Args->Kernels == 2) && (Args->Radius[1] > Halo))
+		Halo = Args->Radius[1];
+
+	const uint8_t	*Rows[2 * Halo + 1];
+
+	LineLength = (SHARPEN_STRIP_WIDTH + 2 * Halo) * Channels;
+	for(int32_t k = 0; k < Args->Kernels; k++)
+	{
+		Line[k] = Args->Buffer + (size_t)k * (LineLength + SHARPEN_STRIP_WIDTH * Channels);
+		Blur[k] = Line[k] + LineLength;
+	}
+
+	for(int32_t StripStart = 0; StripStart < Width; StripStart += SHARPEN_STRIP_WIDTH)
+	{
+		StripEnd = (StripStart + SHARPEN_STRIP_WIDTH < Width) ? StripStart + SHARPEN_STRIP_WIDTH : Width;
+
+		/* Line position 0 is column Origin. Columns [First:Last[ are inside the image */
+		Origin = StripStart - Halo;
+		First = (Origin > 0) ? Origin : 0;
+		Last = (StripEnd + Halo < Width) ? StripEnd + Halo : Width;
+
+		for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+		{
+			for(int32_t k = 0; k < Args->Kernels; k++)
+			{
+				for(int32_t j = -Args->Radius[k]; j <= Args->Radius[k]; j++)
+				{
+					Source = border_index(Row + j, Height, Args->Border);
+					Rows[j + Args->Radius[k]] = ((Source < 0) ? Args->BorderRow : byte_row(Args->InputImage, Source)) +
+					                            First * Channels;
+				}
+
+				sharpen_columns(Rows, Args->Coef[k], Args->Radius[k], Line[k] + (First - Origin) * Channels,
+				                (Last - First) * Channels);
+
+				/* Margins outside the image */
+				for(int32_t Column = Origin; Column < StripEnd + Halo; Column++)
+				{
+					if((Column >= First) && (Column < Last))
+						continue;
+
+					Source = border_index(Column, Width, Args->Border);
+					for(int32_t c = 0; c < Channels; c++)
+					{
+						Line[k][(Column - Origin) * Channels + c] = (Source < 0) ? Args->BorderValue :
+						                                            Line[k][(Source - Origin) * Channels + c];
+					}
+				}
+
+				sharpen_rows(Line[k] + Halo * Channels, Args->Coef[k], Args->Radius[k], Channels, Blur[k],
+				             (StripEnd - StripStart) * Channels);
+			}
+
+			Pixel = byte_row(Args->InputImage, Row) + StripStart * Channels;
+			Destination = byte_row(Args->OutputImage, Row) + StripStart * Channels;
+
+			for(int32_t i = 0; i < (StripEnd - StripStart) * Channels; i++)
+			{
+				if(Args->Kernels == 2)
+				{
+					Destination[i] = color_clip(128.0f + Args->Amount * (Blur[0][i] - Blur[1][i]));
+				}
+				else
+				{
+					Detail = Pixel[i] - Blur[0][i];
+					Destination[i] = (fabsf(Detail) < Args->Threshold) ? Pixel[i] : color_clip(Pixel[i] + Args->Amount * Detail);
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Blur with one (unsharp mask) or two (difference of gaussians) kernels and combine
+   with the source in a single pass using multiple threads. Return NULL if fail */
+static img_t *run_sharpen(img_t *Img, const float *Sigma, int32_t Kernels, float Amount, float Threshold,
+                          int Border, int32_t ThreadsNum)
+{
+	sharpen_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	sharpen_work_t	Setup;
+	img_t			*OutputImg;
+	float			*Buffers;
+	size_t			BufferSize;
+	int32_t			Halo = 0;
+
+	Setup.Kernels = Kernels;
+	Setup.Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	Setup.Border = Border;
+	Setup.Amount = Amount;
+	Setup.Threshold = Threshold;
+	Setup.BorderValue = (Border == BORDER_WHITE) ? 255.0 : 0.0;
+	Setup.Coef[0] = NULL;
+	Setup.Coef[1] = NULL;
+
+	for(int32_t k = 0; k < Kernels; k++)
+	{
+		Setup.Radius[k] = (int32_t)ceilf(3.0 * Sigma[k]);
+		Setup.Coef[k] = (float *)malloc(sizeof(float) * (2 * Setup.Radius[k] + 1));
+		if(Setup.Radius[k] > Halo)
+			Halo = Setup.Radius[k];
+	}
+
+	BufferSize = (size_t)Kernels * ((SHARPEN_STRIP_WIDTH + 2 * Halo) + SHARPEN_STRIP_WIDTH) * Setup.Channels;
+	Buffers = (float *)malloc(sizeof(float) * BufferSize * ThreadsNum);
+	Setup.BorderRow = (uint8_t *)malloc((size_t)Img->Width * Setup.Channels);
+	OutputImg = new_BMP_as_size(Img, (Setup.Channels == 3) ? RGB_24BITS : GRAY_8BITS);
+
+	if((Setup.Coef[0] == NULL) || ((Kernels == 2) && (Setup.Coef[1] == NULL)) || (Buffers == NULL) ||
+	   (Setup.BorderRow == NULL) || (OutputImg == NULL))
+	{
+		free_img(OutputImg);
+		OutputImg = NULL;
+	}
+	else
+	{
+		for(int32_t k = 0; k < Kernels; k++)
+			gaussian_coefficients(Setup.Coef[k], Setup.Radius[k], Sigma[k]);
+
+		for(int32_t i = 0; i < Img->Width * Setup.Channels; i++)
+			Setup.BorderRow[i] = (uint8_t)Setup.BorderValue;
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			ThreadArg[i] = Setup;
+			ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+			ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+			ThreadArg[i].Buffer = Buffers + BufferSize * i;
+			ThreadArg[i].InputImage = Img;
+			ThreadArg[i].OutputImage = OutputImg;
+
+			pthread_create(&ThreadId[i], NULL, sharpen_strips, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+	}
+
+	free(Setup.Coef[0]);
+	free(Setup.Coef[1]);
+	free(Setup.BorderRow);
+	free(Buffers);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+#define CANNY_STRONG	255		/* Edge pixel */
+#define CANNY_WEAK		1		/* Candidate not yet linked to a strong edge */
+#define CANNY_LABELED	2		/* Weak candidate already labeled on band boundaries */
+
+/* Smoothed row "Row" of the image (border handled) on padded line "Smooth", i.e.
+   Smooth[-1] and Smooth[Width] also hold the border */
+static void canny_smooth_row(canny_work_t *Args, int32_t Row, float *Line, float *Blur, uint8_t *Smooth)
+{
+	int32_t			Width = Args->InputImage->Width;
+	int32_t			Height = Args->InputImage->Height;
+	int32_t			Radius = Args->Radius;
+	int32_t			Source;
+	const uint8_t	*Rows[2 * Radius + 1];
+
+	Source = border_index(Row, Height, Args->Border);
+	if(Source < 0)
+	{
+		for(int32_t Column = -1; Column <= Width; Column++)
+			Smooth[Column] = (uint8_t)Args->BorderValue;
+
+		return;
+	}
+
+	for(int32_t j = -Radius; j <= Radius; j++)
+	{
+		Row = border_index(Source + j, Height, Args->Border);
+		Rows[j + Radius] = (Row < 0) ? Args->BorderRow : Args->InputImage->Pixel8[Row];
+	}
+
+	/* Line[Radius] is column 0 */
+	sharpen_columns(Rows, Args->Coef, Radius, Line + Radius, Width);
+
+	for(int32_t Column = -Radius; Column < Width + Radius; Column++)
+	{
+		if((Column >= 0) && (Column < Width))
+			continue;
+
+		Source = border_index(Column, Width, Args->Border);
+		Line[Column + Radius] = (Source < 0) ? Args->BorderValue : Line[Source + Radius];
+	}
+
+	sharpen_rows(Line + Radius, Args->Coef, Radius, 1, Blur, Width);
+
+	for(int32_t Column = 0; Column < Width; Column++)
+		Smooth[Column] = color_clip(Blur[Column]);
+
+	Source = border_index(-1, Width, Args->Border);
+	Smooth[-1] = (Source < 0) ? (uint8_t)Args->BorderValue : Smooth[Source];
+	Source = border_index(Width, Width, Args->Border);
+	Smooth[Width] = (Source < 0) ? (uint8_t)Args->BorderValue : Smooth[Source];
+}
+/*******************************************************************************/
+/* Non maximum suppression and double threshold of one row from the padded magnitude
+   rows above, at and below it. Magnitude must be a maximum along gradient direction
+   (strictly against the previous neighbour so plateaus give a single pixel) */
+static void canny_suppress_row(canny_work_t *Args, const int32_t *Up, const int32_t *Mid, const int32_t *Down,
+                               const int16_t *Gx, const int16_t *Gy, uint8_t *Output)
+{
+	int32_t	Width = Args->InputImage->Width;
+	int32_t	Before, After;
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		if(Mid[Column] <= Args->LowThreshold)
+		{
+			Output[Column] = 0;
+			continue;
+		}
+
+		switch(quantize_orientation(Gx[Column], Gy[Column], 4))
+		{
+			case 0:
+				Before = Mid[Column - 1];
+				After = Mid[Column + 1];
+				break;
+
+			case 1:
+				Before = Up[Column - 1];
+				After = Down[Column + 1];
+				break;
+
+			case 2:
+				Before = Up[Column];
+				After = Down[Column];
+				break;
+
+			default:
+				Before = Up[Column + 1];
+				After = Down[Column - 1];
+				break;
+		}
+
+		if((Mid[Column] > Before) && (Mid[Column] >= After))
+			Output[Column] = (Mid[Column] > Args->HighThreshold) ? CANNY_STRONG : CANNY_WEAK;
+		else
+			Output[Column] = 0;
+	}
+}
+/*******************************************************************************/
+/* Push pixel "Index" (counted from the first row of the band) on the stack of the thread */
+static void canny_push(canny_work_t *Args, uint32_t Index)
+{
+	if(Args->StackTop == Args->StackSize)
+	{
+		Args->StackSize *= 2;
+		Args->Stack = (uint32_t *)realloc(Args->Stack, sizeof(uint32_t) * Args->StackSize);
+		if(Args->Stack == NULL)
+		{
+			printf("Error: [canny_push()] --> Could not allocate memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	Args->Stack[Args->StackTop++] = Index;
+}
+/*******************************************************************************/
+/* Empty the stack turning 8-connected neighbours inside the band from "From" to "To"
+   and pushing them. If "Label" is not 0, popped pixels on the first or last row of
+   the band receive it */
+static void canny_flood(canny_work_t *Args, uint8_t From, uint8_t To, uint32_t Label)
+{
+	int32_t		Width = Args->InputImage->Width;
+	int32_t		Rows = Args->EndRow - Args->StartRow;
+	int32_t		Row, Column;
+	uint32_t	Index;
+	uint8_t		*Pixel;
+
+	while(Args->StackTop > 0)
+	{
+		Index = Args->Stack[--Args->StackTop];
+		Row = Index / Width;
+		Column = Index % Width;
+
+		if(Label != 0)
+		{
+			if(Row == 0)
+				Args->BoundaryLabel[Column] = Label;
+			if(Row == Rows - 1)
+				Args->BoundaryLabel[Width + Column] = Label;
+		}
+
+		for(int32_t y = Row - 1; y <= Row + 1; y++)
+		{
+			if((y < 0) || (y >= Rows))
+				continue;
+
+			Pixel = Args->OutputImage->Pixel8[Args->StartRow + y];
+			for(int32_t x = Column - 1; x <= Column + 1; x++)
+			{
+				if((x >= 0) && (x < Width) && (Pixel[x] == From))
+				{
+					Pixel[x] = To;
+					canny_push(Args, (uint32_t)(y * Width + x));
+				}
+			}
+		}
+	}
+}
+/*******************************************************************************/
+/* Receive "canny_work_t" type. Smoothing, gradient, non maximum suppression and double
+   threshold run as a pipeline over rotating line buffers, so only the edge map is
+   written. Then weak candidates are linked to strong edges inside the band and the
+   remaining ones touching the first or last row are labeled for the merge */
+static void *canny_band(void *ThreadArg)
+{
+	canny_work_t *Args = (canny_work_t *)ThreadArg;
+
+	int32_t		Width = Args->InputImage->Width;
+	int32_t		Height = Args->InputImage->Height;
+	float		*Line, *Blur;
+	uint8_t		*Smooth;
+	int16_t		*Gx, *Gy;
+	int32_t		*Magnitude;
+	int32_t		*Mag[3];
+	uint8_t		*Pixel;
+	int32_t		Slot, Step;
+
+	Line = (float *)malloc(sizeof(float) * (Width + 2 * Args->Radius));
+	Blur = (float *)malloc(sizeof(float) * Width);
+	Smooth = (uint8_t *)malloc(3 * (Width + 2));
+	Gx = (int16_t *)malloc(sizeof(int16_t) * 3 * Width);
+	Gy = (int16_t *)malloc(sizeof(int16_t) * 3 * Width);
+	Magnitude = (int32_t *)calloc(3 * (Width + 2), sizeof(int32_t));
+	if((Line == NULL) || (Blur == NULL) || (Smooth == NULL) || (Gx == NULL) || (Gy == NULL) || (Magnitude == NULL))
+	{
+		printf("Error: [canny_band()] --> Could not allocate line buffers.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Row "r" goes to slot (r + 3) % 3 of each ring. Magnitude is 0 outside the image */
+	if(Args->StartRow < Args->EndRow)
+	{
+		canny_smooth_row(Args, Args->StartRow - 2, Line, Blur, Smooth + ((Args->StartRow + 1) % 3) * (Width + 2) + 1);
+		canny_smooth_row(Args, Args->StartRow - 1, Line, Blur, Smooth + ((Args->StartRow + 2) % 3) * (Width + 2) + 1);
+	}
+
+	for(int32_t Row = Args->StartRow - 1; (Args->StartRow < Args->EndRow) && (Row <= Args->EndRow); Row++)
+	{
+		canny_smooth_row(Args, Row + 1, Line, Blur, Smooth + ((Row + 4) % 3) * (Width + 2) + 1);
+
+		for(int32_t i = 0; i < 3; i++)
+			Mag[i] = Magnitude + ((Row + 1 + i) % 3) * (Width + 2) + 1;	/* Rows - 2, - 1 and 0 */
+
+		Slot = (Row + 3) % 3;
+		if((Row >= 0) && (Row < Height))
+		{
+			gradient_row(Smooth + ((Row + 2) % 3) * (Width + 2) + 1, Smooth + Slot * (Width + 2) + 1,
+			             Smooth + ((Row + 4) % 3) * (Width + 2) + 1, Width, Args->Operator,
+			             Gx + Slot * Width, Gy + Slot * Width);
+
+			for(int32_t Column = 0; Column < Width; Column++)
+			{
+				int32_t X = Gx[Slot * Width + Column];
+				int32_t Y = Gy[Slot * Width + Column];
+
+				if(Args->Norm == GRADIENT_L2)
+					Mag[2][Column] = (int32_t)sqrtf((float)(X * X + Y * Y));
+				else
+					Mag[2][Column] = abs(X) + abs(Y);
+			}
+		}
+		else
+		{
+			for(int32_t Column = 0; Column < Width; Column++)
+				Mag[2][Column] = 0;
+		}
+
+		if(Row > Args->StartRow)
+		{
+			Slot = (Row + 2) % 3;
+			canny_suppress_row(Args, Mag[0], Mag[1], Mag[2], Gx + Slot * Width, Gy + Slot * Width,
+			                   Args->OutputImage->Pixel8[Row - 1]);
+		}
+	}
+
+	free(Line);
+	free(Blur);
+	free(Smooth);
+	free(Gx);
+	free(Gy);
+	free(Magnitude);
+
+	/* Hysteresis inside the band */
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Pixel = Args->OutputImage->Pixel8[Row];
+		for(int32_t Column = 0; Column < Width; Column++)
+		{
+			if(Pixel[Column] == CANNY_STRONG)
+			{
+				canny_push(Args, (uint32_t)((Row - Args->StartRow) * Width + Column));
+				canny_flood(Args, CANNY_WEAK, CANNY_STRONG, 0);
+			}
+		}
+	}
+
+	/* Label weak candidates reaching the first or last row */
+	Args->Used = 0;
+	Step = (Args->EndRow - Args->StartRow > 1) ? Args->EndRow - Args->StartRow - 1 : 1;
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row += Step)
+	{
+		Pixel = Args->OutputImage->Pixel8[Row];
+		for(int32_t Column = 0; Column < Width; Column++)
+		{
+			if(Pixel[Column] != CANNY_WEAK)
+				continue;
+
+			uint32_t Label = Args->Base + Args->Used++;
+
+			Args->Parent[Label] = Label;
+			Args->Strong[Label] = 0;
+			Args->Seed[Label] = (uint32_t)((Row - Args->StartRow) * Width + Column);
+
+			Pixel[Column] = CANNY_LABELED;
+			canny_push(Args, Args->Seed[Label]);
+			canny_flood(Args, CANNY_WEAK, CANNY_LABELED, Label);
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "canny_work_t" type. Labeled candidates connected to strong edges of other
+   bands become edges and every other candidate is removed */
+static void *canny_finish(void *ThreadArg)
+{
+	canny_work_t *Args = (canny_work_t *)ThreadArg;
+
+	int32_t		Width = Args->InputImage->Width;
+	uint32_t	Index;
+	uint8_t		*Pixel;
+
+	for(uint32_t Label = Args->Base; Label < Args->Base + Args->Used; Label++)
+	{
+		Index = Args->Seed[Label];
+		Pixel = Args->OutputImage->Pixel8[Args->StartRow + Index / Width] + Index % Width;
+		if((Args->Strong[Label] == 0) || (*Pixel != CANNY_LABELED))
+			continue;
+
+		*Pixel = CANNY_STRONG;
+		canny_push(Args, Index);
+		canny_flood(Args, CANNY_LABELED, CANNY_STRONG, 0);
+	}
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Pixel = Args->OutputImage->Pixel8[Row];
+		for(int32_t Column = 0; Column < Width; Column++)
+		{
+			if(Pixel[Column] != CANNY_STRONG)
+				Pixel[Column] = 0;
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Join labeled candidates of the last row of a band ("Up") with the first row of the
+   band below ("Down"). Candidates touching a strong edge are flagged */
+static void canny_link_bands(canny_work_t *Up, canny_work_t *Down)
+{
+	int32_t		Width = Down->InputImage->Width;
+	uint8_t		*Above = Down->OutputImage->Pixel8[Down->StartRow - 1];
+	uint8_t		*Below = Down->OutputImage->Pixel8[Down->StartRow];
+	uint32_t	*UpLabel = Up->BoundaryLabel + Width;
+	uint32_t	*DownLabel = Down->BoundaryLabel;
+
+	for(int32_t Column = 0; Column < Width; Column++)
+	{
+		if(Below[Column] == 0)
+			continue;
+
+		for(int32_t x = Column - 1; x <= Column + 1; x++)
+		{
+			if((x < 0) || (x >= Width) || (Above[x] == 0))
+				continue;
+
+			if(Below[Column] == CANNY_LABELED)
+			{
+				if(Above[x] == CANNY_STRONG)
+					Down->Strong[DownLabel[Column]] = 1;
+				else if(Above[x] == CANNY_LABELED)
+					merge_labels(Down->Parent, DownLabel[Column], UpLabel[x]);
+			}
+			else if((Below[Column] == CANNY_STRONG) && (Above[x] == CANNY_LABELED))
+			{
+				Down->Strong[UpLabel[x]] = 1;
+			}
+		}
+	}
+}
+/*******************************************************************************/
+/* Window [Top:Bottom[ x [Left:Right[ sum of a 32 or 64 bits summed-area table */
+static inline uint32_t window_sum_u32(integral_t *Table, int32_t Top, int32_t Left, int32_t Bottom, int32_t Right)
+{
+	const uint32_t	*Upper = Table->Sum32 + (size_t)Top * Table->Width;
+	const uint32_t	*Lower = Table->Sum32 + (size_t)Bottom * Table->Width;
+
+	return Lower[Right] - Lower[Left] - Upper[Right] + Upper[Left];
+}
+
+static inline uint64_t window_sum_u64(integral_t *Table, int32_t Top, int32_t Left, int32_t Bottom, int32_t Right)
+{
+	const uint64_t	*Upper = Table->Sum64 + (size_t)Top * Table->Width;
+	const uint64_t	*Lower = Table->Sum64 + (size_t)Bottom * Table->Width;
+
+	return Lower[Right] - Lower[Left] - Upper[Right] + Upper[Left];
+}
+
+static inline double window_sum_double(integral_t *Table, int32_t Top, int32_t Left, int32_t Bottom, int32_t Right)
+{
+	const double	*Upper = Table->SumDouble + (size_t)Top * Table->Width;
+	const double	*Lower = Table->SumDouble + (size_t)Bottom * Table->Width;
+
+	return Lower[Right] - Lower[Left] - Upper[Right] + Upper[Left];
+}
+/*******************************************************************************/
+/* Receive "guided_work_t" type. Linear coefficients a = cov(I, p) / (var(I) + Epsilon)
+   and b = mean(p) - a * mean(I) of the window around each pixel (clipped at the image
+   borders) go straight to the row prefix sums of tables "A" and "B" */
+static void *guided_coefficients(void *ThreadArg)
+{
+	guided_work_t *Args = (guided_work_t *)ThreadArg;
+
+	int32_t	ImgWidth = Args->InputImage->Width;
+	int32_t	ImgHeight = Args->InputImage->Height;
+	int32_t	Radius = Args->Radius;
+	int32_t	Top, Bottom, Left, Right;
+	double	*RowA, *RowB;
+	double	AccA, AccB;
+	double	Scale, MeanI, MeanP, Variance, Covariance, a;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Top = (Row - Radius > 0) ? Row - Radius : 0;
+		Bottom = (Row + Radius + 1 < ImgHeight) ? Row + Radius + 1 : ImgHeight;
+
+		RowA = Args->A->SumDouble + (size_t)(Row + 1) * Args->A->Width;
+		RowB = Args->B->SumDouble + (size_t)(Row + 1) * Args->B->Width;
+		RowA[0] = 0.0;
+		RowB[0] = 0.0;
+		AccA = 0.0;
+		AccB = 0.0;
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+		{
+			Left = (Column - Radius > 0) ? Column - Radius : 0;
+			Right = (Column + Radius + 1 < ImgWidth) ? Column + Radius + 1 : ImgWidth;
+			Scale = 1.0 / ((Bottom - Top) * (Right - Left));
+
+			MeanI = window_sum_u32(Args->GuideSum, Top, Left, Bottom, Right) * Scale;
+			MeanP = window_sum_u32(Args->InputSum, Top, Left, Bottom, Right) * Scale;
+			Variance = window_sum_u64(Args->GuideSqSum, Top, Left, Bottom, Right) * Scale - MeanI * MeanI;
+			Covariance = window_sum_u64(Args->CrossSum, Top, Left, Bottom, Right) * Scale - MeanI * MeanP;
+
+			a = Covariance / (Variance + Args->Epsilon);
+			AccA += a;
+			AccB += MeanP - a * MeanI;
+			RowA[Column + 1] = AccA;
+			RowB[Column + 1] = AccB;
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "guided_work_t" type. Output is mean(a) * I + mean(b) over the same windows */
+static void *guided_output(void *ThreadArg)
+{
+	guided_work_t *Args = (guided_work_t *)ThreadArg;
+
+	int32_t	ImgWidth = Args->InputImage->Width;
+	int32_t	ImgHeight = Args->InputImage->Height;
+	int32_t	Radius = Args->Radius;
+	int32_t	Top, Bottom, Left, Right;
+	double	Scale;
+	uint8_t	*Guide, *Output;
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Top = (Row - Radius > 0) ? Row - Radius : 0;
+		Bottom = (Row + Radius + 1 < ImgHeight) ? Row + Radius + 1 : ImgHeight;
+		Guide = Args->GuideImage->Pixel8[Row];
+		Output = Args->OutputImage->Pixel8[Row];
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++)
+		{
+			Left = (Column - Radius > 0) ? Column - Radius : 0;
+			Right = (Column + Radius + 1 < ImgWidth) ? Column + Radius + 1 : ImgWidth;
+			Scale = 1.0 / ((Bottom - Top) * (Right - Left));
+
+			Output[Column] = color_clip((float)((window_sum_double(Args->A, Top, Left, Bottom, Right) * Guide[Column] +
+			                                    window_sum_double(Args->B, Top, Left, Bottom, Right)) * Scale));
+		}
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Guided filter of one GRAY_8BITS plane. Tables of the guide are built by the caller and
+   reused when the plane is its own guide. Return NULL if fail */
+static img_t *run_guided(img_t *Plane, img_t *Guide, integral_t *GuideSum, integral_t *GuideSqSum,
+                         int32_t Radius, float Epsilon, int32_t ThreadsNum)
+{
+	guided_work_t	ThreadArg[ThreadsNum];
+	integral_work_t	ColumnArg[2 * ThreadsNum];
+	pthread_t		ThreadId[2 * ThreadsNum];
+	img_t			*OutputImg;
+	integral_t		*InputSum = GuideSum;
+	integral_t		*CrossSum = GuideSqSum;
+	integral_t		*A, *B;
+
+	if(Plane != Guide)
+	{
+		InputSum = build_integral(Plane, NULL, INTEGRAL_UINT32, ThreadsNum);
+		CrossSum = build_integral(Guide, Plane, INTEGRAL_UINT64, ThreadsNum);
+	}
+
+	A = new_integral(Plane->Width, Plane->Height, INTEGRAL_DOUBLE);
+	B = new_integral(Plane->Width, Plane->Height, INTEGRAL_DOUBLE);
+	OutputImg = new_BMP_as_size(Plane, GRAY_8BITS);
+
+	if((InputSum == NULL) || (CrossSum == NULL) || (A == NULL) || (B == NULL) || (OutputImg == NULL))
+	{
+		free_img(OutputImg);
+		OutputImg = NULL;
+	}
+	else
+	{
+		/* First table row is zero */
+		for(int32_t Column = 0; Column < A->Width; Column++)
+		{
+			A->SumDouble[Column] = 0.0;
+			B->SumDouble[Column] = 0.0;
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			ThreadArg[i].StartRow = i * Plane->Height/ThreadsNum;
+			ThreadArg[i].EndRow = (i + 1) * Plane->Height/ThreadsNum;
+			ThreadArg[i].Radius = Radius;
+			ThreadArg[i].Epsilon = Epsilon;
+			ThreadArg[i].GuideSum = GuideSum;
+			ThreadArg[i].InputSum = InputSum;
+			ThreadArg[i].GuideSqSum = GuideSqSum;
+			ThreadArg[i].CrossSum = CrossSum;
+			ThreadArg[i].A = A;
+			ThreadArg[i].B = B;
+			ThreadArg[i].GuideImage = Guide;
+			ThreadArg[i].InputImage = Plane;
+			ThreadArg[i].OutputImage = OutputImg;
+
+			pthread_create(&ThreadId[i], NULL, guided_coefficients, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+
+		/* Column pass of both coefficient tables */
+		for(int32_t i = 0; i < 2 * ThreadsNum; i++)
+		{
+			ColumnArg[i].Start = (i % ThreadsNum) * A->Width/ThreadsNum;
+			ColumnArg[i].End = (i % ThreadsNum + 1) * A->Width/ThreadsNum;
+			ColumnArg[i].FactorImage = NULL;
+			ColumnArg[i].Table = (i < ThreadsNum) ? A : B;
+			ColumnArg[i].InputImage = Plane;
+
+			pthread_create(&ThreadId[i], NULL, integral_columns, (void *)&ColumnArg[i]);
+		}
+
+		for(int32_t i = 0; i < 2 * ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_create(&ThreadId[i], NULL, guided_output, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+	}
+
+	if(Plane != Guide)
+	{
+		free_integral(InputSum);
+		free_integral(CrossSum);
+	}
+
+	free_integral(A);
+	free_integral(B);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Value used on the range axis: gray level or integer luma of RGB pixels */
+static inline int32_t bilateral_range(const uint8_t *Pixel, int32_t Channels)
+{
+	if(Channels == 1)
+		return Pixel[0];
+
+	return (29 * Pixel[0] + 150 * Pixel[1] + 77 * Pixel[2] + 128) >> 8;
+}
+/*******************************************************************************/
+/* Out[k] = In[k - Step] + 2 * In[k] + In[k + Step] for k on [Start:End[ with In zero
+   outside [0:Length[. Grid normalization cancels on slicing so weights are not scaled */
+static void grid_blur_span(const float *In, float *Out, size_t Start, size_t End, size_t Length, size_t Step)
+{
+	size_t	k = Start;
+
+	/* Cells without left neighbour */
+	for(; (k < End) && (k < Step); k++)
+		Out[k] = 2.0f * In[k] + ((k + Step < Length) ? In[k + Step] : 0.0f);
+
+#ifdef __SSE2__
+	__m128	Two = _mm_set1_ps(2.0f);
+
+	for(; (k + 4 <= End) && (k + 4 + Step <= Length); k += 4)
+	{
+		_mm_storeu_ps(Out + k, _mm_add_ps(_mm_add_ps(_mm_loadu_ps(In + k - Step), _mm_loadu_ps(In + k + Step)),
+		                                  _mm_mul_ps(Two, _mm_loadu_ps(In + k))));
+	}
+#endif
+
+	for(; k < End; k++)
+		Out[k] = In[k - Step] + 2.0f * In[k] + ((k + Step < Length) ? In[k + Step] : 0.0f);
+}
+/*******************************************************************************/
+/* Receive "bilateral_work_t" type. Pixels whose nearest grid row is on [StartRow:EndRow[
+   are accumulated on their nearest cell, then those grid rows are blurred along range
+   and columns. Every cell is written by a single thread */
+static void *bilateral_splat(void *ThreadArg)
+{
+	bilateral_work_t *Args = (bilateral_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int32_t		ImgHeight = Args->InputImage->Height;
+	int32_t		Channels = Args->Channels;
+	int32_t		Cell = Channels + 1;
+	size_t		Depth = (size_t)Args->GridDepth * Cell;
+	size_t		RowSize = Depth * Args->GridWidth;
+	float		Scale = 1.0f / Args->SigmaSpace;
+	float		RangeScale = 1.0f / Args->SigmaRange;
+	float		*GridRow, *Target;
+	uint8_t		*Pixel;
+	int32_t		Row, GridRowIndex;
+
+	for(size_t k = Args->StartRow * RowSize; k < Args->EndRow * RowSize; k++)
+		Args->Grid[k] = 0.0f;
+
+	Row = (int32_t)((Args->StartRow - 0.5f) * Args->SigmaSpace) - 1;
+	for(Row = (Row > 0) ? Row : 0; Row < ImgHeight; Row++)
+	{
+		GridRowIndex = (int32_t)(Row * Scale + 0.5f);
+		if(GridRowIndex < Args->StartRow)
+			continue;
+		if(GridRowIndex >= Args->EndRow)
+			break;
+
+		GridRow = Args->Grid + GridRowIndex * RowSize;
+		Pixel = byte_row(Args->InputImage, Row);
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++, Pixel += Channels)
+		{
+			Target = GridRow + (int32_t)(Column * Scale + 0.5f) * Depth +
+			         (int32_t)(bilateral_range(Pixel, Channels) * RangeScale + 0.5f) * Cell;
+
+			for(int32_t c = 0; c < Channels; c++)
+				Target[c] += Pixel[c];
+			Target[Channels] += 1.0f;
+		}
+	}
+
+	for(int32_t y = Args->StartRow; y < Args->EndRow; y++)
+	{
+		GridRow = Args->Grid + y * RowSize;
+
+		for(int32_t x = 0; x < Args->GridWidth; x++)
+			grid_blur_span(GridRow + x * Depth, Args->Line + x * Depth, 0, Depth, Depth, Cell);
+
+		grid_blur_span(Args->Line, GridRow, 0, RowSize, RowSize, Depth);
+	}
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "bilateral_work_t" type and blurs grid rows [StartRow:EndRow[ along grid rows */
+static void *bilateral_blur_rows(void *ThreadArg)
+{
+	bilateral_work_t *Args = (bilateral_work_t *)ThreadArg;
+
+	size_t	RowSize = (size_t)Args->GridWidth * Args->GridDepth * (Args->Channels + 1);
+
+	grid_blur_span(Args->Grid, Args->Blurred, Args->StartRow * RowSize, Args->EndRow * RowSize,
+	               Args->GridHeight * RowSize, RowSize);
+
+	return NULL;
+}
+/*******************************************************************************/
+/* Receive "bilateral_work_t" type. Each pixel reads the blurred grid at its position
+   (column, row and range) with trilinear interpolation and is divided by the weight */
+static void *bilateral_slice(void *ThreadArg)
+{
+	bilateral_work_t *Args = (bilateral_work_t *)ThreadArg;
+
+	int32_t		ImgWidth = Args->InputImage->Width;
+	int32_t		Channels = Args->Channels;
+	int32_t		Cell = Channels + 1;
+	size_t		Depth = (size_t)Args->GridDepth * Cell;
+	size_t		RowSize = Depth * Args->GridWidth;
+	float		Scale = 1.0f / Args->SigmaSpace;
+	float		RangeScale = 1.0f / Args->SigmaRange;
+	float		Y, X, Z, FracY, FracX, FracZ;
+	float		Weight[4];
+	float		Sum[4];
+	const float	*GridRow, *Base;
+	uint8_t		*Pixel, *Output;
+	int32_t		x0, z0;
+#ifdef __SSE2__
+	__m128		Near, Far, W;
+#endif
+
+	for(int32_t Row = Args->StartRow; Row < Args->EndRow; Row++)
+	{
+		Y = Row * Scale;
+		FracY = Y - (int32_t)Y;
+		GridRow = Args->Blurred + (int32_t)Y * RowSize;
+		Pixel = byte_row(Args->InputImage, Row);
+		Output = byte_row(Args->OutputImage, Row);
+
+		for(int32_t Column = 0; Column < ImgWidth; Column++, Pixel += Channels, Output += Channels)
+		{
+			X = Column * Scale;
+			Z = bilateral_range(Pixel, Channels) * RangeScale;
+			x0 = (int32_t)X;
+			z0 = (int32_t)Z;
+			FracX = X - x0;
+			FracZ = Z - z0;
+
+			/* Corners (x0, y0), (x0 + 1, y0), (x0, y0 + 1) and (x0 + 1, y0 + 1) at z0 */
+			Base = GridRow + x0 * Depth + z0 * Cell;
+			Weight[0] = (1.0f - FracY) * (1.0f - FracX);
+			Weight[1] = (1.0f - FracY) * FracX;
+			Weight[2] = FracY * (1.0f - FracX);
+			Weight[3] = FracY * FracX;
+
+#ifdef __SSE2__
+			if(Channels == 1)
+			{
+				/* One load holds (sum, weight) at z0 and z0 + 1 */
+				W = _mm_set1_ps(Weight[0]);
+				Near = _mm_mul_ps(W, _mm_loadu_ps(Base));
+				W = _mm_set1_ps(Weight[1]);
+				Near = _mm_add_ps(Near, _mm_mul_ps(W, _mm_loadu_ps(Base + Depth)));
+				W = _mm_set1_ps(Weight[2]);
+				Near = _mm_add_ps(Near, _mm_mul_ps(W, _mm_loadu_ps(Base + RowSize)));
+				W = _mm_set1_ps(Weight[3]);
+				Near = _mm_add_ps(Near, _mm_mul_ps(W, _mm_loadu_ps(Base + RowSize + Depth)));
+
+				Near = _mm_mul_ps(Near, _mm_set_ps(FracZ, FracZ, 1.0f - FracZ, 1.0f - FracZ));
+				Near = _mm_add_ps(Near, _mm_movehl_ps(Near, Near));
+			}
+			else
+			{
+				W = _mm_set1_ps(Weight[0]);
+				Near = _mm_mul_ps(W, _mm_loadu_ps(Base));
+				Far = _mm_mul_ps(W, _mm_loadu_ps(Base + 4));
+				W = _mm_set1_ps(Weight[1]);
+				Near = _mm_add_ps(Near, _mm_mul_ps(W, _mm_loadu_ps(Base + Depth)));
+				Far = _mm_add_ps(Far, _mm_mul_ps(W, _mm_loadu_ps(Base + Depth + 4)));
+				W = _mm_set1_ps(Weight[2]);
+				Near = _mm_add_ps(Near, _mm_mul_ps(W, _mm_loadu_ps(Base + RowSize)));
+				Far = _mm_add_ps(Far, _mm_mul_ps(W, _mm_loadu_ps(Base + RowSize + 4)));
+				W = _mm_set1_ps(Weight[3]);
+				Near = _mm_add_ps(Near, _mm_mul_ps(W, _mm_loadu_ps(Base + RowSize + Depth)));
+				Far = _mm_add_ps(Far, _mm_mul_ps(W, _mm_loadu_ps(Base + RowSize + Depth + 4)));
+
+				Near = _mm_add_ps(_mm_mul_ps(Near, _mm_set1_ps(1.0f - FracZ)), _mm_mul_ps(Far, _mm_set1_ps(FracZ)));
+			}
+
+			_mm_storeu_ps(Sum, Near);
+#else
+			for(int32_t c = 0; c < Cell; c++)
+			{
+				Sum[c] = (1.0f - FracZ) * (Weight[0] * Base[c] + Weight[1] * Base[Depth + c] +
+				                           Weight[2] * Base[RowSize + c] + Weight[3] * Base[RowSize + Depth + c]) +
+				         FracZ * (Weight[0] * Base[Cell + c] + Weight[1] * Base[Depth + Cell + c] +
+				                  Weight[2] * Base[RowSize + Cell + c] + Weight[3] * Base[RowSize + Depth + Cell + c]);
+			}
+#endif
+
+			for(int32_t c = 0; c < Channels; c++)
+				Output[c] = (Sum[Channels] > 0.0f) ? color_clip(Sum[c] / Sum[Channels]) : Pixel[c];
+		}
+	}
+
+	return NULL;
+}
+/*=============================================================================*/
+/*##########                     MAIN FUNCTIONS                      ##########*/
+/*=============================================================================*/
+/*******************************************************************************/
+/* Convert RGB to grayscale. Return NULL on failure.
+	(method: channels average) ==> GRAY_AVERAGE
+	Pixel = (Red + Green + Blue)/3
+	(method: channel-dependent luminance perception) ==> GRAY_LUMI_PERCEP
+	Pixel = (0.2126Red + 0.7152Green + 0.0722Blue)/1
+	(method: linear aproximation of gamma and luminance perception) ==> GRAY_APROX_GAM_LUMI_PERCEP
+	Pixel = (0.299Red + 0.587Green + 0.114Blue)/1 */
+img_t *RGB_to_grayscale(img_t *InputImage, int Method)
+{
+	return parallel_RGB_to_grayscale(InputImage, Method, 1);
+}
+/*******************************************************************************/
+/* Convert RGB to grayscale using multiple threads. Return NULL if fail
+   Weights are applied in 15 bits fixed point and the result is rounded. Rows are
+   split among threads and 32 pixels are converted at a time with SIMD.
+	Method  --> GRAY_AVERAGE               (channels average)
+	            GRAY_LUMI_PERCEP           (channel-dependent luminance perception)
+	            GRAY_APROX_GAM_LUMI_PERCEP (linear aproximation of gamma and luminance perception)
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *parallel_RGB_to_grayscale(img_t *InputImage, int Method, int32_t ThreadsNum)
+{
+	if((InputImage == NULL) || (InputImage->Pixel24 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	gray_work_t	ThreadArg[ThreadsNum];
+	pthread_t	ThreadId[ThreadsNum];
+	uint16_t	Weights[3];
+	img_t		*OutImg;
+
+	if(gray_weights(Method, Weights) == -1)
+	{
+		printf("Error: invalid \"Method\" input on RGB_to_grayscale function. Should be:\n");
+		printf("       GRAY_AVERAGE, GRAY_LUMI_PERCEP or GRAY_APROX_GAM_LUMI_PERCEP\n\n");
+		return NULL;
+	}
+
+	OutImg = new_BMP_as_size(InputImage, GRAY_8BITS);
+	if(OutImg == NULL)
+		return NULL;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * InputImage->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * InputImage->Height/ThreadsNum;
+		ThreadArg[i].Weights = Weights;
+		ThreadArg[i].InputImage = InputImage;
+		ThreadArg[i].OutputImage = OutImg;
+
+		pthread_create(&ThreadId[i], NULL, gray_convert, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return OutImg;
+}
+/*******************************************************************************/
+/* Read BMP image converting rows to grayscale while they are decoded, so the 24 bits
+   image is never stored. Result is the same of "RGB_to_grayscale". Return NULL if fail
+	Method --> GRAY_AVERAGE, GRAY_LUMI_PERCEP or GRAY_APROX_GAM_LUMI_PERCEP */
+img_t *read_BMP_gray(const char *Filename, int Method)
+{
+	FILE		*ImageFile;
+	img_t		*OutImg;
+	uint8_t		*Line;
+	uint16_t	Weights[3];
+	int32_t		Width, Height;
+	size_t		LineSize;
+
+	if(gray_weights(Method, Weights) == -1)
+	{
+		printf("Error: [read_BMP_gray()] --> Invalid \"Method\" input.\n\n");
+		return NULL;
+	}
+
+	ImageFile = open_BMP(Filename, &Width, &Height);
+	if(ImageFile == NULL)
+		return NULL;
+
+	/* File rows are padded to 4 bytes */
+	LineSize = ((3 * (size_t)Width + 3) / 4) * 4;
+
+	OutImg = new_BMP(Width, Height, GRAY_8BITS);
+	Line = (uint8_t *)malloc(LineSize);
+
+	if((OutImg == NULL) || (Line == NULL))
+	{
+		printf("Error: [read_BMP_gray()] --> Could not allocate memory.\n\n");
+		free_img(OutImg);
+		free(Line);
+		fclose(ImageFile);
+		return NULL;
+	}
+
+	for(int32_t Row = 0; Row < Height; Row++)
+	{
+		if(fread(Line, 1, LineSize, ImageFile) != LineSize)
+		{
+			printf("Error: [read_BMP_gray()] --> Could not read pixel values from file.\n\n");
+			free_img(OutImg);
+			free(Line);
+			fclose(ImageFile);
+			return NULL;
+		}
+
+		gray_row((pixel24_t *)Line, OutImg->Pixel8[Row], Width, Weights);
+	}
+
+	free(Line);
+	fclose(ImageFile);
+
+	return OutImg;
+}
+
+/*******************************************************************************/
+/* Channel pass filter. Return -1 if fail or 0 on success.
+	ChannelSelect --> PASS_RED_CHANNEL
+	                  PASS_GREEN_CHANNEL
+	                  PASS_BLUE_CHANNEL */
+img_t *channel_pass_filter(img_t *InputImage, int ChannelSelect)
+{
+	if(InputImage == NULL)
+		return NULL;
+
+	img_t	*OutImg;
+
+	OutImg = new_BMP_as_size(InputImage, RGB_24BITS);
+
+	switch(ChannelSelect)
+	{
+		case PASS_RED_CHANNEL :
+			for(int32_t Row = 0; Row < InputImage->Height; Row++)
+			{
+				for(int32_t Column = 0; Column < InputImage->Width; Column++)
+				{
+					OutImg->Pixel24[Row][Column].Red = InputImage->Pixel24[Row][Column].Red;
+					OutImg->Pixel24[Row][Column].Green = 0;
+					OutImg->Pixel24[Row][Column].Blue = 0;
+				}
+			}
+			break;
+			
+		case PASS_GREEN_CHANNEL :
+			for(int32_t Row = 0; Row < InputImage->Height; Row++)
+			{
+				for(int32_t Column = 0; Column < InputImage->Width; Column++)
+				{
+					OutImg->Pixel24[Row][Column].Red = 0;
+					OutImg->Pixel24[Row][Column].Green = InputImage->Pixel24[Row][Column].Green;
+					OutImg->Pixel24[Row][Column].Blue = 0;
+				}
+			}
+			break;
+			
+		case PASS_BLUE_CHANNEL :
+			for(int32_t Row = 0; Row < InputImage->Height; Row++)
+			{
+				for(int Column = 0; Column < InputImage->Width; Column++)
+				{
+					OutImg->Pixel24[Row][Column].Red = 0;
+					OutImg->Pixel24[Row][Column].Green = 0;
+					OutImg->Pixel24[Row][Column].Blue = InputImage->Pixel24[Row][Column].Blue;
+				}
+			}
+			break;
+			
+		default :
+			printf("Error: invalid \"ChannelSelect\" input on channel_pass_filter function. Should be:\n");
+			printf("       PASS_RED_CHANNEL, PASS_GREEN_CHANNEL or PASS_BLUE_CHANNEL\n\n");
+			free_img(OutImg);
+			return NULL;
+	}
+
+	return OutImg;
+}
+/*******************************************************************************/
+/* Frees memory allocated by the kernel template */
+void free_kernel(kernel_t *Kernel)
+{
+	for (int32_t Row = 0; Row < Kernel->Height; Row++)
+	{
+		free(Kernel->Weight[Row]);
+	}
+	free(Kernel->Weight);
+	free(Kernel);
+}
+/*******************************************************************************/
+/* Create a sparse kernel holding only the non-zero taps of given kernel.
+   Return NULL if fail */
+sparse_kernel_t *create_sparse_kernel(kernel_t *Kernel)
+{
+	if(Kernel == NULL)
+		return NULL;
+
+	sparse_kernel_t	*SparseKernel;
+	int32_t			NumTaps = 0;
+
+	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Kernel->Width; Column++)
+		{
+			if(Kernel->Weight[Row][Column] != 0.0)
+				NumTaps++;
+		}
+	}
+
+	SparseKernel = (sparse_kernel_t *)malloc(sizeof(sparse_kernel_t));
+	if(SparseKernel == NULL)
+		return NULL;
+
+	/* Allocate at least one tap so an all-zero kernel is still valid */
+	SparseKernel->Tap = (sparse_tap_t *)malloc(sizeof(sparse_tap_t) * (NumTaps > 0 ? NumTaps : 1));
+	if(SparseKernel->Tap == NULL)
+	{
+		free(SparseKernel);
+		return NULL;
+	}
+
+	SparseKernel->Height = Kernel->Height;
+	SparseKernel->Width = Kernel->Width;
+	SparseKernel->NumTaps = 0;
+
+	/* Offsets are precomputed relative to the kernel center */
+	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Kernel->Width; Column++)
+		{
+			if(Kernel->Weight[Row][Column] != 0.0)
+			{
+				SparseKernel->Tap[SparseKernel->NumTaps].RowOffset = Row - Kernel->Height/2;
+				SparseKernel->Tap[SparseKernel->NumTaps].ColumnOffset = Column - Kernel->Width/2;
+				SparseKernel->Tap[SparseKernel->NumTaps].Weight = Kernel->Weight[Row][Column];
+				SparseKernel->NumTaps++;
+			}
+		}
+	}
+
+	return SparseKernel;
+}
+/*******************************************************************************/
+/* Frees memory allocated by the sparse kernel */
+void free_sparse_kernel(sparse_kernel_t *Kernel)
+{
+	if(Kernel == NULL)
+		return;
+
+	free(Kernel->Tap);
+	free(Kernel);
+}
+/*******************************************************************************/
+/* Create a low pass filter kernel with given odd dimension. Return NULL if fail
+   Type --> NEIGHBOR_AVERAGE */
+kernel_t *create_kernel_low_pass_filter(int32_t Height, int32_t Width, int Type)
+{
+	kernel_t	*Kernel;
+
+	/* Check if dimensions are odd */
+	if(((Height % 2) == 0) || ((Width % 2) == 0))
+	{
+		printf("Error: kernel dimensions need to be odd.\n");
+		return NULL;
+	}
+
+	/* Allocating kernel */
+	Kernel = (kernel_t *)malloc(sizeof(kernel_t));
+	Kernel->Weight = (float **)malloc(sizeof(float *) * Height);
+	for(int32_t Row = 0; Row < Height; Row++)
+	{
+		Kernel->Weight[Row] = (float *)malloc(sizeof(float) * Width);
+	}
+
+	/* Assingning values */
+	Kernel->Height = Height;
+	Kernel->Width = Width;
+
+	switch(Type)
+	{
+		case NEIGHBOR_AVERAGE:
+			for(int32_t Row = 0; Row < Height; Row++)
+			{
+				for(int32_t Column = 0; Column < Width; Column++)
+				{
+					Kernel->Weight[Row][Column] = 1.0/(Height * Width);
+				}
+			}
+			break;
+
+		case GAUSSIAN_FILTER:
+		{
+			/* Sigma derived from kernel size for each dimension */
+			float	SigmaY = 0.3 * ((Height - 1) * 0.5 - 1) + 0.8;
+			float	SigmaX = 0.3 * ((Width - 1) * 0.5 - 1) + 0.8;
+			float	CoefY[Height];
+			float	CoefX[Width];
+
+			gaussian_coefficients(CoefY, Height/2, SigmaY);
+			gaussian_coefficients(CoefX, Width/2, SigmaX);
+
+			for(int32_t Row = 0; Row < Height; Row++)
+			{
+				for(int32_t Column = 0; Column < Width; Column++)
+				{
+					Kernel->Weight[Row][Column] = CoefY[Row] * CoefX[Column];
+				}
+			}
+			break;
+		}
+
+		default:
+			free_kernel(Kernel);
+			printf("Error: Type not supported on low pass kernel creation.\n");
+			return NULL;
+	}
+
+	return Kernel;
+}
+/*******************************************************************************/
+/* Create a high pass filter kernel with given odd dimension. Return NULL if fail
+   Type --> LAPLACIAN_OPERATOR */
+kernel_t *create_kernel_high_pass_filter(int32_t Height, int32_t Width, int Type)
+{
+	kernel_t	*Kernel;
+
+	/* Check if dimensions are odd */
+	if(((Height % 2) == 0) || ((Width % 2) == 0))
+	{
+		printf("Error: kernel dimensions need to be odd.\n");
+		return NULL;
+	}	
+
+	/* Allocating kernel */
+	Kernel = (kernel_t *)malloc(sizeof(kernel_t));
+	Kernel->Weight = (float **)malloc(sizeof(float *) * Height);
+	for(int32_t Row = 0; Row < Height; Row++)
+	{
+		Kernel->Weight[Row] = (float *)malloc(sizeof(float) * Width);
+	}
+
+	/* Assingning values */
+	Kernel->Height = Height;
+	Kernel->Width = Width;
+
+	switch(Type)
+	{
+		case LAPLACIAN_OPERATOR_NORM:
+			for(int32_t Row = 0; Row < Height; Row++)
+			{
+				for(int32_t Column = 0; Column < Width; Column++)
+				{
+					if((Row == Height/2) && (Column == Width/2))
+					{
+						Kernel->Weight[Row][Column] = ((Height * Width) - 1)/(Height * Width);
+					}
+					else
+					{
+						Kernel->Weight[Row][Column] = -1.0/(Height * Width);
+					}
+				}
+			}
+			break;
+
+		case LAPLACIAN_OPERATOR:
+			for(int32_t Row = 0; Row < Height; Row++)
+			{
+				for(int32_t Column = 0; Column < Width; Column++)
+				{
+					if((Row == Height/2) && (Column == Width/2))
+					{
+						Kernel->Weight[Row][Column] = ((Height * Width) - 1);
+					}
+					else
+					{
+						Kernel->Weight[Row][Column] = -1.0;
+					}
+				}
+			}
+			break;
+
+		default:
+			free_kernel(Kernel);
+			printf("Error: Type not supported on high pass kernel creation.\n");
+			return NULL;
+	}
+
+	return Kernel;
+}
+/*******************************************************************************/
+/* Makes cross correlation betwen the kernel and image using multiple threads.
+   Return NULL if fail
+	Img     --> Pointer to source image. This image will also be the output.
+	Kernel  --> Pointer to the the kernel to be used.
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *parallel_cross_correlation(img_t *Img, kernel_t *Kernel, int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || (Kernel == NULL) || (ThreadsNum < 1) || (Img->Pixel8 == NULL))
+		return NULL;
+
+	return auto_cross_correlation(Img, Kernel, ThreadsNum, Border);
+}
+/*******************************************************************************/
+/* Makes convolution betwen the kernel and image using multiple threads.
+   Return NULL if fail
+	Img     --> Pointer to source image. This image will also be the output.
+	Kernel  --> Pointer to the the kernel to be used.
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
 img_t *parallel_convolution(img_t *Img, kernel_t *Kernel, int32_t ThreadsNum, int Border)
 {
-	if((Img == NULL) || (Kernel == NULL) || (ThreadsNum < 1) || (Img->Pixel8 == NULL))
+	if((Img == NULL) || (Kernel == NULL) || (ThreadsNum < 1) || (Img->Pixel8 == NULL))
+		return NULL;
+
+	img_t				*OutputImg;
+
+	int32_t				TmpRow, TmpCol;
+	kernel_t			*NewKernel;
+
+	/* Allocate memory for convolution kernel */
+	NewKernel = (kernel_t *)malloc(sizeof(kernel_t));
+
+	NewKernel->Height = Kernel->Height;
+	NewKernel->Width = Kernel->Width;
+			
+	NewKernel->Weight = (float **)malloc(sizeof(float *) * Kernel->Height);
+	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	{
+		NewKernel->Weight[Row] = (float *)malloc(sizeof(float) * Kernel->Width);
+	}
+
+	/* Convolution is a cross correlation with the kernel matrix rotated 180° */
+	/* Rotating kernel matrix 180° */
+	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Kernel->Width; Column++)
+		{
+			TmpRow = Kernel->Height - (1 + Row);
+			TmpCol = Kernel->Width - (1 + Column);
+			NewKernel->Weight[Row][Column] = Kernel->Weight[TmpRow][TmpCol];
+		}
+	}
+
+
+	OutputImg = auto_cross_correlation(Img, NewKernel, ThreadsNum, Border);
+
+	free_kernel(NewKernel);
+	
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Makes cross correlation betwen a sparse kernel and image using multiple threads.
+   Only the non-zero taps are visited. Return NULL if fail
+	Img     --> Pointer to source image.
+	Kernel  --> Pointer to the the sparse kernel to be used.
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *parallel_sparse_cross_correlation(img_t *Img, sparse_kernel_t *Kernel, int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || (Kernel == NULL) || (ThreadsNum < 1) || (Img->Pixel8 == NULL))
+		return NULL;
+
+	return run_cross_correlation(Img, NULL, Kernel, ThreadsNum, Border);
+}
+/*******************************************************************************/
+/* Generate the histogram for a given image and print it */
+void histogram(img_t *Img)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL))
+	{
+		printf("Error: [histogram()] --> Invalid image argument.\n\n");
+		return;
+	}
+
+	uint32_t	Gray[256] = {0};
+	uint32_t	NumPixel = Img->Height * Img->Width;
+	uint32_t	MaxSamePixel = 0;
+	float		Percent;
+	float		NormalPercent;
+	uint8_t		HeaderFlag = 1;
+
+	/* Acquiring histogram data */
+	if(histogram_compute(Img, Gray, 1) == -1)
+		return;
+
+	for(int32_t i = 0; i < 256; i++)
+	{
+		if(Gray[i] > MaxSamePixel)
+			MaxSamePixel = Gray[i];
+	}
+
+	/* Printing histogram */
+	printf("               NORMALIZED GRAPH\n");
+	for(int32_t i = 0; i < 256; i++)
+	{
+		Percent = 100.0 * (float)Gray[i] / (float)NumPixel;
+		NormalPercent = 100.0 * (float)Gray[i] / (float)MaxSamePixel;
+		
+		for(int32_t j = 0; j < 50; j++)
+		{
+			if((j <= NormalPercent/2) && (HeaderFlag == 0))
+				printf("#");
+			else
+				printf(" ");
+		}
+		if(HeaderFlag == 0)
+			printf("| %d / %0.4f%% / %u\n", i, Percent, Gray[i]);
+		else
+		{
+			printf("| Gray / Percent / pixels\n");
+			HeaderFlag = 0;
+		}
+	}
+}
+/*******************************************************************************/
+/* Computes histogram of given image (or ROI view) using multiple threads.
+   Return -1 if fail or 0 on success
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	Hist    --> Receives the counts. GRAY_8BITS needs 256 entries. RGB_24BITS needs
+	            3*256 entries: Hist[Channel*256 + Value] with Channel one of
+	            PASS_RED_CHANNEL, PASS_GREEN_CHANNEL or PASS_BLUE_CHANNEL
+	Threads --> Number of threads to be used in parallel on computacion */
+int histogram_compute(img_t *Img, uint32_t *Hist, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) ||
+	   (Hist == NULL) || (ThreadsNum < 1))
+	{
+		printf("Error: [histogram_compute()] --> Invalid arguments.\n\n");
+		return -1;
+	}
+
+	histogram_work_t	ThreadArg[ThreadsNum];
+	pthread_t			ThreadId[ThreadsNum];
+	uint32_t			*Partial;
+	int32_t				Entries = (Img->Pixel8 != NULL) ? 256 : 3 * 256;
+
+	Partial = (uint32_t *)malloc(sizeof(uint32_t) * Entries * ThreadsNum);
+	if(Partial == NULL)
+	{
+		printf("Error: [histogram_compute()] --> Could not allocate memory.\n\n");
+		return -1;
+	}
+
+	/* Creating threads arguments and starting threads */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+		ThreadArg[i].Hist = Partial + i * Entries;
+		ThreadArg[i].InputImage = Img;
+
+		pthread_create(&ThreadId[i], NULL, histogram_count, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	/* Merging per thread histograms */
+	for(int32_t j = 0; j < Entries; j++)
+	{
+		Hist[j] = 0;
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+			Hist[j] += Partial[i * Entries + j];
+	}
+
+	free(Partial);
+
+	return 0;
+}
+/*******************************************************************************/
+/* Gaussian smoothing of a grayscale image using multiple threads. Return NULL if fail
+   Sigma below GAUSSIAN_IIR_SIGMA uses a separable FIR kernel, otherwise a recursive
+   Young - van Vliet filter is used and the cost does not depend on sigma.
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Sigma   --> Standard deviation in pixels (> 0).
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *gaussian_blur(img_t *Img, float Sigma, int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1) || !(Sigma > 0.0))
+		return NULL;
+
+	gaussian_work_t	ThreadArg[ThreadsNum];
+	img_t			*OutputImg;
+	float			*Buffer;
+	float			*Coef;
+	float			BorderValue;
+	int32_t			Radius;
+
+	if(get_border_value(Border, &BorderValue) == -1)
+	{
+		printf("Error: [gaussian_blur()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
+
+	if(Sigma < GAUSSIAN_IIR_SIGMA)
+	{
+		Radius = (int32_t)ceilf(3.0 * Sigma);
+		Coef = (float *)malloc(sizeof(float) * (2 * Radius + 1));
+	}
+	else
+	{
+		/* On IIR "Radius" is the padding after the end of each line */
+		Radius = (int32_t)ceilf(4.0 * Sigma);
+		Coef = (float *)malloc(sizeof(float) * 4);
+	}
+
+	Buffer = (float *)malloc(sizeof(float) * Img->Width * Img->Height);
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+
+	if((Coef == NULL) || (Buffer == NULL) || (OutputImg == NULL))
+	{
+		printf("Error: [gaussian_blur()] --> Could not allocate memory.\n\n");
+		free(Coef);
+		free(Buffer);
+		free_img(OutputImg);
+		return NULL;
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Radius = Radius;
+		ThreadArg[i].BorderValue = BorderValue;
+		ThreadArg[i].Coef = Coef;
+		ThreadArg[i].Buffer = Buffer;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+	}
+
+	if(Sigma < GAUSSIAN_IIR_SIGMA)
+	{
+		gaussian_coefficients(Coef, Radius, Sigma);
+
+		run_gaussian_pass(gaussian_fir_rows, ThreadArg, ThreadsNum, Img->Height);
+		run_gaussian_pass(gaussian_fir_columns, ThreadArg, ThreadsNum, Img->Height);
+	}
+	else
+	{
+		young_van_vliet_coefficients(Coef, Sigma);
+
+		run_gaussian_pass(gaussian_iir_rows, ThreadArg, ThreadsNum, Img->Height);
+		run_gaussian_pass(gaussian_iir_columns, ThreadArg, ThreadsNum, Img->Width);
+	}
+
+	free(Coef);
+	free(Buffer);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Computes gradient magnitude and optionally quantized orientation in a single pass
+   using multiple threads. Magnitude saturates at 255. Return NULL if fail
+	Img         --> Pointer to source image (GRAY_8BITS).
+	Operator    --> GRADIENT_SOBEL
+	                GRADIENT_SCHARR
+	Norm        --> GRADIENT_L1
+	                GRADIENT_L2
+	Orientation --> If not NULL receives a new GRAY_8BITS image with quantized direction
+	Bins        --> Number of orientation bins (1 to 180). Ignored if Orientation is NULL
+	Threads     --> Number of threads to be used in parallel on computacion
+	Border      --> BORDER_BLACK
+	                BORDER_WHITE */
+img_t *parallel_gradient(img_t *Img, int Operator, int Norm, img_t **Orientation, int32_t Bins,
+                         int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	gradient_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_t			*MagnitudeImg;
+	img_t			*OrientationImg = NULL;
+	float			BorderValue;
+
+	if(((Operator != GRADIENT_SOBEL) && (Operator != GRADIENT_SCHARR)) ||
+	   ((Norm != GRADIENT_L1) && (Norm != GRADIENT_L2)))
+	{
+		printf("Error: [parallel_gradient()] --> Invalid operator or norm.\n\n");
+		return NULL;
+	}
+
+	if((Orientation != NULL) && ((Bins < 1) || (Bins > 180)))
+	{
+		printf("Error: [parallel_gradient()] --> Number of orientation bins should be 1 to 180.\n\n");
+		return NULL;
+	}
+
+	if(get_border_value(Border, &BorderValue) == -1)
+	{
+		printf("Error: [parallel_gradient()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
+
+	MagnitudeImg = new_BMP_as_size(Img, GRAY_8BITS);
+	if(MagnitudeImg == NULL)
+		return NULL;
+
+	if(Orientation != NULL)
+	{
+		OrientationImg = new_BMP_as_size(Img, GRAY_8BITS);
+		if(OrientationImg == NULL)
+		{
+			free_img(MagnitudeImg);
+			return NULL;
+		}
+	}
+
+	/* Creating threads arguments and starting threads */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+		ThreadArg[i].Operator = Operator;
+		ThreadArg[i].Norm = Norm;
+		ThreadArg[i].OrientationBins = Bins;
+		ThreadArg[i].BorderValue = (uint8_t)BorderValue;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].MagnitudeImage = MagnitudeImg;
+		ThreadArg[i].OrientationImage = OrientationImg;
+
+		pthread_create(&ThreadId[i], NULL, gradient, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	if(Orientation != NULL)
+		*Orientation = OrientationImg;
+
+	return MagnitudeImg;
+}
+/*******************************************************************************/
+/* Median filter with square window of side 2*Radius+1 using multiple threads.
+   RGB images are filtered per channel. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	Radius  --> Window radius (0 to MEDIAN_MAX_RADIUS).
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *median_filter(img_t *Img, int32_t Radius, int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (ThreadsNum < 1))
+		return NULL;
+
+	median_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_t			*OutputImg;
+	float			BorderValue;
+
+	if((Radius < 0) || (Radius > MEDIAN_MAX_RADIUS))
+	{
+		printf("Error: [median_filter()] --> Radius should be 0 to %d.\n\n", MEDIAN_MAX_RADIUS);
+		return NULL;
+	}
+
+	if(get_border_value(Border, &BorderValue) == -1)
+	{
+		printf("Error: [median_filter()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
+
+	if(Img->Pixel8 != NULL)
+		OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	else
+		OutputImg = new_BMP_as_size(Img, RGB_24BITS);
+
+	if(OutputImg == NULL)
+		return NULL;
+
+	/* Creating threads arguments and starting threads (one column strip per thread) */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartColumn = i * Img->Width/ThreadsNum;
+		ThreadArg[i].EndColumn = (i + 1) * Img->Width/ThreadsNum;
+
+		ThreadArg[i].Radius = Radius;
+		ThreadArg[i].BorderValue = (uint8_t)BorderValue;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+
+		pthread_create(&ThreadId[i], NULL, median, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Grayscale morphology with a rectangular structuring element using multiple threads.
+   Return NULL if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	Operation --> MORPH_ERODE, MORPH_DILATE, MORPH_OPEN, MORPH_CLOSE,
+	              MORPH_TOPHAT or MORPH_BLACKHAT
+	Height    --> Structuring element height (>= 1). Anchor at Height/2
+	Width     --> Structuring element width (>= 1). Anchor at Width/2
+	Threads   --> Number of threads to be used in parallel on computacion
+	Border    --> BORDER_BLACK
+	              BORDER_WHITE */
+img_t *morphology(img_t *Img, int Operation, int32_t Height, int32_t Width, int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	img_t	*FirstImg;
+	img_t	*OutputImg;
+	float	BorderValue;
+	int32_t	Difference;
+
+	if((Height < 1) || (Width < 1))
+	{
+		printf("Error: [morphology()] --> Structuring element dimensions should be positive.\n\n");
+		return NULL;
+	}
+
+	if(get_border_value(Border, &BorderValue) == -1)
+	{
+		printf("Error: [morphology()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
+
+	switch(Operation)
+	{
+		case MORPH_ERODE:
+			return erode_dilate(Img, 0, Height, Width, ThreadsNum, (uint8_t)BorderValue);
+
+		case MORPH_DILATE:
+			return erode_dilate(Img, 1, Height, Width, ThreadsNum, (uint8_t)BorderValue);
+
+		case MORPH_OPEN:
+		case MORPH_TOPHAT:
+			FirstImg = erode_dilate(Img, 0, Height, Width, ThreadsNum, (uint8_t)BorderValue);
+			if(FirstImg == NULL)
+				return NULL;
+			OutputImg = erode_dilate(FirstImg, 1, Height, Width, ThreadsNum, (uint8_t)BorderValue);
+			break;
+
+		case MORPH_CLOSE:
+		case MORPH_BLACKHAT:
+			FirstImg = erode_dilate(Img, 1, Height, Width, ThreadsNum, (uint8_t)BorderValue);
+			if(FirstImg == NULL)
+				return NULL;
+			OutputImg = erode_dilate(FirstImg, 0, Height, Width, ThreadsNum, (uint8_t)BorderValue);
+			break;
+
+		default:
+			printf("Error: [morphology()] --> Invalid \"Operation\" input.\n\n");
+			return NULL;
+	}
+
+	free_img(FirstImg);
+
+	if((OutputImg == NULL) || (Operation == MORPH_OPEN) || (Operation == MORPH_CLOSE))
+		return OutputImg;
+
+	/* Top-hat transforms (differences saturate at 0) */
+	for(int32_t Row = 0; Row < Img->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < Img->Width; Column++)
+		{
+			if(Operation == MORPH_TOPHAT)
+				Difference = Img->Pixel8[Row][Column] - OutputImg->Pixel8[Row][Column];
+			else
+				Difference = OutputImg->Pixel8[Row][Column] - Img->Pixel8[Row][Column];
+
+			OutputImg->Pixel8[Row][Column] = (Difference < 0) ? 0 : (uint8_t)Difference;
+		}
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Global histogram equalization using multiple threads. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *histogram_equalization(img_t *Img, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	lut_work_t	ThreadArg[ThreadsNum];
+	pthread_t	ThreadId[ThreadsNum];
+	img_t		*OutputImg;
+	uint32_t	Hist[256];
+	uint8_t		Lut[256];
+
+	if(histogram_compute(Img, Hist, ThreadsNum) == -1)
+		return NULL;
+
+	equalization_lut(Hist, Img->Height * Img->Width, Lut);
+
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	/* Creating threads arguments and starting threads */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+		ThreadArg[i].Lut = Lut;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+
+		pthread_create(&ThreadId[i], NULL, lut_apply, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Contrast limited adaptive histogram equalization (CLAHE) using multiple threads.
+   Return NULL if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	TilesY    --> Number of tile rows (1 to image height).
+	TilesX    --> Number of tile columns (1 to image width).
+	ClipLimit --> Histogram clip as a multiple of the average bin count
+	              (values <= 0 disable clipping).
+	Threads   --> Number of threads to be used in parallel on computacion */
+img_t *clahe(img_t *Img, int32_t TilesY, int32_t TilesX, float ClipLimit, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	clahe_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_t			*OutputImg;
+	uint8_t			*Lut;
+	int32_t			*ColumnTile;
+	int32_t			*ColumnWeight;
+	int32_t			NumTiles;
+	float			PosX;
+
+	if((TilesY < 1) || (TilesX < 1) || (TilesY > Img->Height) || (TilesX > Img->Width))
+	{
+		printf("Error: [clahe()] --> Invalid number of tiles.\n\n");
+		return NULL;
+	}
+
+	NumTiles = TilesY * TilesX;
+
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	Lut = (uint8_t *)malloc(NumTiles * 256);
+	ColumnTile = (int32_t *)malloc(sizeof(int32_t) * Img->Width);
+	ColumnWeight = (int32_t *)malloc(sizeof(int32_t) * Img->Width);
+
+	if((OutputImg == NULL) || (Lut == NULL) || (ColumnTile == NULL) || (ColumnWeight == NULL))
+	{
+		printf("Error: [clahe()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		free(Lut);
+		free(ColumnTile);
+		free(ColumnWeight);
+		return NULL;
+	}
+
+	/* Horizontal interpolation is the same for every row */
+	for(int32_t Column = 0; Column < Img->Width; Column++)
+	{
+		PosX = (Column + 0.5) * TilesX / Img->Width - 0.5;
+		if(PosX < 0)
+			PosX = 0;
+
+		ColumnTile[Column] = (int32_t)PosX;
+		if(ColumnTile[Column] >= TilesX - 1)
+		{
+			ColumnTile[Column] = TilesX - 1;
+			ColumnWeight[Column] = 0;
+		}
+		else
+		{
+			ColumnWeight[Column] = (int32_t)((PosX - ColumnTile[Column]) * 256.0 + 0.5);
+		}
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].TilesY = TilesY;
+		ThreadArg[i].TilesX = TilesX;
+		ThreadArg[i].ClipLimit = ClipLimit;
+		ThreadArg[i].Lut = Lut;
+		ThreadArg[i].ColumnTile = ColumnTile;
+		ThreadArg[i].ColumnWeight = ColumnWeight;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+	}
+
+	/* Tile tables (threads split tiles) */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * NumTiles/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * NumTiles/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, clahe_tiles, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	/* Interpolated mapping (threads split rows) */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Img->Height/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Img->Height/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, clahe_interpolate, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	free(Lut);
+	free(ColumnTile);
+	free(ColumnWeight);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Frees memory allocated by the bit mask */
+void free_bit_mask(bit_mask_t *Mask)
+{
+	if(Mask == NULL)
+		return;
+
+	free(Mask->Bits);
+	free(Mask);
+}
+/*******************************************************************************/
+/* Expand bit mask to a GRAY_8BITS image (set bits --> 255). Return NULL if fail */
+img_t *bit_mask_to_img(bit_mask_t *Mask)
+{
+	if((Mask == NULL) || (Mask->Bits == NULL))
+		return NULL;
+
+	img_t	*OutputImg;
+	uint8_t	*Bits;
+
+	OutputImg = new_BMP(Mask->Width, Mask->Height, GRAY_8BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	for(int32_t Row = 0; Row < Mask->Height; Row++)
+	{
+		Bits = Mask->Bits + (size_t)Row * Mask->Stride;
+
+		for(int32_t Column = 0; Column < Mask->Width; Column++)
+			OutputImg->Pixel8[Row][Column] = ((Bits[Column / 8] >> (Column % 8)) & 1) ? 255 : 0;
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Computes summed-area table of pixel values using multiple threads (row prefix
+   sums per thread followed by a column pass). Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Type    --> INTEGRAL_UINT32
+	            INTEGRAL_UINT64
+	            INTEGRAL_DOUBLE
+	Threads --> Number of threads to be used in parallel on computacion */
+integral_t *integral_image(img_t *Img, int Type, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	return build_integral(Img, NULL, Type, ThreadsNum);
+}
+/*******************************************************************************/
+/* Same as "integral_image" but with squared pixel values. Return NULL if fail */
+integral_t *integral_image_sq(img_t *Img, int Type, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	return build_integral(Img, Img, Type, ThreadsNum);
+}
+/*******************************************************************************/
+/* Frees memory allocated by the summed-area table */
+void free_integral(integral_t *Table)
+{
+	if(Table == NULL)
+		return;
+
+	free(Table->Sum32);
+	free(Table->Sum64);
+	free(Table->SumDouble);
+	free(Table);
+}
+/*******************************************************************************/
+/* Sum of the image pixels on rows [Top:Bottom[ and columns [Left:Right[ read from
+   the summed-area table with four accesses. Limits are not checked */
+double integral_sum(integral_t *Table, int32_t Top, int32_t Left, int32_t Bottom, int32_t Right)
+{
+	size_t	TopRow = (size_t)Top * Table->Width;
+	size_t	BottomRow = (size_t)Bottom * Table->Width;
+
+	switch(Table->Type)
+	{
+		case INTEGRAL_UINT32:
+			return (double)(uint32_t)(Table->Sum32[BottomRow + Right] - Table->Sum32[BottomRow + Left]
+			                        - Table->Sum32[TopRow + Right] + Table->Sum32[TopRow + Left]);
+
+		case INTEGRAL_UINT64:
+			return (double)(Table->Sum64[BottomRow + Right] - Table->Sum64[BottomRow + Left]
+			              - Table->Sum64[TopRow + Right] + Table->Sum64[TopRow + Left]);
+
+		default:
+			return Table->SumDouble[BottomRow + Right] - Table->SumDouble[BottomRow + Left]
+			     - Table->SumDouble[TopRow + Right] + Table->SumDouble[TopRow + Left];
+	}
+}
+/*******************************************************************************/
+/* Computes global threshold with Otsu method using multiple threads.
+   Pixels above the returned level belong to the bright class. Return -1 if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Threads --> Number of threads to be used in parallel on computacion */
+int32_t otsu_threshold(img_t *Img, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return -1;
+
+	uint32_t	Hist[256];
+	double		Total, SumAll = 0.0;
+	double		WeightBack = 0.0, SumBack = 0.0;
+	double		MeanBack, MeanFore, Between;
+	double		MaxBetween = -1.0;
+	int32_t		Level = 0;
+
+	if(histogram_compute(Img, Hist, ThreadsNum) == -1)
+		return -1;
+
+	Total = (double)Img->Height * Img->Width;
+
+	for(int32_t i = 0; i < 256; i++)
+		SumAll += (double)i * Hist[i];
+
+	/* Maximize between class variance */
+	for(int32_t i = 0; i < 256; i++)
+	{
+		WeightBack += Hist[i];
+		if(WeightBack == 0)
+			continue;
+		if(WeightBack == Total)
+			break;
+
+		SumBack += (double)i * Hist[i];
+
+		MeanBack = SumBack / WeightBack;
+		MeanFore = (SumAll - SumBack) / (Total - WeightBack);
+		Between = WeightBack * (Total - WeightBack) * (MeanBack - MeanFore) * (MeanBack - MeanFore);
+
+		if(Between > MaxBetween)
+		{
+			MaxBetween = Between;
+			Level = i;
+		}
+	}
+
+	return Level;
+}
+/*******************************************************************************/
+/* Binarize image with global level using multiple threads (Pixel > Level --> 255).
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Level   --> Threshold level (i.e. from "otsu_threshold").
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *threshold(img_t *Img, uint8_t Level, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	img_t	*OutputImg;
+
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	run_threshold(Img, Level, ThreadsNum, OutputImg, NULL);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Same as "threshold" but the result is packed with 1 bit per pixel. Return NULL if fail */
+bit_mask_t *threshold_mask(img_t *Img, uint8_t Level, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	bit_mask_t	*Mask;
+
+	Mask = new_bit_mask(Img->Width, Img->Height);
+	if(Mask == NULL)
+		return NULL;
+
+	run_threshold(Img, Level, ThreadsNum, NULL, Mask);
+
+	return Mask;
+}
+/*******************************************************************************/
+/* Binarize image with local threshold computed on a (2*Radius+1) square window
+   using multiple threads (Pixel > T --> 255). Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Method  --> ADAPTIVE_MEAN    (Param is the constant subtracted from the mean)
+	            ADAPTIVE_SAUVOLA (Param is the k factor, usually 0.2 to 0.5)
+	Radius  --> Window radius (>= 1).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *adaptive_threshold(img_t *Img, int Method, int32_t Radius, float Param, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	img_t	*OutputImg;
+
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	if(run_adaptive_threshold(Img, Method, Radius, Param, ThreadsNum, OutputImg, NULL) == -1)
+	{
+		free_img(OutputImg);
+		return NULL;
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Same as "adaptive_threshold" but the result is packed with 1 bit per pixel.
+   Return NULL if fail */
+bit_mask_t *adaptive_threshold_mask(img_t *Img, int Method, int32_t Radius, float Param, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	bit_mask_t	*Mask;
+
+	Mask = new_bit_mask(Img->Width, Img->Height);
+	if(Mask == NULL)
+		return NULL;
+
+	if(run_adaptive_threshold(Img, Method, Radius, Param, ThreadsNum, NULL, Mask) == -1)
+	{
+		free_bit_mask(Mask);
+		return NULL;
+	}
+
+	return Mask;
+}
+/*******************************************************************************/
+/* Label 8-connected components of a binary image (non-zero pixels are foreground)
+   and compute area, bounding box and centroid of each one using multiple threads.
+   Strips are labeled in parallel with block based union-find, equivalences across
+   strips are merged and the statistics are gathered on the final labeling pass.
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS, i.e. from "threshold").
+	Threads --> Number of threads to be used in parallel on computacion */
+components_t *connected_components(img_t *Img, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	components_work_t	ThreadArg[ThreadsNum];
+	pthread_t			ThreadId[ThreadsNum];
+	components_t		*Output;
+	int32_t				BlockRows = (Img->Height + 1) / 2;
+	int32_t				Blocks = (Img->Width + 1) / 2;
+	size_t				BlockCount = (size_t)BlockRows * Blocks;
+	uint32_t			*Parent;
+	uint32_t			*BlockLabel;
+	uint8_t				*BlockMask;
+	blob_t				*Partial;
+	blob_t				*Blob;
+	uint32_t			Count = 0;
+	int32_t				Row;
+
+	Output = (components_t *)malloc(sizeof(components_t));
+	if(Output == NULL)
+	{
+		printf("Error: [connected_components()] --> Could not allocate memory.\n\n");
+		return NULL;
+	}
+
+	Output->Width = Img->Width;
+	Output->Height = Img->Height;
+	Output->Count = 0;
+	Output->Blobs = NULL;
+	Output->Labels = (uint32_t *)malloc(sizeof(uint32_t) * Img->Width * Img->Height);
+
+	Parent = (uint32_t *)malloc(sizeof(uint32_t) * (BlockCount + 1));
+	BlockLabel = (uint32_t *)malloc(sizeof(uint32_t) * BlockCount);
+	BlockMask = (uint8_t *)malloc(sizeof(uint8_t) * BlockCount);
+
+	if((Output->Labels == NULL) || (Parent == NULL) || (BlockLabel == NULL) || (BlockMask == NULL))
+	{
+		printf("Error: [connected_components()] --> Could not allocate memory.\n\n");
+		free(Parent);
+		free(BlockLabel);
+		free(BlockMask);
+		free_components(Output);
+		return NULL;
+	}
+
+	/* First pass: provisional labels of each strip */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * BlockRows/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * BlockRows/ThreadsNum;
+		ThreadArg[i].Base = (uint32_t)((size_t)ThreadArg[i].StartRow * Blocks + 1);
+		ThreadArg[i].Used = 0;
+		ThreadArg[i].Parent = Parent;
+		ThreadArg[i].BlockLabel = BlockLabel;
+		ThreadArg[i].BlockMask = BlockMask;
+		ThreadArg[i].Blobs = NULL;
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].Output = Output;
+
+		pthread_create(&ThreadId[i], NULL, label_blocks, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	/* Merge equivalences across strip boundaries */
+	for(int32_t i = 1; i < ThreadsNum; i++)
+	{
+		Row = ThreadArg[i].StartRow;
+		if((Row == 0) || (Row == ThreadArg[i].EndRow))
+			continue;
+
+		for(int32_t Column = 0; Column < Blocks; Column++)
+		{
+			if(BlockMask[(size_t)Row * Blocks + Column] == 0)
+				continue;
+
+			link_upper_blocks(Parent, BlockMask + (size_t)(Row - 1) * Blocks,
+			                  BlockLabel + (size_t)(Row - 1) * Blocks, Column, Blocks,
+			                  BlockMask[(size_t)Row * Blocks + Column],
+			                  BlockLabel[(size_t)Row * Blocks + Column]);
+		}
+	}
+
+	/* Flatten: roots are the smallest label of its tree, so on ascending order the
+	   parent of a non root label already holds its final label */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		for(uint32_t Label = ThreadArg[i].Base; Label < ThreadArg[i].Base + ThreadArg[i].Used; Label++)
+		{
+			if(Parent[Label] < Label)
+				Parent[Label] = Parent[Parent[Label]];
+			else
+				Parent[Label] = ++Count;
+		}
+	}
+
+	Output->Count = Count;
+	Output->Blobs = (blob_t *)malloc(sizeof(blob_t) * (Count + 1));
+	Partial = (blob_t *)malloc(sizeof(blob_t) * ((size_t)Count * ThreadsNum + 1));
+
+	if((Output->Blobs == NULL) || (Partial == NULL))
+	{
+		printf("Error: [connected_components()] --> Could not allocate memory.\n\n");
+		free(Parent);
+		free(BlockLabel);
+		free(BlockMask);
+		free(Partial);
+		free_components(Output);
+		return NULL;
+	}
+
+	/* Second pass: final labels and partial statistics */
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Blobs = Partial + (size_t)i * Count;
+
+		pthread_create(&ThreadId[i], NULL, label_pixels, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	/* Merge partial statistics on thread order */
+	for(uint32_t Label = 0; Label < Count; Label++)
+	{
+		Blob = &Output->Blobs[Label];
+		*Blob = Partial[Label];
+
+		for(int32_t i = 1; i < ThreadsNum; i++)
+		{
+			blob_t *Part = &Partial[(size_t)i * Count + Label];
+
+			if(Part->Area == 0)
+				continue;
+
+			Blob->Area += Part->Area;
+			Blob->SumX += Part->SumX;
+			Blob->SumY += Part->SumY;
+			if(Part->Left < Blob->Left)
+				Blob->Left = Part->Left;
+			if(Part->Right > Blob->Right)
+				Blob->Right = Part->Right;
+			if(Part->Top < Blob->Top)
+				Blob->Top = Part->Top;
+			if(Part->Bottom > Blob->Bottom)
+				Blob->Bottom = Part->Bottom;
+		}
+
+		Blob->CentroidX = (double)Blob->SumX / Blob->Area;
+		Blob->CentroidY = (double)Blob->SumY / Blob->Area;
+	}
+
+	free(Parent);
+	free(BlockLabel);
+	free(BlockMask);
+	free(Partial);
+
+	return Output;
+}
+/*******************************************************************************/
+/* Frees memory allocated by connected component labeling */
+void free_components(components_t *Components)
+{
+	if(Components == NULL)
+		return;
+
+	free(Components->Labels);
+	free(Components->Blobs);
+	free(Components);
+}
+/*******************************************************************************/
+/* Frees memory allocated by the float map */
+void free_float_map(float_map_t *Map)
+{
+	if(Map == NULL)
+		return;
+
+	free(Map->Data);
+	free(Map);
+}
+/*******************************************************************************/
+/* Scale float map from its [min:max] range to a GRAY_8BITS image. Return NULL if fail */
+img_t *float_map_to_img(float_map_t *Map)
+{
+	if((Map == NULL) || (Map->Data == NULL))
+		return NULL;
+
+	img_t	*Img;
+	float	Min = Map->Data[0];
+	float	Max = Map->Data[0];
+	float	Scale;
+	float	*Src;
+
+	Img = new_BMP(Map->Width, Map->Height, GRAY_8BITS);
+	if(Img == NULL)
+	{
+		printf("Error: [float_map_to_img()] --> Could not allocate memory.\n\n");
+		return NULL;
+	}
+
+	for(size_t i = 1; i < (size_t)Map->Width * Map->Height; i++)
+	{
+		if(Map->Data[i] < Min)
+			Min = Map->Data[i];
+		if(Map->Data[i] > Max)
+			Max = Map->Data[i];
+	}
+
+	Scale = (Max > Min) ? 255.0f / (Max - Min) : 0.0f;
+
+	for(int32_t Row = 0; Row < Map->Height; Row++)
+	{
+		Src = Map->Data + (size_t)Row * Map->Width;
+		for(int32_t Column = 0; Column < Map->Width; Column++)
+			Img->Pixel8[Row][Column] = (uint8_t)((Src[Column] - Min) * Scale + 0.5f);
+	}
+
+	return Img;
+}
+/*******************************************************************************/
+/* Computes normalized cross correlation score of the template at every position of
+   the image using multiple threads. Template energy and windowed image statistics
+   come from summed-area tables, numerator comes from direct correlation on small
+   templates or from FFT on large ones (see NCC_FFT_AREA). Map has size
+   (Img->Width - Template->Width + 1) x (Img->Height - Template->Height + 1) and
+   scores are in [-1:1] (flat image windows score 0). Return NULL if fail
+	Img      --> Pointer to source image (GRAY_8BITS).
+	Template --> Pointer to template image (GRAY_8BITS, not flat).
+	Threads  --> Number of threads to be used in parallel on computacion */
+float_map_t *ncc_map(img_t *Img, img_t *Template, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (Template == NULL) || (Template->Pixel8 == NULL) ||
+	   (ThreadsNum < 1))
+		return NULL;
+
+	ncc_work_t	Setup;
+	float_map_t	*Output;
+
+	if((Template->Width > Img->Width) || (Template->Height > Img->Height))
+	{
+		printf("Error: [ncc_map()] --> Template larger than image.\n\n");
+		return NULL;
+	}
+
+	if(prepare_ncc(Img, Template, &Setup, ThreadsNum) == -1)
+	{
+		printf("Error: [ncc_map()] --> Could not allocate memory.\n\n");
+		return NULL;
+	}
+
+	if(Setup.TemplateNorm == 0.0)
+	{
+		printf("Error: [ncc_map()] --> Flat template.\n\n");
+		release_ncc(&Setup);
+		return NULL;
+	}
+
+	Output = new_float_map(Img->Width - Template->Width + 1, Img->Height - Template->Height + 1);
+	if((Output == NULL) || (compute_ncc(&Setup, Output, ThreadsNum) == -1))
+	{
+		printf("Error: [ncc_map()] --> Could not allocate memory.\n\n");
+		free_float_map(Output);
+		release_ncc(&Setup);
+		return NULL;
+	}
+
+	release_ncc(&Setup);
+
+	return Output;
+}
+/*******************************************************************************/
+/* Find best non overlapping template matches by normalized cross correlation using
+   multiple threads. With more than one level the search runs on the coarsest level of
+   an image pyramid and candidates are refined on each finer level.
+   Return number of matches (best first) or -1 if fail
+	Img        --> Pointer to source image (GRAY_8BITS).
+	Template   --> Pointer to template image (GRAY_8BITS, not flat).
+	Levels     --> Pyramid levels (1 --> search on full resolution only). Reduced if
+	               template gets smaller than NCC_PYRAMID_MIN_SIZE.
+	MinScore   --> Smallest score accepted.
+	Matches    --> Output array.
+	MaxMatches --> Size of "Matches" array.
+	Threads    --> Number of threads to be used in parallel on computacion */
+int32_t match_template(img_t *Img, img_t *Template, int32_t Levels, float MinScore,
+                       match_t *Matches, int32_t MaxMatches, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (Template == NULL) || (Template->Pixel8 == NULL) ||
+	   (Matches == NULL) || (MaxMatches < 1) || (Levels < 1) || (ThreadsNum < 1))
+		return -1;
+
+	if((Template->Width > Img->Width) || (Template->Height > Img->Height))
+	{
+		printf("Error: [match_template()] --> Template larger than image.\n\n");
+		return -1;
+	}
+
+	if(flat_image(Template))
+	{
+		printf("Error: [match_template()] --> Flat template.\n\n");
+		return -1;
+	}
+
+	while((Levels > 1) && (((Template->Width >> (Levels - 1)) < NCC_PYRAMID_MIN_SIZE) ||
+	                       ((Template->Height >> (Levels - 1)) < NCC_PYRAMID_MIN_SIZE)))
+		Levels--;
+
+	img_t		*ImgLevel[Levels];
+	img_t		*TplLevel[Levels];
+	int32_t		Top = 0;
+	int32_t		Count = -1;
+
+	ImgLevel[0] = Img;
+	TplLevel[0] = Template;
+	/* Levels past a failed allocation stay NULL */
+	for(int32_t Level = 1; Level < Levels; Level++)
+	{
+		ImgLevel[Level] = NULL;
+		TplLevel[Level] = NULL;
+		if((ImgLevel[Level - 1] != NULL) && (TplLevel[Level - 1] != NULL))
+		{
+			ImgLevel[Level] = half_size(ImgLevel[Level - 1]);
+			TplLevel[Level] = half_size(TplLevel[Level - 1]);
+		}
+	}
+
+	/* Coarsest level used is the last one allocated with a template that is not flat */
+	while((Top + 1 < Levels) && (ImgLevel[Top + 1] != NULL) && (TplLevel[Top + 1] != NULL) &&
+	      (flat_image(TplLevel[Top + 1]) == 0))
+		Top++;
+
+	if((Top + 1 == Levels) || ((ImgLevel[Top + 1] != NULL) && (TplLevel[Top + 1] != NULL)))
+		Count = pyramid_search(ImgLevel, TplLevel, Top, MinScore, Matches, MaxMatches, ThreadsNum);
+
+	if(Count == -1)
+		printf("Error: [match_template()] --> Could not allocate memory.\n\n");
+
+	for(int32_t Level = 1; Level < Levels; Level++)
+	{
+		free_img(ImgLevel[Level]);
+		free_img(TplLevel[Level]);
+	}
+
+	return Count;
+}
+/*******************************************************************************/
+/* Exact Euclidean distance from every non-zero pixel to the nearest zero pixel (zero
+   pixels get 0) using multiple threads. Column scans give vertical distances and
+   each row takes the lower envelope of parabolas (Felzenszwalb-Huttenlocher), so the
+   cost is linear in the number of pixels. Images without zero pixels give INFINITY.
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS, i.e. from "threshold").
+	Threads --> Number of threads to be used in parallel on computacion */
+float_map_t *distance_transform(img_t *Img, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	float_map_t	*Output;
+	uint32_t	*Squared;
+
+	Output = new_float_map(Img->Width, Img->Height);
+	Squared = (uint32_t *)malloc(sizeof(uint32_t) * Img->Width * Img->Height);
+
+	if((Output == NULL) || (Squared == NULL))
+	{
+		printf("Error: [distance_transform()] --> Could not allocate memory.\n\n");
+		free_float_map(Output);
+		free(Squared);
+		return NULL;
+	}
+
+	run_distance_transform(Img, Squared, Output->Data, ThreadsNum);
+
+	free(Squared);
+
+	return Output;
+}
+/*******************************************************************************/
+/* Same as "distance_transform" but writes squared distances as integers (row-major,
+   Width*Height entries, UINT32_MAX if the image has no zero pixel). Return -1 if fail */
+int distance_transform_sq(img_t *Img, uint32_t *SqDistance, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (SqDistance == NULL) || (ThreadsNum < 1))
+		return -1;
+
+	run_distance_transform(Img, SqDistance, NULL, ThreadsNum);
+
+	return 0;
+}
+/*******************************************************************************/
+/* Find straight lines on an edge image with Hough transform using multiple threads.
+   Each thread votes on a private accumulator and they are merged at the end. With
+   an orientation image each edge pixel votes only on a narrow theta band around its
+   gradient direction. Peaks go through non maximum suppression (HOUGH_NMS_RADIUS).
+   Image sides must be below 32768. Return number of lines (most voted first) or -1 if fail
+	Edges       --> Pointer to edge image (GRAY_8BITS, i.e. gradient magnitude or binary).
+	Threshold   --> Pixels above this value are edges.
+	Orientation --> NULL or orientation image from "parallel_gradient".
+	Bins        --> Orientation bins used on "parallel_gradient". Ignored if Orientation
+	                is NULL.
+	ThetaBins   --> Theta resolution, number of angles on [0:180[ (i.e. 180).
+	MinVotes    --> Smallest number of votes accepted.
+	Lines       --> Output array.
+	MaxLines    --> Size of "Lines" array.
+	Threads     --> Number of threads to be used in parallel on computacion */
+int32_t hough_lines(img_t *Edges, uint8_t Threshold, img_t *Orientation, int32_t Bins,
+                    int32_t ThetaBins, uint32_t MinVotes, hough_line_t *Lines, int32_t MaxLines,
+                    int32_t ThreadsNum)
+{
+	if((Edges == NULL) || (Edges->Pixel8 == NULL) || (Lines == NULL) || (MaxLines < 1) ||
+	   (ThetaBins < 1) || (ThreadsNum < 1))
+		return -1;
+
+	if((Edges->Width >= 32768) || (Edges->Height >= 32768))
+	{
+		printf("Error: [hough_lines()] --> Image too large.\n\n");
+		return -1;
+	}
+
+	if((Orientation != NULL) && ((Orientation->Pixel8 == NULL) || (Bins < 1) ||
+	   (Orientation->Width != Edges->Width) || (Orientation->Height != Edges->Height)))
+	{
+		printf("Error: [hough_lines()] --> Invalid \"Orientation\" input.\n\n");
+		return -1;
+	}
+
+	hough_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	int32_t			RhoMax = (int32_t)ceil(sqrt((double)Edges->Width * Edges->Width +
+	                                            (double)Edges->Height * Edges->Height)) + 1;
+	int32_t			RhoBins = 2 * RhoMax + 1;
+	size_t			Cells = (size_t)ThetaBins * RhoBins;
+	int32_t			*Table;
+	uint32_t		*Partials;
+	int32_t			LinesNum;
+
+	Table = (int32_t *)malloc(sizeof(int32_t) * 2 * ThetaBins);
+	Partials = (uint32_t *)malloc(sizeof(uint32_t) * Cells * ThreadsNum);
+
+	if((Table == NULL) || (Partials == NULL))
+	{
+		printf("Error: [hough_lines()] --> Could not allocate memory.\n\n");
+		free(Table);
+		free(Partials);
+		return -1;
+	}
+
+	for(int32_t Theta = 0; Theta < ThetaBins; Theta++)
+	{
+		Table[Theta] = (int32_t)lrint(cos(Theta * M_PI / ThetaBins) * (1 << HOUGH_FRACTION_BITS));
+		Table[ThetaBins + Theta] = (int32_t)lrint(sin(Theta * M_PI / ThetaBins) * (1 << HOUGH_FRACTION_BITS));
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Edges->Height/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Edges->Height/ThreadsNum;
+		ThreadArg[i].ThetaBins = ThetaBins;
+		ThreadArg[i].RhoBins = RhoBins;
+		ThreadArg[i].RhoMax = RhoMax;
+		ThreadArg[i].Bins = Bins;
+		/* One orientation bin on each side (3x3 operators are noisy on orientation) */
+		ThreadArg[i].Band = (Bins > 0) ? (ThetaBins + Bins - 1) / Bins : 0;
+		ThreadArg[i].Threshold = Threshold;
+		ThreadArg[i].Cos = Table;
+		ThreadArg[i].Sin = Table + ThetaBins;
+		ThreadArg[i].Accumulator = Partials + i * Cells;
+		ThreadArg[i].Partials = Partials;
+		ThreadArg[i].PartialsNum = ThreadsNum;
+		ThreadArg[i].InputImage = Edges;
+		ThreadArg[i].Orientation = Orientation;
+
+		pthread_create(&ThreadId[i], NULL, hough_vote, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].Start = i * Cells/ThreadsNum;
+		ThreadArg[i].End = (i + 1) * Cells/ThreadsNum;
+
+		pthread_create(&ThreadId[i], NULL, hough_merge, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	LinesNum = hough_peaks(Partials, ThetaBins, RhoBins, RhoMax, MinVotes, Lines, MaxLines);
+	if(LinesNum == -1)
+		printf("Error: [hough_lines()] --> Could not allocate memory.\n\n");
+
+	free(Table);
+	free(Partials);
+
+	return LinesNum;
+}
+/*******************************************************************************/
+/* Detect FAST corners (segment test on the 16 pixels circle of radius 3) using multiple
+   threads. Pixels are rejected 16 at a time with SIMD tests on the 4 compass pixels.
+   Score is the smallest absolute difference on the best arc. Corners are
+   3x3 local maxima and each grid cell keeps its strongest one.
+   Return number of corners (strongest first) or -1 if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	Arc       --> Contiguous circle pixels needed: 9 (FAST-9) to 12 (FAST-12).
+	Threshold --> Intensity difference to the center pixel.
+	GridSize  --> Side of grid cells in pixels (1 --> only 3x3 suppression).
+	Points    --> Output array.
+	MaxPoints --> Size of "Points" array (strongest corners are kept).
+	Threads   --> Number of threads to be used in parallel on computacion */
+int32_t fast_corners(img_t *Img, int32_t Arc, uint8_t Threshold, int32_t GridSize,
+                     keypoint_t *Points, int32_t MaxPoints, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (Points == NULL) || (MaxPoints < 1) ||
+	   (GridSize < 1) || (ThreadsNum < 1))
+		return -1;
+
+	if((Arc < 9) || (Arc > 12))
+	{
+		printf("Error: [fast_corners()] --> Invalid \"Arc\" input.\n\n");
+		return -1;
+	}
+
+	corner_work_t	Setup;
+	int32_t			Found;
+
+	Setup.Detector = CORNER_FAST;
+	Setup.Arc = Arc;
+	Setup.Threshold = Threshold;
+	Setup.Radius = 0;
+	Setup.Weights = NULL;
+	Setup.K = 0.0f;
+	Setup.MinScore = 0.0f;
+	Setup.Margin = 4;		/* Circle radius plus suppression neighbourhood */
+	Setup.GridSize = GridSize;
+	Setup.InputImage = Img;
+
+	Found = run_corner_detect(&Setup, 3 * (size_t)Img->Width, Points, MaxPoints, ThreadsNum);
+	if(Found == -1)
+		printf("Error: [fast_corners()] --> Could not allocate memory.\n\n");
+
+	return Found;
+}
+/*******************************************************************************/
+/* Detect Harris or Shi-Tomasi corners using multiple threads. Sobel gradient products
+   are averaged by the window and turned into the response on a single pass over row
+   bands. Gradients are normalized to gray levels per pixel. Corners are 3x3 local
+   maxima not below "MinScore" and each grid cell keeps its strongest one.
+   Return number of corners (strongest first) or -1 if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	Detector  --> CORNER_HARRIS
+	              CORNER_SHI_TOMASI
+	Window    --> CORNER_WINDOW_BOX
+	              CORNER_WINDOW_GAUSSIAN
+	Radius    --> Window radius (>= 1).
+	K         --> Harris trace factor (usually 0.04 to 0.06). Ignored on CORNER_SHI_TOMASI.
+	MinScore  --> Smallest response accepted.
+	GridSize  --> Side of grid cells in pixels (1 --> only 3x3 suppression).
+	Points    --> Output array.
+	MaxPoints --> Size of "Points" array (strongest corners are kept).
+	Threads   --> Number of threads to be used in parallel on computacion */
+int32_t harris_corners(img_t *Img, int Detector, int Window, int32_t Radius, float K, float MinScore,
+                       int32_t GridSize, keypoint_t *Points, int32_t MaxPoints, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (Points == NULL) || (MaxPoints < 1) ||
+	   (Radius < 1) || (GridSize < 1) || (ThreadsNum < 1))
+		return -1;
+
+	if((Detector != CORNER_HARRIS) && (Detector != CORNER_SHI_TOMASI))
+	{
+		printf("Error: [harris_corners()] --> Invalid \"Detector\" input.\n\n");
+		return -1;
+	}
+
+	if((Window != CORNER_WINDOW_BOX) && (Window != CORNER_WINDOW_GAUSSIAN))
+	{
+		printf("Error: [harris_corners()] --> Invalid \"Window\" input.\n\n");
+		return -1;
+	}
+
+	corner_work_t	Setup;
+	int32_t			Taps = 2 * Radius + 1;
+	float			Weights[Taps];
+	float			Total = 0.0f;
+	size_t			ScratchSize;
+	int32_t			Found;
+
+	for(int32_t k = 0; k < Taps; k++)
+	{
+		if(Window == CORNER_WINDOW_GAUSSIAN)
+			Weights[k] = expf(-2.0f * (k - Radius) * (k - Radius) / ((float)Radius * Radius));
+		else
+			Weights[k] = 1.0f;
+		Total += Weights[k];
+	}
+
+	for(int32_t k = 0; k < Taps; k++)
+		Weights[k] /= Total;
+
+	Setup.Detector = Detector;
+	Setup.Arc = 0;
+	Setup.Threshold = 0;
+	Setup.Radius = Radius;
+	Setup.Weights = Weights;
+	Setup.K = K;
+	Setup.MinScore = MinScore;
+	Setup.Margin = Radius + 2;	/* Window and derivatives inside the image */
+	Setup.GridSize = GridSize;
+	Setup.InputImage = Img;
+
+	/* Response rows, product ring, window sums, Gx, Gy and padded lines (in floats) */
+	ScratchSize = 3 * (size_t)Img->Width + 3 * (size_t)Taps * Img->Width +
+	              3 * ((size_t)Img->Width + 2 * Radius) + (size_t)Img->Width +
+	              (3 * ((size_t)Img->Width + 2) + sizeof(float) - 1) / sizeof(float);
+
+	Found = run_corner_detect(&Setup, ScratchSize, Points, MaxPoints, ThreadsNum);
+	if(Found == -1)
+		printf("Error: [harris_corners()] --> Could not allocate memory.\n\n");
+
+	return Found;
+}
+/*******************************************************************************/
+/* Compute minimum, maximum, sum, mean and standard deviation of an image (per channel on
+   RGB_24BITS) in a single pass using multiple threads. Return -1 if fail or 0 on success
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Stats   --> Receives the statistics.
+	Locate  --> 1 to also find positions of minimum and maximum, 0 otherwise.
+	Threads --> Number of threads to be used in parallel on computacion */
+int image_stats(img_t *Img, img_stats_t *Stats, int Locate, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (Stats == NULL) ||
+	   (Img->Width < 1) || (Img->Height < 1) || (ThreadsNum < 1))
+	{
+		printf("Error: [image_stats()] --> Invalid arguments.\n\n");
+		return -1;
+	}
+
+	stats_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_stats_t		*Partial;
+	uint64_t		SumSq, Quotient, Remainder;
+	double			Deviation;
+	int32_t			Merged;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+		ThreadArg[i].Locate = Locate;
+		ThreadArg[i].InputImage = Img;
+
+		pthread_create(&ThreadId[i], NULL, stats_worker, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	Stats->Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	Stats->Count = (uint64_t)Img->Width * Img->Height;
+
+	for(int32_t c = 0; c < 3; c++)
+	{
+		Stats->Min[c] = 255;
+		Stats->Max[c] = 0;
+		Stats->Sum[c] = 0;
+		Stats->Mean[c] = 0.0;
+		Stats->StdDev[c] = 0.0;
+		Stats->MinX[c] = -1;
+		Stats->MinY[c] = -1;
+		Stats->MaxX[c] = -1;
+		Stats->MaxY[c] = -1;
+	}
+
+	for(int32_t c = 0; c < Stats->Channels; c++)
+	{
+		SumSq = 0;
+		Merged = 0;
+
+		/* Threads hold consecutive rows, so the first strict improvement is the first
+		   occurrence in raster order */
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			if(ThreadArg[i].StartRow == ThreadArg[i].EndRow)
+				continue;
+
+			Partial = &ThreadArg[i].Partial;
+
+			if((Partial->Min[c] < Stats->Min[c]) || (Merged == 0))
+			{
+				Stats->Min[c] = Partial->Min[c];
+				Stats->MinX[c] = Partial->MinX[c];
+				Stats->MinY[c] = Partial->MinY[c];
+			}
+
+			if((Partial->Max[c] > Stats->Max[c]) || (Merged == 0))
+			{
+				Stats->Max[c] = Partial->Max[c];
+				Stats->MaxX[c] = Partial->MaxX[c];
+				Stats->MaxY[c] = Partial->MaxY[c];
+			}
+
+			Stats->Sum[c] += Partial->Sum[c];
+			SumSq += ThreadArg[i].SumSq[c];
+			Merged = 1;
+		}
+
+		/* Sum of squared deviations is SumSq - Sum^2/Count. With Sum = Quotient*Count +
+		   Remainder the integer part is subtracted exactly and only Remainder^2/Count
+		   is rounded, so constant images give exactly zero */
+		Quotient = Stats->Sum[c] / Stats->Count;
+		Remainder = Stats->Sum[c] % Stats->Count;
+		Deviation = (double)(SumSq - Quotient * Quotient * Stats->Count - 2 * Quotient * Remainder) -
+		            (double)Remainder * Remainder / Stats->Count;
+
+		Stats->Mean[c] = (double)Stats->Sum[c] / Stats->Count;
+		Stats->StdDev[c] = sqrt(Deviation / Stats->Count);
+	}
+
+	return 0;
+}
+/*******************************************************************************/
+/* Reset point operations chain to identity (no change on any channel) */
+void point_lut_identity(point_lut_t *Lut)
+{
+	if(Lut == NULL)
+		return;
+
+	for(int32_t c = 0; c < 3; c++)
+	{
+		for(int32_t i = 0; i < 256; i++)
+			Lut->Table[c][i] = (uint8_t)i;
+	}
+}
+/*******************************************************************************/
+/* Append an arbitrary operation to the chain: Value --> Table[Value]. Tables are
+   composed so the chain stays a single lookup per pixel and gives exactly the same
+   result as applying each operation on its own pass.
+   Return -1 if fail or 0 on success
+	Channel --> PASS_RED_CHANNEL, PASS_GREEN_CHANNEL, PASS_BLUE_CHANNEL or POINT_ALL_CHANNELS
+	Table   --> 256 entries */
+int point_lut_table(point_lut_t *Lut, int Channel, const uint8_t *Table)
+{
+	if((Lut == NULL) || (Table == NULL))
+		return -1;
+
+	if((Channel < PASS_RED_CHANNEL) || (Channel > POINT_ALL_CHANNELS))
+	{
+		printf("Error: [point_lut_table()] --> Invalid \"Channel\" input.\n\n");
+		return -1;
+	}
+
+	for(int32_t c = 0; c < 3; c++)
+	{
+		if((Channel != POINT_ALL_CHANNELS) && (Channel != c))
+			continue;
+
+		for(int32_t i = 0; i < 256; i++)
+			Lut->Table[c][i] = Table[Lut->Table[c][i]];
+	}
+
+	return 0;
+}
+/*******************************************************************************/
+/* Append brightness change: Value + Offset (saturated) */
+int point_lut_brightness(point_lut_t *Lut, int Channel, int32_t Offset)
+{
+	uint8_t	Table[256];
+	int32_t	Value;
+
+	for(int32_t i = 0; i < 256; i++)
+	{
+		Value = i + Offset;
+		Table[i] = (uint8_t)((Value < 0) ? 0 : ((Value > 255) ? 255 : Value));
+	}
+
+	return point_lut_table(Lut, Channel, Table);
+}
+/*******************************************************************************/
+/* Append contrast change around mid gray: (Value - 128) * Factor + 128 (saturated) */
+int point_lut_contrast(point_lut_t *Lut, int Channel, float Factor)
+{
+	uint8_t	Table[256];
+	float	Value;
+
+	for(int32_t i = 0; i < 256; i++)
+	{
+		Value = (i - 128) * Factor + 128.0f;
+		Table[i] = (uint8_t)((Value < 0.0f) ? 0 : ((Value > 255.0f) ? 255 : (int32_t)(Value + 0.5f)));
+	}
+
+	return point_lut_table(Lut, Channel, Table);
+}
+/*******************************************************************************/
+/* Append gamma correction: 255 * (Value/255)^Gamma (Gamma > 0, below 1 brightens) */
+int point_lut_gamma(point_lut_t *Lut, int Channel, float Gamma)
+{
+	if(!(Gamma > 0.0f))
+	{
+		printf("Error: [point_lut_gamma()] --> Invalid \"Gamma\" input.\n\n");
+		return -1;
+	}
+
+	uint8_t	Table[256];
+
+	for(int32_t i = 0; i < 256; i++)
+		Table[i] = (uint8_t)(255.0 * pow(i / 255.0, Gamma) + 0.5);
+
+	return point_lut_table(Lut, Channel, Table);
+}
+/*******************************************************************************/
+/* Append inversion: 255 - Value */
+int point_lut_invert(point_lut_t *Lut, int Channel)
+{
+	uint8_t	Table[256];
+
+	for(int32_t i = 0; i < 256; i++)
+		Table[i] = (uint8_t)(255 - i);
+
+	return point_lut_table(Lut, Channel, Table);
+}
+/*******************************************************************************/
+/* Append threshold: 255 if Value > Level, 0 otherwise */
+int point_lut_threshold(point_lut_t *Lut, int Channel, uint8_t Level)
+{
+	uint8_t	Table[256];
+
+	for(int32_t i = 0; i < 256; i++)
+		Table[i] = (i > Level) ? 255 : 0;
+
+	return point_lut_table(Lut, Channel, Table);
+}
+/*******************************************************************************/
+/* Append level mapping: [InLow:InHigh] is stretched linearly to [OutLow:OutHigh]
+   and values outside are clipped (InLow < InHigh) */
+int point_lut_levels(point_lut_t *Lut, int Channel, uint8_t InLow, uint8_t InHigh,
+                     uint8_t OutLow, uint8_t OutHigh)
+{
+	if(InLow >= InHigh)
+	{
+		printf("Error: [point_lut_levels()] --> \"InLow\" must be below \"InHigh\".\n\n");
+		return -1;
+	}
+
+	uint8_t	Table[256];
+	int32_t	Value, Range = InHigh - InLow;
+
+	for(int32_t i = 0; i < 256; i++)
+	{
+		Value = (i < InLow) ? InLow : ((i > InHigh) ? InHigh : i);
+
+		/* Rounded division of a possibly negative numerator */
+		Value = (Value - InLow) * (OutHigh - OutLow);
+		Value = (Value >= 0) ? (Value + Range/2) / Range : -((-Value + Range/2) / Range);
+
+		Table[i] = (uint8_t)(OutLow + Value);
+	}
+
+	return point_lut_table(Lut, Channel, Table);
+}
+/*******************************************************************************/
+/* Apply a chain of point operations in a single pass using multiple threads. Any number of
+   operations costs one table lookup per pixel (and channel). Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Lut     --> Operations chain.
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *point_lut_apply(img_t *Img, point_lut_t *Lut, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (Lut == NULL) ||
+	   (ThreadsNum < 1))
+		return NULL;
+
+	lut_work_t	ThreadArg[ThreadsNum];
+	pthread_t	ThreadId[ThreadsNum];
+	img_t		*OutputImg;
+
+	OutputImg = new_BMP_as_size(Img, (Img->Pixel8 != NULL) ? GRAY_8BITS : RGB_24BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+		ThreadArg[i].Lut = &Lut->Table[0][0];
+		ThreadArg[i].InputImage = Img;
+		ThreadArg[i].OutputImage = OutputImg;
+		ThreadArg[i].Mask = NULL;
+
+		pthread_create(&ThreadId[i], NULL, lut_apply, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Split RGB image into three GRAY_8BITS planes in a single pass using multiple threads.
+   Pixels are deinterleaved 32 at a time with SIMD. Return -1 if fail or 0 on success
+	Img     --> Pointer to source image (RGB_24BITS) or ROI view.
+	Red     --> Receives red plane (NULL --> not extracted).
+	Green   --> Receives green plane (NULL --> not extracted).
+	Blue    --> Receives blue plane (NULL --> not extracted).
+	Threads --> Number of threads to be used in parallel on computacion */
+int split_channels(img_t *Img, img_t **Red, img_t **Green, img_t **Blue, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel24 == NULL) || (ThreadsNum < 1))
+	{
+		printf("Error: [split_channels()] --> Invalid arguments.\n\n");
+		return -1;
+	}
+
+	channels_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_t			**Output[3];
+	img_t			*Planes[3];
+
+	Output[PASS_RED_CHANNEL] = Red;
+	Output[PASS_GREEN_CHANNEL] = Green;
+	Output[PASS_BLUE_CHANNEL] = Blue;
+
+	for(int32_t c = 0; c < 3; c++)
+	{
+		Planes[c] = NULL;
+		if(Output[c] == NULL)
+			continue;
+
+		Planes[c] = new_BMP_as_size(Img, GRAY_8BITS);
+		if(Planes[c] == NULL)
+		{
+			printf("Error: [split_channels()] --> Could not allocate planes.\n\n");
+			for(int32_t i = 0; i < c; i++)
+				free_img(Planes[i]);
+			return -1;
+		}
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+		ThreadArg[i].ColorImage = Img;
+
+		for(int32_t c = 0; c < 3; c++)
+			ThreadArg[i].Planes[c] = Planes[c];
+
+		pthread_create(&ThreadId[i], NULL, channels_split, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	for(int32_t c = 0; c < 3; c++)
+	{
+		if(Output[c] != NULL)
+			*Output[c] = Planes[c];
+	}
+
+	return 0;
+}
+/*******************************************************************************/
+/* Merge three GRAY_8BITS planes of same size into a RGB image using multiple threads.
+   Pixels are interleaved 32 at a time with SIMD. Return NULL if fail */
+img_t *merge_channels(img_t *Red, img_t *Green, img_t *Blue, int32_t ThreadsNum)
+{
+	if((Red == NULL) || (Green == NULL) || (Blue == NULL) ||
+	   (Red->Pixel8 == NULL) || (Green->Pixel8 == NULL) || (Blue->Pixel8 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	if((Red->Width != Green->Width) || (Red->Width != Blue->Width) ||
+	   (Red->Height != Green->Height) || (Red->Height != Blue->Height))
+	{
+		printf("Error: [merge_channels()] --> Planes must have the same size.\n\n");
+		return NULL;
+	}
+
+	channels_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	img_t			*OutputImg;
+
+	OutputImg = new_BMP_as_size(Red, RGB_24BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StartRow = i * Red->Height/ThreadsNum;
+		ThreadArg[i].EndRow = (i + 1) * Red->Height/ThreadsNum;
+		ThreadArg[i].ColorImage = OutputImg;
+		ThreadArg[i].Planes[PASS_RED_CHANNEL] = Red;
+		ThreadArg[i].Planes[PASS_GREEN_CHANNEL] = Green;
+		ThreadArg[i].Planes[PASS_BLUE_CHANNEL] = Blue;
+
+		pthread_create(&ThreadId[i], NULL, channels_merge, (void *)&ThreadArg[i]);
+	}
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		pthread_join(ThreadId[i], NULL);
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Create a read only view of one channel without copying pixels. The view shares pixel
+   memory with the image, so it must not outlive it. Return NULL if fail
+	Channel --> PASS_RED_CHANNEL, PASS_GREEN_CHANNEL or PASS_BLUE_CHANNEL (ignored on GRAY_8BITS) */
+channel_view_t *new_channel_view(img_t *Img, int Channel)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)))
+		return NULL;
+
+	if((Img->Pixel8 == NULL) && ((Channel < PASS_RED_CHANNEL) || (Channel > PASS_BLUE_CHANNEL)))
+	{
+		printf("Error: [new_channel_view()] --> Invalid \"Channel\" input.\n\n");
+		return NULL;
+	}
+
+	channel_view_t	*View;
+
+	View = (channel_view_t *)malloc(sizeof(channel_view_t));
+	if(View == NULL)
+		return NULL;
+
+	View->Rows = (const uint8_t **)malloc(sizeof(uint8_t *) * Img->Height);
+	if(View->Rows == NULL)
+	{
+		free(View);
+		return NULL;
+	}
+
+	View->Width = Img->Width;
+	View->Height = Img->Height;
+	View->Step = (Img->Pixel8 != NULL) ? 1 : 3;
+
+	/* Pixels are stored as blue, green and red */
+	for(int32_t Row = 0; Row < Img->Height; Row++)
+	{
+		if(Img->Pixel8 != NULL)
+			View->Rows[Row] = Img->Pixel8[Row];
+		else
+			View->Rows[Row] = (const uint8_t *)Img->Pixel24[Row] + (PASS_BLUE_CHANNEL - Channel);
+	}
+
+	return View;
+}
+/*******************************************************************************/
+/* Frees a view created by "new_channel_view". Pixels are not released */
+void free_channel_view(channel_view_t *View)
+{
+	if(View == NULL)
+		return;
+
+	free(View->Rows);
+	free(View);
+}
+/*******************************************************************************/
+/* Convert color space of an image using multiple threads. YCbCr and HSV use fixed point
+   SIMD (HSV divides by per pixel Max and Delta on float lanes) and Lab tables for sRGB
+   gamma and cube root. Return NULL if fail
+	Img        --> Pointer to source image (RGB_24BITS) or ROI view.
+	Conversion --> One of "color_conversion" (i.e. COLOR_RGB_TO_HSV).
+	Threads    --> Number of threads to be used in parallel on computacion */
+img_t *convert_color(img_t *Img, int Conversion, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel24 == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	if((Conversion < COLOR_RGB_TO_HSV) || (Conversion > COLOR_LAB_TO_RGB))
+	{
+		printf("Error: [convert_color()] --> Invalid \"Conversion\" input.\n\n");
+		return NULL;
+	}
+
+	img_t	*OutputImg;
+
+	OutputImg = new_BMP_as_size(Img, RGB_24BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	if(run_color_convert(Conversion, Img, NULL, OutputImg, NULL, ThreadsNum) == -1)
+	{
+		printf("Error: [convert_color()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		return NULL;
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Convert color space of an image to three GRAY_8BITS planes using multiple threads.
+   Return -1 if fail or 0 on success
+	Img        --> Pointer to source image (RGB_24BITS) or ROI view.
+	Conversion --> One of "color_conversion" (i.e. COLOR_RGB_TO_YCBCR_601).
+	Planes     --> Receives the three new planes (first, second and third components).
+	Threads    --> Number of threads to be used in parallel on computacion */
+int convert_color_to_planes(img_t *Img, int Conversion, img_t **Planes, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel24 == NULL) || (Planes == NULL) || (ThreadsNum < 1))
+		return -1;
+
+	if((Conversion < COLOR_RGB_TO_HSV) || (Conversion > COLOR_LAB_TO_RGB))
+	{
+		printf("Error: [convert_color_to_planes()] --> Invalid \"Conversion\" input.\n\n");
+		return -1;
+	}
+
+	img_t	*Output[3];
+
+	for(int32_t c = 0; c < 3; c++)
+		Output[c] = new_BMP_as_size(Img, GRAY_8BITS);
+
+	if((Output[0] == NULL) || (Output[1] == NULL) || (Output[2] == NULL) ||
+	   (run_color_convert(Conversion, Img, NULL, NULL, Output, ThreadsNum) == -1))
+	{
+		printf("Error: [convert_color_to_planes()] --> Could not allocate memory.\n\n");
+		for(int32_t c = 0; c < 3; c++)
+			free_img(Output[c]);
+		return -1;
+	}
+
+	for(int32_t c = 0; c < 3; c++)
+		Planes[c] = Output[c];
+
+	return 0;
+}
+/*******************************************************************************/
+/* Convert color space of three GRAY_8BITS planes of same size to a RGB_24BITS image
+   using multiple threads. Return NULL if fail
+	Planes     --> First, second and third components.
+	Conversion --> One of "color_conversion" (i.e. COLOR_HSV_TO_RGB).
+	Threads    --> Number of threads to be used in parallel on computacion */
+img_t *convert_color_from_planes(img_t **Planes, int Conversion, int32_t ThreadsNum)
+{
+	if((Planes == NULL) || (Planes[0] == NULL) || (Planes[1] == NULL) || (Planes[2] == NULL) ||
+	   (Planes[0]->Pixel8 == NULL) || (Planes[1]->Pixel8 == NULL) || (Planes[2]->Pixel8 == NULL) ||
+	   (ThreadsNum < 1))
+		return NULL;
+
+	if((Planes[0]->Width != Planes[1]->Width) || (Planes[0]->Width != Planes[2]->Width) ||
+	   (Planes[0]->Height != Planes[1]->Height) || (Planes[0]->Height != Planes[2]->Height))
+	{
+		printf("Error: [convert_color_from_planes()] --> Planes must have the same size.\n\n");
+		return NULL;
+	}
+
+	if((Conversion < COLOR_RGB_TO_HSV) || (Conversion > COLOR_LAB_TO_RGB))
+	{
+		printf("Error: [convert_color_from_planes()] --> Invalid \"Conversion\" input.\n\n");
+		return NULL;
+	}
+
+	img_t	*OutputImg;
+
+	OutputImg = new_BMP_as_size(Planes[0], RGB_24BITS);
+	if(OutputImg == NULL)
+		return NULL;
+
+	if(run_color_convert(Conversion, NULL, Planes, OutputImg, NULL, ThreadsNum) == -1)
+	{
+		printf("Error: [convert_color_from_planes()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		return NULL;
+	}
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Resize an image (GRAY_8BITS or RGB_24BITS) using multiple threads. Bilinear and exact
+   2x/4x area decimation use fixed point SIMD. Return NULL if fail
+	Img     --> Pointer to source image or ROI view.
+	Width   --> Width of resized image.
+	Height  --> Height of resized image.
+	Method  --> RESIZE_NEAREST, RESIZE_BILINEAR or RESIZE_AREA.
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *resize_image(img_t *Img, int32_t Width, int32_t Height, int Method, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (ThreadsNum < 1))
+		return NULL;
+
+	if((Width < 1) || (Height < 1))
+	{
+		printf("Error: [resize_image()] --> Invalid output size.\n\n");
+		return NULL;
+	}
+
+	if((Method < RESIZE_NEAREST) || (Method > RESIZE_AREA))
+	{
+		printf("Error: [resize_image()] --> Invalid \"Method\" input.\n\n");
+		return NULL;
+	}
+
+	resize_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	resize_work_t	Setup;
+	img_t			*OutputImg;
+	uint8_t			*Buffers;
+	size_t			BufferSize = 0;
+	int				Fail = 0;
+
+	Setup.Method = Method;
+	Setup.Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	Setup.FactorX = 0;
+	Setup.FactorY = 0;
+	Setup.ColumnIndex = NULL;
+	Setup.RowIndex = NULL;
+	Setup.ColumnWeight = NULL;
+	Setup.RowWeight = NULL;
+	Setup.ColumnArea = NULL;
+	Setup.RowArea = NULL;
+
+	/* Area averaging only reduces. Integer factors avoid weights (block sums fit 16 bits) */
+	if((Method == RESIZE_AREA) && ((Width > Img->Width) || (Height > Img->Height)))
+		Setup.Method = RESIZE_BILINEAR;
+	else if((Method == RESIZE_AREA) && (Img->Width % Width == 0) && (Img->Height % Height == 0) &&
+	        (Img->Height / Height <= 257))
+	{
+		Setup.FactorX = Img->Width / Width;
+		Setup.FactorY = Img->Height / Height;
+	}
+
+	if(Setup.Method == RESIZE_NEAREST)
+	{
+		Setup.ColumnIndex = (int32_t *)malloc(sizeof(int32_t) * Width);
+		Setup.RowIndex = (int32_t *)malloc(sizeof(int32_t) * Height);
+		Fail = (Setup.ColumnIndex == NULL) || (Setup.RowIndex == NULL);
+
+		if(Fail == 0)
+		{
+			resize_nearest_table(Img->Width, Width, Setup.Channels, Setup.ColumnIndex);
+			resize_nearest_table(Img->Height, Height, 1, Setup.RowIndex);
+		}
+	}
+	else if(Setup.Method == RESIZE_BILINEAR)
+	{
+		Setup.ColumnIndex = (int32_t *)malloc(sizeof(int32_t) * 2 * Width);
+		Setup.RowIndex = (int32_t *)malloc(sizeof(int32_t) * 2 * Height);
+		Setup.ColumnWeight = (int16_t *)malloc(sizeof(int16_t) * 2 * Width);
+		Setup.RowWeight = (int16_t *)malloc(sizeof(int16_t) * 2 * Height);
+		Fail = (Setup.ColumnIndex == NULL) || (Setup.RowIndex == NULL) ||
+		       (Setup.ColumnWeight == NULL) || (Setup.RowWeight == NULL);
+		BufferSize = sizeof(int16_t) * 2 * Width * Setup.Channels;
+
+		if(Fail == 0)
+		{
+			resize_linear_table(Img->Width, Width, Setup.Channels, Setup.ColumnIndex, Setup.ColumnWeight);
+			resize_linear_table(Img->Height, Height, 1, Setup.RowIndex, Setup.RowWeight);
+		}
+	}
+	else if(Setup.FactorX != 0)
+	{
+		BufferSize = sizeof(uint16_t) * Img->Width * Setup.Channels;
+	}
+	else
+	{
+		Setup.ColumnIndex = (int32_t *)malloc(sizeof(int32_t) * 3 * Width);
+		Setup.RowIndex = (int32_t *)malloc(sizeof(int32_t) * 3 * Height);
+		Setup.ColumnArea = (float *)malloc(sizeof(float) * (Img->Width + Width));
+		Setup.RowArea = (float *)malloc(sizeof(float) * (Img->Height + Height));
+		Fail = (Setup.ColumnIndex == NULL) || (Setup.RowIndex == NULL) ||
+		       (Setup.ColumnArea == NULL) || (Setup.RowArea == NULL);
+		BufferSize = sizeof(float) * Width * Setup.Channels;
+
+		if(Fail == 0)
+		{
+			resize_area_table(Img->Width, Width, Setup.ColumnIndex, Setup.ColumnArea);
+			resize_area_table(Img->Height, Height, Setup.RowIndex, Setup.RowArea);
+		}
+	}
+
+	OutputImg = new_BMP(Width, Height, (Setup.Channels == 3) ? RGB_24BITS : GRAY_8BITS);
+	Buffers = (uint8_t *)malloc(BufferSize * ThreadsNum + 1);
+
+	if((Fail != 0) || (OutputImg == NULL) || (Buffers == NULL))
+	{
+		printf("Error: [resize_image()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		OutputImg = NULL;
+	}
+	else
+	{
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			ThreadArg[i] = Setup;
+			ThreadArg[i].StartRow = i * Height/ThreadsNum;
+			ThreadArg[i].EndRow = (i + 1) * Height/ThreadsNum;
+			ThreadArg[i].Buffer = Buffers + BufferSize * i;
+			ThreadArg[i].Input = Img;
+			ThreadArg[i].Output = OutputImg;
+
+			pthread_create(&ThreadId[i], NULL, resize_rows, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+	}
+
+	free(Setup.ColumnIndex);
+	free(Setup.RowIndex);
+	free(Setup.ColumnWeight);
+	free(Setup.RowWeight);
+	free(Setup.ColumnArea);
+	free(Setup.RowArea);
+	free(Buffers);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Gaussian pyramid using multiple threads. Each level is computed in one pass over the
+   previous one and only kept (even) pixels are blurred. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS) or ROI view.
+	Levels  --> Number of levels (level 0 is a copy of source). Reduced when the
+	            coarsest level would be smaller than 1x1.
+	Threads --> Number of threads to be used in parallel on computacion */
+pyramid_t *gaussian_pyramid(img_t *Img, int32_t Levels, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (Levels < 1) || (ThreadsNum < 1))
+		return NULL;
+
+	pyramid_t	*Pyramid;
+
+	Pyramid = build_pyramid(Img, Levels, 0, ThreadsNum);
+	if(Pyramid == NULL)
+		printf("Error: [gaussian_pyramid()] --> Could not allocate memory.\n\n");
+
+	return Pyramid;
+}
+/*******************************************************************************/
+/* Laplacian pyramid using multiple threads: Gaussian levels plus bands with the detail
+   lost on each level. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS) or ROI view.
+	Levels  --> Number of levels (bands are Levels - 1).
+	Threads --> Number of threads to be used in parallel on computacion */
+pyramid_t *laplacian_pyramid(img_t *Img, int32_t Levels, int32_t ThreadsNum)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (Levels < 1) || (ThreadsNum < 1))
+		return NULL;
+
+	pyramid_t	*Pyramid;
+
+	Pyramid = build_pyramid(Img, Levels, 1, ThreadsNum);
+	if(Pyramid == NULL)
+		printf("Error: [laplacian_pyramid()] --> Could not allocate memory.\n\n");
+
+	return Pyramid;
+}
+/*******************************************************************************/
+/* Rebuild the image of a Laplacian pyramid from its coarsest level and its bands using
+   multiple threads. Unchanged bands give back the source exactly. Return NULL if fail
+	Pyramid --> Pointer to pyramid from "laplacian_pyramid" (bands may be edited).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *collapse_laplacian(pyramid_t *Pyramid, int32_t ThreadsNum)
+{
+	if((Pyramid == NULL) || (ThreadsNum < 1))
+		return NULL;
+
+	if(Pyramid->Band == NULL)
+	{
+		printf("Error: [collapse_laplacian()] --> Pyramid has no bands.\n\n");
+		return NULL;
+	}
+
+	img_t	*Level = Pyramid->Level;
+	img_t	*OutputImg, *TmpImg = NULL;
+	img_t	Current, Target;
+	uint8_t	*Scratch;
+	size_t	ScratchSize = pyramid_scratch(Level[0].Width);
+
+	OutputImg = new_BMP(Level[0].Width, Level[0].Height, GRAY_8BITS);
+	if(Pyramid->Levels > 2)
+		TmpImg = new_BMP(Level[1].Width, Level[1].Height, GRAY_8BITS);
+	Scratch = (uint8_t *)malloc(ScratchSize * ThreadsNum);
+
+	if((OutputImg == NULL) || ((Pyramid->Levels > 2) && (TmpImg == NULL)) || (Scratch == NULL))
+	{
+		printf("Error: [collapse_laplacian()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		free_img(TmpImg);
+		free(Scratch);
+		return NULL;
+	}
+
+	/* Rebuilt levels alternate between output (even levels) and temporary image */
+	if(Pyramid->Levels == 1)
+	{
+		for(int32_t Row = 0; Row < Level[0].Height; Row++)
+		{
+			for(int32_t Column = 0; Column < Level[0].Width; Column++)
+				OutputImg->Pixel8[Row][Column] = Level[0].Pixel8[Row][Column];
+		}
+	}
+
+	Current = Level[Pyramid->Levels - 1];
+	for(int32_t l = Pyramid->Levels - 2; l >= 0; l--)
+	{
+		Target = ((l & 1) == 0) ? *OutputImg : *TmpImg;
+		Target.Width = Level[l].Width;
+		Target.Height = Level[l].Height;
+
+		run_pyramid(pyramid_expand, &Target, &Current, Pyramid->Band[l], 1, Scratch, ScratchSize, ThreadsNum);
+		Current = Target;
+	}
+
+	free_img(TmpImg);
+	free(Scratch);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Frees memory allocated by the pyramid (levels and bands) */
+void free_pyramid(pyramid_t *Pyramid)
+{
+	free(Pyramid);
+}
+/*******************************************************************************/
+/* Affine warp of an image (GRAY_8BITS or RGB_24BITS) using multiple threads. Source
+   coordinates are stepped along output rows on fixed point and the output is filled
+   in tiles. Return NULL if fail
+	Img           --> Pointer to source image or ROI view.
+	Matrix        --> 2x3 transform (row-major) from source to destination:
+	                  x' = M[0] x + M[1] y + M[2]    y' = M[3] x + M[4] y + M[5]
+	Width         --> Width of warped image.
+	Height        --> Height of warped image.
+	Interpolation --> WARP_NEAREST or WARP_BILINEAR.
+	Border        --> One of "border_handling" (i.e. BORDER_REPLICATE).
+	Threads       --> Number of threads to be used in parallel on computacion */
+img_t *warp_affine(img_t *Img, const double *Matrix, int32_t Width, int32_t Height, int Interpolation,
+                   int Border, int32_t ThreadsNum)
+{
+	double	Forward[9];
+
+	if(Matrix == NULL)
 		return NULL;
 
-	correlation_work_t	ThreadArg[ThreadsNum];
-	img_t				*OutputImg;
-	pthread_t			ThreadId[ThreadsNum];
+	for(int32_t i = 0; i < 6; i++)
+		Forward[i] = Matrix[i];
 
-	int32_t				TmpRow, TmpCol;
-	kernel_t			*NewKernel;
+	Forward[6] = 0.0;
+	Forward[7] = 0.0;
+	Forward[8] = 1.0;
 
-	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+	return warp_perspective(Img, Forward, Width, Height, Interpolation, Border, ThreadsNum);
+}
+/*******************************************************************************/
+/* Perspective warp of an image (GRAY_8BITS or RGB_24BITS) using multiple threads. Return
+   NULL if fail
+	Img           --> Pointer to source image or ROI view.
+	Matrix        --> 3x3 homography (row-major) from source to destination.
+	Width         --> Width of warped image.
+	Height        --> Height of warped image.
+	Interpolation --> WARP_NEAREST or WARP_BILINEAR.
+	Border        --> One of "border_handling" (i.e. BORDER_BLACK).
+	Threads       --> Number of threads to be used in parallel on computacion */
+img_t *warp_perspective(img_t *Img, const double *Matrix, int32_t Width, int32_t Height, int Interpolation,
+                        int Border, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (Matrix == NULL) || (ThreadsNum < 1))
+		return NULL;
 
-	/* Allocate memory for convolution kernel */
-	NewKernel = (kernel_t *)malloc(sizeof(kernel_t));
+	if((Width < 1) || (Height < 1))
+	{
+		printf("Error: [warp_perspective()] --> Invalid output size.\n\n");
+		return NULL;
+	}
 
-	NewKernel->Height = Kernel->Height;
-	NewKernel->Width = Kernel->Width;
-			
-	NewKernel->Weight = (float **)malloc(sizeof(float *) * Kernel->Height);
-	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	if((Interpolation != WARP_NEAREST) && (Interpolation != WARP_BILINEAR))
 	{
-		NewKernel->Weight[Row] = (float *)malloc(sizeof(float) * Kernel->Width);
+		printf("Error: [warp_perspective()] --> Invalid \"Interpolation\" input.\n\n");
+		return NULL;
 	}
 
-	/* Convolution is a cross correlation with the kernel matrix rotated 180° */
-	/* Rotating kernel matrix 180° */
-	for(int32_t Row = 0; Row < Kernel->Height; Row++)
+	if((Border < BORDER_BLACK) || (Border > BORDER_REFLECT))
 	{
-		for(int32_t Column = 0; Column < Kernel->Width; Column++)
+		printf("Error: [warp_perspective()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
+
+	double	Inverse[9];
+	img_t	*OutputImg;
+
+	if(invert_matrix3(Matrix, Inverse) == -1)
+	{
+		printf("Error: [warp_perspective()] --> Singular \"Matrix\".\n\n");
+		return NULL;
+	}
+
+	OutputImg = run_warp(Img, Inverse, Width, Height, Interpolation, Border, ThreadsNum);
+	if(OutputImg == NULL)
+		printf("Error: [warp_perspective()] --> Could not allocate memory.\n\n");
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Fill a 2x3 affine matrix that rotates around a point and scales
+	CenterX --> Column of rotation center.
+	CenterY --> Row of rotation center.
+	Angle   --> Degrees, positive is counter-clockwise as seen on the image.
+	Scale   --> Scale factor.
+	Matrix  --> Output of 6 values for "warp_affine" */
+void rotation_matrix(double CenterX, double CenterY, double Angle, double Scale, double *Matrix)
+{
+	double	Cosine = Scale * cos(Angle * M_PI / 180.0);
+	double	Sine = Scale * sin(Angle * M_PI / 180.0);
+
+	Matrix[0] = Cosine;
+	Matrix[1] = Sine;
+	Matrix[2] = (1.0 - Cosine) * CenterX - Sine * CenterY;
+	Matrix[3] = -Sine;
+	Matrix[4] = Cosine;
+	Matrix[5] = Sine * CenterX + (1.0 - Cosine) * CenterY;
+}
+/*******************************************************************************/
+/* Fill the 3x3 homography that maps four source points to four destination points.
+   Return -1 if points are degenerate (three of them aligned) or 0 on success
+	Source      --> 4 points as (x, y) pairs.
+	Destination --> 4 points as (x, y) pairs.
+	Matrix      --> Output of 9 values for "warp_perspective" */
+int perspective_matrix(const double *Source, const double *Destination, double *Matrix)
+{
+	if((Source == NULL) || (Destination == NULL) || (Matrix == NULL))
+		return -1;
+
+	double	System[8][9];
+	double	Factor, Swap;
+	int32_t	Pivot;
+
+	/* Two equations per point on the 8 unknowns (last matrix entry is 1) */
+	for(int32_t i = 0; i < 4; i++)
+	{
+		double	X = Source[2 * i], Y = Source[2 * i + 1];
+		double	U = Destination[2 * i], V = Destination[2 * i + 1];
+		double	RowU[9] = {X, Y, 1.0, 0.0, 0.0, 0.0, -X * U, -Y * U, U};
+		double	RowV[9] = {0.0, 0.0, 0.0, X, Y, 1.0, -X * V, -Y * V, V};
+
+		for(int32_t j = 0; j < 9; j++)
 		{
-			TmpRow = Kernel->Height - (1 + Row);
-			TmpCol = Kernel->Width - (1 + Column);
-			NewKernel->Weight[Row][Column] = Kernel->Weight[TmpRow][TmpCol];
+			System[2 * i][j] = RowU[j];
+			System[2 * i + 1][j] = RowV[j];
 		}
 	}
 
-
-	/* Creating threads arguments and starting threads */
-	for(int32_t i = 0; i < ThreadsNum; i++)
+	/* Gaussian elimination with partial pivoting */
+	for(int32_t Column = 0; Column < 8; Column++)
 	{
-		ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
-		
-		if(i == ThreadsNum - 1)
-			ThreadArg[i].EndRow = Img->Height;
-		else
-			ThreadArg[i].EndRow = ThreadArg[i].StartRow + Img->Height/ThreadsNum;
+		Pivot = Column;
+		for(int32_t Row = Column + 1; Row < 8; Row++)
+		{
+			if(fabs(System[Row][Column]) > fabs(System[Pivot][Column]))
+				Pivot = Row;
+		}
 
-		
-		ThreadArg[i].BorderHandling = Border;
-		ThreadArg[i].Kernel = NewKernel;
-		ThreadArg[i].InputImage = Img;
-		ThreadArg[i].OutputImage = OutputImg;
+		if(fabs(System[Pivot][Column]) < 1e-12)
+		{
+			printf("Error: [perspective_matrix()] --> Degenerate points.\n\n");
+			return -1;
+		}
 
-		pthread_create(&ThreadId[i], NULL, cross_correlation, (void *)&ThreadArg[i]);
+		for(int32_t j = 0; j < 9; j++)
+		{
+			Swap = System[Column][j];
+			System[Column][j] = System[Pivot][j];
+			System[Pivot][j] = Swap;
+		}
+
+		for(int32_t Row = 0; Row < 8; Row++)
+		{
+			if(Row == Column)
+				continue;
+
+			Factor = System[Row][Column] / System[Column][Column];
+			for(int32_t j = Column; j < 9; j++)
+				System[Row][j] -= Factor * System[Column][j];
+		}
 	}
 
-	for(int32_t i = 0; i < ThreadsNum; i++)
+	for(int32_t i = 0; i < 8; i++)
+		Matrix[i] = System[i][8] / System[i][i];
+
+	Matrix[8] = 1.0;
+
+	return 0;
+}
+/*******************************************************************************/
+/* Unsharp mask (source plus amplified difference to its gaussian blur) of an image using
+   multiple threads. Blur, difference, gain and clamp are done in one pass. Return NULL
+   if fail
+	Img       --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Sigma     --> Standard deviation of the blur in pixels (> 0).
+	Amount    --> Gain of the detail (i.e. 1.0 doubles it).
+	Threshold --> Details below this value are left unchanged (0 sharpens everything).
+	Threads   --> Number of threads to be used in parallel on computacion
+	Border    --> One of "border_handling" (i.e. BORDER_REPLICATE) */
+img_t *unsharp_mask(img_t *Img, float Sigma, float Amount, uint8_t Threshold, int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (ThreadsNum < 1) || !(Sigma > 0.0))
+		return NULL;
+
+	if((Border < BORDER_BLACK) || (Border > BORDER_REFLECT))
 	{
-		pthread_join(ThreadId[i], NULL);
+		printf("Error: [unsharp_mask()] --> Selected border handling not suported.\n\n");
+		return NULL;
 	}
 
-	free_kernel(NewKernel);
-	
+	img_t	*OutputImg;
+
+	OutputImg = run_sharpen(Img, &Sigma, 1, Amount, Threshold, Border, ThreadsNum);
+	if(OutputImg == NULL)
+		printf("Error: [unsharp_mask()] --> Could not allocate memory.\n\n");
+
 	return OutputImg;
 }
 /*******************************************************************************/
-/* Generate the histogram for a given image */
-void histogram(img_t *Img)
+/* Difference of gaussians (band pass) of an image using multiple threads. Both blurs,
+   difference, gain and clamp are done in one pass. Result is centered at 128. Return
+   NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Sigma1  --> Standard deviation of the first (usually narrower) blur (> 0).
+	Sigma2  --> Standard deviation of the blur subtracted from the first one (> 0).
+	Gain    --> Gain of the difference.
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> One of "border_handling" (i.e. BORDER_REFLECT) */
+img_t *difference_of_gaussians(img_t *Img, float Sigma1, float Sigma2, float Gain, int32_t ThreadsNum, int Border)
 {
-	if((Img == NULL) || (Img->Pixel8 == NULL))
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (ThreadsNum < 1) ||
+	   !(Sigma1 > 0.0) || !(Sigma2 > 0.0))
+		return NULL;
+
+	if((Border < BORDER_BLACK) || (Border > BORDER_REFLECT))
 	{
-		printf("Error: [histogram()] --> Invalid image argument.\n\n");
-		return;
+		printf("Error: [difference_of_gaussians()] --> Selected border handling not suported.\n\n");
+		return NULL;
 	}
 
-	uint32_t	Gray[256] = {0};
-	uint32_t	NumPixel = Img->Height * Img->Width;
-	uint32_t	MaxSamePixel = 0;
-	float		Percent;
-	float		NormalPercent;
-	uint8_t		HeaderFlag = 1;
+	float	Sigma[2] = {Sigma1, Sigma2};
+	img_t	*OutputImg;
 
-	/* Acquiring histogram data */
-	for(int32_t Row = 0; Row < Img->Height; Row++)
+	OutputImg = run_sharpen(Img, Sigma, 2, Gain, 0.0, Border, ThreadsNum);
+	if(OutputImg == NULL)
+		printf("Error: [difference_of_gaussians()] --> Could not allocate memory.\n\n");
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Canny edge detection using multiple threads. Each thread runs smoothing, gradient,
+   non maximum suppression and double threshold on its band as a pipeline over line
+   buffers. Hysteresis follows candidates with a stack inside each band and joins bands
+   with union-find. Edges are 255 and background 0. Return NULL if fail
+	Img           --> Pointer to source image (GRAY_8BITS).
+	Sigma         --> Standard deviation of the gaussian smoothing (0 for no smoothing).
+	LowThreshold  --> Gradient magnitudes above this value are candidates.
+	HighThreshold --> Gradient magnitudes above this value start an edge.
+	Operator      --> GRADIENT_SOBEL
+	                  GRADIENT_SCHARR
+	Norm          --> GRADIENT_L1
+	                  GRADIENT_L2
+	Threads       --> Number of threads to be used in parallel on computacion
+	Border        --> One of "border_handling" (i.e. BORDER_REPLICATE) */
+img_t *canny_edges(img_t *Img, float Sigma, int32_t LowThreshold, int32_t HighThreshold, int Operator, int Norm,
+                   int32_t ThreadsNum, int Border)
+{
+	if((Img == NULL) || (Img->Pixel8 == NULL) || (ThreadsNum < 1) || !(Sigma >= 0.0))
+		return NULL;
+
+	canny_work_t	ThreadArg[ThreadsNum];
+	pthread_t		ThreadId[ThreadsNum];
+	canny_work_t	*Up;
+	img_t			*OutputImg;
+	size_t			Labels = (size_t)2 * Img->Width * ThreadsNum + 1;
+	int32_t			Radius = (Sigma > 0.0) ? (int32_t)ceilf(3.0 * Sigma) : 0;
+	float			*Coef;
+	uint8_t			*BorderRow;
+	uint32_t		*BoundaryLabels, *Parent, *Seed;
+	uint8_t			*Strong;
+	int32_t			Failed = 0;
+
+	if(((Operator != GRADIENT_SOBEL) && (Operator != GRADIENT_SCHARR)) ||
+	   ((Norm != GRADIENT_L1) && (Norm != GRADIENT_L2)))
 	{
-		for(int32_t Column = 0; Column < Img->Width; Column++)
+		printf("Error: [canny_edges()] --> Invalid operator or norm.\n\n");
+		return NULL;
+	}
+
+	if((LowThreshold < 0) || (LowThreshold > HighThreshold))
+	{
+		printf("Error: [canny_edges()] --> Thresholds should be 0 <= LowThreshold <= HighThreshold.\n\n");
+		return NULL;
+	}
+
+	if((Border < BORDER_BLACK) || (Border > BORDER_REFLECT))
+	{
+		printf("Error: [canny_edges()] --> Selected border handling not suported.\n\n");
+		return NULL;
+	}
+
+	Coef = (float *)malloc(sizeof(float) * (2 * Radius + 1));
+	BorderRow = (uint8_t *)malloc(Img->Width);
+	BoundaryLabels = (uint32_t *)malloc(sizeof(uint32_t) * 2 * Img->Width * ThreadsNum);
+	Parent = (uint32_t *)malloc(sizeof(uint32_t) * Labels);
+	Seed = (uint32_t *)malloc(sizeof(uint32_t) * Labels);
+	Strong = (uint8_t *)malloc(Labels);
+	OutputImg = new_BMP_as_size(Img, GRAY_8BITS);
+
+	for(int32_t i = 0; i < ThreadsNum; i++)
+	{
+		ThreadArg[i].StackSize = 4 * (size_t)Img->Width;
+		ThreadArg[i].Stack = (uint32_t *)malloc(sizeof(uint32_t) * ThreadArg[i].StackSize);
+		Failed |= (ThreadArg[i].Stack == NULL);
+	}
+
+	if(Failed || (Coef == NULL) || (BorderRow == NULL) || (BoundaryLabels == NULL) || (Parent == NULL) ||
+	   (Seed == NULL) || (Strong == NULL) || (OutputImg == NULL))
+	{
+		printf("Error: [canny_edges()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		OutputImg = NULL;
+	}
+	else
+	{
+		if(Radius > 0)
+			gaussian_coefficients(Coef, Radius, Sigma);
+		else
+			Coef[0] = 1.0;
+
+		for(int32_t i = 0; i < Img->Width; i++)
+			BorderRow[i] = (Border == BORDER_WHITE) ? 255 : 0;
+
+		/* Pipeline and hysteresis inside each band */
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+			ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+			ThreadArg[i].Radius = Radius;
+			ThreadArg[i].Operator = Operator;
+			ThreadArg[i].Norm = Norm;
+			ThreadArg[i].Border = Border;
+			ThreadArg[i].LowThreshold = LowThreshold;
+			ThreadArg[i].HighThreshold = HighThreshold;
+			ThreadArg[i].Base = (uint32_t)(2 * Img->Width * i + 1);
+			ThreadArg[i].Used = 0;
+			ThreadArg[i].BorderValue = (Border == BORDER_WHITE) ? 255.0 : 0.0;
+			ThreadArg[i].Coef = Coef;
+			ThreadArg[i].BorderRow = BorderRow;
+			ThreadArg[i].StackTop = 0;
+			ThreadArg[i].BoundaryLabel = BoundaryLabels + (size_t)2 * Img->Width * i;
+			ThreadArg[i].Parent = Parent;
+			ThreadArg[i].Seed = Seed;
+			ThreadArg[i].Strong = Strong;
+			ThreadArg[i].InputImage = Img;
+			ThreadArg[i].OutputImage = OutputImg;
+
+			pthread_create(&ThreadId[i], NULL, canny_band, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+
+		/* Join candidates across band boundaries (empty bands are skipped) */
+		Up = NULL;
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			if(ThreadArg[i].StartRow == ThreadArg[i].EndRow)
+				continue;
+
+			if(Up != NULL)
+				canny_link_bands(Up, &ThreadArg[i]);
+
+			Up = &ThreadArg[i];
+		}
+
+		/* Roots gather the flags of their trees, then every label takes the flag of its root */
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			for(uint32_t Label = ThreadArg[i].Base; Label < ThreadArg[i].Base + ThreadArg[i].Used; Label++)
+			{
+				if(Strong[Label])
+					Strong[find_root(Parent, Label)] = 1;
+			}
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			for(uint32_t Label = ThreadArg[i].Base; Label < ThreadArg[i].Base + ThreadArg[i].Used; Label++)
+				Strong[Label] = Strong[find_root(Parent, Label)];
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_create(&ThreadId[i], NULL, canny_finish, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
 		{
-			Gray[Img->Pixel8[Row][Column]]++;
+			pthread_join(ThreadId[i], NULL);
 		}
 	}
 
-	for(int32_t i = 0; i < 256; i++)
+	for(int32_t i = 0; i < ThreadsNum; i++)
+		free(ThreadArg[i].Stack);
+
+	free(Coef);
+	free(BorderRow);
+	free(BoundaryLabels);
+	free(Parent);
+	free(Seed);
+	free(Strong);
+
+	return OutputImg;
+}
+/*******************************************************************************/
+/* Edge preserving smoothing with the guided filter using multiple threads. Every output
+   pixel is a linear function of the guide fitted on each window, with window means read
+   from summed-area tables so cost does not depend on radius. RGB images are filtered
+   per channel. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	Guide   --> GRAY_8BITS image of same size guiding every channel, or NULL to make
+	            each channel guide itself (edge preserving smoothing).
+	Radius  --> Window radius (window side is 2*Radius+1, clipped at the borders).
+	Epsilon --> Regularization in squared gray levels. Edges with standard deviation
+	            well above sqrt(Epsilon) are kept (i.e. 400 smooths variations of ~20).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *guided_filter(img_t *Img, img_t *Guide, int32_t Radius, float Epsilon, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (ThreadsNum < 1))
+		return NULL;
+
+	img_t		*Planes[3] = {NULL, NULL, NULL};
+	img_t		*Filtered[3] = {NULL, NULL, NULL};
+	img_t		*OutputImg = NULL;
+	integral_t	*GuideSum = NULL;
+	integral_t	*GuideSqSum = NULL;
+	int32_t		Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	int32_t		Failed = 0;
+
+	if((Radius < 1) || !(Epsilon > 0.0))
 	{
-		if(Gray[i] > MaxSamePixel)
-			MaxSamePixel = Gray[i];
+		printf("Error: [guided_filter()] --> Radius should be at least 1 and Epsilon positive.\n\n");
+		return NULL;
 	}
 
-	/* Printing histogram */
-	printf("               NORMALIZED GRAPH\n");
-	for(int32_t i = 0; i < 256; i++)
+	if((Guide != NULL) && ((Guide->Pixel8 == NULL) || (Guide->Width != Img->Width) || (Guide->Height != Img->Height)))
 	{
-		Percent = 100.0 * (float)Gray[i] / (float)NumPixel;
-		NormalPercent = 100.0 * (float)Gray[i] / (float)MaxSamePixel;
-		
-		for(int32_t j = 0; j < 50; j++)
+		printf("Error: [guided_filter()] --> Guide should be a GRAY_8BITS image of same size.\n\n");
+		return NULL;
+	}
+
+	if(Channels == 1)
+		Planes[0] = Img;
+	else if(split_channels(Img, &Planes[0], &Planes[1], &Planes[2], ThreadsNum) == -1)
+		return NULL;
+
+	if(Guide != NULL)
+	{
+		GuideSum = build_integral(Guide, NULL, INTEGRAL_UINT32, ThreadsNum);
+		GuideSqSum = build_integral(Guide, Guide, INTEGRAL_UINT64, ThreadsNum);
+		Failed = (GuideSum == NULL) || (GuideSqSum == NULL);
+	}
+
+	for(int32_t c = 0; (c < Channels) && !Failed; c++)
+	{
+		if(Guide == NULL)
 		{
-			if((j <= NormalPercent/2) && (HeaderFlag == 0))
-				printf("#");
-			else
-				printf(" ");
+			GuideSum = build_integral(Planes[c], NULL, INTEGRAL_UINT32, ThreadsNum);
+			GuideSqSum = build_integral(Planes[c], Planes[c], INTEGRAL_UINT64, ThreadsNum);
 		}
-		if(HeaderFlag == 0)
-			printf("| %d / %0.4f%% / %u\n", i, Percent, Gray[i]);
-		else
+
+		if((GuideSum != NULL) && (GuideSqSum != NULL))
 		{
-			printf("| Gray / Percent / pixels\n");
-			HeaderFlag = 0;
+			Filtered[c] = run_guided(Planes[c], (Guide != NULL) ? Guide : Planes[c], GuideSum, GuideSqSum,
+			                         Radius, Epsilon, ThreadsNum);
+		}
+
+		Failed = (Filtered[c] == NULL);
+
+		if(Guide == NULL)
+		{
+			free_integral(GuideSum);
+			free_integral(GuideSqSum);
+			GuideSum = NULL;
+			GuideSqSum = NULL;
 		}
 	}
+
+	if(!Failed)
+		OutputImg = (Channels == 1) ? Filtered[0] : merge_channels(Filtered[0], Filtered[1], Filtered[2], ThreadsNum);
+
+	if(OutputImg == NULL)
+		printf("Error: [guided_filter()] --> Could not allocate memory.\n\n");
+
+	free_integral(GuideSum);
+	free_integral(GuideSqSum);
+
+	if(Channels == 3)
+	{
+		for(int32_t c = 0; c < 3; c++)
+		{
+			free_img(Planes[c]);
+			free_img(Filtered[c]);
+		}
+	}
+
+	return OutputImg;
 }
+/*******************************************************************************/
+/* Bilateral filter approximated on a bilateral grid using multiple threads. Pixels are
+   accumulated on a grid downsampled by the spatial and range sigmas, the grid is blurred
+   with [1 2 1] along each axis and read back with trilinear interpolation, so cost does
+   not depend on the sigmas. RGB images use the luma as range. Return NULL if fail
+	Img        --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	SigmaSpace --> Spatial extent in pixels (>= 1).
+	SigmaRange --> Range extent in gray levels (>= 1). Edges well above it are kept.
+	Threads    --> Number of threads to be used in parallel on computacion */
+img_t *bilateral_grid(img_t *Img, float SigmaSpace, float SigmaRange, int32_t ThreadsNum)
+{
+	if((Img == NULL) || ((Img->Pixel8 == NULL) && (Img->Pixel24 == NULL)) || (ThreadsNum < 1))
+		return NULL;
+
+	if(!(SigmaSpace >= 1.0) || !(SigmaRange >= 1.0))
+	{
+		printf("Error: [bilateral_grid()] --> Sigmas should be at least 1.\n\n");
+		return NULL;
+	}
+
+	bilateral_work_t	ThreadArg[ThreadsNum];
+	pthread_t			ThreadId[ThreadsNum];
+	bilateral_work_t	Setup;
+	img_t				*OutputImg;
+	float				*Lines;
+	size_t				RowSize, GridSize;
+
+	/* Last pixel (rounded on splat, interpolated on slicing) stays inside the grid. Sizes
+	   use the same float reciprocal as splat and slicing: "x / s" and "x * (1 / s)" may
+	   round to different sides of an integer */
+	Setup.Channels = (Img->Pixel8 != NULL) ? 1 : 3;
+	Setup.GridWidth = (int32_t)((Img->Width - 1) * (1.0f / SigmaSpace)) + 2;
+	Setup.GridHeight = (int32_t)((Img->Height - 1) * (1.0f / SigmaSpace)) + 2;
+	Setup.GridDepth = (int32_t)(255 * (1.0f / SigmaRange)) + 2;
+	Setup.SigmaSpace = SigmaSpace;
+	Setup.SigmaRange = SigmaRange;
+	Setup.InputImage = Img;
+
+	RowSize = (size_t)Setup.GridWidth * Setup.GridDepth * (Setup.Channels + 1);
+	GridSize = RowSize * Setup.GridHeight;
+
+	Setup.Grid = (float *)malloc(sizeof(float) * GridSize);
+	Setup.Blurred = (float *)malloc(sizeof(float) * GridSize);
+	Lines = (float *)malloc(sizeof(float) * RowSize * ThreadsNum);
+	OutputImg = new_BMP_as_size(Img, (Setup.Channels == 3) ? RGB_24BITS : GRAY_8BITS);
+
+	if((Setup.Grid == NULL) || (Setup.Blurred == NULL) || (Lines == NULL) || (OutputImg == NULL))
+	{
+		printf("Error: [bilateral_grid()] --> Could not allocate memory.\n\n");
+		free_img(OutputImg);
+		OutputImg = NULL;
+	}
+	else
+	{
+		Setup.OutputImage = OutputImg;
+
+		/* Splat and blur along range and columns */
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			ThreadArg[i] = Setup;
+			ThreadArg[i].StartRow = i * Setup.GridHeight/ThreadsNum;
+			ThreadArg[i].EndRow = (i + 1) * Setup.GridHeight/ThreadsNum;
+			ThreadArg[i].Line = Lines + RowSize * i;
+
+			pthread_create(&ThreadId[i], NULL, bilateral_splat, (void *)&ThreadArg[i]);
+		}
 
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+
+		/* Blur along grid rows */
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_create(&ThreadId[i], NULL, bilateral_blur_rows, (void *)&ThreadArg[i]);
+		}
+
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
 
+		/* Slicing */
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			ThreadArg[i].StartRow = i * Img->Height/ThreadsNum;
+			ThreadArg[i].EndRow = (i + 1) * Img->Height/ThreadsNum;
+
+			pthread_create(&ThreadId[i], NULL, bilateral_slice, (void *)&ThreadArg[i]);
+		}
 
+		for(int32_t i = 0; i < ThreadsNum; i++)
+		{
+			pthread_join(ThreadId[i], NULL);
+		}
+	}
 
+	free(Setup.Grid);
+	free(Setup.Blurred);
+	free(Lines);
 
+	return OutputImg;
+}
@@ -12,6 +12,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <math.h>
+#include <float.h>
 
  #include "bitmap.h"
  
@@ -27,6 +29,138 @@ struct kernel
 };
 typedef struct kernel kernel_t;
 
+/* One non-zero tap of a sparse kernel. Offsets are relative to the kernel center */
+struct sparse_tap
+{
+	int32_t	RowOffset;
+	int32_t	ColumnOffset;
+	float	Weight;
+};
+typedef struct sparse_tap sparse_tap_t;
+
+/* Sparse kernel: only the non-zero taps are stored (in row-major order) */
+struct sparse_kernel
+{
+	int32_t			Width;
+	int32_t			Height;
+	int32_t			NumTaps;
+	sparse_tap_t	*Tap;
+};
+typedef struct sparse_kernel sparse_kernel_t;
+
+/* Binary image packed with 1 bit per pixel. Bit (Column % 8) of byte
+	Bits[Row * Stride + Column / 8] holds pixel (Row, Column) */
+struct bit_mask
+{
+	int32_t	Width;
+	int32_t	Height;
+	int32_t	Stride;			/* Bytes per row */
+	uint8_t	*Bits;
+};
+typedef struct bit_mask bit_mask_t;
+
+/* Single channel image of floats (scores, responses, distances) in row-major order */
+struct float_map
+{
+	int32_t	Width;
+	int32_t	Height;
+	float	*Data;
+};
+typedef struct float_map float_map_t;
+
+/* Template match. Row and Column are the top left corner of the template on the image */
+struct match
+{
+	int32_t	Row;
+	int32_t	Column;
+	float	Score;
+};
+typedef struct match match_t;
+
+/* Line found by Hough transform: Column * cos(Theta) + Row * sin(Theta) = Rho */
+struct hough_line
+{
+	float		Rho;				/* Pixels (may be negative) */
+	float		Theta;				/* Radians in [0:pi[ */
+	uint32_t	Votes;
+};
+typedef struct hough_line hough_line_t;
+
+/* Keypoint found by corner detectors. X is the column and Y the row */
+struct keypoint
+{
+	int32_t	X;
+	int32_t	Y;
+	float	Score;
+};
+typedef struct keypoint keypoint_t;
+
+/* Statistics computed by "image_stats". RGB_24BITS images fill the entries indexed by
+	PASS_RED_CHANNEL, PASS_GREEN_CHANNEL and PASS_BLUE_CHANNEL, GRAY_8BITS images only
+	the first one. Positions are the first occurrence in raster order (-1 if not asked) */
+struct img_stats
+{
+	int32_t		Channels;
+	uint64_t	Count;				/* Pixels */
+	uint8_t		Min[3];
+	uint8_t		Max[3];
+	uint64_t	Sum[3];
+	double		Mean[3];
+	double		StdDev[3];			/* Population standard deviation */
+	int32_t		MinX[3];
+	int32_t		MinY[3];
+	int32_t		MaxX[3];
+	int32_t		MaxY[3];
+};
+typedef struct img_stats img_stats_t;
+
+/* Chain of per pixel operations composed into lookup tables ("point_lut_*" functions).
+	Tables are indexed by PASS_RED_CHANNEL, PASS_GREEN_CHANNEL and PASS_BLUE_CHANNEL.
+	GRAY_8BITS images use the first one */
+struct point_lut
+{
+	uint8_t		Table[3][256];
+};
+typedef struct point_lut point_lut_t;
+
+/* Read only view of one channel of an image without copying pixels. Pixel (Row, Column)
+	is Rows[Row][Column * Step] */
+struct channel_view
+{
+	int32_t			Width;
+	int32_t			Height;
+	int32_t			Step;			/* Bytes between pixels (3 on RGB_24BITS, 1 on GRAY_8BITS) */
+	const uint8_t	**Rows;
+};
+typedef struct channel_view channel_view_t;
+
+/* Image pyramid (GRAY_8BITS) held in a single allocation. Level 0 has the source size and
+	each level is the previous one blurred (5 taps binomial) and decimated by 2 (sizes
+	rounded up). Laplacian pyramids also keep on Band[i] (i < Levels - 1, row-major) the
+	difference of level i to the expansion of level i + 1. Levels live inside the pyramid
+	allocation: copy them (i.e. "copy_BMP") before "save_BMP" or "free_img" */
+struct pyramid
+{
+	int32_t		Levels;
+	img_t		*Level;
+	int16_t		**Band;			/* NULL on Gaussian pyramids */
+};
+typedef struct pyramid pyramid_t;
+
+/* Summed-area table of an image. Entry [Row * Width + Column] holds the sum of the image
+	pixels (or squared pixels) on rows [0:Row[ and columns [0:Column[, so first row and
+	column are zero. Only the array matching "Type" is allocated */
+struct integral
+{
+	int32_t		Width;			/* Table width  (image width + 1) */
+	int32_t		Height;			/* Table height (image height + 1) */
+	int32_t		Type;
+	uint32_t	*Sum32;			/* INTEGRAL_UINT32 (sums modulo 2^32) */
+	uint64_t	*Sum64;			/* INTEGRAL_UINT64 */
+	double		*SumDouble;		/* INTEGRAL_DOUBLE */
+};
+typedef struct integral integral_t;
+
 /* Hold arguments to do multithreaded cross correlation and convolution
 	Interval for correlation or convolution is NOT closed i.e. [StartRow:EndRow[ */
 struct cross_correlation_work
@@ -35,15 +169,524 @@ struct cross_correlation_work
 	int32_t		EndRow;
 	int32_t		BorderHandling;
 	kernel_t	*Kernel;
+	sparse_kernel_t	*SparseKernel;	/* Used instead of "Kernel" when not NULL */
 	img_t		*InputImage;
 	img_t		*OutputImage;
 	
 };
 typedef struct cross_correlation_work correlation_work_t;
 
+/* Hold arguments to do multithreaded gaussian smoothing. Depending on the pass
+	the interval refers to rows or to columns and it is NOT closed i.e. [Start:End[ */
+struct gaussian_work
+{
+	int32_t		Start;
+	int32_t		End;
+	int32_t		Radius;			/* FIR kernel radius (or padding length on IIR) */
+	float		BorderValue;
+	float		*Coef;			/* FIR: 2*Radius+1 weights. IIR: B, b1, b2, b3 */
+	float		*Buffer;		/* Intermediate image (Width*Height) */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct gaussian_work gaussian_work_t;
+
+/* Hold arguments to do multithreaded gradient computation
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct gradient_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Operator;
+	int32_t		Norm;
+	int32_t		OrientationBins;
+	uint8_t		BorderValue;
+	img_t		*InputImage;
+	img_t		*MagnitudeImage;
+	img_t		*OrientationImage;	/* NULL if orientation is not wanted */
+};
+typedef struct gradient_work gradient_work_t;
+
+/* Hold arguments to do multithreaded median filtering
+	Interval is NOT closed i.e. [StartColumn:EndColumn[ */
+struct median_work
+{
+	int32_t		StartColumn;
+	int32_t		EndColumn;
+	int32_t		Radius;
+	uint8_t		BorderValue;
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct median_work median_work_t;
+
+/* Hold arguments to do multithreaded morphology passes. Depending on the pass
+	the interval refers to rows or to columns and it is NOT closed i.e. [Start:End[ */
+struct morphology_work
+{
+	int32_t		Start;
+	int32_t		End;
+	int32_t		Size;			/* Structuring element length along the pass */
+	int32_t		IsMax;			/* 1 --> dilation (max)  0 --> erosion (min) */
+	uint8_t		BorderValue;
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct morphology_work morphology_work_t;
+
+/* Hold arguments to do multithreaded histogram computation
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct histogram_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	uint32_t	*Hist;				/* Thread private counts (256 per channel) */
+	img_t		*InputImage;
+};
+typedef struct histogram_work histogram_work_t;
+
+/* Hold arguments to apply a lookup table using multiple threads
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct lut_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	uint8_t		*Lut;				/* 256 entries (3*256 on RGB_24BITS, see "point_lut_t") */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+	bit_mask_t	*Mask;				/* If not NULL non-zero results are packed here instead */
+};
+typedef struct lut_work lut_work_t;
+
+/* Hold arguments to do multithreaded CLAHE. On tile pass the interval refers to
+	tiles (row-major index) and on interpolation pass to image rows.
+	Interval is NOT closed i.e. [Start:End[ */
+struct clahe_work
+{
+	int32_t		Start;
+	int32_t		End;
+	int32_t		TilesY;
+	int32_t		TilesX;
+	float		ClipLimit;
+	uint8_t		*Lut;				/* TilesY*TilesX tables of 256 entries */
+	int32_t		*ColumnTile;		/* Left tile of each column */
+	int32_t		*ColumnWeight;		/* Weight of right tile (Q8) of each column */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct clahe_work clahe_work_t;
+
+/* Hold arguments to do multithreaded summed-area table computation. On the row pass
+	the interval refers to rows and on the column pass to columns.
+	Interval is NOT closed i.e. [Start:End[ */
+struct integral_work
+{
+	int32_t		Start;
+	int32_t		End;
+	img_t		*FactorImage;		/* If not NULL pixels are multiplied by it (Img --> squares) */
+	integral_t	*Table;
+	img_t		*InputImage;
+};
+typedef struct integral_work integral_work_t;
+
+/* Hold arguments to do multithreaded adaptive thresholding
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct adaptive_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Method;
+	int32_t		Radius;
+	float		Param;
+	integral_t	*Sum;				/* INTEGRAL_UINT32 */
+	integral_t	*SqSum;				/* INTEGRAL_UINT64 (only on ADAPTIVE_SAUVOLA) */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+	bit_mask_t	*Mask;				/* If not NULL result is packed here instead */
+};
+typedef struct adaptive_work adaptive_work_t;
+
+/* Statistics of one connected component. Bounding box limits are inclusive */
+struct blob
+{
+	uint32_t	Area;				/* Number of pixels */
+	int32_t		Left;
+	int32_t		Top;
+	int32_t		Right;
+	int32_t		Bottom;
+	uint64_t	SumX;				/* First order moments */
+	uint64_t	SumY;
+	double		CentroidX;
+	double		CentroidY;
+};
+typedef struct blob blob_t;
+
+/* Result of connected component labeling. Labels holds one label per pixel (row-major),
+	0 is background and blob "Blobs[i]" has label i + 1 */
+struct components
+{
+	int32_t		Width;
+	int32_t		Height;
+	uint32_t	Count;
+	uint32_t	*Labels;
+	blob_t		*Blobs;
+};
+typedef struct components components_t;
+
+/* Hold arguments to do multithreaded connected component labeling. Image is scanned
+	on 2x2 pixel blocks and each thread owns the provisional labels [Base:Base+Used[.
+	Interval refers to block rows and is NOT closed i.e. [StartRow:EndRow[ */
+struct components_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	uint32_t	Base;
+	uint32_t	Used;
+	uint32_t	*Parent;			/* Union-find forest shared by all threads */
+	uint32_t	*BlockLabel;
+	uint8_t		*BlockMask;			/* Foreground pixels of each block (4 bits) */
+	blob_t		*Blobs;				/* Partial statistics of this thread */
+	img_t		*InputImage;
+	components_t	*Output;
+};
+typedef struct components_work components_work_t;
+
+/* Hold arguments to do multithreaded normalized cross correlation. On the direct path
+	the interval refers to rows of the score map and on the FFT path to tiles.
+	Interval is NOT closed i.e. [Start:End[ */
+struct ncc_work
+{
+	int32_t		Start;
+	int32_t		End;
+	int32_t		FFTSize;			/* Tile side on FFT path, 0 on direct path */
+	int32_t		TemplateWidth;
+	int32_t		TemplateHeight;
+	float		*Template;			/* Zero mean template */
+	double		TemplateNorm;		/* Square root of zero mean template energy */
+	float		*SpectrumRe;		/* Conjugated template spectrum (FFT path) */
+	float		*SpectrumIm;
+	float		*Cos;				/* FFT twiddle factors */
+	float		*Sin;
+	float		*Scratch;			/* 2 * FFTSize^2 floats of this thread */
+	integral_t	*Sum;				/* INTEGRAL_UINT32 of the image */
+	integral_t	*SqSum;				/* INTEGRAL_UINT64 of the squared image */
+	img_t		*InputImage;
+	float_map_t	*Output;
+};
+typedef struct ncc_work ncc_work_t;
+
+/* Hold arguments to do multithreaded distance transform. On the column pass the
+	interval refers to columns and on the row pass to rows.
+	Interval is NOT closed i.e. [Start:End[ */
+struct distance_work
+{
+	int32_t		Start;
+	int32_t		End;
+	uint32_t	*Squared;			/* Width*Height squared distances (row-major) */
+	float		*Output;			/* If not NULL row pass writes distances here instead */
+	img_t		*InputImage;
+};
+typedef struct distance_work distance_work_t;
+
+/* Hold arguments to do multithreaded Hough transform. On the voting pass the interval
+	refers to rows of the edge image and on the merge pass to accumulator cells.
+	Interval is NOT closed i.e. [Start:End[ */
+struct hough_work
+{
+	int32_t		Start;
+	int32_t		End;
+	int32_t		ThetaBins;
+	int32_t		RhoBins;
+	int32_t		RhoMax;
+	int32_t		Bins;				/* Orientation bins */
+	int32_t		Band;				/* Theta bins voted on each side of orientation */
+	uint8_t		Threshold;
+	int32_t		*Cos;				/* Fixed point (HOUGH_FRACTION_BITS) */
+	int32_t		*Sin;
+	uint32_t	*Accumulator;		/* Private accumulator of this thread */
+	uint32_t	*Partials;			/* All private accumulators (merge pass) */
+	int32_t		PartialsNum;
+	img_t		*InputImage;
+	img_t		*Orientation;		/* NULL --> every theta is voted */
+};
+typedef struct hough_work hough_work_t;
+
+/* Hold arguments to do multithreaded corner detection. Each thread owns the grid cells
+	of its rows so cells need no locking. Interval refers to rows of grid cells and
+	is NOT closed i.e. [StartRow:EndRow[ */
+struct corner_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Detector;			/* CORNER_FAST, CORNER_HARRIS or CORNER_SHI_TOMASI */
+	int32_t		Arc;				/* FAST: contiguous pixels needed (9 to 12) */
+	uint8_t		Threshold;			/* FAST: intensity difference */
+	int32_t		Radius;				/* Harris: window radius */
+	float		*Weights;			/* Harris: 2*Radius+1 separable window weights */
+	float		K;					/* Harris: trace factor */
+	float		MinScore;
+	int32_t		Margin;				/* Image border without detections */
+	int32_t		GridSize;
+	float		*Scratch;			/* Line buffers of this thread */
+	keypoint_t	*Cells;				/* Strongest corner of each cell (Score -FLT_MAX if none) */
+	img_t		*InputImage;
+};
+typedef struct corner_work corner_work_t;
+
+/* Hold arguments to do multithreaded image statistics. Sums are exact so partials of
+	threads are merged without rounding. Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct stats_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Locate;				/* Find positions of minimum and maximum */
+	uint64_t	SumSq[3];
+	img_stats_t	Partial;			/* Result of this thread (Count, Mean and StdDev unused) */
+	img_t		*InputImage;
+};
+typedef struct stats_work stats_work_t;
+
+/* Hold arguments to convert RGB to grayscale using multiple threads
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct gray_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	uint16_t	*Weights;			/* Red, Green and Blue weights (15 bits fixed point) */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct gray_work gray_work_t;
+
+/* Hold arguments to split or merge channels using multiple threads. Planes are indexed
+	by PASS_RED_CHANNEL, PASS_GREEN_CHANNEL and PASS_BLUE_CHANNEL (NULL --> skipped on split)
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct channels_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	img_t		*ColorImage;
+	img_t		*Planes[3];
+};
+typedef struct channels_work channels_work_t;
+
+/* Hold arguments to convert color spaces using multiple threads. Each side is either a
+	packed image (RGB_24BITS) or three GRAY_8BITS planes (packed image NULL). Channels
+	are indexed by PASS_RED_CHANNEL, PASS_GREEN_CHANNEL and PASS_BLUE_CHANNEL
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct color_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Conversion;
+	int16_t		Matrix[9];			/* YCbCr: 14 bits fixed point, row-major */
+	int32_t		Offset[3];			/* YCbCr: added before the shift (with rounding) */
+	float		*Linear;			/* Lab: sRGB to linear table (256 entries) */
+	float		*CubeRoot;			/* Lab: f(t) table on [0:1] */
+	uint8_t		*Gamma;				/* Lab: linear to sRGB table */
+	uint8_t		*Scratch;			/* 6 rows of this thread */
+	img_t		*Input;
+	img_t		*InputPlanes[3];
+	img_t		*Output;
+	img_t		*OutputPlanes[3];
+};
+typedef struct color_work color_work_t;
+
+/* Hold arguments to resize images using multiple threads. Tables are shared, buffers
+	are of each thread. Interval is NOT closed i.e. [StartRow:EndRow[ (output rows) */
+struct resize_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Method;				/* RESIZE_AREA is on the general path when Factor is 0 */
+	int32_t		Channels;			/* Bytes per pixel */
+	int32_t		FactorX;			/* Integer area factors or 0 */
+	int32_t		FactorY;
+	int32_t		*ColumnIndex;		/* Source columns (byte offset) or area spans of each output column */
+	int32_t		*RowIndex;			/* Source rows or area spans of each output row */
+	int16_t		*ColumnWeight;		/* Bilinear: 14 bits fixed point pairs */
+	int16_t		*RowWeight;
+	float		*ColumnArea;		/* Area: overlap of source pixels */
+	float		*RowArea;
+	void		*Buffer;			/* Scratch rows of this thread */
+	img_t		*Input;
+	img_t		*Output;
+};
+typedef struct resize_work resize_work_t;
+
+/* Hold arguments to reduce or expand pyramid levels using multiple threads. Expansion
+	either stores Fine minus expanded Coarse on Band or rebuilds Fine adding Band
+	Interval is NOT closed i.e. [StartRow:EndRow[ (rows of the larger level written) */
+struct pyramid_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Collapse;			/* Expansion: 0 --> store band, 1 --> rebuild Fine */
+	uint16_t	*Buffer;			/* Padded row of this thread */
+	uint8_t		*Expanded;			/* Expanded row of this thread */
+	int16_t		*Band;
+	img_t		*Fine;
+	img_t		*Coarse;
+};
+typedef struct pyramid_work pyramid_work_t;
+
+/* Hold arguments to warp images using multiple threads. Matrix maps destination to source
+	coordinates (pixel centers on integers). Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct warp_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Interpolation;
+	int32_t		Border;
+	int32_t		Channels;			/* Bytes per pixel */
+	int32_t		Perspective;		/* 0 --> affine rows are stepped on 32.32 fixed point */
+	uint8_t		BorderValue;
+	double		Matrix[9];
+	img_t		*Input;
+	img_t		*Output;
+};
+typedef struct warp_work warp_work_t;
+
+/* Hold arguments to do unsharp mask or difference of gaussians using multiple threads.
+	Each thread blurs its rows in column strips through line buffers and combines the
+	blurs with the source on the same pass. Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct sharpen_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Kernels;			/* 1 --> unsharp mask  2 --> difference of gaussians */
+	int32_t		Radius[2];
+	int32_t		Channels;			/* Bytes per pixel */
+	int32_t		Border;
+	float		Amount;				/* Gain of detail (unsharp) or of difference (DoG) */
+	float		Threshold;			/* Unsharp: smaller details are kept unchanged */
+	float		BorderValue;
+	float		*Coef[2];			/* 2*Radius+1 weights of each kernel */
+	float		*Buffer;			/* Line buffers of this thread */
+	uint8_t		*BorderRow;			/* Row filled with border value (constant borders) */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct sharpen_work sharpen_work_t;
+
+/* Hold arguments to do multithreaded Canny edge detection. Each thread owns the
+	provisional labels [Base:Base+Used[ given to weak edges touching its first or last row.
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct canny_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Radius;				/* Smoothing kernel radius (0 for no smoothing) */
+	int32_t		Operator;
+	int32_t		Norm;
+	int32_t		Border;
+	int32_t		LowThreshold;
+	int32_t		HighThreshold;
+	uint32_t	Base;
+	uint32_t	Used;
+	float		BorderValue;
+	float		*Coef;				/* 2*Radius+1 smoothing weights */
+	uint8_t		*BorderRow;			/* Row filled with border value (constant borders) */
+	uint32_t	*Stack;				/* Pixels to visit (index from the first row of the band) */
+	size_t		StackSize;
+	size_t		StackTop;
+	uint32_t	*BoundaryLabel;		/* Labels of first (Width) and last (Width) row */
+	uint32_t	*Parent;			/* Union-find forest shared by all threads */
+	uint32_t	*Seed;				/* One pixel of each label */
+	uint8_t		*Strong;			/* Label is connected to a strong edge */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct canny_work canny_work_t;
+
+/* Hold arguments to do multithreaded guided filtering. Window statistics come from
+	summed-area tables of the guide (I), the filtered plane (p), I*I and I*p. On the
+	column pass of "A" and "B" the interval refers to table columns.
+	Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct guided_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Radius;
+	float		Epsilon;
+	integral_t	*GuideSum;			/* INTEGRAL_UINT32 */
+	integral_t	*InputSum;			/* INTEGRAL_UINT32 */
+	integral_t	*GuideSqSum;		/* INTEGRAL_UINT64 */
+	integral_t	*CrossSum;			/* INTEGRAL_UINT64 */
+	integral_t	*A;					/* INTEGRAL_DOUBLE of the linear coefficients "a" */
+	integral_t	*B;					/* INTEGRAL_DOUBLE of the linear coefficients "b" */
+	img_t		*GuideImage;
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct guided_work guided_work_t;
+
+/* Hold arguments to do multithreaded bilateral filtering on a bilateral grid. Each cell
+	holds the sum of every channel and the weight (Channels + 1 floats) with the range
+	axis innermost. On splat and blur passes the interval refers to grid rows and on
+	slicing to image rows. Interval is NOT closed i.e. [StartRow:EndRow[ */
+struct bilateral_work
+{
+	int32_t		StartRow;
+	int32_t		EndRow;
+	int32_t		Channels;
+	int32_t		GridWidth;
+	int32_t		GridHeight;
+	int32_t		GridDepth;
+	float		SigmaSpace;			/* Grid spacing in pixels */
+	float		SigmaRange;			/* Grid spacing in gray levels */
+	float		*Grid;
+	float		*Blurred;
+	float		*Line;				/* One grid row of this thread */
+	img_t		*InputImage;
+	img_t		*OutputImage;
+};
+typedef struct bilateral_work bilateral_work_t;
+
 /*******************************************************************************
  *                                 DEFINITIONS                                 *
  *******************************************************************************/
+/* Kernels with a fraction of non-zero taps below this value are executed
+   through the sparse path on cross correlation and convolution */
+#define SPARSE_KERNEL_DENSITY	0.25
+
+/* Gaussian smoothing uses the recursive (IIR) filter from this sigma on */
+#define GAUSSIAN_IIR_SIGMA		3.0
+
+/* Largest radius accepted by median filter (window counts must fit 16 bits) */
+#define MEDIAN_MAX_RADIUS		127
+
+/* Width of the column strips processed at once by median filter */
+#define MEDIAN_STRIP_WIDTH		256
+
+/* Pixels of the column strips processed at once by unsharp mask and difference of
+   gaussians (line buffers of a strip stay on cache) */
+#define SHARPEN_STRIP_WIDTH		512
+
+/* Number of interleaved sub-histograms kept by each thread on histogram computation
+   (consecutive pixels with same value do not wait on the same counter) */
+#define HISTOGRAM_BANKS			4
+
+/* Templates with at least this many pixels are correlated through FFT on normalized
+   cross correlation, smaller ones directly */
+#define NCC_FFT_AREA			256
+
+/* Coarsest pyramid level used on template matching keeps templates at least this size */
+#define NCC_PYRAMID_MIN_SIZE	16
+
+/* Candidates kept on the coarsest pyramid level (per requested match) and how much
+   lower than the requested score they may be */
+#define NCC_PYRAMID_CANDIDATES	4
+#define NCC_PYRAMID_SLACK		0.15
+
+/* Peaks of the Hough accumulator closer than this (in theta and rho cells) to a
+   stronger peak are suppressed */
+#define HOUGH_NMS_RADIUS		4
+
+/* Warps fill the output in square tiles of this side, so source pixels read by
+   neighbouring rows stay on cache whatever the rotation is */
+#define WARP_TILE_SIZE			64
+
 /* Conversion method selection for "RGB_to_grayscale" function */
 enum gray_method 
 {
@@ -60,19 +703,29 @@ enum channel_pass
 	PASS_BLUE_CHANNEL
 };
 
-/* Border handling on cross correlation and convolution */
+/* Border handling on cross correlation, convolution and filters. BORDER_REPLICATE and
+   BORDER_REFLECT (edge pixel repeated: cba|abc) are only supported on warps, unsharp
+   mask, difference of gaussians and Canny edges */
 enum border_handling
 {
 	BORDER_BLACK,
-	BORDER_WHITE
-/*	BORDER_REPLICATE,    (not implemented yet)*/
-/*	BORDER_REFLECT       (not implemented yet)*/
+	BORDER_WHITE,
+	BORDER_REPLICATE,
+	BORDER_REFLECT
+};
+
+/* Sampling of warped images */
+enum warp_interpolation
+{
+	WARP_NEAREST,
+	WARP_BILINEAR
 };
 
 /* Defines the type of low pass filter kernel */
 enum lf_kernel_filter
 {
-	NEIGHBOR_AVERAGE
+	NEIGHBOR_AVERAGE,
+	GAUSSIAN_FILTER   /* Sigma derived from kernel size */
 };
 
 /* Defines the type of high pass filter kernel */
@@ -81,6 +734,93 @@ enum hf_kernel_filter
 	LAPLACIAN_OPERATOR_NORM,  /* Normalized kernel */
 	LAPLACIAN_OPERATOR
 };
+
+/* Defines the 3x3 derivative operator used on gradient computation */
+enum gradient_operator
+{
+	GRADIENT_SOBEL,    /* [1 2 1] smoothing */
+	GRADIENT_SCHARR    /* [3 10 3] smoothing */
+};
+
+/* Element type of summed-area tables */
+enum integral_type
+{
+	INTEGRAL_UINT32,   /* Window sums exact while below 2^32 */
+	INTEGRAL_UINT64,
+	INTEGRAL_DOUBLE
+};
+
+/* Local threshold selection for "adaptive_threshold" function */
+enum adaptive_method
+{
+	ADAPTIVE_MEAN,     /* T = mean - Param */
+	ADAPTIVE_SAUVOLA   /* T = mean * (1 + Param * (std/128 - 1)) */
+};
+
+/* Morphological operation selection for "morphology" function */
+enum morph_operation
+{
+	MORPH_ERODE,
+	MORPH_DILATE,
+	MORPH_OPEN,        /* Dilate(Erode(Img)) */
+	MORPH_CLOSE,       /* Erode(Dilate(Img)) */
+	MORPH_TOPHAT,      /* Img - Open(Img) */
+	MORPH_BLACKHAT     /* Close(Img) - Img */
+};
+
+/* Corner detector selection (CORNER_HARRIS and CORNER_SHI_TOMASI on "harris_corners") */
+enum corner_detector
+{
+	CORNER_FAST,
+	CORNER_HARRIS,        /* det(M) - K*trace(M)^2 */
+	CORNER_SHI_TOMASI     /* Smallest eigenvalue of M */
+};
+
+/* Window used to average gradient products on "harris_corners" */
+enum corner_window
+{
+	CORNER_WINDOW_BOX,
+	CORNER_WINDOW_GAUSSIAN   /* Sigma is Radius/2 */
+};
+
+/* Interpolation of "resize_image" */
+enum resize_method
+{
+	RESIZE_NEAREST,
+	RESIZE_BILINEAR,
+	RESIZE_AREA      /* Average of covered source pixels, bilinear when enlarging */
+};
+
+/* Color space conversions. Converted images store first, second and third components on
+   red, green and blue channels (or planes) with 8 bits:
+	HSV   --> H in [0:180[ (degrees/2), S and V in [0:255]
+	YCbCr --> Full range (JPEG), Cb and Cr centered at 128
+	Lab   --> L*255/100, a+128 and b+128 (D65 white) */
+enum color_conversion
+{
+	COLOR_RGB_TO_HSV,
+	COLOR_HSV_TO_RGB,
+	COLOR_RGB_TO_YCBCR_601,
+	COLOR_YCBCR_601_TO_RGB,
+	COLOR_RGB_TO_YCBCR_709,
+	COLOR_YCBCR_709_TO_RGB,
+	COLOR_RGB_TO_LAB,
+	COLOR_LAB_TO_RGB
+};
+
+/* Channel selection of point operations besides PASS_RED_CHANNEL, PASS_GREEN_CHANNEL
+   and PASS_BLUE_CHANNEL */
+enum point_channel
+{
+	POINT_ALL_CHANNELS = 3
+};
+
+/* Defines the norm used on gradient magnitude */
+enum gradient_norm
+{
+	GRADIENT_L1,       /* |Gx| + |Gy| */
+	GRADIENT_L2        /* sqrt(Gx^2 + Gy^2) */
+};
 /*******************************************************************************
  *                                  FUNCTIONS                                  *
  *******************************************************************************/
@@ -92,6 +832,20 @@ enum hf_kernel_filter
 img_t *RGB_to_grayscale(img_t *InputImage, int Method);
 
 
+/* Convert RGB to grayscale using multiple threads. Return NULL if fail
+	Method  --> GRAY_AVERAGE               (channels average)
+	            GRAY_LUMI_PERCEP           (channel-dependent luminance perception)
+	            GRAY_APROX_GAM_LUMI_PERCEP (linear aproximation of gamma and luminance perception)
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *parallel_RGB_to_grayscale(img_t *InputImage, int Method, int32_t Threads);
+
+
+/* Read BMP image converting rows to grayscale while they are decoded, so the 24 bits
+   image is never stored. Result is the same of "RGB_to_grayscale". Return NULL if fail
+	Method --> GRAY_AVERAGE, GRAY_LUMI_PERCEP or GRAY_APROX_GAM_LUMI_PERCEP */
+img_t *read_BMP_gray(const char *Filename, int Method);
+
+
 /* Channel pass filter. Return NULL if fail
 	ChannelSelect --> PASS_RED_CHANNEL
 	                  PASS_GREEN_CHANNEL
@@ -104,7 +858,8 @@ void free_kernel(kernel_t *Kernel);
 
 
 /* Create a low pass filter kernel with given odd dimension. Return NULL if fail
-   Type --> NEIGHBOR_AVERAGE */
+   Type --> NEIGHBOR_AVERAGE
+            GAUSSIAN_FILTER */
 kernel_t *create_kernel_low_pass_filter(int32_t Height, int32_t Width, int Type);
 
 
@@ -113,6 +868,15 @@ kernel_t *create_kernel_low_pass_filter(int32_t Height, int32_t Width, int Type)
 kernel_t *create_kernel_high_pass_filter(int32_t Height, int32_t Width, int Type);
 
 
+/* Create a sparse kernel holding only the non-zero taps of given kernel.
+   Return NULL if fail */
+sparse_kernel_t *create_sparse_kernel(kernel_t *Kernel);
+
+
+/* Frees memory allocated by the sparse kernel */
+void free_sparse_kernel(sparse_kernel_t *Kernel);
+
+
 /* Makes cross correlation betwen the kernel and image using multiple threads.
    Return NULL if fail
 	Img     --> Pointer to source image. This image will also be the output.
@@ -132,9 +896,546 @@ img_t *parallel_cross_correlation(img_t *Img, kernel_t *Kernel, int32_t Threads,
 	            BORDER_WHITE */
 img_t *parallel_convolution(img_t *Img, kernel_t *Kernel, int32_t Threads, int Border);
 
-/* Generate the histogram for a given image */
+
+/* Makes cross correlation betwen a sparse kernel and image using multiple threads.
+   Only the non-zero taps are visited. Return NULL if fail
+	Img     --> Pointer to source image.
+	Kernel  --> Pointer to the the sparse kernel to be used.
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *parallel_sparse_cross_correlation(img_t *Img, sparse_kernel_t *Kernel, int32_t Threads, int Border);
+
+/* Generate the histogram for a given image and print it */
 void histogram(img_t *Img);
 
 
+/* Computes histogram of given image (or ROI view) using multiple threads.
+   Return -1 if fail or 0 on success
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	Hist    --> Receives the counts. GRAY_8BITS needs 256 entries. RGB_24BITS needs
+	            3*256 entries: Hist[Channel*256 + Value] with Channel one of
+	            PASS_RED_CHANNEL, PASS_GREEN_CHANNEL or PASS_BLUE_CHANNEL
+	Threads --> Number of threads to be used in parallel on computacion */
+int histogram_compute(img_t *Img, uint32_t *Hist, int32_t Threads);
+
+
+/* Gaussian smoothing of a grayscale image using multiple threads. Return NULL if fail
+   Sigma below GAUSSIAN_IIR_SIGMA uses a separable FIR kernel, otherwise a recursive
+   Young - van Vliet filter is used and the cost does not depend on sigma.
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Sigma   --> Standard deviation in pixels (> 0).
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *gaussian_blur(img_t *Img, float Sigma, int32_t Threads, int Border);
+
+
+/* Computes gradient magnitude and optionally quantized orientation in a single pass
+   using multiple threads. Magnitude saturates at 255. Return NULL if fail
+	Img         --> Pointer to source image (GRAY_8BITS).
+	Operator    --> GRADIENT_SOBEL
+	                GRADIENT_SCHARR
+	Norm        --> GRADIENT_L1
+	                GRADIENT_L2
+	Orientation --> If not NULL receives a new GRAY_8BITS image with the gradient
+	                direction (atan2(Gy, Gx) modulo 180 degrees, Gx along columns and
+	                Gy along rows) quantized to bins centered on k*180/Bins. Bin index
+	                is stored on each pixel. With 4 bins: 0 (0), 1 (45), 2 (90), 3 (135)
+	Bins        --> Number of orientation bins (1 to 180). Ignored if Orientation is NULL
+	Threads     --> Number of threads to be used in parallel on computacion
+	Border      --> BORDER_BLACK
+	                BORDER_WHITE */
+img_t *parallel_gradient(img_t *Img, int Operator, int Norm, img_t **Orientation, int32_t Bins,
+                         int32_t Threads, int Border);
+
+
+/* Median filter with square window of side 2*Radius+1 using multiple threads.
+   RGB images are filtered per channel. Radius 1 and 2 use sorting networks, bigger
+   windows use the constant time histogram algorithm (Perreault - Hebert).
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	Radius  --> Window radius (0 to MEDIAN_MAX_RADIUS).
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> BORDER_BLACK
+	            BORDER_WHITE */
+img_t *median_filter(img_t *Img, int32_t Radius, int32_t Threads, int Border);
+
+
+/* Grayscale morphology with a rectangular structuring element using multiple threads.
+   Uses van Herk - Gil-Werman algorithm on each direction so the cost per pixel does
+   not depend on the element size. Return NULL if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	Operation --> MORPH_ERODE, MORPH_DILATE, MORPH_OPEN, MORPH_CLOSE,
+	              MORPH_TOPHAT or MORPH_BLACKHAT
+	Height    --> Structuring element height (>= 1). Anchor at Height/2
+	Width     --> Structuring element width (>= 1). Anchor at Width/2
+	Threads   --> Number of threads to be used in parallel on computacion
+	Border    --> BORDER_BLACK
+	              BORDER_WHITE */
+img_t *morphology(img_t *Img, int Operation, int32_t Height, int32_t Width, int32_t Threads, int Border);
+
+
+/* Global histogram equalization using multiple threads. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *histogram_equalization(img_t *Img, int32_t Threads);
+
+
+/* Contrast limited adaptive histogram equalization (CLAHE) using multiple threads.
+   Each tile gets a clipped equalization table and every pixel is mapped with the
+   bilinear interpolation of the tables of the four nearest tiles. Return NULL if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	TilesY    --> Number of tile rows (1 to image height).
+	TilesX    --> Number of tile columns (1 to image width).
+	ClipLimit --> Histogram clip as a multiple of the average bin count
+	              (values <= 0 disable clipping).
+	Threads   --> Number of threads to be used in parallel on computacion */
+img_t *clahe(img_t *Img, int32_t TilesY, int32_t TilesX, float ClipLimit, int32_t Threads);
+
+
+/* Frees memory allocated by the bit mask */
+void free_bit_mask(bit_mask_t *Mask);
+
+
+/* Expand bit mask to a GRAY_8BITS image (set bits --> 255). Return NULL if fail */
+img_t *bit_mask_to_img(bit_mask_t *Mask);
+
+
+/* Computes summed-area table of pixel values using multiple threads (row prefix
+   sums per thread followed by a column pass). Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Type    --> INTEGRAL_UINT32
+	            INTEGRAL_UINT64
+	            INTEGRAL_DOUBLE
+	Threads --> Number of threads to be used in parallel on computacion */
+integral_t *integral_image(img_t *Img, int Type, int32_t Threads);
+
+
+/* Same as "integral_image" but with squared pixel values. Return NULL if fail */
+integral_t *integral_image_sq(img_t *Img, int Type, int32_t Threads);
+
+
+/* Frees memory allocated by the summed-area table */
+void free_integral(integral_t *Table);
+
+
+/* Sum of the image pixels on rows [Top:Bottom[ and columns [Left:Right[ read from
+   the summed-area table with four accesses. Limits are not checked */
+double integral_sum(integral_t *Table, int32_t Top, int32_t Left, int32_t Bottom, int32_t Right);
+
+
+/* Computes global threshold with Otsu method using multiple threads.
+   Pixels above the returned level belong to the bright class. Return -1 if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Threads --> Number of threads to be used in parallel on computacion */
+int32_t otsu_threshold(img_t *Img, int32_t Threads);
+
+
+/* Binarize image with global level using multiple threads (Pixel > Level --> 255).
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Level   --> Threshold level (i.e. from "otsu_threshold").
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *threshold(img_t *Img, uint8_t Level, int32_t Threads);
+
+
+/* Same as "threshold" but the result is packed with 1 bit per pixel. Return NULL if fail */
+bit_mask_t *threshold_mask(img_t *Img, uint8_t Level, int32_t Threads);
+
+
+/* Binarize image with local threshold computed on a (2*Radius+1) square window
+   using multiple threads (Pixel > T --> 255). Local mean and standard deviation come
+   from summed-area tables so the cost per pixel does not depend on the radius.
+   Windows are clipped at the image border. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS).
+	Method  --> ADAPTIVE_MEAN    (Param is the constant subtracted from the mean)
+	            ADAPTIVE_SAUVOLA (Param is the k factor, usually 0.2 to 0.5)
+	Radius  --> Window radius (>= 1).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *adaptive_threshold(img_t *Img, int Method, int32_t Radius, float Param, int32_t Threads);
+
+
+/* Same as "adaptive_threshold" but the result is packed with 1 bit per pixel.
+   Return NULL if fail */
+bit_mask_t *adaptive_threshold_mask(img_t *Img, int Method, int32_t Radius, float Param, int32_t Threads);
+
+
+/* Label 8-connected components of a binary image (non-zero pixels are foreground)
+   and compute area, bounding box and centroid of each one using multiple threads.
+   Strips are labeled in parallel with block based union-find, equivalences across
+   strips are merged and the statistics are gathered on the final labeling pass.
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS, i.e. from "threshold").
+	Threads --> Number of threads to be used in parallel on computacion */
+components_t *connected_components(img_t *Img, int32_t Threads);
+
+
+/* Frees memory allocated by connected component labeling */
+void free_components(components_t *Components);
+
+
+/* Frees memory allocated by the float map */
+void free_float_map(float_map_t *Map);
+
+
+/* Scale float map from its [min:max] range to a GRAY_8BITS image. Return NULL if fail */
+img_t *float_map_to_img(float_map_t *Map);
+
+
+/* Computes normalized cross correlation score of the template at every position of
+   the image using multiple threads. Template energy and windowed image statistics
+   come from summed-area tables, numerator comes from direct correlation on small
+   templates or from FFT on large ones (see NCC_FFT_AREA). Map has size
+   (Img->Width - Template->Width + 1) x (Img->Height - Template->Height + 1) and
+   scores are in [-1:1] (flat image windows score 0). Return NULL if fail
+	Img      --> Pointer to source image (GRAY_8BITS).
+	Template --> Pointer to template image (GRAY_8BITS, not flat).
+	Threads  --> Number of threads to be used in parallel on computacion */
+float_map_t *ncc_map(img_t *Img, img_t *Template, int32_t Threads);
+
+
+/* Find best non overlapping template matches by normalized cross correlation using
+   multiple threads. With more than one level the search runs on the coarsest level of
+   an image pyramid and candidates are refined on each finer level.
+   Return number of matches (best first) or -1 if fail
+	Img        --> Pointer to source image (GRAY_8BITS).
+	Template   --> Pointer to template image (GRAY_8BITS, not flat).
+	Levels     --> Pyramid levels (1 --> search on full resolution only). Reduced if
+	               template gets smaller than NCC_PYRAMID_MIN_SIZE.
+	MinScore   --> Smallest score accepted.
+	Matches    --> Output array.
+	MaxMatches --> Size of "Matches" array.
+	Threads    --> Number of threads to be used in parallel on computacion */
+int32_t match_template(img_t *Img, img_t *Template, int32_t Levels, float MinScore,
+                       match_t *Matches, int32_t MaxMatches, int32_t Threads);
+
+
+/* Exact Euclidean distance from every non-zero pixel to the nearest zero pixel (zero
+   pixels get 0) using multiple threads. Column scans give vertical distances and
+   each row takes the lower envelope of parabolas (Felzenszwalb-Huttenlocher), so the
+   cost is linear in the number of pixels. Images without zero pixels give INFINITY.
+   Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS, i.e. from "threshold").
+	Threads --> Number of threads to be used in parallel on computacion */
+float_map_t *distance_transform(img_t *Img, int32_t Threads);
+
+
+/* Same as "distance_transform" but writes squared distances as integers (row-major,
+   Width*Height entries, UINT32_MAX if the image has no zero pixel). Return -1 if fail */
+int distance_transform_sq(img_t *Img, uint32_t *SqDistance, int32_t Threads);
+
+
+/* Find straight lines on an edge image with Hough transform using multiple threads.
+   Each thread votes on a private accumulator and they are merged at the end. With
+   an orientation image each edge pixel votes only on a narrow theta band around its
+   gradient direction. Peaks go through non maximum suppression (HOUGH_NMS_RADIUS).
+   Image sides must be below 32768. Return number of lines (most voted first) or -1 if fail
+	Edges       --> Pointer to edge image (GRAY_8BITS, i.e. gradient magnitude or binary).
+	Threshold   --> Pixels above this value are edges.
+	Orientation --> NULL or orientation image from "parallel_gradient".
+	Bins        --> Orientation bins used on "parallel_gradient". Ignored if Orientation
+	                is NULL.
+	ThetaBins   --> Theta resolution, number of angles on [0:180[ (i.e. 180).
+	MinVotes    --> Smallest number of votes accepted.
+	Lines       --> Output array.
+	MaxLines    --> Size of "Lines" array.
+	Threads     --> Number of threads to be used in parallel on computacion */
+int32_t hough_lines(img_t *Edges, uint8_t Threshold, img_t *Orientation, int32_t Bins,
+                    int32_t ThetaBins, uint32_t MinVotes, hough_line_t *Lines, int32_t MaxLines,
+                    int32_t Threads);
+
+
+/* Detect FAST corners (segment test on the 16 pixels circle of radius 3) using multiple
+   threads. Pixels are rejected 16 at a time with SIMD tests on the 4 compass pixels.
+   Score is the smallest absolute difference on the best arc. Corners are
+   3x3 local maxima and each grid cell keeps its strongest one.
+   Return number of corners (strongest first) or -1 if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	Arc       --> Contiguous circle pixels needed: 9 (FAST-9) to 12 (FAST-12).
+	Threshold --> Intensity difference to the center pixel.
+	GridSize  --> Side of grid cells in pixels (1 --> only 3x3 suppression).
+	Points    --> Output array.
+	MaxPoints --> Size of "Points" array (strongest corners are kept).
+	Threads   --> Number of threads to be used in parallel on computacion */
+int32_t fast_corners(img_t *Img, int32_t Arc, uint8_t Threshold, int32_t GridSize,
+                     keypoint_t *Points, int32_t MaxPoints, int32_t Threads);
+
+
+/* Detect Harris or Shi-Tomasi corners using multiple threads. Sobel gradient products
+   are averaged by the window and turned into the response on a single pass over row
+   bands. Gradients are normalized to gray levels per pixel. Corners are 3x3 local
+   maxima not below "MinScore" and each grid cell keeps its strongest one.
+   Return number of corners (strongest first) or -1 if fail
+	Img       --> Pointer to source image (GRAY_8BITS).
+	Detector  --> CORNER_HARRIS
+	              CORNER_SHI_TOMASI
+	Window    --> CORNER_WINDOW_BOX
+	              CORNER_WINDOW_GAUSSIAN
+	Radius    --> Window radius (>= 1).
+	K         --> Harris trace factor (usually 0.04 to 0.06). Ignored on CORNER_SHI_TOMASI.
+	MinScore  --> Smallest response accepted.
+	GridSize  --> Side of grid cells in pixels (1 --> only 3x3 suppression).
+	Points    --> Output array.
+	MaxPoints --> Size of "Points" array (strongest corners are kept).
+	Threads   --> Number of threads to be used in parallel on computacion */
+int32_t harris_corners(img_t *Img, int Detector, int Window, int32_t Radius, float K, float MinScore,
+                       int32_t GridSize, keypoint_t *Points, int32_t MaxPoints, int32_t Threads);
+
+
+/* Compute minimum, maximum, sum, mean and standard deviation of an image (per channel on
+   RGB_24BITS) in a single pass using multiple threads. Return -1 if fail or 0 on success
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Stats   --> Receives the statistics.
+	Locate  --> 1 to also find positions of minimum and maximum, 0 otherwise.
+	Threads --> Number of threads to be used in parallel on computacion */
+int image_stats(img_t *Img, img_stats_t *Stats, int Locate, int32_t Threads);
+
+
+/* Reset point operations chain to identity (no change on any channel) */
+void point_lut_identity(point_lut_t *Lut);
+
+
+/* Append an arbitrary operation to the chain: Value --> Table[Value]. Following
+   "point_lut_*" functions do the same with common operations.
+   Return -1 if fail or 0 on success
+	Channel --> PASS_RED_CHANNEL, PASS_GREEN_CHANNEL, PASS_BLUE_CHANNEL or POINT_ALL_CHANNELS
+	Table   --> 256 entries */
+int point_lut_table(point_lut_t *Lut, int Channel, const uint8_t *Table);
+
+
+/* Append brightness change: Value + Offset (saturated) */
+int point_lut_brightness(point_lut_t *Lut, int Channel, int32_t Offset);
+
+
+/* Append contrast change around mid gray: (Value - 128) * Factor + 128 (saturated) */
+int point_lut_contrast(point_lut_t *Lut, int Channel, float Factor);
+
+
+/* Append gamma correction: 255 * (Value/255)^Gamma (Gamma > 0, below 1 brightens) */
+int point_lut_gamma(point_lut_t *Lut, int Channel, float Gamma);
+
+
+/* Append inversion: 255 - Value */
+int point_lut_invert(point_lut_t *Lut, int Channel);
+
+
+/* Append threshold: 255 if Value > Level, 0 otherwise */
+int point_lut_threshold(point_lut_t *Lut, int Channel, uint8_t Level);
+
+
+/* Append level mapping: [InLow:InHigh] is stretched linearly to [OutLow:OutHigh]
+   and values outside are clipped (InLow < InHigh) */
+int point_lut_levels(point_lut_t *Lut, int Channel, uint8_t InLow, uint8_t InHigh,
+                     uint8_t OutLow, uint8_t OutHigh);
+
+
+/* Apply a chain of point operations in a single pass using multiple threads. Any number of
+   operations costs one table lookup per pixel (and channel). Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Lut     --> Operations chain.
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *point_lut_apply(img_t *Img, point_lut_t *Lut, int32_t Threads);
+
+
+/* Split RGB image into three GRAY_8BITS planes in a single pass using multiple threads.
+   Return -1 if fail or 0 on success
+	Img     --> Pointer to source image (RGB_24BITS) or ROI view.
+	Red     --> Receives red plane (NULL --> not extracted).
+	Green   --> Receives green plane (NULL --> not extracted).
+	Blue    --> Receives blue plane (NULL --> not extracted).
+	Threads --> Number of threads to be used in parallel on computacion */
+int split_channels(img_t *Img, img_t **Red, img_t **Green, img_t **Blue, int32_t Threads);
+
+
+/* Merge three GRAY_8BITS planes of same size into a RGB image using multiple threads.
+   Return NULL if fail */
+img_t *merge_channels(img_t *Red, img_t *Green, img_t *Blue, int32_t Threads);
+
+
+/* Create a read only view of one channel without copying pixels. The view shares pixel
+   memory with the image. Return NULL if fail
+	Channel --> PASS_RED_CHANNEL, PASS_GREEN_CHANNEL or PASS_BLUE_CHANNEL (ignored on GRAY_8BITS) */
+channel_view_t *new_channel_view(img_t *Img, int Channel);
+
+
+/* Frees a view created by "new_channel_view". Pixels are not released */
+void free_channel_view(channel_view_t *View);
+
+
+/* Convert color space of an image using multiple threads. YCbCr and HSV use fixed point
+   SIMD (HSV divides by per pixel Max and Delta on float lanes) and Lab tables for sRGB
+   gamma and cube root. Return NULL if fail
+	Img        --> Pointer to source image (RGB_24BITS) or ROI view.
+	Conversion --> One of "color_conversion" (i.e. COLOR_RGB_TO_HSV).
+	Threads    --> Number of threads to be used in parallel on computacion */
+img_t *convert_color(img_t *Img, int Conversion, int32_t Threads);
+
+
+/* Convert color space of an image to three GRAY_8BITS planes using multiple threads.
+   Return -1 if fail or 0 on success
+	Img        --> Pointer to source image (RGB_24BITS) or ROI view.
+	Conversion --> One of "color_conversion" (i.e. COLOR_RGB_TO_YCBCR_601).
+	Planes     --> Receives the three new planes (first, second and third components).
+	Threads    --> Number of threads to be used in parallel on computacion */
+int convert_color_to_planes(img_t *Img, int Conversion, img_t **Planes, int32_t Threads);
+
+
+/* Convert color space of three GRAY_8BITS planes of same size to a RGB_24BITS image
+   using multiple threads. Return NULL if fail
+	Planes     --> First, second and third components.
+	Conversion --> One of "color_conversion" (i.e. COLOR_HSV_TO_RGB).
+	Threads    --> Number of threads to be used in parallel on computacion */
+img_t *convert_color_from_planes(img_t **Planes, int Conversion, int32_t Threads);
+
+/* Resize an image (GRAY_8BITS or RGB_24BITS) using multiple threads. Bilinear and exact
+   2x/4x area decimation use fixed point SIMD. Return NULL if fail
+	Img     --> Pointer to source image or ROI view.
+	Width   --> Width of resized image.
+	Height  --> Height of resized image.
+	Method  --> RESIZE_NEAREST, RESIZE_BILINEAR or RESIZE_AREA.
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *resize_image(img_t *Img, int32_t Width, int32_t Height, int Method, int32_t Threads);
+
+
+/* Gaussian pyramid using multiple threads. Each level is computed in one pass over the
+   previous one and only kept (even) pixels are blurred. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS) or ROI view.
+	Levels  --> Number of levels (level 0 is a copy of source). Reduced when the
+	            coarsest level would be smaller than 1x1.
+	Threads --> Number of threads to be used in parallel on computacion */
+pyramid_t *gaussian_pyramid(img_t *Img, int32_t Levels, int32_t Threads);
+
+
+/* Laplacian pyramid using multiple threads: Gaussian levels plus bands with the detail
+   lost on each level. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS) or ROI view.
+	Levels  --> Number of levels (bands are Levels - 1).
+	Threads --> Number of threads to be used in parallel on computacion */
+pyramid_t *laplacian_pyramid(img_t *Img, int32_t Levels, int32_t Threads);
+
+
+/* Rebuild the image of a Laplacian pyramid from its coarsest level and its bands using
+   multiple threads. Unchanged bands give back the source exactly. Return NULL if fail
+	Pyramid --> Pointer to pyramid from "laplacian_pyramid" (bands may be edited).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *collapse_laplacian(pyramid_t *Pyramid, int32_t Threads);
+
+
+/* Frees memory allocated by the pyramid (levels and bands) */
+void free_pyramid(pyramid_t *Pyramid);
+
+
+/* Affine warp of an image (GRAY_8BITS or RGB_24BITS) using multiple threads. Source
+   coordinates are stepped along output rows on fixed point and the output is filled
+   in tiles. Return NULL if fail
+	Img           --> Pointer to source image or ROI view.
+	Matrix        --> 2x3 transform (row-major) from source to destination:
+	                  x' = M[0] x + M[1] y + M[2]    y' = M[3] x + M[4] y + M[5]
+	Width         --> Width of warped image.
+	Height        --> Height of warped image.
+	Interpolation --> WARP_NEAREST or WARP_BILINEAR.
+	Border        --> One of "border_handling" (i.e. BORDER_REPLICATE).
+	Threads       --> Number of threads to be used in parallel on computacion */
+img_t *warp_affine(img_t *Img, const double *Matrix, int32_t Width, int32_t Height, int Interpolation,
+                   int Border, int32_t Threads);
+
+
+/* Perspective warp of an image (GRAY_8BITS or RGB_24BITS) using multiple threads. Return
+   NULL if fail
+	Img           --> Pointer to source image or ROI view.
+	Matrix        --> 3x3 homography (row-major) from source to destination.
+	Width         --> Width of warped image.
+	Height        --> Height of warped image.
+	Interpolation --> WARP_NEAREST or WARP_BILINEAR.
+	Border        --> One of "border_handling" (i.e. BORDER_BLACK).
+	Threads       --> Number of threads to be used in parallel on computacion */
+img_t *warp_perspective(img_t *Img, const double *Matrix, int32_t Width, int32_t Height, int Interpolation,
+                        int Border, int32_t Threads);
+
+
+/* Fill a 2x3 affine matrix that rotates around a point and scales
+	CenterX --> Column of rotation center.
+	CenterY --> Row of rotation center.
+	Angle   --> Degrees, positive is counter-clockwise as seen on the image.
+	Scale   --> Scale factor.
+	Matrix  --> Output of 6 values for "warp_affine" */
+void rotation_matrix(double CenterX, double CenterY, double Angle, double Scale, double *Matrix);
+
+
+/* Fill the 3x3 homography that maps four source points to four destination points.
+   Return -1 if points are degenerate (three of them aligned) or 0 on success
+	Source      --> 4 points as (x, y) pairs.
+	Destination --> 4 points as (x, y) pairs.
+	Matrix      --> Output of 9 values for "warp_perspective" */
+int perspective_matrix(const double *Source, const double *Destination, double *Matrix);
+
+
+/* Unsharp mask (source plus amplified difference to its gaussian blur) of an image using
+   multiple threads. Blur, difference, gain and clamp are done in one pass. Return NULL
+   if fail
+	Img       --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Sigma     --> Standard deviation of the blur in pixels (> 0).
+	Amount    --> Gain of the detail (i.e. 1.0 doubles it).
+	Threshold --> Details below this value are left unchanged (0 sharpens everything).
+	Threads   --> Number of threads to be used in parallel on computacion
+	Border    --> One of "border_handling" (i.e. BORDER_REPLICATE) */
+img_t *unsharp_mask(img_t *Img, float Sigma, float Amount, uint8_t Threshold, int32_t Threads, int Border);
+
+
+/* Difference of gaussians (band pass) of an image using multiple threads. Both blurs,
+   difference, gain and clamp are done in one pass. Result is centered at 128. Return
+   NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS) or ROI view.
+	Sigma1  --> Standard deviation of the first (usually narrower) blur (> 0).
+	Sigma2  --> Standard deviation of the blur subtracted from the first one (> 0).
+	Gain    --> Gain of the difference.
+	Threads --> Number of threads to be used in parallel on computacion
+	Border  --> One of "border_handling" (i.e. BORDER_REFLECT) */
+img_t *difference_of_gaussians(img_t *Img, float Sigma1, float Sigma2, float Gain, int32_t Threads, int Border);
+
+
+/* Canny edge detection using multiple threads. Each thread runs smoothing, gradient,
+   non maximum suppression and double threshold on its band as a pipeline over line
+   buffers. Hysteresis follows candidates with a stack inside each band and joins bands
+   with union-find. Edges are 255 and background 0. Return NULL if fail
+	Img           --> Pointer to source image (GRAY_8BITS).
+	Sigma         --> Standard deviation of the gaussian smoothing (0 for no smoothing).
+	LowThreshold  --> Gradient magnitudes above this value are candidates.
+	HighThreshold --> Gradient magnitudes above this value start an edge.
+	Operator      --> GRADIENT_SOBEL
+	                  GRADIENT_SCHARR
+	Norm          --> GRADIENT_L1
+	                  GRADIENT_L2
+	Threads       --> Number of threads to be used in parallel on computacion
+	Border        --> One of "border_handling" (i.e. BORDER_REPLICATE) */
+img_t *canny_edges(img_t *Img, float Sigma, int32_t LowThreshold, int32_t HighThreshold, int Operator, int Norm,
+                   int32_t Threads, int Border);
+
+
+/* Edge preserving smoothing with the guided filter using multiple threads. Every output
+   pixel is a linear function of the guide fitted on each window, with window means read
+   from summed-area tables so cost does not depend on radius. RGB images are filtered
+   per channel. Return NULL if fail
+	Img     --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	Guide   --> GRAY_8BITS image of same size guiding every channel, or NULL to make
+	            each channel guide itself (edge preserving smoothing).
+	Radius  --> Window radius (window side is 2*Radius+1, clipped at the borders).
+	Epsilon --> Regularization in squared gray levels. Edges with standard deviation
+	            well above sqrt(Epsilon) are kept (i.e. 400 smooths variations of ~20).
+	Threads --> Number of threads to be used in parallel on computacion */
+img_t *guided_filter(img_t *Img, img_t *Guide, int32_t Radius, float Epsilon, int32_t Threads);
+
+
+/* Bilateral filter approximated on a bilateral grid using multiple threads. Pixels are
+   accumulated on a grid downsampled by the spatial and range sigmas, the grid is blurred
+   with [1 2 1] along each axis and read back with trilinear interpolation, so cost does
+   not depend on the sigmas. RGB images use the luma as range. Return NULL if fail
+	Img        --> Pointer to source image (GRAY_8BITS or RGB_24BITS).
+	SigmaSpace --> Spatial extent in pixels (>= 1).
+	SigmaRange --> Range extent in gray levels (>= 1). Edges well above it are kept.
+	Threads    --> Number of threads to be used in parallel on computacion */
+img_t *bilateral_grid(img_t *Img, float SigmaSpace, float SigmaRange, int32_t Threads);
+
 #endif
  
@@ -51,6 +51,86 @@ int main(int argc, char* argv[])
 	img_t		*ImgConvHighPassBlack;
 	img_t		*ImgConvHighPassWhite;
 
+	sparse_kernel_t	*SparseKernel;
+	img_t		*ImgSparseHighPass;
+
+	img_t		*ImgGaussFIR;
+	img_t		*ImgGaussIIR;
+
+	img_t		*ImgGradient;
+	img_t		*ImgOrientation;
+
+	img_t		*ImgMedianGray;
+	img_t		*ImgMedianRGB;
+
+	img_t		*ImgOpen;
+	img_t		*ImgTopHat;
+
+	img_t		*ImgView;
+	uint32_t	HistGray[256];
+	uint32_t	HistRGB[3 * 256];
+
+	img_t		*ImgEqualized;
+	img_t		*ImgCLAHE;
+
+	int32_t		OtsuLevel;
+	img_t		*ImgOtsu;
+	img_t		*ImgSauvola;
+	bit_mask_t	*SauvolaMask;
+
+	integral_t	*Integral;
+	integral_t	*IntegralSq;
+	double		WindowMean;
+
+	img_t		*ImgBinary;
+	components_t	*Components;
+	uint32_t	Largest;
+
+	img_t		*ImgTemplate;
+	float_map_t	*ScoreMap;
+	img_t		*ImgScore;
+	match_t		Matches[4];
+	int32_t		MatchesNum;
+
+	float_map_t	*DistanceMap;
+	img_t		*ImgDistance;
+
+	hough_line_t	Lines[8];
+	int32_t		LinesNum;
+
+	keypoint_t	Corners[5];
+	int32_t		CornersNum;
+
+	img_stats_t	Stats;
+
+	img_t		*ImgGrayParallel;
+	img_t		*ImgGrayDecoded;
+	int32_t		Differences;
+
+	point_lut_t	PointLut;
+	img_t		*ImgPoint;
+
+	img_t		*ImgRedPlane;
+	img_t		*ImgGreenPlane;
+	img_t		*ImgBluePlane;
+	img_t		*ImgMerged;
+	channel_view_t	*GreenView;
+	img_t		*ImgHSV;
+	img_t		*ImgHSVBack;
+	img_t		*LabPlanes[3];
+	img_t		*ImgHalf;
+	img_t		*ImgEnlarged;
+	pyramid_t	*Pyramid;
+	img_t		*ImgCollapsed;
+	double		WarpMatrix[9];
+	double		Corners4[8];
+	double		Rectified4[8];
+	img_t		*ImgWarped;
+	img_t		*ImgSharpened;
+	img_t		*ImgCanny;
+	img_t		*ImgSmoothed;
+	img_t		*ImgTiny;
+
 	InputImage = read_BMP(argv[1]);
 
 	/*===========================================================================*/
@@ -233,6 +313,637 @@ int main(int argc, char* argv[])
 	free_img(ImgConvHighPassBlack);
 	free_img(ImgConvHighPassWhite);
 
+	/*===========================================================================*/
+	/*              TESTING: parallel_sparse_cross_correlation()                 */
+	/*===========================================================================*/
+	printf("Creating sparse kernel from high pass filter kernel ...\n");
+	SparseKernel = create_sparse_kernel(HighPassKernel);
+	if(SparseKernel == NULL)
+		exit_msg("Error: Could not create sparse kernel.\n", EXIT_FAILURE);
+
+	printf("Making sparse cross correlation (HIGH_PASS, BLACK_BORDER) ...\n");
+	ImgSparseHighPass = parallel_sparse_cross_correlation(ImgToGrayAverage, SparseKernel, ThreadNum, BORDER_BLACK);
+	if(ImgSparseHighPass == NULL)
+		exit_msg("Error: Could not make sparse cross correlation (HIGH_PASS, BLACK_BORDER).\n",
+					EXIT_FAILURE);
+
+	printf("Saving sparse cross correlated image ...\n\n");
+
+	if(save_BMP(ImgSparseHighPass, "saida15-SparseHighPass.bmp") == -1)
+		exit_msg("Error: Could not save \"SparseHighPass\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgSparseHighPass);
+	free_sparse_kernel(SparseKernel);
+
+	/*===========================================================================*/
+	/*                         TESTING: gaussian_blur()                          */
+	/*===========================================================================*/
+	printf("Making gaussian blur (FIR, sigma 1.5) ...\n");
+	ImgGaussFIR = gaussian_blur(ImgToGrayAverage, 1.5, ThreadNum, BORDER_BLACK);
+	if(ImgGaussFIR == NULL)
+		exit_msg("Error: Could not make gaussian blur (FIR).\n", EXIT_FAILURE);
+
+	printf("Making gaussian blur (IIR, sigma 10) ...\n");
+	ImgGaussIIR = gaussian_blur(ImgToGrayAverage, 10.0, ThreadNum, BORDER_BLACK);
+	if(ImgGaussIIR == NULL)
+		exit_msg("Error: Could not make gaussian blur (IIR).\n", EXIT_FAILURE);
+
+	printf("Saving gaussian blurred images ...\n\n");
+
+	if(save_BMP(ImgGaussFIR, "saida16-GaussFIR.bmp") == -1)
+		exit_msg("Error: Could not save \"GaussFIR\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgGaussIIR, "saida17-GaussIIR.bmp") == -1)
+		exit_msg("Error: Could not save \"GaussIIR\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgGaussFIR);
+	free_img(ImgGaussIIR);
+
+	/*===========================================================================*/
+	/*                        TESTING: parallel_gradient()                       */
+	/*===========================================================================*/
+	printf("Making gradient (SOBEL, L2, 4 orientation bins) ...\n");
+	ImgGradient = parallel_gradient(ImgToGrayAverage, GRADIENT_SOBEL, GRADIENT_L2, &ImgOrientation, 4,
+	                                ThreadNum, BORDER_BLACK);
+	if(ImgGradient == NULL)
+		exit_msg("Error: Could not make gradient (SOBEL, L2).\n", EXIT_FAILURE);
+
+	printf("Saving gradient magnitude image ...\n\n");
+
+	if(save_BMP(ImgGradient, "saida18-GradientSobel.bmp") == -1)
+		exit_msg("Error: Could not save \"GradientSobel\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgGradient);
+	free_img(ImgOrientation);
+
+	/*===========================================================================*/
+	/*                          TESTING: median_filter()                         */
+	/*===========================================================================*/
+	printf("Making median filter (GRAY, radius 1) ...\n");
+	ImgMedianGray = median_filter(ImgToGrayAverage, 1, ThreadNum, BORDER_BLACK);
+	if(ImgMedianGray == NULL)
+		exit_msg("Error: Could not make median filter (GRAY).\n", EXIT_FAILURE);
+
+	printf("Making median filter (RGB, radius 5) ...\n");
+	ImgMedianRGB = median_filter(InputImage, 5, ThreadNum, BORDER_BLACK);
+	if(ImgMedianRGB == NULL)
+		exit_msg("Error: Could not make median filter (RGB).\n", EXIT_FAILURE);
+
+	printf("Saving median filtered images ...\n\n");
+
+	if(save_BMP(ImgMedianGray, "saida19-MedianGray.bmp") == -1)
+		exit_msg("Error: Could not save \"MedianGray\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgMedianRGB, "saida20-MedianRGB.bmp") == -1)
+		exit_msg("Error: Could not save \"MedianRGB\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgMedianGray);
+	free_img(ImgMedianRGB);
+
+	/*===========================================================================*/
+	/*                           TESTING: morphology()                           */
+	/*===========================================================================*/
+	printf("Making morphology (OPEN, 9x15) ...\n");
+	ImgOpen = morphology(ImgToGrayAverage, MORPH_OPEN, 9, 15, ThreadNum, BORDER_BLACK);
+	if(ImgOpen == NULL)
+		exit_msg("Error: Could not make morphology (OPEN).\n", EXIT_FAILURE);
+
+	printf("Making morphology (TOPHAT, 21x21) ...\n");
+	ImgTopHat = morphology(ImgToGrayAverage, MORPH_TOPHAT, 21, 21, ThreadNum, BORDER_WHITE);
+	if(ImgTopHat == NULL)
+		exit_msg("Error: Could not make morphology (TOPHAT).\n", EXIT_FAILURE);
+
+	printf("Saving morphology images ...\n\n");
+
+	if(save_BMP(ImgOpen, "saida21-MorphOpen.bmp") == -1)
+		exit_msg("Error: Could not save \"MorphOpen\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgTopHat, "saida22-MorphTopHat.bmp") == -1)
+		exit_msg("Error: Could not save \"MorphTopHat\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgOpen);
+	free_img(ImgTopHat);
+
+	/*===========================================================================*/
+	/*                 TESTING: histogram_compute() and new_ROI_view()           */
+	/*===========================================================================*/
+	printf("Computing histogram (GRAY, ROI view) ...\n");
+	ImgView = new_ROI_view(ImgToGrayAverage, 0, 0, ImgToGrayAverage->Height/2, ImgToGrayAverage->Width/2);
+	if(ImgView == NULL)
+		exit_msg("Error: Could not create ROI view.\n", EXIT_FAILURE);
+
+	if(histogram_compute(ImgView, HistGray, ThreadNum) == -1)
+		exit_msg("Error: Could not compute histogram (GRAY).\n", EXIT_FAILURE);
+
+	free_ROI_view(ImgView);
+
+	printf("Computing histogram (RGB) ...\n\n");
+	if(histogram_compute(InputImage, HistRGB, ThreadNum) == -1)
+		exit_msg("Error: Could not compute histogram (RGB).\n", EXIT_FAILURE);
+
+	/*===========================================================================*/
+	/*                 TESTING: histogram_equalization() and clahe()             */
+	/*===========================================================================*/
+	printf("Making histogram equalization ...\n");
+	ImgEqualized = histogram_equalization(ImgToGrayAverage, ThreadNum);
+	if(ImgEqualized == NULL)
+		exit_msg("Error: Could not make histogram equalization.\n", EXIT_FAILURE);
+
+	printf("Making CLAHE (8x8 tiles, clip 2.0) ...\n");
+	ImgCLAHE = clahe(ImgToGrayAverage, 8, 8, 2.0, ThreadNum);
+	if(ImgCLAHE == NULL)
+		exit_msg("Error: Could not make CLAHE.\n", EXIT_FAILURE);
+
+	printf("Saving equalized images ...\n\n");
+
+	if(save_BMP(ImgEqualized, "saida23-Equalized.bmp") == -1)
+		exit_msg("Error: Could not save \"Equalized\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgCLAHE, "saida24-CLAHE.bmp") == -1)
+		exit_msg("Error: Could not save \"CLAHE\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgEqualized);
+	free_img(ImgCLAHE);
+
+	/*===========================================================================*/
+	/*            TESTING: otsu_threshold() and adaptive_threshold()             */
+	/*===========================================================================*/
+	printf("Computing Otsu threshold ...\n");
+	OtsuLevel = otsu_threshold(ImgToGrayAverage, ThreadNum);
+	if(OtsuLevel == -1)
+		exit_msg("Error: Could not compute Otsu threshold.\n", EXIT_FAILURE);
+
+	ImgOtsu = threshold(ImgToGrayAverage, (uint8_t)OtsuLevel, ThreadNum);
+	if(ImgOtsu == NULL)
+		exit_msg("Error: Could not make threshold (OTSU).\n", EXIT_FAILURE);
+
+	printf("Making adaptive threshold (SAUVOLA, radius 15) ...\n");
+	ImgSauvola = adaptive_threshold(ImgToGrayAverage, ADAPTIVE_SAUVOLA, 15, 0.3, ThreadNum);
+	if(ImgSauvola == NULL)
+		exit_msg("Error: Could not make adaptive threshold (SAUVOLA).\n", EXIT_FAILURE);
+
+	SauvolaMask = adaptive_threshold_mask(ImgToGrayAverage, ADAPTIVE_SAUVOLA, 15, 0.3, ThreadNum);
+	if(SauvolaMask == NULL)
+		exit_msg("Error: Could not make adaptive threshold mask (SAUVOLA).\n", EXIT_FAILURE);
+
+	printf("Saving thresholded images ...\n\n");
+
+	if(save_BMP(ImgOtsu, "saida25-Otsu.bmp") == -1)
+		exit_msg("Error: Could not save \"Otsu\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgSauvola, "saida26-Sauvola.bmp") == -1)
+		exit_msg("Error: Could not save \"Sauvola\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgOtsu);
+	free_img(ImgSauvola);
+	free_bit_mask(SauvolaMask);
+
+	/*===========================================================================*/
+	/*                 TESTING: integral_image() and integral_sum()              */
+	/*===========================================================================*/
+	printf("Computing integral images (UINT32 and squared UINT64) ...\n");
+	Integral = integral_image(ImgToGrayAverage, INTEGRAL_UINT32, ThreadNum);
+	if(Integral == NULL)
+		exit_msg("Error: Could not compute integral image.\n", EXIT_FAILURE);
+
+	IntegralSq = integral_image_sq(ImgToGrayAverage, INTEGRAL_UINT64, ThreadNum);
+	if(IntegralSq == NULL)
+		exit_msg("Error: Could not compute squared integral image.\n", EXIT_FAILURE);
+
+	WindowMean = integral_sum(Integral, 0, 0, ImgToGrayAverage->Height, ImgToGrayAverage->Width) /
+	             ((double)ImgToGrayAverage->Height * ImgToGrayAverage->Width);
+	printf("Image mean: %.3f\n\n", WindowMean);
+
+	free_integral(Integral);
+	free_integral(IntegralSq);
+
+	/*===========================================================================*/
+	/*                      TESTING: connected_components()                      */
+	/*===========================================================================*/
+	printf("Labeling connected components of Otsu binarization ...\n");
+	ImgBinary = threshold(ImgToGrayAverage, (uint8_t)OtsuLevel, ThreadNum);
+	if(ImgBinary == NULL)
+		exit_msg("Error: Could not make threshold.\n", EXIT_FAILURE);
+
+	Components = connected_components(ImgBinary, ThreadNum);
+	if(Components == NULL)
+		exit_msg("Error: Could not label connected components.\n", EXIT_FAILURE);
+
+	Largest = 0;
+	for(uint32_t i = 1; i < Components->Count; i++)
+	{
+		if(Components->Blobs[i].Area > Components->Blobs[Largest].Area)
+			Largest = i;
+	}
+
+	printf("Components: %u\n", Components->Count);
+	if(Components->Count > 0)
+		printf("Largest: area %u, box (%d, %d)-(%d, %d), centroid (%.1f, %.1f)\n\n",
+		       Components->Blobs[Largest].Area,
+		       Components->Blobs[Largest].Left, Components->Blobs[Largest].Top,
+		       Components->Blobs[Largest].Right, Components->Blobs[Largest].Bottom,
+		       Components->Blobs[Largest].CentroidX, Components->Blobs[Largest].CentroidY);
+
+	free_components(Components);
+	free_img(ImgBinary);
+
+	/*===========================================================================*/
+	/*                 TESTING: ncc_map() and match_template()                   */
+	/*===========================================================================*/
+	printf("Matching template cut from the image center ...\n");
+	ImgTemplate = new_ROI_view(ImgToGrayAverage, ImgToGrayAverage->Height/2 - 24,
+	                           ImgToGrayAverage->Width/2 - 24, 48, 48);
+	if(ImgTemplate == NULL)
+		exit_msg("Error: Could not create template view.\n", EXIT_FAILURE);
+
+	ScoreMap = ncc_map(ImgToGrayAverage, ImgTemplate, ThreadNum);
+	if(ScoreMap == NULL)
+		exit_msg("Error: Could not compute NCC map.\n", EXIT_FAILURE);
+
+	ImgScore = float_map_to_img(ScoreMap);
+	if(ImgScore == NULL)
+		exit_msg("Error: Could not convert NCC map.\n", EXIT_FAILURE);
+
+	MatchesNum = match_template(ImgToGrayAverage, ImgTemplate, 2, 0.8, Matches, 4, ThreadNum);
+	if(MatchesNum == -1)
+		exit_msg("Error: Could not match template.\n", EXIT_FAILURE);
+
+	for(int32_t i = 0; i < MatchesNum; i++)
+		printf("Match %d: row %d, column %d, score %.3f\n", i, Matches[i].Row, Matches[i].Column, Matches[i].Score);
+
+	printf("Saving NCC map ...\n\n");
+
+	if(save_BMP(ImgScore, "saida27-NCC.bmp") == -1)
+		exit_msg("Error: Could not save \"NCC\" image file.\n", EXIT_FAILURE);
+
+	free_ROI_view(ImgTemplate);
+	free_float_map(ScoreMap);
+	free_img(ImgScore);
+
+	/*===========================================================================*/
+	/*                       TESTING: distance_transform()                       */
+	/*===========================================================================*/
+	printf("Making distance transform of Otsu binarization ...\n");
+	ImgBinary = threshold(ImgToGrayAverage, (uint8_t)OtsuLevel, ThreadNum);
+	if(ImgBinary == NULL)
+		exit_msg("Error: Could not make threshold.\n", EXIT_FAILURE);
+
+	DistanceMap = distance_transform(ImgBinary, ThreadNum);
+	if(DistanceMap == NULL)
+		exit_msg("Error: Could not make distance transform.\n", EXIT_FAILURE);
+
+	ImgDistance = float_map_to_img(DistanceMap);
+	if(ImgDistance == NULL)
+		exit_msg("Error: Could not convert distance map.\n", EXIT_FAILURE);
+
+	printf("Saving distance map ...\n\n");
+
+	if(save_BMP(ImgDistance, "saida28-Distance.bmp") == -1)
+		exit_msg("Error: Could not save \"Distance\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgBinary);
+	free_float_map(DistanceMap);
+	free_img(ImgDistance);
+
+	/*===========================================================================*/
+	/*                          TESTING: hough_lines()                           */
+	/*===========================================================================*/
+	printf("Finding lines with Hough transform (36 orientation bins) ...\n");
+	ImgGradient = parallel_gradient(ImgToGrayAverage, GRADIENT_SOBEL, GRADIENT_L1, &ImgOrientation, 36,
+	                                ThreadNum, BORDER_WHITE);
+	if(ImgGradient == NULL)
+		exit_msg("Error: Could not make gradient.\n", EXIT_FAILURE);
+
+	LinesNum = hough_lines(ImgGradient, 128, ImgOrientation, 36, 180, 50, Lines, 8, ThreadNum);
+	if(LinesNum == -1)
+		exit_msg("Error: Could not find lines.\n", EXIT_FAILURE);
+
+	for(int32_t i = 0; i < LinesNum; i++)
+		printf("Line %d: rho %.1f, theta %.1f degrees, %u votes\n", i, Lines[i].Rho,
+		       Lines[i].Theta * 180.0 / M_PI, Lines[i].Votes);
+	printf("\n");
+
+	free_img(ImgGradient);
+	free_img(ImgOrientation);
+
+	/*===========================================================================*/
+	/*                  TESTING: fast_corners() / harris_corners()               */
+	/*===========================================================================*/
+	printf("Detecting FAST-9 corners (threshold 20, 16x16 grid) ...\n");
+	CornersNum = fast_corners(ImgToGrayAverage, 9, 20, 16, Corners, 5, ThreadNum);
+	if(CornersNum == -1)
+		exit_msg("Error: Could not detect FAST corners.\n", EXIT_FAILURE);
+
+	for(int32_t i = 0; i < CornersNum; i++)
+		printf("Corner %d: (%d, %d) score %.1f\n", i, Corners[i].X, Corners[i].Y, Corners[i].Score);
+	printf("\n");
+
+	printf("Detecting Shi-Tomasi corners (gaussian window radius 2, 16x16 grid) ...\n");
+	CornersNum = harris_corners(ImgToGrayAverage, CORNER_SHI_TOMASI, CORNER_WINDOW_GAUSSIAN, 2, 0.04f, 10.0f,
+	                            16, Corners, 5, ThreadNum);
+	if(CornersNum == -1)
+		exit_msg("Error: Could not detect Shi-Tomasi corners.\n", EXIT_FAILURE);
+
+	for(int32_t i = 0; i < CornersNum; i++)
+		printf("Corner %d: (%d, %d) score %.1f\n", i, Corners[i].X, Corners[i].Y, Corners[i].Score);
+	printf("\n");
+
+	/*===========================================================================*/
+	/*                          TESTING: image_stats()                           */
+	/*===========================================================================*/
+	printf("Computing image statistics ...\n");
+	if(image_stats(ImgToGrayAverage, &Stats, 1, ThreadNum) == -1)
+		exit_msg("Error: Could not compute gray statistics.\n", EXIT_FAILURE);
+
+	printf("Gray: min %u at (%d, %d), max %u at (%d, %d), mean %.2f, std dev %.2f\n",
+	       Stats.Min[0], Stats.MinX[0], Stats.MinY[0], Stats.Max[0], Stats.MaxX[0], Stats.MaxY[0],
+	       Stats.Mean[0], Stats.StdDev[0]);
+
+	if(image_stats(InputImage, &Stats, 0, ThreadNum) == -1)
+		exit_msg("Error: Could not compute RGB statistics.\n", EXIT_FAILURE);
+
+	printf("Red: mean %.2f, std dev %.2f\n", Stats.Mean[PASS_RED_CHANNEL], Stats.StdDev[PASS_RED_CHANNEL]);
+	printf("Green: mean %.2f, std dev %.2f\n", Stats.Mean[PASS_GREEN_CHANNEL], Stats.StdDev[PASS_GREEN_CHANNEL]);
+	printf("Blue: mean %.2f, std dev %.2f\n\n", Stats.Mean[PASS_BLUE_CHANNEL], Stats.StdDev[PASS_BLUE_CHANNEL]);
+
+	/*===========================================================================*/
+	/*             TESTING: parallel_RGB_to_grayscale() / read_BMP_gray()        */
+	/*===========================================================================*/
+	printf("Converting to grayscale with threads and while decoding (GRAY_LUMI_PERCEP) ...\n");
+	ImgGrayParallel = parallel_RGB_to_grayscale(InputImage, GRAY_LUMI_PERCEP, ThreadNum);
+	if(ImgGrayParallel == NULL)
+		exit_msg("Error: Could not convert to grayscale.\n", EXIT_FAILURE);
+
+	ImgGrayDecoded = read_BMP_gray(argv[1], GRAY_LUMI_PERCEP);
+	if(ImgGrayDecoded == NULL)
+		exit_msg("Error: Could not read image as grayscale.\n", EXIT_FAILURE);
+
+	Differences = 0;
+	for(int32_t Row = 0; Row < ImgGrayParallel->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < ImgGrayParallel->Width; Column++)
+			Differences += (ImgGrayParallel->Pixel8[Row][Column] != ImgGrayDecoded->Pixel8[Row][Column]);
+	}
+	printf("Pixels differing: %d\n\n", Differences);
+
+	if(save_BMP(ImgGrayDecoded, "saida29-Gray_decoded.bmp") == -1)
+		exit_msg("Error: Could not save \"Gray_decoded\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgGrayParallel);
+	free_img(ImgGrayDecoded);
+
+	/*===========================================================================*/
+	/*                          TESTING: point_lut_apply()                       */
+	/*===========================================================================*/
+	printf("Applying fused point operations (levels, gamma, contrast, warmer colors) ...\n\n");
+	point_lut_identity(&PointLut);
+	point_lut_levels(&PointLut, POINT_ALL_CHANNELS, 10, 245, 0, 255);
+	point_lut_gamma(&PointLut, POINT_ALL_CHANNELS, 0.8f);
+	point_lut_contrast(&PointLut, POINT_ALL_CHANNELS, 1.2f);
+	point_lut_brightness(&PointLut, PASS_RED_CHANNEL, 15);
+	point_lut_brightness(&PointLut, PASS_BLUE_CHANNEL, -15);
+
+	ImgPoint = point_lut_apply(InputImage, &PointLut, ThreadNum);
+	if(ImgPoint == NULL)
+		exit_msg("Error: Could not apply point operations.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgPoint, "saida30-Point_ops.bmp") == -1)
+		exit_msg("Error: Could not save \"Point_ops\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgPoint);
+
+	/*===========================================================================*/
+	/*          TESTING: split_channels() / merge_channels() / channel views     */
+	/*===========================================================================*/
+	printf("Splitting and merging channels ...\n");
+	if(split_channels(InputImage, &ImgRedPlane, &ImgGreenPlane, &ImgBluePlane, ThreadNum) == -1)
+		exit_msg("Error: Could not split channels.\n", EXIT_FAILURE);
+
+	ImgMerged = merge_channels(ImgRedPlane, ImgGreenPlane, ImgBluePlane, ThreadNum);
+	GreenView = new_channel_view(InputImage, PASS_GREEN_CHANNEL);
+	if((ImgMerged == NULL) || (GreenView == NULL))
+		exit_msg("Error: Could not merge channels or create view.\n", EXIT_FAILURE);
+
+	Differences = 0;
+	for(int32_t Row = 0; Row < InputImage->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < InputImage->Width; Column++)
+		{
+			Differences += (ImgMerged->Pixel24[Row][Column].Red != InputImage->Pixel24[Row][Column].Red);
+			Differences += (GreenView->Rows[Row][Column * GreenView->Step] != ImgGreenPlane->Pixel8[Row][Column]);
+		}
+	}
+	printf("Pixels differing: %d\n\n", Differences);
+
+	if(save_BMP(ImgRedPlane, "saida31-Red_plane.bmp") == -1)
+		exit_msg("Error: Could not save \"Red_plane\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgRedPlane);
+	free_img(ImgGreenPlane);
+	free_img(ImgBluePlane);
+	free_img(ImgMerged);
+	free_channel_view(GreenView);
+
+	/*===========================================================================*/
+	/*                          TESTING: convert_color()                         */
+	/*===========================================================================*/
+	printf("Converting color spaces ...\n");
+	ImgHSV = convert_color(InputImage, COLOR_RGB_TO_HSV, ThreadNum);
+	if(ImgHSV == NULL)
+		exit_msg("Error: Could not convert to HSV.\n", EXIT_FAILURE);
+
+	ImgHSVBack = convert_color(ImgHSV, COLOR_HSV_TO_RGB, ThreadNum);
+	if(ImgHSVBack == NULL)
+		exit_msg("Error: Could not convert from HSV.\n", EXIT_FAILURE);
+
+	if(convert_color_to_planes(InputImage, COLOR_RGB_TO_LAB, LabPlanes, ThreadNum) == -1)
+		exit_msg("Error: Could not convert to Lab.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgHSVBack, "saida32-HSV_round_trip.bmp") == -1)
+		exit_msg("Error: Could not save \"HSV_round_trip\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(LabPlanes[0], "saida33-Lab_lightness.bmp") == -1)
+		exit_msg("Error: Could not save \"Lab_lightness\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgHSV);
+	free_img(ImgHSVBack);
+	for(int32_t i = 0; i < 3; i++)
+		free_img(LabPlanes[i]);
+
+	/*===========================================================================*/
+	/*                           TESTING: resize_image()                         */
+	/*===========================================================================*/
+	printf("Resizing image ...\n");
+	ImgHalf = resize_image(InputImage, InputImage->Width/2, InputImage->Height/2, RESIZE_AREA, ThreadNum);
+	if(ImgHalf == NULL)
+		exit_msg("Error: Could not reduce image.\n", EXIT_FAILURE);
+
+	ImgEnlarged = resize_image(ImgHalf, InputImage->Width, InputImage->Height, RESIZE_BILINEAR, ThreadNum);
+	if(ImgEnlarged == NULL)
+		exit_msg("Error: Could not enlarge image.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgHalf, "saida34-Resize_half.bmp") == -1)
+		exit_msg("Error: Could not save \"Resize_half\" image file.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgEnlarged, "saida35-Resize_enlarged.bmp") == -1)
+		exit_msg("Error: Could not save \"Resize_enlarged\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgHalf);
+	free_img(ImgEnlarged);
+
+	/*===========================================================================*/
+	/*            TESTING: gaussian_pyramid() / laplacian_pyramid()              */
+	/*===========================================================================*/
+	printf("Building image pyramids ...\n");
+	Pyramid = gaussian_pyramid(ImgToGrayAverage, 4, ThreadNum);
+	if(Pyramid == NULL)
+		exit_msg("Error: Could not build Gaussian pyramid.\n", EXIT_FAILURE);
+
+	/* Levels live inside the pyramid allocation, so a copy is saved */
+	ImgCollapsed = copy_BMP(&Pyramid->Level[2]);
+	if(ImgCollapsed == NULL)
+		exit_msg("Error: Could not copy pyramid level.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgCollapsed, "saida36-Pyramid_level2.bmp") == -1)
+		exit_msg("Error: Could not save \"Pyramid_level2\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgCollapsed);
+	free_pyramid(Pyramid);
+
+	Pyramid = laplacian_pyramid(ImgToGrayAverage, 4, ThreadNum);
+	if(Pyramid == NULL)
+		exit_msg("Error: Could not build Laplacian pyramid.\n", EXIT_FAILURE);
+
+	ImgCollapsed = collapse_laplacian(Pyramid, ThreadNum);
+	if(ImgCollapsed == NULL)
+		exit_msg("Error: Could not collapse Laplacian pyramid.\n", EXIT_FAILURE);
+
+	Differences = 0;
+	for(int32_t Row = 0; Row < ImgToGrayAverage->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < ImgToGrayAverage->Width; Column++)
+			Differences += (ImgCollapsed->Pixel8[Row][Column] != ImgToGrayAverage->Pixel8[Row][Column]);
+	}
+	printf("Pixels differing: %d\n\n", Differences);
+
+	free_pyramid(Pyramid);
+	free_img(ImgCollapsed);
+
+	/*===========================================================================*/
+	/*                  TESTING: warp_affine() / warp_perspective()              */
+	/*===========================================================================*/
+	printf("Warping image ...\n");
+	rotation_matrix(InputImage->Width / 2.0, InputImage->Height / 2.0, 10.0, 1.0, WarpMatrix);
+	ImgWarped = warp_affine(InputImage, WarpMatrix, InputImage->Width, InputImage->Height,
+	                        WARP_BILINEAR, BORDER_WHITE, ThreadNum);
+	if(ImgWarped == NULL)
+		exit_msg("Error: Could not rotate image.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgWarped, "saida37-Warp_rotated.bmp") == -1)
+		exit_msg("Error: Could not save \"Warp_rotated\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgWarped);
+
+	/* Quadrilateral inside the image stretched to the whole output */
+	Corners4[0] = InputImage->Width * 0.1;	Corners4[1] = InputImage->Height * 0.2;
+	Corners4[2] = InputImage->Width * 0.9;	Corners4[3] = InputImage->Height * 0.1;
+	Corners4[4] = InputImage->Width * 0.8;	Corners4[5] = InputImage->Height * 0.9;
+	Corners4[6] = InputImage->Width * 0.2;	Corners4[7] = InputImage->Height * 0.8;
+	Rectified4[0] = 0.0;					Rectified4[1] = 0.0;
+	Rectified4[2] = InputImage->Width - 1;	Rectified4[3] = 0.0;
+	Rectified4[4] = InputImage->Width - 1;	Rectified4[5] = InputImage->Height - 1;
+	Rectified4[6] = 0.0;					Rectified4[7] = InputImage->Height - 1;
+
+	if(perspective_matrix(Corners4, Rectified4, WarpMatrix) == -1)
+		exit_msg("Error: Could not compute perspective matrix.\n", EXIT_FAILURE);
+
+	ImgWarped = warp_perspective(InputImage, WarpMatrix, InputImage->Width, InputImage->Height,
+	                             WARP_BILINEAR, BORDER_REPLICATE, ThreadNum);
+	if(ImgWarped == NULL)
+		exit_msg("Error: Could not rectify image.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgWarped, "saida38-Warp_rectified.bmp") == -1)
+		exit_msg("Error: Could not save \"Warp_rectified\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgWarped);
+
+	/*===========================================================================*/
+	/*             TESTING: unsharp_mask() / difference_of_gaussians()           */
+	/*===========================================================================*/
+	printf("Sharpening image ...\n");
+	ImgSharpened = unsharp_mask(InputImage, 2.0, 1.5, 3, ThreadNum, BORDER_REPLICATE);
+	if(ImgSharpened == NULL)
+		exit_msg("Error: Could not sharpen image.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgSharpened, "saida39-Unsharp.bmp") == -1)
+		exit_msg("Error: Could not save \"Unsharp\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgSharpened);
+
+	printf("Computing difference of gaussians ...\n");
+	ImgSharpened = difference_of_gaussians(ImgToGrayAverage, 1.0, 3.0, 4.0, ThreadNum, BORDER_REFLECT);
+	if(ImgSharpened == NULL)
+		exit_msg("Error: Could not compute difference of gaussians.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgSharpened, "saida40-DoG.bmp") == -1)
+		exit_msg("Error: Could not save \"DoG\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgSharpened);
+
+	/*===========================================================================*/
+	/*                           TESTING: canny_edges()                          */
+	/*===========================================================================*/
+	printf("Detecting Canny edges ...\n");
+	ImgCanny = canny_edges(ImgToGrayAverage, 1.4, 40, 100, GRADIENT_SOBEL, GRADIENT_L1, ThreadNum, BORDER_REPLICATE);
+	if(ImgCanny == NULL)
+		exit_msg("Error: Could not detect Canny edges.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgCanny, "saida41-Canny.bmp") == -1)
+		exit_msg("Error: Could not save \"Canny\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgCanny);
+
+	/*===========================================================================*/
+	/*                 TESTING: guided_filter() / bilateral_grid()               */
+	/*===========================================================================*/
+	printf("Smoothing image with guided filter ...\n");
+	ImgSmoothed = guided_filter(InputImage, NULL, 4, 400.0, ThreadNum);
+	if(ImgSmoothed == NULL)
+		exit_msg("Error: Could not apply guided filter.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgSmoothed, "saida42-Guided.bmp") == -1)
+		exit_msg("Error: Could not save \"Guided\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgSmoothed);
+
+	printf("Smoothing image with bilateral grid ...\n");
+	ImgSmoothed = bilateral_grid(InputImage, 8.0, 20.0, ThreadNum);
+	if(ImgSmoothed == NULL)
+		exit_msg("Error: Could not apply bilateral grid.\n", EXIT_FAILURE);
+
+	if(save_BMP(ImgSmoothed, "saida43-Bilateral.bmp") == -1)
+		exit_msg("Error: Could not save \"Bilateral\" image file.\n", EXIT_FAILURE);
+
+	free_img(ImgSmoothed);
+
+	/* Sigma whose reciprocal rounds up on the last pixel of a 28 pixels wide image */
+	ImgTiny = new_BMP(28, 28, GRAY_8BITS);
+	if(ImgTiny == NULL)
+		exit_msg("Error: Could not create small image.\n", EXIT_FAILURE);
+
+	for(int32_t Row = 0; Row < ImgTiny->Height; Row++)
+	{
+		for(int32_t Column = 0; Column < ImgTiny->Width; Column++)
+			ImgTiny->Pixel8[Row][Column] = ImgToGrayAverage->Pixel8[Row][Column];
+	}
+
+	ImgSmoothed = bilateral_grid(ImgTiny, 1.08, 20.0, 2);
+	if(ImgSmoothed == NULL)
+		exit_msg("Error: Could not apply bilateral grid on small image.\n", EXIT_FAILURE);
+
+	free_img(ImgSmoothed);
+	free_img(ImgTiny);
+
 	/*===========================================================================*/
 	/*                           TESTING: free_kernel()                          */
 	/*===========================================================================*/